@@ -20,6 +20,10 @@ extern "C" {
 #define STM32_SRAM_SIZE        (128)
 #define STM32_SRAM_END         (0x20000000 + STM32_SRAM_SIZE * 1024)
 
+#define STM32_CCM_BEGIN        (0x10000000)
+#define STM32_CCM_SIZE         (64)
+#define STM32_CCM_END          (STM32_CCM_BEGIN + STM32_CCM_SIZE * 1024)
+
 #define STM32_FLASH_START_ADRESS     ((uint32_t)0x08000000)
 #define STM32_FLASH_SIZE             (1024 * 1024)
 #define STM32_FLASH_END_ADDRESS      ((uint32_t)(STM32_FLASH_START_ADRESS + STM32_FLASH_SIZE))
@@ -37,6 +41,17 @@ extern int __bss_end;
 
 #define HEAP_END        STM32_SRAM_END
 
+#if defined(__ARMCC_VERSION)
+/* the scatter file puts the lwip pools into the ccm ram, the heap takes the rest */
+extern int Image$$RW_IRAM2$$ZI$$Limit;
+#define CCM_HEAP_BEGIN  ((void *)&Image$$RW_IRAM2$$ZI$$Limit)
+#else
+/* gcc and iar link nothing into the ccm ram, the heap is all of it */
+#define CCM_HEAP_BEGIN  ((void *)STM32_CCM_BEGIN)
+#endif
+
+#define CCM_HEAP_END    STM32_CCM_END
+
 void SystemClock_Config(void);
 
 #ifdef __cplusplus
@@ -0,0 +1,192 @@
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_DEVICE_IPC) && defined(RT_USING_HEAP)
+
+#include "chry_ringbuffer.h"
+
+/*
+ * chry_ringbuffer spsc against rt_ringbuffer, the serial v1/v2 way: producer puts and releases a
+ * semaphore for every chunk. The spsc consumer asks for <batch> bytes and is only signalled when
+ * they are there. Producer runs below the consumer like an isr feeding a thread, every chunk carries
+ * the DWT cycle counter so the consumer gets the latency from put to get.
+ */
+
+#define RB_BENCH_POOL_SIZE 4096
+#define RB_BENCH_TOTAL     (1024 * 1024)
+#define RB_BENCH_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+struct rb_bench {
+    rt_bool_t is_spsc;
+    rt_uint32_t chunk;
+    rt_uint32_t batch;
+    chry_ringbuffer_spsc_t spsc;
+    struct rt_ringbuffer rb;
+    struct rt_semaphore rx_sem;
+    struct rt_semaphore tx_sem;
+    struct rt_semaphore done_sem;
+    rt_uint32_t wakeups;
+    rt_uint32_t lat_sum;
+    rt_uint32_t lat_max;
+    rt_uint32_t lat_num;
+};
+
+static int rb_bench_wait(void *event, uint32_t timeout)
+{
+    return rt_sem_take((rt_sem_t)event, timeout);
+}
+
+static void rb_bench_signal(void *event)
+{
+    rt_sem_release((rt_sem_t)event);
+}
+
+static void rb_bench_producer(void *parameter)
+{
+    struct rb_bench *b = (struct rb_bench *)parameter;
+    rt_uint8_t buf[256];
+
+    rt_memset(buf, 0x5a, sizeof(buf));
+    for (rt_uint32_t sent = 0; sent < RB_BENCH_TOTAL; sent += b->chunk) {
+        *(rt_uint32_t *)buf = DWT->CYCCNT;
+        if (b->is_spsc) {
+            chry_ringbuffer_spsc_wait_free(&b->spsc, b->chunk, RT_WAITING_FOREVER);
+            chry_ringbuffer_spsc_write(&b->spsc, buf, b->chunk);
+        } else {
+            while (rt_ringbuffer_space_len(&b->rb) < b->chunk) {
+                rt_sem_take(&b->tx_sem, RT_WAITING_FOREVER);
+            }
+            rt_ringbuffer_put(&b->rb, buf, b->chunk);
+            rt_sem_release(&b->rx_sem);
+        }
+    }
+}
+
+static void rb_bench_consumer(void *parameter)
+{
+    struct rb_bench *b = (struct rb_bench *)parameter;
+    rt_uint8_t buf[256];
+    rt_uint32_t stamp, lat;
+
+    for (rt_uint32_t recv = 0; recv < RB_BENCH_TOTAL;) {
+        if (b->is_spsc) {
+            chry_ringbuffer_spsc_wait_data(&b->spsc, RB_BENCH_MIN(b->batch, RB_BENCH_TOTAL - recv), RT_WAITING_FOREVER);
+        } else {
+            rt_sem_take(&b->rx_sem, RT_WAITING_FOREVER);
+        }
+        b->wakeups++;
+
+        for (;;) {
+            if (b->is_spsc) {
+                if (chry_ringbuffer_spsc_read(&b->spsc, buf, b->chunk) != b->chunk) {
+                    break;
+                }
+            } else {
+                if (rt_ringbuffer_get(&b->rb, buf, b->chunk) != b->chunk) {
+                    break;
+                }
+                rt_sem_release(&b->tx_sem);
+            }
+            stamp = *(rt_uint32_t *)buf;
+            lat = DWT->CYCCNT - stamp;
+            b->lat_sum += lat;
+            b->lat_num++;
+            if (lat > b->lat_max) {
+                b->lat_max = lat;
+            }
+            recv += b->chunk;
+        }
+    }
+    rt_sem_release(&b->done_sem);
+}
+
+static rt_err_t rb_bench_run(struct rb_bench *b, rt_uint8_t *pool)
+{
+    rt_thread_t prod, cons;
+    rt_uint8_t prio = rt_thread_self()->current_priority;
+    rt_tick_t tick;
+    rt_uint32_t mhz = SystemCoreClock / 1000000;
+
+    b->wakeups = b->lat_sum = b->lat_max = b->lat_num = 0;
+    rt_sem_init(&b->rx_sem, "rbrx", 0, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&b->tx_sem, "rbtx", 0, RT_IPC_FLAG_PRIO);
+    rt_sem_init(&b->done_sem, "rbdone", 0, RT_IPC_FLAG_PRIO);
+    if (b->is_spsc) {
+        chry_ringbuffer_spsc_init(&b->spsc, pool, RB_BENCH_POOL_SIZE);
+        chry_ringbuffer_spsc_set_event(&b->spsc, &b->rx_sem, &b->tx_sem, rb_bench_wait, rb_bench_signal);
+    } else {
+        rt_ringbuffer_init(&b->rb, pool, RB_BENCH_POOL_SIZE);
+    }
+
+    cons = rt_thread_create("rbcons", rb_bench_consumer, b, 1024, prio > 2 ? prio - 2 : 0, 10);
+    prod = rt_thread_create("rbprod", rb_bench_producer, b, 1024, prio > 1 ? prio - 1 : 0, 10);
+    if (cons == RT_NULL || prod == RT_NULL) {
+        if (cons) {
+            rt_thread_delete(cons);
+        }
+        if (prod) {
+            rt_thread_delete(prod);
+        }
+        return -RT_ENOMEM;
+    }
+
+    tick = rt_tick_get();
+    rt_thread_startup(cons);
+    rt_thread_startup(prod);
+    rt_sem_take(&b->done_sem, RT_WAITING_FOREVER);
+    tick = rt_tick_get() - tick;
+
+    rt_kprintf("%-13s chunk %3d: %5d KB/s, %6d wakeups, latency avg %d us max %d us\n",
+               b->is_spsc ? "chry spsc" : "rt_ringbuffer", b->chunk,
+               (RB_BENCH_TOTAL / 1024) * RT_TICK_PER_SECOND / (tick ? tick : 1), b->wakeups,
+               b->lat_num ? b->lat_sum / b->lat_num / mhz : 0, b->lat_max / mhz);
+
+    rt_thread_mdelay(10);
+    rt_sem_detach(&b->rx_sem);
+    rt_sem_detach(&b->tx_sem);
+    rt_sem_detach(&b->done_sem);
+    return RT_EOK;
+}
+
+static int chry_rb_bench(int argc, char **argv)
+{
+    static const rt_uint32_t chunks[] = { 16, 64, 256 };
+    struct rb_bench *b;
+    rt_uint8_t *pool;
+    rt_uint32_t batch = argc > 1 ? atoi(argv[1]) : 0;
+
+    b = rt_malloc(sizeof(struct rb_bench));
+    pool = rt_malloc(RB_BENCH_POOL_SIZE);
+    if (b == RT_NULL || pool == RT_NULL) {
+        rt_free(b);
+        rt_free(pool);
+        return -RT_ENOMEM;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    rt_kprintf("%d KB, pool %d bytes, spsc batch %d\n", RB_BENCH_TOTAL / 1024, RB_BENCH_POOL_SIZE, batch);
+    for (rt_uint32_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+        rt_memset(b, 0, sizeof(struct rb_bench));
+        b->chunk = chunks[i];
+        /* the spsc consumer wakes for at least one chunk, at most half the pool */
+        b->batch = RB_BENCH_MIN(RT_ALIGN(batch ? batch : b->chunk, b->chunk), RB_BENCH_POOL_SIZE / 2);
+        if (rb_bench_run(b, pool) != RT_EOK) {
+            break;
+        }
+        b->is_spsc = RT_TRUE;
+        if (rb_bench_run(b, pool) != RT_EOK) {
+            break;
+        }
+    }
+
+    rt_free(pool);
+    rt_free(b);
+    return 0;
+}
+MSH_CMD_EXPORT(chry_rb_bench, chry_ringbuffer spsc against rt_ringbuffer: chry_rb_bench [batch]);
+
+#endif
@@ -6,6 +6,11 @@
 #include "usbd_core.h"
 #include "usbd_msc.h"
 #include <board.h>
+#include <stdlib.h>
+#include <string.h>
+#ifdef BSP_USING_HEAP_CLASS
+#include <drv_heap.h>
+#endif
 
 #define MSC_IN_EP  0x81
 #define MSC_OUT_EP 0x01
@@ -126,32 +131,62 @@ static void usbd_event_handler(uint8_t busid, uint8_t event)
     }
 }
 
+/*
+ * Ram backed lun for msc throughput. Start it with "msc_bench start [KB]", format it on the host
+ * and time it there, e.g. dd if=/dev/sdX of=/dev/null bs=64k iflag=direct. "msc_bench" prints what
+ * the device saw since the last call: MB/s from the first to the last sector access, and how long
+ * each media access took, which the block buffer pipeline hides behind the bulk transfers.
+ */
 #define BLOCK_SIZE  512
-#define BLOCK_COUNT 10
 
-typedef struct
-{
-    uint8_t BlockSpace[BLOCK_SIZE];
-} BLOCK_TYPE;
+struct msc_ram_stat {
+    uint64_t bytes;
+    uint32_t calls;
+    uint32_t cycles;
+    rt_tick_t first;
+    rt_tick_t last;
+};
 
-static BLOCK_TYPE mass_block[BLOCK_COUNT];
+static uint8_t *msc_ram_disk;
+static uint32_t msc_ram_blocks;
+static struct msc_ram_stat msc_ram_read_stat;
+static struct msc_ram_stat msc_ram_write_stat;
+
+static void msc_ram_stat_add(struct msc_ram_stat *stat, uint32_t length, uint32_t start)
+{
+    stat->cycles += DWT->CYCCNT - start;
+    if (stat->calls++ == 0) {
+        stat->first = rt_tick_get();
+    }
+    stat->last = rt_tick_get();
+    stat->bytes += length;
+}
 
 void usbd_msc_get_cap(uint8_t busid, uint8_t lun, uint32_t *block_num, uint32_t *block_size)
 {
-    *block_num = 1000; //Pretend having so many buffer,not has actually.
+    *block_num = msc_ram_blocks;
     *block_size = BLOCK_SIZE;
 }
+
 int usbd_msc_sector_read(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length)
 {
-    if (sector < BLOCK_COUNT)
-        memcpy(buffer, mass_block[sector].BlockSpace, length);
+    uint32_t start = DWT->CYCCNT;
+
+    if ((length / BLOCK_SIZE > msc_ram_blocks) || (sector > msc_ram_blocks - length / BLOCK_SIZE))
+        return -1;
+    memcpy(buffer, &msc_ram_disk[sector * BLOCK_SIZE], length);
+    msc_ram_stat_add(&msc_ram_read_stat, length, start);
     return 0;
 }
 
 int usbd_msc_sector_write(uint8_t busid, uint8_t lun, uint32_t sector, uint8_t *buffer, uint32_t length)
 {
-    if (sector < BLOCK_COUNT)
-        memcpy(mass_block[sector].BlockSpace, buffer, length);
+    uint32_t start = DWT->CYCCNT;
+
+    if ((length / BLOCK_SIZE > msc_ram_blocks) || (sector > msc_ram_blocks - length / BLOCK_SIZE))
+        return -1;
+    memcpy(&msc_ram_disk[sector * BLOCK_SIZE], buffer, length);
+    msc_ram_stat_add(&msc_ram_write_stat, length, start);
     return 0;
 }
 
@@ -174,6 +209,23 @@ void msc_ram_polling(uint8_t busid)
 
 int msc_ram_demo(void)
 {
+    if (msc_ram_disk == NULL) {
+        if (msc_ram_blocks == 0) {
+            msc_ram_blocks = 64 * 1024 / BLOCK_SIZE;
+        }
+#ifdef BSP_USING_HEAP_CLASS
+        msc_ram_disk = heap_class_calloc(HEAP_CLASS_BULK, msc_ram_blocks, BLOCK_SIZE);
+#else
+        msc_ram_disk = rt_calloc(msc_ram_blocks, BLOCK_SIZE);
+#endif
+        if (msc_ram_disk == NULL) {
+            msc_ram_blocks = 0;
+            return -RT_ENOMEM;
+        }
+    }
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
 #ifdef BSP_USING_USB_OTG_FS
     msc_ram_init(0, USB_OTG_FS_PERIPH_BASE);
 #else
@@ -182,3 +234,49 @@ int msc_ram_demo(void)
 
     return RT_EOK;
 }
+
+/* the otg core is the host's without BSP_USING_USB_DEVICE, starting a device on it would take it from usbh */
+#if defined(RT_USING_FINSH) && defined(BSP_USING_USB_DEVICE)
+static void msc_bench_show(const char *name, struct msc_ram_stat *stat)
+{
+    uint32_t ms = (stat->last - stat->first) * 1000 / RT_TICK_PER_SECOND;
+    uint32_t kbps = ms ? (uint32_t)(stat->bytes / ms) : 0;
+
+    rt_kprintf("%-5s %8d KB in %6d ms, %d.%03d MB/s, %d accesses of %d us\n", name, (uint32_t)(stat->bytes / 1024), ms,
+               kbps / 1000, kbps % 1000, stat->calls,
+               stat->calls ? stat->cycles / stat->calls / (SystemCoreClock / 1000000) : 0);
+    rt_memset(stat, 0, sizeof(*stat));
+}
+
+static int msc_bench(int argc, char **argv)
+{
+    uint32_t size;
+
+    if (argc > 1 && strcmp(argv[1], "start") == 0) {
+        if (msc_ram_disk) {
+            rt_kprintf("msc ram disk already started\n");
+            return -RT_EBUSY;
+        }
+        size = argc > 2 ? atoi(argv[2]) : 64;
+        msc_ram_blocks = size * 1024 / BLOCK_SIZE;
+        if (msc_ram_blocks == 0 || msc_ram_demo() != RT_EOK) {
+            rt_kprintf("no memory for a %d KB disk\n", size);
+            msc_ram_blocks = 0;
+            return -RT_ENOMEM;
+        }
+        rt_kprintf("%d KB msc ram disk, block buffers of %d bytes\n", size, CONFIG_USBDEV_MSC_MAX_BUFSIZE);
+        return 0;
+    }
+    if (msc_ram_disk == NULL) {
+        rt_kprintf("usage: msc_bench start [KB]\n");
+        rt_kprintf("       msc_bench\n");
+        return -RT_EINVAL;
+    }
+
+    msc_bench_show("read", &msc_ram_read_stat);
+    msc_bench_show("write", &msc_ram_write_stat);
+
+    return 0;
+}
+MSH_CMD_EXPORT(msc_bench, msc ram disk throughput: msc_bench start [KB] | msc_bench);
+#endif
@@ -7,6 +7,7 @@
 #define CHERRYUSB_CONFIG_H
 
 #include <rtthread.h>
+#include <drv_common.h>
 
 #ifdef BSP_USING_USB_OTG_FS
 #define CONFIG_USBDEV_EP_NUM 4
@@ -42,6 +43,14 @@
  */
 #define CONFIG_USB_DWC2_RX_FIFO_SIZE ((1012 - CONFIG_USB_DWC2_NPTX_FIFO_SIZE - CONFIG_USB_DWC2_PTX_FIFO_SIZE))
 
+/* host always uses internal dma, unaligned urb buffer is copied through bounce buffers
+ * size must be a multiple of the largest ep mps
+ */
+#define CONFIG_USB_DWC2_BOUNCE_BUFFER_NUM  2
+#define CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE 512
+/* thread stacks may live in the ccm ram, which has no path to the otg dma */
+#define CONFIG_USB_DWC2_DMA_REACHABLE(addr) STM32_DMA_REACHABLE(addr)
+
 #define CONFIG_USB_DFS_MOUNT_POINT "/sda"
 
 #endif
@@ -90,6 +99,9 @@
 #define CONFIG_USBDEV_MSC_MAX_LUN 1
 #endif
 
+/* msc block buffer size, a multiple of the sector size. match the erase size of the media (4096 for spi nor)
+ * so that aligned host writes reach the media as whole erase blocks
+ */
 #ifndef CONFIG_USBDEV_MSC_MAX_BUFSIZE
 #define CONFIG_USBDEV_MSC_MAX_BUFSIZE 512
 #endif
@@ -112,6 +124,11 @@
 /* move msc read & write from isr to thread */
 // #define CONFIG_USBDEV_MSC_THREAD
 
+/* Number of msc block buffers, media access of one overlaps the bulk transfer of the other.
+ * 2 with CONFIG_USBDEV_MSC_THREAD or CONFIG_USBDEV_MSC_POLLING, else 1
+ */
+// #define CONFIG_USBDEV_MSC_BUFFER_NUM 2
+
 #ifndef CONFIG_USBDEV_MSC_PRIO
 #define CONFIG_USBDEV_MSC_PRIO 4
 #endif
@@ -124,9 +141,19 @@
 #define CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE 156
 #endif
 
-/* rndis transfer buffer size, must be a multiple of (1536 + 44)*/
+/* rndis transfer buffer size, must be a multiple of (1536 + 44), one frame per 1580 bytes in each transfer */
 #ifndef CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE
-#define CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE 1580
+#define CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE 3160
+#endif
+
+/* Number of rndis bulk out transfers buffered, frames in them are lent to lwip without copy */
+#ifndef CONFIG_USBDEV_RNDIS_RX_RING_DEPTH
+#define CONFIG_USBDEV_RNDIS_RX_RING_DEPTH 3
+#endif
+
+/* Number of rx frames lwip can hold in the rndis rx ring at once */
+#ifndef CONFIG_USBDEV_RNDIS_RX_PBUF_NUM
+#define CONFIG_USBDEV_RNDIS_RX_PBUF_NUM 8
 #endif
 
 #ifndef CONFIG_USBDEV_RNDIS_VENDOR_ID
@@ -183,20 +210,37 @@
 #define CONFIG_USBHOST_MSC_TIMEOUT 5000
 #endif
 
-/* This parameter affects usb performance, and depends on (TCP_WND)tcp eceive windows size,
- * you can change to 2K ~ 16K and must be larger than TCP RX windows size in order to avoid being overflow.
+/* Commands each msc lun can queue, luns of one device share the bulk pipes */
+#ifndef CONFIG_USBHOST_MSC_QUEUE_DEPTH
+#define CONFIG_USBHOST_MSC_QUEUE_DEPTH 2
+#endif
+
+/* Send cbw of the next command while csw of the current one is read, device naks it until ready.
+ * Off by default, not every device handles an early cbw.
+ */
+// #define CONFIG_USBHOST_MSC_CBW_AHEAD
+
+/* Number of bulk in transfers buffered by net class rx ring, each one costs a rx slot of memory */
+#ifndef CONFIG_USBHOST_BULKIN_RING_DEPTH
+#define CONFIG_USBHOST_BULKIN_RING_DEPTH 3
+#endif
+
+/* Size of one rx ring slot, device is limited to send at most one slot in a transfer.
+ * you can change to 2K ~ 16K, larger slot aggregates more frames in a transfer.
  */
 #ifndef CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE
 #define CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE (2048)
 #endif
 
-/* Because lwip do not support multi pbuf at a time, so increasing this variable has no performance improvement */
+/* Frames queued by lwip are aggregated into one transfer up to this size and device MaxTransferSize,
+ * a single frame is sent from its pbuf without copy.
+ */
 #ifndef CONFIG_USBHOST_RNDIS_ETH_MAX_TX_SIZE
 #define CONFIG_USBHOST_RNDIS_ETH_MAX_TX_SIZE (2048)
 #endif
 
-/* This parameter affects usb performance, and depends on (TCP_WND)tcp eceive windows size,
- * you can change to 2K ~ 16K and must be larger than TCP RX windows size in order to avoid being overflow.
+/* Size of one rx ring slot, device is limited to send at most one slot in a transfer.
+ * you can change to 2K ~ 16K, larger slot aggregates more frames in a transfer.
  */
 #ifndef CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE
 #define CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE (2048)
@@ -0,0 +1,93 @@
+#include <rtthread.h>
+#include <stdlib.h>
+
+#if defined(PKG_CHERRYUSB_DEVICE_CDC_RNDIS) && defined(CONFIG_USBDEV_RNDIS_USING_LWIP) && defined(RT_USING_FINSH)
+
+#include <usbd_core.h>
+#include <usbd_rndis.h>
+#include <lwip/pbuf.h>
+
+/*
+ * Rndis device throughput, with tools/test_srcipts/test_rndis_speed.py of CherryUSB standing in for the
+ * host driver. The script sends packed transfers of frames that lwip drops once the class handed them
+ * over, "rndis_bench tx [seconds] [len]" sends frames back as fast as the class takes them.
+ * "rndis_bench" prints the class counters since the last call: frames and transfers each way, frames
+ * per transfer, rx frames copied instead of lent from the rx ring, tx frames refused with both buffers full.
+ */
+
+static rt_tick_t rndis_bench_tick;
+
+static void rndis_bench_show(void)
+{
+    struct usbd_rndis_stat stat;
+    rt_uint32_t ms;
+
+    usbd_rndis_get_stat(&stat, RT_TRUE);
+    ms = (rt_tick_get() - rndis_bench_tick) * 1000 / RT_TICK_PER_SECOND;
+    rndis_bench_tick = rt_tick_get();
+
+    rt_kprintf("%d ms\n", ms);
+    rt_kprintf("rx %8d frames in %7d transfers, %d.%02d per transfer, %d copied, %d dropped\n", stat.rx_frames,
+               stat.rx_transfers, stat.rx_transfers ? stat.rx_frames / stat.rx_transfers : 0,
+               stat.rx_transfers ? stat.rx_frames * 100 / stat.rx_transfers % 100 : 0, stat.rx_copied, stat.rx_dropped);
+    rt_kprintf("tx %8d frames in %7d transfers, %d.%02d per transfer, %d refused\n", stat.tx_frames,
+               stat.tx_transfers, stat.tx_transfers ? stat.tx_frames / stat.tx_transfers : 0,
+               stat.tx_transfers ? stat.tx_frames * 100 / stat.tx_transfers % 100 : 0, stat.tx_busy);
+}
+
+static int rndis_bench_tx(rt_uint32_t seconds, rt_uint32_t len)
+{
+    static const rt_uint8_t head[14] = { 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x02, 0x00, 0x00, 0x00, 0x00, 0x02, 0x88, 0xb5 };
+    struct pbuf *p;
+    rt_tick_t start;
+    rt_uint32_t frames = 0, ms;
+    int ret = 0;
+
+    p = pbuf_alloc(PBUF_RAW, len, PBUF_RAM);
+    if (p == RT_NULL) {
+        return -RT_ENOMEM;
+    }
+    rt_memset(p->payload, 0x55, len);
+    rt_memcpy(p->payload, head, sizeof(head));
+
+    start = rt_tick_get();
+    while (rt_tick_get() - start < seconds * RT_TICK_PER_SECOND) {
+        ret = usbd_rndis_eth_tx(p);
+        if (ret == -USB_ERR_BUSY) {
+            rt_thread_yield();
+            continue;
+        }
+        if (ret < 0) {
+            rt_kprintf("rndis tx failed %d\n", ret);
+            break;
+        }
+        frames++;
+    }
+    ms = (rt_tick_get() - start) * 1000 / RT_TICK_PER_SECOND;
+    pbuf_free(p);
+
+    rt_kprintf("tx %d frames of %d bytes, %d KB/s\n", frames, len, ms ? (rt_uint32_t)((rt_uint64_t)frames * len / ms) : 0);
+    return ret < 0 && ret != -USB_ERR_BUSY ? ret : 0;
+}
+
+static int rndis_bench(int argc, char **argv)
+{
+    rt_uint32_t seconds, len;
+
+    if (argc > 1 && rt_strcmp(argv[1], "tx") == 0) {
+        seconds = argc > 2 ? atoi(argv[2]) : 5;
+        len = argc > 3 ? atoi(argv[3]) : 1514;
+        if (seconds == 0 || len < 14 || len > 1514) {
+            rt_kprintf("usage: rndis_bench tx [seconds] [len 14..1514]\n");
+            return -RT_EINVAL;
+        }
+        rndis_bench_show();
+        rndis_bench_tx(seconds, len);
+    }
+    rndis_bench_show();
+
+    return 0;
+}
+MSH_CMD_EXPORT(rndis_bench, rndis device counters: rndis_bench [tx [seconds] [len]]);
+
+#endif
@@ -0,0 +1,162 @@
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(PKG_CHERRYUSB_DEVICE_VIDEO) && defined(RT_USING_HEAP) && defined(RT_USING_FINSH)
+
+#include <usbd_core.h>
+#include <usbd_video.h>
+
+#ifdef PKG_CHERRYUSB_DEVICE_TEMPLATE_VIDEO
+extern const unsigned char cherryusb_mjpeg[24775];
+#else
+#include "../../../packages/CherryUSB-v1.4.0/demo/cherryusb_mjpeg.h"
+#define UVC_BENCH_INIT_INTF
+#endif
+
+/*
+ * Frames per second the uvc packer gives on the cherryusb_mjpeg sample, nothing sent on the bus.
+ *
+ * frame: usbd_video_payload_fill, the whole frame copied with its headers into a frame-sized buffer
+ * before the first payload can go. staged: usbd_video_stream_fill, one payload at a time into a
+ * payload-sized buffer. cut: usbd_video_stream_next with PTS and SCR, headers only, the data stays
+ * in the frame. DWT cycles per frame avg/max, and until the first payload is ready.
+ * Every staged payload is compared against the frame-sized output first.
+ *
+ * Runs the packer of bus 0, the video stream of the template must be closed.
+ */
+
+#define UVC_BENCH_PAYLOAD_SIZE 1020
+
+struct uvc_bench_cost {
+    rt_uint32_t sum;
+    rt_uint32_t num;
+    rt_uint32_t max;
+};
+
+rt_inline void uvc_bench_add(struct uvc_bench_cost *c, rt_uint32_t cycles)
+{
+    c->sum += cycles;
+    c->num++;
+    if (cycles > c->max) {
+        c->max = cycles;
+    }
+}
+
+static void uvc_bench_show(const char *what, struct uvc_bench_cost *c, rt_uint32_t first, rt_uint32_t buffer)
+{
+    rt_uint32_t avg = c->sum / c->num;
+
+    rt_kprintf("%-6s %8d/%8d cycles, %5d fps, first payload %7d cycles, %6d bytes buffer\n", what, avg, c->max,
+               avg ? SystemCoreClock / avg : 0, first, buffer);
+}
+
+static rt_uint32_t uvc_bench_check(uint8_t busid, const rt_uint8_t *frame_out, rt_uint32_t frame_len, rt_uint8_t *payload)
+{
+    rt_uint32_t len, i = 0, bad = 0;
+
+    usbd_video_stream_frame(busid, cherryusb_mjpeg, sizeof(cherryusb_mjpeg), 0);
+    while ((len = usbd_video_stream_fill(busid, payload)) > 0) {
+        const rt_uint8_t *ref = &frame_out[UVC_BENCH_PAYLOAD_SIZE * i];
+
+        /* the fid differs, one frame later */
+        if (i * UVC_BENCH_PAYLOAD_SIZE + len > frame_len || payload[0] != ref[0] ||
+            ((payload[1] ^ ref[1]) & ~VIDEO_PAYLOAD_HEADER_FID) || rt_memcmp(&payload[2], &ref[2], len - 2)) {
+            bad++;
+        }
+        i++;
+    }
+
+    return bad;
+}
+
+static int uvc_bench(int argc, char **argv)
+{
+    rt_uint32_t frames = argc > 1 ? atoi(argv[1]) : 100;
+    struct uvc_bench_cost frame, staged, cut;
+    struct usbd_video_payload payload;
+    rt_uint32_t first_frame = 0, first_staged = 0, first_cut = 0;
+    rt_uint32_t start, len, out_len, packets, bad;
+    rt_uint8_t *frame_out, *payload_out;
+    uint8_t busid = 0;
+
+    if (frames == 0) {
+        rt_kprintf("usage: uvc_bench [frames]\n");
+        return -RT_EINVAL;
+    }
+
+#ifdef UVC_BENCH_INIT_INTF
+    static struct usbd_interface intf;
+
+    usbd_video_init_intf(busid, &intf, 333333, 640 * 480 * 2, UVC_BENCH_PAYLOAD_SIZE);
+#endif
+    packets = (sizeof(cherryusb_mjpeg) + UVC_BENCH_PAYLOAD_SIZE - 3) / (UVC_BENCH_PAYLOAD_SIZE - 2);
+    frame_out = rt_malloc(packets * UVC_BENCH_PAYLOAD_SIZE);
+    payload_out = rt_malloc(UVC_BENCH_PAYLOAD_SIZE);
+    if (frame_out == RT_NULL || payload_out == RT_NULL) {
+        rt_free(frame_out);
+        rt_free(payload_out);
+        return -RT_ENOMEM;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    rt_memset(&frame, 0, sizeof(frame));
+    rt_memset(&staged, 0, sizeof(staged));
+    rt_memset(&cut, 0, sizeof(cut));
+
+    usbd_video_stream_start(busid, 0, 0);
+    usbd_video_payload_fill(busid, (uint8_t *)cherryusb_mjpeg, sizeof(cherryusb_mjpeg), frame_out, &out_len);
+    bad = uvc_bench_check(busid, frame_out, out_len, payload_out);
+
+    for (rt_uint32_t i = 0; i < frames; i++) {
+        start = DWT->CYCCNT;
+        usbd_video_payload_fill(busid, (uint8_t *)cherryusb_mjpeg, sizeof(cherryusb_mjpeg), frame_out, &out_len);
+        uvc_bench_add(&frame, DWT->CYCCNT - start);
+    }
+    first_frame = frame.sum / frame.num;
+
+    for (rt_uint32_t i = 0; i < frames; i++) {
+        start = DWT->CYCCNT;
+        usbd_video_stream_frame(busid, cherryusb_mjpeg, sizeof(cherryusb_mjpeg), 0);
+        usbd_video_stream_fill(busid, payload_out);
+        if (i == 0) {
+            first_staged = DWT->CYCCNT - start;
+        }
+        while (usbd_video_stream_fill(busid, payload_out) > 0) {
+        }
+        uvc_bench_add(&staged, DWT->CYCCNT - start);
+    }
+
+    usbd_video_stream_start(busid, VIDEO_PAYLOAD_HEADER_PTS | VIDEO_PAYLOAD_HEADER_SCR, SystemCoreClock);
+    for (rt_uint32_t i = 0; i < frames; i++) {
+        start = DWT->CYCCNT;
+        usbd_video_stream_frame(busid, cherryusb_mjpeg, sizeof(cherryusb_mjpeg), start);
+        do {
+            usbd_video_stream_scr(busid, DWT->CYCCNT, i);
+            len = usbd_video_stream_next(busid, &payload);
+            if (i == 0 && first_cut == 0) {
+                first_cut = DWT->CYCCNT - start;
+            }
+        } while (len);
+        uvc_bench_add(&cut, DWT->CYCCNT - start);
+    }
+    usbd_video_stream_start(busid, 0, 0);
+
+    rt_kprintf("%d bytes mjpeg, %d payloads of %d, %d frames\n", (int)sizeof(cherryusb_mjpeg), packets, UVC_BENCH_PAYLOAD_SIZE, frames);
+    uvc_bench_show("frame", &frame, first_frame, packets * UVC_BENCH_PAYLOAD_SIZE);
+    uvc_bench_show("staged", &staged, first_staged, UVC_BENCH_PAYLOAD_SIZE);
+    uvc_bench_show("cut", &cut, first_cut, 0);
+    if (bad) {
+        rt_kprintf("%d staged payloads differ from the frame output\n", bad);
+    }
+
+    rt_free(frame_out);
+    rt_free(payload_out);
+
+    return 0;
+}
+MSH_CMD_EXPORT(uvc_bench, uvc payload packer frames per second: uvc_bench [frames]);
+
+#endif
@@ -0,0 +1,190 @@
+#include <rtthread.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(PKG_CHERRYUSB_HOST) && defined(PKG_CHERRYUSB_HOST_MSC) && defined(BSP_USING_BENCH)
+
+#include <usbh_core.h>
+#include <usbh_msc.h>
+#include "bench_load.h"
+
+/*
+ * Bulk IN/OUT throughput and cpu load of the usb host controller, measured through a msc disk.
+ *
+ * Cpu load is sampled by bench_load while transfers are going.
+ * Write test writes back the data read from the same sectors, so the disk content is unchanged.
+ */
+
+#define USBH_BENCH_MAX_SIZE (32 * 1024)
+
+static int usbh_bench(int argc, char **argv)
+{
+    struct usbh_msc *msc_class;
+    rt_uint8_t *raw, *buf;
+    rt_uint32_t size, loops, nsectors, used_loops;
+    rt_tick_t tick;
+    rt_bool_t is_write, unaligned;
+    int ret = 0;
+
+    if (argc < 4) {
+        rt_kprintf("usage: usbh_bench <devname> <read|write> <size> [loops] [unaligned]\n");
+        rt_kprintf("e.g.   usbh_bench sda read 16384 256\n");
+        return -RT_EINVAL;
+    }
+
+    msc_class = (struct usbh_msc *)usbh_find_class_instance(argv[1]);
+    if (msc_class == RT_NULL) {
+        rt_kprintf("%s is not a msc device\n", argv[1]);
+        return -RT_ERROR;
+    }
+
+    is_write = (strcmp(argv[2], "write") == 0);
+    size = atoi(argv[3]);
+    loops = argc > 4 ? atoi(argv[4]) : 64;
+    unaligned = argc > 5;
+
+    nsectors = size / msc_class->blocksize;
+    if (nsectors == 0 || size > USBH_BENCH_MAX_SIZE || nsectors * loops > msc_class->blocknum) {
+        rt_kprintf("size must be 1 ~ %d sectors, total less than disk size\n", USBH_BENCH_MAX_SIZE / msc_class->blocksize);
+        return -RT_EINVAL;
+    }
+    size = nsectors * msc_class->blocksize;
+
+    raw = rt_malloc(size + 4);
+    if (raw == RT_NULL) {
+        return -RT_ENOMEM;
+    }
+    /* odd address forces bounce buffer path */
+    buf = unaligned ? raw + 1 : raw;
+
+    if (bench_load_start() != RT_EOK) {
+        rt_free(raw);
+        return -RT_ENOMEM;
+    }
+
+    used_loops = bench_load_loops();
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++) {
+        if (is_write) {
+            /* write back what is already there, keep disk unchanged */
+            ret = usbh_msc_scsi_read10(msc_class, i * nsectors, buf, nsectors);
+            if (ret >= 0) {
+                ret = usbh_msc_scsi_write10(msc_class, i * nsectors, buf, nsectors);
+            }
+        } else {
+            ret = usbh_msc_scsi_read10(msc_class, i * nsectors, buf, nsectors);
+        }
+        if (ret < 0) {
+            rt_kprintf("transfer failed at loop %d, ret:%d\n", i, ret);
+            break;
+        }
+    }
+    tick = rt_tick_get() - tick;
+    used_loops = bench_load_loops() - used_loops;
+    bench_load_stop();
+
+    if (ret >= 0 && tick > 0) {
+        rt_uint32_t bytes = size * loops * (is_write ? 2 : 1);
+
+        rt_kprintf("%s %d bytes x %d%s: %d ms, %d KB/s, cpu load %d%%\n",
+                   is_write ? "read+write" : "read", size, loops, unaligned ? " unaligned" : "",
+                   tick * 1000 / RT_TICK_PER_SECOND,
+                   (bytes / 1024) * RT_TICK_PER_SECOND / tick,
+                   bench_load_percent(used_loops, tick));
+        rt_kprintf("lun %d: %d commands, max queue depth %d\n", msc_class->lun, msc_class->cmd_count, msc_class->max_queue_depth);
+    }
+
+    rt_free(raw);
+    return ret < 0 ? ret : 0;
+}
+MSH_CMD_EXPORT(usbh_bench, usb host bulk throughput and cpu load test);
+
+#if defined(RT_USING_DFS) && defined(RT_USING_DFS_V1)
+#include <dfs_file.h>
+#include <fcntl.h>
+
+/*
+ * Throughput through dfs_file with several request sizes, covers fatfs, udisk block layer
+ * (merging, read-ahead, bounce) and msc. Close is timed too as it flushes merged writes.
+ */
+
+static const rt_uint32_t usbh_dfs_bench_size[] = { 512, 4096, 16384, 32768 };
+
+static rt_int32_t usbh_dfs_bench_run(const char *path, rt_uint8_t *buf, rt_uint32_t req, rt_uint32_t total, rt_bool_t is_write)
+{
+    struct dfs_file fd;
+    rt_tick_t tick;
+    rt_uint32_t done = 0;
+    ssize_t len;
+
+    fd_init(&fd);
+    if (dfs_file_open(&fd, path, is_write ? (O_WRONLY | O_CREAT | O_TRUNC) : O_RDONLY) < 0) {
+        rt_kprintf("open %s failed\n", path);
+        return -RT_ERROR;
+    }
+
+    tick = rt_tick_get();
+    while (done < total) {
+        len = is_write ? dfs_file_write(&fd, buf, req) : dfs_file_read(&fd, buf, req);
+        if (len != req) {
+            rt_kprintf("%s failed at %d\n", is_write ? "write" : "read", done);
+            break;
+        }
+        done += req;
+    }
+    dfs_file_close(&fd);
+    tick = rt_tick_get() - tick;
+
+    if (done < total) {
+        return -RT_ERROR;
+    }
+    /* KB/s */
+    return (total / 1024) * RT_TICK_PER_SECOND / (tick ? tick : 1);
+}
+
+static int usbh_dfs_bench(int argc, char **argv)
+{
+    rt_uint8_t *buf;
+    rt_uint32_t total;
+    rt_int32_t wspeed, rspeed;
+
+    if (argc < 2) {
+        rt_kprintf("usage: usbh_dfs_bench <file> [total_kb]\n");
+        rt_kprintf("e.g.   usbh_dfs_bench /sda/bench.bin 1024\n");
+        return -RT_EINVAL;
+    }
+
+    total = (argc > 2 ? atoi(argv[2]) : 1024) * 1024;
+    total = RT_ALIGN_DOWN(total, USBH_BENCH_MAX_SIZE);
+    if (total == 0) {
+        total = USBH_BENCH_MAX_SIZE;
+    }
+
+    buf = rt_malloc(USBH_BENCH_MAX_SIZE);
+    if (buf == RT_NULL) {
+        return -RT_ENOMEM;
+    }
+    for (rt_uint32_t i = 0; i < USBH_BENCH_MAX_SIZE; i++) {
+        buf[i] = i;
+    }
+
+    rt_kprintf("%d KB through %s\n", total / 1024, argv[1]);
+    for (rt_uint32_t i = 0; i < sizeof(usbh_dfs_bench_size) / sizeof(usbh_dfs_bench_size[0]); i++) {
+        wspeed = usbh_dfs_bench_run(argv[1], buf, usbh_dfs_bench_size[i], total, RT_TRUE);
+        rspeed = wspeed < 0 ? -1 : usbh_dfs_bench_run(argv[1], buf, usbh_dfs_bench_size[i], total, RT_FALSE);
+        if (rspeed < 0) {
+            break;
+        }
+        rt_kprintf("req %5d: write %d.%02d MB/s, read %d.%02d MB/s\n", usbh_dfs_bench_size[i],
+                   wspeed / 1024, (wspeed % 1024) * 100 / 1024,
+                   rspeed / 1024, (rspeed % 1024) * 100 / 1024);
+    }
+
+    dfs_file_unlink(argv[1]);
+    rt_free(buf);
+    return 0;
+}
+MSH_CMD_EXPORT(usbh_dfs_bench, usb disk file throughput test);
+#endif
+
+#endif
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     loogg        first version
+ */
+
+#include "bench_load.h"
+
+static volatile rt_uint32_t bench_load_count;
+static volatile rt_bool_t bench_load_running;
+static rt_uint32_t bench_load_calib;
+
+static void bench_load_entry(void *parameter)
+{
+    while (bench_load_running)
+    {
+        bench_load_count++;
+    }
+}
+
+/* start the spinning thread and calibrate its loops per tick for half a second, nothing else should run */
+rt_err_t bench_load_start(void)
+{
+    rt_thread_t tid;
+
+    if (bench_load_running)
+    {
+        return -RT_EBUSY;
+    }
+
+    bench_load_count = 0;
+    bench_load_running = RT_TRUE;
+    tid = rt_thread_create("bload", bench_load_entry, RT_NULL, 512, RT_THREAD_PRIORITY_MAX - 2, 10);
+    if (tid == RT_NULL)
+    {
+        bench_load_running = RT_FALSE;
+        return -RT_ENOMEM;
+    }
+    rt_thread_startup(tid);
+    rt_thread_mdelay(RT_TICK_PER_SECOND / 2);
+    bench_load_calib = bench_load_count / (RT_TICK_PER_SECOND / 2);
+
+    return RT_EOK;
+}
+
+/* the thread leaves by itself, give it the cpu to do so */
+void bench_load_stop(void)
+{
+    bench_load_running = RT_FALSE;
+    rt_thread_mdelay(10);
+}
+
+rt_uint32_t bench_load_loops(void)
+{
+    return bench_load_count;
+}
+
+/* cpu load in percent over ticks, in which the thread got loops */
+int bench_load_percent(rt_uint32_t loops, rt_tick_t ticks)
+{
+    rt_uint32_t idle;
+
+    if (bench_load_calib == 0)
+    {
+        return 0;
+    }
+
+    idle = loops / (ticks ? ticks : 1) * 100 / bench_load_calib;
+    return idle > 100 ? 0 : 100 - idle;
+}
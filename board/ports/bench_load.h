@@ -0,0 +1,22 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-18     loogg        first version
+ */
+
+#ifndef __BENCH_LOAD_H__
+#define __BENCH_LOAD_H__
+
+#include <rtthread.h>
+
+/* cpu load of the benchmarks: loops of a thread spinning just above idle, against its loops when nothing runs */
+rt_err_t bench_load_start(void);
+void bench_load_stop(void);
+rt_uint32_t bench_load_loops(void);
+int bench_load_percent(rt_uint32_t loops, rt_tick_t ticks);
+
+#endif
@@ -0,0 +1,413 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <board.h>
+
+#ifdef BSP_USING_HEAP_CLASS
+#include "drv_heap.h"
+#ifdef BSP_USING_SRAM
+#include "drv_sram.h"
+#endif
+
+/*
+ * Heap classes over the three rams of the board:
+ * ccm  64 KB core coupled ram, no wait state, but on the cpu data bus only, no dma reaches it.
+ * sram the system heap in main sram, reached by every dma master.
+ * ext  the "sram" memheap of drv_sram.c on the fsmc, 1 MB, slow, still reached by dma.
+ * Each class takes the heaps in its own order, HEAP_CLASS_STRICT stops at the first.
+ * With BSP_HEAP_CLASS_KERNEL_CCM rt_kernel_malloc is the fast class, so thread stacks, kernel
+ * objects and ipc pools go to ccm first. Drivers doing dma from caller buffers bounce what is
+ * in ccm (STM32_DMA_REACHABLE).
+ */
+
+//#define DRV_DEBUG
+#define LOG_TAG             "drv.heap"
+#include <drv_log.h>
+
+enum
+{
+    HEAP_CCM,
+    HEAP_SRAM,
+    HEAP_EXT,
+    HEAP_NUM
+};
+
+enum
+{
+    CLASS_FAST,
+    CLASS_DMA,
+    CLASS_BULK,
+    CLASS_NUM
+};
+
+struct heap_class_stat
+{
+    rt_uint32_t allocs;
+    rt_uint32_t others;                 /* given by a heap not first of the class */
+    rt_uint32_t fails;
+};
+
+static const char *const heap_names[HEAP_NUM] = { "ccm", "sram", "ext" };
+static const char *const class_names[CLASS_NUM] = { "fast", "dma", "bulk" };
+static const rt_uint8_t class_order[CLASS_NUM][HEAP_NUM] =
+{
+    { HEAP_CCM, HEAP_SRAM, HEAP_EXT },
+    { HEAP_SRAM, HEAP_EXT, HEAP_NUM },
+    { HEAP_EXT, HEAP_SRAM, HEAP_NUM },
+};
+
+static struct rt_memheap ccm_heap;
+static rt_bool_t ccm_ready;
+static struct rt_memheap *ext_heap;
+static struct heap_class_stat class_stat[CLASS_NUM];
+
+static int heap_of(const void *ptr)
+{
+    rt_ubase_t addr = (rt_ubase_t)ptr;
+
+    if (addr >= STM32_CCM_BEGIN && addr < STM32_CCM_END)
+    {
+        return HEAP_CCM;
+    }
+#ifdef BSP_USING_SRAM
+    if (addr >= SRAM_BANK_ADDR && addr < SRAM_BANK_ADDR + SRAM_SIZE)
+    {
+        return HEAP_EXT;
+    }
+#endif
+
+    return HEAP_SRAM;
+}
+
+static void *heap_alloc(int heap, rt_size_t size)
+{
+    switch (heap)
+    {
+    case HEAP_CCM:
+        return ccm_ready ? rt_memheap_alloc(&ccm_heap, size) : RT_NULL;
+    case HEAP_SRAM:
+        return rt_malloc(size);
+    case HEAP_EXT:
+        return ext_heap ? rt_memheap_alloc(ext_heap, size) : RT_NULL;
+    default:
+        return RT_NULL;
+    }
+}
+
+/**
+ * @brief This function allocates a block from the heaps of a class.
+ *
+ * @param flags is one of HEAP_CLASS_FAST, HEAP_CLASS_DMA, HEAP_CLASS_BULK, with HEAP_CLASS_STRICT
+ *        for no other heap. No class is HEAP_CLASS_DMA.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return the pointer to allocated memory or NULL if no heap of the class has room.
+ */
+void *heap_class_malloc(rt_uint32_t flags, rt_size_t size)
+{
+    struct heap_class_stat *stat;
+    const rt_uint8_t *order;
+    void *ptr = RT_NULL;
+    int cls, i;
+
+    if (flags & HEAP_CLASS_FAST)
+        cls = CLASS_FAST;
+    else if (flags & HEAP_CLASS_BULK)
+        cls = CLASS_BULK;
+    else
+        cls = CLASS_DMA;
+    stat = &class_stat[cls];
+    order = class_order[cls];
+
+    for (i = 0; i < HEAP_NUM && order[i] != HEAP_NUM; i++)
+    {
+        if (i > 0 && (flags & HEAP_CLASS_STRICT))
+        {
+            break;
+        }
+        ptr = heap_alloc(order[i], size);
+        if (ptr != RT_NULL)
+        {
+            break;
+        }
+    }
+
+    if (ptr != RT_NULL)
+    {
+        stat->allocs++;
+        if (i > 0)
+        {
+            stat->others++;
+        }
+    }
+    else
+    {
+        stat->fails++;
+        LOG_D("%s: no room for %d bytes", class_names[cls], size);
+    }
+
+    return ptr;
+}
+
+void *heap_class_calloc(rt_uint32_t flags, rt_size_t count, rt_size_t size)
+{
+    void *ptr;
+
+    ptr = heap_class_malloc(flags, count * size);
+    if (ptr != RT_NULL)
+    {
+        rt_memset(ptr, 0, count * size);
+    }
+
+    return ptr;
+}
+
+/**
+ * @brief This function changes the size of a block, it stays in the heap it was got from.
+ *
+ * @param ptr is the pointer to memory allocated by heap_class_malloc, RT_NULL is a block
+ *        of HEAP_CLASS_DMA.
+ *
+ * @param newsize is the required new size.
+ *
+ * @return the changed memory block address.
+ */
+void *heap_class_realloc(void *ptr, rt_size_t newsize)
+{
+    if (ptr == RT_NULL)
+    {
+        return heap_class_malloc(HEAP_CLASS_DMA, newsize);
+    }
+
+    switch (heap_of(ptr))
+    {
+    case HEAP_CCM:
+        return rt_memheap_realloc(&ccm_heap, ptr, newsize);
+    case HEAP_EXT:
+        return rt_memheap_realloc(ext_heap, ptr, newsize);
+    default:
+        return rt_realloc(ptr, newsize);
+    }
+}
+
+void heap_class_free(void *ptr)
+{
+    if (ptr == RT_NULL)
+    {
+        return;
+    }
+
+    if (heap_of(ptr) == HEAP_SRAM)
+    {
+        rt_free(ptr);
+    }
+    else
+    {
+        rt_memheap_free(ptr);
+    }
+}
+
+/**
+ * @brief This function tells the ram a block is in.
+ *
+ * @param ptr is any address.
+ *
+ * @return "ccm", "sram", "ext" or "flash".
+ */
+const char *heap_class_where(const void *ptr)
+{
+    if ((rt_ubase_t)ptr < STM32_CCM_BEGIN)
+    {
+        return "flash";
+    }
+
+    return heap_names[heap_of(ptr)];
+}
+
+#ifdef BSP_HEAP_CLASS_KERNEL_CCM
+void *rt_kernel_malloc(rt_size_t size)
+{
+    return heap_class_malloc(HEAP_CLASS_FAST, size);
+}
+
+void *rt_kernel_realloc(void *ptr, rt_size_t newsize)
+{
+    if (ptr == RT_NULL)
+    {
+        return heap_class_malloc(HEAP_CLASS_FAST, newsize);
+    }
+
+    return heap_class_realloc(ptr, newsize);
+}
+
+void rt_kernel_free(void *ptr)
+{
+    heap_class_free(ptr);
+}
+#endif /* BSP_HEAP_CLASS_KERNEL_CCM */
+
+static int heap_class_init(void)
+{
+    rt_size_t size = (rt_ubase_t)CCM_HEAP_END - (rt_ubase_t)CCM_HEAP_BEGIN;
+
+    if (rt_memheap_init(&ccm_heap, "ccm", CCM_HEAP_BEGIN, size) != RT_EOK)
+    {
+        LOG_E("ccm heap init failed");
+        return -RT_ERROR;
+    }
+    ccm_ready = RT_TRUE;
+
+    return RT_EOK;
+}
+INIT_BOARD_EXPORT(heap_class_init);
+
+/* the external sram is up after the board init */
+static int heap_class_bind(void)
+{
+#ifdef BSP_USING_SRAM
+    ext_heap = (struct rt_memheap *)rt_object_find("sram", RT_Object_Class_MemHeap);
+    if (ext_heap == RT_NULL)
+    {
+        LOG_W("no external sram heap, bulk class in sram");
+    }
+#endif
+
+    return RT_EOK;
+}
+INIT_PREV_EXPORT(heap_class_bind);
+
+struct heap_class_place
+{
+    rt_uint16_t count[HEAP_NUM + 1];    /* static ones last */
+};
+
+static const struct
+{
+    rt_uint8_t type;
+    const char *name;
+} heap_class_objects[] =
+{
+    { RT_Object_Class_Thread, "thread" },
+#ifdef RT_USING_SEMAPHORE
+    { RT_Object_Class_Semaphore, "semaphore" },
+#endif
+#ifdef RT_USING_MUTEX
+    { RT_Object_Class_Mutex, "mutex" },
+#endif
+#ifdef RT_USING_EVENT
+    { RT_Object_Class_Event, "event" },
+#endif
+#ifdef RT_USING_MAILBOX
+    { RT_Object_Class_MailBox, "mailbox" },
+#endif
+#ifdef RT_USING_MESSAGEQUEUE
+    { RT_Object_Class_MessageQueue, "msgqueue" },
+#endif
+#ifdef RT_USING_DEVICE
+    { RT_Object_Class_Device, "device" },
+#endif
+    { RT_Object_Class_Timer, "timer" },
+};
+
+static void heap_class_report_heaps(void)
+{
+    rt_size_t total, used, max_used;
+
+    rt_kprintf("heap base         total     used      max\n");
+    if (ccm_ready)
+    {
+        rt_memheap_info(&ccm_heap, &total, &used, &max_used);
+        rt_kprintf("%-4s 0x%08x %7d  %7d  %7d\n", heap_names[HEAP_CCM], ccm_heap.start_addr, total, used, max_used);
+    }
+    rt_memory_info(&total, &used, &max_used);
+    rt_kprintf("%-4s 0x%08x %7d  %7d  %7d\n", heap_names[HEAP_SRAM], HEAP_BEGIN, total, used, max_used);
+    if (ext_heap)
+    {
+        rt_memheap_info(ext_heap, &total, &used, &max_used);
+        rt_kprintf("%-4s 0x%08x %7d  %7d  %7d\n", heap_names[HEAP_EXT], ext_heap->start_addr, total, used, max_used);
+    }
+
+    rt_kprintf("\nclass  allocs  other heap  failed\n");
+    for (int i = 0; i < CLASS_NUM; i++)
+    {
+        rt_kprintf("%-5s %7d  %10d  %6d\n", class_names[i], class_stat[i].allocs, class_stat[i].others, class_stat[i].fails);
+    }
+}
+
+static void heap_class_report_threads(rt_object_t *objs, int max)
+{
+    struct rt_thread *thread;
+    int num;
+
+    num = rt_object_get_pointers(RT_Object_Class_Thread, objs, max);
+    rt_kprintf("\n%-*.*s stack  at    tcb\n", RT_NAME_MAX, RT_NAME_MAX, "thread");
+    for (int i = 0; i < num; i++)
+    {
+        thread = (struct rt_thread *)objs[i];
+        rt_kprintf("%-*.*s %5d  %-4s  %s\n", RT_NAME_MAX, RT_NAME_MAX, thread->parent.name, thread->stack_size,
+                   heap_class_where(thread->stack_addr),
+                   rt_object_is_systemobject(&thread->parent) ? "static" : heap_class_where(thread));
+    }
+}
+
+static void heap_class_report_objects(rt_object_t *objs, int max)
+{
+    struct heap_class_place place;
+    int num;
+
+    rt_kprintf("\nobject      ccm  sram   ext  static\n");
+    for (int i = 0; i < sizeof(heap_class_objects) / sizeof(heap_class_objects[0]); i++)
+    {
+        rt_memset(&place, 0, sizeof(place));
+        num = rt_object_get_pointers((enum rt_object_class_type)heap_class_objects[i].type, objs, max);
+        for (int j = 0; j < num; j++)
+        {
+            place.count[rt_object_is_systemobject(objs[j]) ? HEAP_NUM : heap_of(objs[j])]++;
+        }
+        rt_kprintf("%-10s %4d  %4d  %4d  %6d\n", heap_class_objects[i].name,
+                   place.count[HEAP_CCM], place.count[HEAP_SRAM], place.count[HEAP_EXT], place.count[HEAP_NUM]);
+    }
+}
+
+/* where the memory of every heap, class, thread and kernel object ended up */
+static int heap_class(void)
+{
+    rt_object_t *objs;
+    int max = 0;
+
+    for (int i = 0; i < sizeof(heap_class_objects) / sizeof(heap_class_objects[0]); i++)
+    {
+        int len = rt_object_get_length((enum rt_object_class_type)heap_class_objects[i].type);
+
+        if (len > max)
+        {
+            max = len;
+        }
+    }
+    /* some room for objects made while reporting */
+    max += 8;
+    objs = rt_malloc(max * sizeof(rt_object_t));
+    if (objs == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+
+    heap_class_report_heaps();
+    heap_class_report_threads(objs, max);
+    heap_class_report_objects(objs, max);
+    rt_free(objs);
+
+    return 0;
+}
+MSH_CMD_EXPORT(heap_class, show heaps and where threads and kernel objects are placed);
+
+#endif /* BSP_USING_HEAP_CLASS */
@@ -0,0 +1,28 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#ifndef __DRV_HEAP_H__
+#define __DRV_HEAP_H__
+
+#include <rtthread.h>
+
+/* where a block is wanted, the first heap of the class with room gives it */
+#define HEAP_CLASS_FAST     0x01    /* ccm ram, cpu only: stacks, kernel objects, no dma buffers */
+#define HEAP_CLASS_DMA      0x02    /* main sram, reached by every dma master */
+#define HEAP_CLASS_BULK     0x04    /* external sram, big and slow: framebuffers, disk caches */
+#define HEAP_CLASS_STRICT   0x80    /* no other heap when the class has no room */
+
+void *heap_class_malloc(rt_uint32_t flags, rt_size_t size);
+void *heap_class_calloc(rt_uint32_t flags, rt_size_t count, rt_size_t size);
+void *heap_class_realloc(void *ptr, rt_size_t newsize);
+void heap_class_free(void *ptr);
+const char *heap_class_where(const void *ptr);
+
+#endif
@@ -8,12 +8,20 @@
  * 2021-12-28     unknow       copy by STemwin
  * 2021-12-29     xiangxistu   port for lvgl <lcd_fill_array>
  * 2022-6-26      solar        Improve the api required for resistive touch screen calibration
+ * 2026-10-17     loogg        add window based dma fill and blit engine
+ * 2026-10-17     loogg        add shadow framebuffer in external sram with dirty rectangles
  */
 
 #include <board.h>
 #include "drv_lcd.h"
 #include <drv_gpio.h>
 #include <string.h>
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+#include "drv_config.h"
+#endif
+#ifdef BSP_USING_ONBOARD_LCD_FB
+#include "drv_sram.h"
+#endif
 
 //#define DRV_DEBUG
 #define LOG_TAG "drv.lcd"
@@ -97,58 +105,277 @@ uint16_t LCD_BGR2RGB(uint16_t c)
     return (rgb);
 }
 
+/*
+ * Controller access. lcddev.id (and lcddev.dir for 1963) is resolved once into a function table
+ * in LCD_Display_Dir, drawing code calls through it instead of branching on the id per pixel.
+ * Rectangle ops set the window back to the whole screen when done, so draw_point of 9341/5510 only
+ * moves the cursor.
+ */
+struct lcd_ctrl_ops
+{
+    void (*set_cursor)(uint16_t x, uint16_t y);
+    void (*set_window)(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height);
+    void (*draw_point)(uint16_t x, uint16_t y, uint16_t color);
+};
+
+//9341/5310: 坐标命令带起始和结束两组参数,只写起始
+static void lcd_9341_set_cursor(uint16_t x, uint16_t y)
+{
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(x >> 8);
+    LCD_WR_DATA(x & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(y >> 8);
+    LCD_WR_DATA(y & 0XFF);
+}
+
+static void lcd_9341_set_window(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height)
+{
+    uint16_t ex = sx + width - 1;
+    uint16_t ey = sy + height - 1;
+
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(sx >> 8);
+    LCD_WR_DATA(sx & 0XFF);
+    LCD_WR_DATA(ex >> 8);
+    LCD_WR_DATA(ex & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(sy >> 8);
+    LCD_WR_DATA(sy & 0XFF);
+    LCD_WR_DATA(ey >> 8);
+    LCD_WR_DATA(ey & 0XFF);
+}
+
+static void lcd_9341_draw_point(uint16_t x, uint16_t y, uint16_t color)
+{
+    lcd_9341_set_cursor(x, y);
+    LCD->REG = lcddev.wramcmd;
+    LCD->RAM = color;
+}
+
+//5510: 每个参数字节一个寄存器
+static void lcd_5510_set_cursor(uint16_t x, uint16_t y)
+{
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(x >> 8);
+    LCD_WR_REG(lcddev.setxcmd + 1);
+    LCD_WR_DATA(x & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(y >> 8);
+    LCD_WR_REG(lcddev.setycmd + 1);
+    LCD_WR_DATA(y & 0XFF);
+}
+
+static void lcd_5510_set_window(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height)
+{
+    uint16_t ex = sx + width - 1;
+    uint16_t ey = sy + height - 1;
+
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(sx >> 8);
+    LCD_WR_REG(lcddev.setxcmd + 1);
+    LCD_WR_DATA(sx & 0XFF);
+    LCD_WR_REG(lcddev.setxcmd + 2);
+    LCD_WR_DATA(ex >> 8);
+    LCD_WR_REG(lcddev.setxcmd + 3);
+    LCD_WR_DATA(ex & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(sy >> 8);
+    LCD_WR_REG(lcddev.setycmd + 1);
+    LCD_WR_DATA(sy & 0XFF);
+    LCD_WR_REG(lcddev.setycmd + 2);
+    LCD_WR_DATA(ey >> 8);
+    LCD_WR_REG(lcddev.setycmd + 3);
+    LCD_WR_DATA(ey & 0XFF);
+}
+
+static void lcd_5510_draw_point(uint16_t x, uint16_t y, uint16_t color)
+{
+    lcd_5510_set_cursor(x, y);
+    LCD->REG = lcddev.wramcmd;
+    LCD->RAM = color;
+}
+
+//1963横屏: 起始和结束都要写
+static void lcd_1963_set_cursor(uint16_t x, uint16_t y)
+{
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(x >> 8);
+    LCD_WR_DATA(x & 0XFF);
+    LCD_WR_DATA((lcddev.width - 1) >> 8);
+    LCD_WR_DATA((lcddev.width - 1) & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(y >> 8);
+    LCD_WR_DATA(y & 0XFF);
+    LCD_WR_DATA((lcddev.height - 1) >> 8);
+    LCD_WR_DATA((lcddev.height - 1) & 0XFF);
+}
+
+static void lcd_1963_draw_point(uint16_t x, uint16_t y, uint16_t color)
+{
+    lcd_9341_set_window(x, y, 1, 1);
+    LCD->REG = lcddev.wramcmd;
+    LCD->RAM = color;
+}
+
+//1963竖屏: x坐标需要变换
+static void lcd_1963v_set_cursor(uint16_t x, uint16_t y)
+{
+    x = lcddev.width - 1 - x;
+    LCD_WR_REG(lcddev.setxcmd);
+    LCD_WR_DATA(0);
+    LCD_WR_DATA(0);
+    LCD_WR_DATA(x >> 8);
+    LCD_WR_DATA(x & 0XFF);
+    LCD_WR_REG(lcddev.setycmd);
+    LCD_WR_DATA(y >> 8);
+    LCD_WR_DATA(y & 0XFF);
+    LCD_WR_DATA((lcddev.height - 1) >> 8);
+    LCD_WR_DATA((lcddev.height - 1) & 0XFF);
+}
+
+static void lcd_1963v_set_window(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height)
+{
+    lcd_9341_set_window(lcddev.width - width - sx, sy, width, height);
+}
+
+static void lcd_1963v_draw_point(uint16_t x, uint16_t y, uint16_t color)
+{
+    lcd_9341_set_window(lcddev.width - 1 - x, y, 1, 1);
+    LCD->REG = lcddev.wramcmd;
+    LCD->RAM = color;
+}
+
+static const struct lcd_ctrl_ops lcd_9341_ops = { lcd_9341_set_cursor, lcd_9341_set_window, lcd_9341_draw_point };
+static const struct lcd_ctrl_ops lcd_5510_ops = { lcd_5510_set_cursor, lcd_5510_set_window, lcd_5510_draw_point };
+static const struct lcd_ctrl_ops lcd_1963_ops = { lcd_1963_set_cursor, lcd_9341_set_window, lcd_1963_draw_point };
+static const struct lcd_ctrl_ops lcd_1963v_ops = { lcd_1963v_set_cursor, lcd_1963v_set_window, lcd_1963v_draw_point };
+
+/* mipi dcs style commands by default */
+static const struct lcd_ctrl_ops *lcd_ctrl = &lcd_9341_ops;
+
+static void lcd_ctrl_resolve(void)
+{
+    if (lcddev.id == 0X5510)
+        lcd_ctrl = &lcd_5510_ops;
+    else if (lcddev.id == 0X1963)
+        lcd_ctrl = lcddev.dir == 0 ? &lcd_1963v_ops : &lcd_1963_ops;
+    else
+        lcd_ctrl = &lcd_9341_ops;
+}
+
 //设置光标位置(对RGB屏无效)
 //Xpos:横坐标
 //Ypos:纵坐标
 void LCD_SetCursor(uint16_t Xpos, uint16_t Ypos)
 {
-    if (lcddev.id == 0X9341 || lcddev.id == 0X5310)
-    {
-        LCD_WR_REG(lcddev.setxcmd);
-        LCD_WR_DATA(Xpos >> 8);
-        LCD_WR_DATA(Xpos & 0XFF);
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(Ypos >> 8);
-        LCD_WR_DATA(Ypos & 0XFF);
-    }
-    else if (lcddev.id == 0X1963)
+    lcd_ctrl->set_cursor(Xpos, Ypos);
+}
+
+//设置窗口,并自动设置画点坐标到窗口左上角(sx,sy).
+//sx,sy:窗口起始坐标(左上角)
+//width,height:窗口宽度和高度,必须大于0!!
+//窗体大小:width*height.
+void LCD_Set_Window(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height)
+{
+    lcd_ctrl->set_window(sx, sy, width, height);
+}
+
+//窗口恢复为整屏
+static void lcd_window_restore(void)
+{
+    LCD_Set_Window(0, 0, lcddev.width, lcddev.height);
+}
+
+/*
+ * Shadow framebuffer: with BSP_USING_ONBOARD_LCD_FB the top of the external SRAM keeps a copy of
+ * the screen. In shadow mode all drawing goes into it and only marks the touched rectangles dirty,
+ * RTGRAPHIC_CTRL_RECT_UPDATE pushes the dirty rectangles to the panel by the rectangle engine.
+ * Close or overlapping rectangles are merged as every rectangle costs a window setup, when the
+ * list is full the new one is merged into the rectangle that grows least.
+ */
+#ifdef BSP_USING_ONBOARD_LCD_FB
+#define LCD_FB_DIRTY_MAX   8
+#define LCD_FB_MERGE_SLACK 256 /* pixels pushed for nothing that are cheaper than a window setup */
+#define LCD_MIN(a, b) ((a) < (b) ? (a) : (b))
+#define LCD_MAX(a, b) ((a) > (b) ? (a) : (b))
+
+static struct
+{
+    rt_uint16_t *buf;
+    rt_uint16_t stride;
+    rt_bool_t enabled;
+    struct rt_device_rect_info dirty[LCD_FB_DIRTY_MAX];
+    rt_uint8_t dirty_num;
+    rt_uint32_t marks;
+    rt_uint32_t flushes;
+    rt_uint32_t flush_rects;
+    rt_uint32_t flush_pixels;
+    volatile rt_uint32_t flush_done;
+} _lcd_fb;
+
+static void lcd_fb_union(struct rt_device_rect_info *out, const struct rt_device_rect_info *a, const struct rt_device_rect_info *b)
+{
+    rt_uint16_t x2 = LCD_MAX(a->x + a->width, b->x + b->width);
+    rt_uint16_t y2 = LCD_MAX(a->y + a->height, b->y + b->height);
+
+    out->x = LCD_MIN(a->x, b->x);
+    out->y = LCD_MIN(a->y, b->y);
+    out->width = x2 - out->x;
+    out->height = y2 - out->y;
+}
+
+/* pixels the union pushes more than both rectangles, negative when they overlap */
+static rt_int32_t lcd_fb_merge_cost(const struct rt_device_rect_info *a, const struct rt_device_rect_info *b)
+{
+    struct rt_device_rect_info u;
+
+    lcd_fb_union(&u, a, b);
+    return (rt_int32_t)u.width * u.height - (rt_int32_t)a->width * a->height - (rt_int32_t)b->width * b->height;
+}
+
+/* merge r into the list, list[0 .. *num) */
+static void lcd_fb_dirty_add(struct rt_device_rect_info *list, rt_uint8_t *num, struct rt_device_rect_info r)
+{
+    rt_int32_t cost, best_cost;
+    rt_uint8_t i, best;
+
+    for (;;)
     {
-        if (lcddev.dir == 0) //x坐标需要变换
+        best = 0;
+        best_cost = 0x7FFFFFFF;
+        for (i = 0; i < *num; i++)
         {
-            Xpos = lcddev.width - 1 - Xpos;
-            LCD_WR_REG(lcddev.setxcmd);
-            LCD_WR_DATA(0);
-            LCD_WR_DATA(0);
-            LCD_WR_DATA(Xpos >> 8);
-            LCD_WR_DATA(Xpos & 0XFF);
+            cost = lcd_fb_merge_cost(&list[i], &r);
+            if (cost < best_cost)
+            {
+                best_cost = cost;
+                best = i;
+            }
         }
-        else
+        if (best_cost > LCD_FB_MERGE_SLACK && *num < LCD_FB_DIRTY_MAX)
         {
-            LCD_WR_REG(lcddev.setxcmd);
-            LCD_WR_DATA(Xpos >> 8);
-            LCD_WR_DATA(Xpos & 0XFF);
-            LCD_WR_DATA((lcddev.width - 1) >> 8);
-            LCD_WR_DATA((lcddev.width - 1) & 0XFF);
+            list[(*num)++] = r;
+            return;
         }
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(Ypos >> 8);
-        LCD_WR_DATA(Ypos & 0XFF);
-        LCD_WR_DATA((lcddev.height - 1) >> 8);
-        LCD_WR_DATA((lcddev.height - 1) & 0XFF);
-    }
-    else if (lcddev.id == 0X5510)
-    {
-        LCD_WR_REG(lcddev.setxcmd);
-        LCD_WR_DATA(Xpos >> 8);
-        LCD_WR_REG(lcddev.setxcmd + 1);
-        LCD_WR_DATA(Xpos & 0XFF);
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(Ypos >> 8);
-        LCD_WR_REG(lcddev.setycmd + 1);
-        LCD_WR_DATA(Ypos & 0XFF);
+        /* the union may now touch others, take it out and merge again */
+        lcd_fb_union(&r, &list[best], &r);
+        list[best] = list[--(*num)];
     }
 }
 
+static void lcd_fb_mark(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height)
+{
+    struct rt_device_rect_info r = { x, y, width, height };
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    lcd_fb_dirty_add(_lcd_fb.dirty, &_lcd_fb.dirty_num, r);
+    _lcd_fb.marks++;
+    rt_hw_interrupt_enable(level);
+}
+#endif /* BSP_USING_ONBOARD_LCD_FB */
+
 //读取个某点的颜色值
 //x,y:坐标
 //返回值:此点的颜色
@@ -161,7 +388,16 @@ void LCD_ReadPoint(char *pixel, int x, int y)
         *color = 0; //超过了范围,直接返回
         return;
     }
-    LCD_SetCursor(x, y);
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    if (_lcd_fb.enabled)
+    {
+        *color = _lcd_fb.buf[y * _lcd_fb.stride + x];
+        return;
+    }
+#endif
+    lcd_rect_sync();
+    //读用1x1窗口, 不依赖当前窗口
+    LCD_Set_Window(x, y, 1, 1);
     if (lcddev.id == 0X9341 || lcddev.id == 0X5310 || lcddev.id == 0X1963)
         LCD_WR_REG(0X2E); //9341/3510/1963 发送读GRAM指令
     else if (lcddev.id == 0X5510)
@@ -170,6 +406,7 @@ void LCD_ReadPoint(char *pixel, int x, int y)
     if (lcddev.id == 0X1963)
     {
         *color = r;
+        lcd_window_restore();
         return; //1963直接读就可以
     }
 
@@ -180,6 +417,7 @@ void LCD_ReadPoint(char *pixel, int x, int y)
     g = r & 0XFF; //对于9341/5310/5510,第一次读取的是RG的值,R在前,G在后,各占8位
     g <<= 8;
     *color = (((r >> 11) << 11) | ((g >> 10) << 5) | (b >> 11)); //ILI9341/NT35310/NT35510需要公式转换一下
+    lcd_window_restore();
 }
 //LCD开启显示
 void LCD_DisplayOn(void)
@@ -330,50 +568,6 @@ void LCD_Scan_Dir(uint8_t dir)
     }
 }
 
-//快速画点
-//x,y:坐标
-//color:颜色
-static void LCD_Fast_DrawPoint(const char *pixel, int x, int y)
-{
-    uint16_t color = *((uint16_t *)pixel);
-    if (lcddev.id == 0X9341 || lcddev.id == 0X5310)
-    {
-        LCD_WR_REG(lcddev.setxcmd);
-        LCD_WR_DATA(x >> 8);
-        LCD_WR_DATA(x & 0XFF);
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(y >> 8);
-        LCD_WR_DATA(y & 0XFF);
-    }
-    else if (lcddev.id == 0X5510)
-    {
-        LCD_WR_REG(lcddev.setxcmd);
-        LCD_WR_DATA(x >> 8);
-        LCD_WR_REG(lcddev.setxcmd + 1);
-        LCD_WR_DATA(x & 0XFF);
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(y >> 8);
-        LCD_WR_REG(lcddev.setycmd + 1);
-        LCD_WR_DATA(y & 0XFF);
-    }
-    else if (lcddev.id == 0X1963)
-    {
-        if (lcddev.dir == 0)
-            x = lcddev.width - 1 - x;
-        LCD_WR_REG(lcddev.setxcmd);
-        LCD_WR_DATA(x >> 8);
-        LCD_WR_DATA(x & 0XFF);
-        LCD_WR_DATA(x >> 8);
-        LCD_WR_DATA(x & 0XFF);
-        LCD_WR_REG(lcddev.setycmd);
-        LCD_WR_DATA(y >> 8);
-        LCD_WR_DATA(y & 0XFF);
-        LCD_WR_DATA(y >> 8);
-        LCD_WR_DATA(y & 0XFF);
-    }
-    LCD->REG = lcddev.wramcmd;
-    LCD->RAM = color;
-}
 //SSD1963 背光设置
 //pwm:背光等级,0~100.越大越亮.
 void LCD_SSD_BackLightSet(uint8_t pwm)
@@ -456,22 +650,492 @@ void LCD_Display_Dir(uint8_t dir)
             lcddev.height = 320;
         }
     }
+    lcd_ctrl_resolve();
     LCD_Scan_Dir(DFT_SCAN_DIR); //默认扫描方向
 }
 
+/*
+ * Rectangle engine: the window is set once per rectangle and pixels are streamed into the GRAM.
+ * With BSP_USING_ONBOARD_LCD_DMA the stream is done by a DMA2 memory to memory transfer whose
+ * destination is the fixed LCD->RAM address, rectangles are queued and the done callback is called
+ * in irq context when a rectangle is on the panel. CPU drawing waits for the queue to drain first.
+ * The window is set back to the whole screen after a rectangle on the cpu and when the queue drains,
+ * point drawing and reading only move the cursor.
+ */
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+#define LCD_DMA_QUEUE_SIZE 8
+#define LCD_DMA_MAX_XFER   0xFFFF   /* NDTR is 16 bit */
+#define LCD_DMA_MIN_PIXELS 64       /* short runs are faster by cpu */
+#define LCD_DMA_SYNC_MIN_PIXELS 512 /* waiting costs a context switch */
+
+struct lcd_dma_req
+{
+    rt_uint16_t x, y, width, height;
+    const rt_uint16_t *src; /* RT_NULL for fill */
+    rt_uint16_t stride;     /* source pixels per row */
+    rt_uint16_t color;
+    rt_uint32_t remain;
+    void (*done)(void *user_data);
+    void *user_data;
+};
+
+static struct
+{
+    DMA_HandleTypeDef hdma;
+    struct lcd_dma_req queue[LCD_DMA_QUEUE_SIZE];
+    rt_uint8_t head;
+    rt_uint8_t count;
+    struct rt_semaphore free_sem;
+    volatile rt_bool_t busy;
+    rt_bool_t inited;
+} _lcd_dma;
+
+static void lcd_dma_chunk(struct lcd_dma_req *req)
+{
+    rt_uint32_t len = req->remain > LCD_DMA_MAX_XFER ? LCD_DMA_MAX_XFER : req->remain;
+
+    if (req->src)
+    {
+        /* source with gaps between rows goes one row a transfer, the window keeps the gram going */
+        if (req->stride != req->width)
+        {
+            len = req->width;
+        }
+        SET_BIT(_lcd_dma.hdma.Instance->CR, DMA_SxCR_PINC);
+        HAL_DMA_Start_IT(&_lcd_dma.hdma, (uint32_t)req->src, (uint32_t)&LCD->RAM, len);
+        req->src += (req->stride != req->width) ? req->stride : len;
+    }
+    else
+    {
+        CLEAR_BIT(_lcd_dma.hdma.Instance->CR, DMA_SxCR_PINC);
+        HAL_DMA_Start_IT(&_lcd_dma.hdma, (uint32_t)&req->color, (uint32_t)&LCD->RAM, len);
+    }
+    req->remain -= len;
+}
+
+/* start the queue head, empty requests are barriers and finish at once. irq is disabled or in irq */
+static void lcd_dma_kick(void)
+{
+    struct lcd_dma_req *req;
+
+    while (_lcd_dma.count)
+    {
+        req = &_lcd_dma.queue[_lcd_dma.head];
+        if (req->remain)
+        {
+            LCD_Set_Window(req->x, req->y, req->width, req->height);
+            LCD_WriteRAM_Prepare();
+            lcd_dma_chunk(req);
+            return;
+        }
+
+        if (req->done)
+        {
+            req->done(req->user_data);
+        }
+        _lcd_dma.head = (_lcd_dma.head + 1) % LCD_DMA_QUEUE_SIZE;
+        _lcd_dma.count--;
+        rt_sem_release(&_lcd_dma.free_sem);
+    }
+    lcd_window_restore();
+    _lcd_dma.busy = RT_FALSE;
+}
+
+static void lcd_dma_xfer_cplt(DMA_HandleTypeDef *hdma)
+{
+    struct lcd_dma_req *req = &_lcd_dma.queue[_lcd_dma.head];
+
+    if (req->remain)
+    {
+        lcd_dma_chunk(req);
+        return;
+    }
+    /* finished, kick will call done and go on */
+    lcd_dma_kick();
+}
+
+static void lcd_dma_xfer_error(DMA_HandleTypeDef *hdma)
+{
+    LOG_E("dma error 0x%x", hdma->ErrorCode);
+    _lcd_dma.queue[_lcd_dma.head].remain = 0;
+    lcd_dma_kick();
+}
+
+void MEMTOMEM1_DMA_IRQHandler(void)
+{
+    /* enter interrupt */
+    rt_interrupt_enter();
+
+    HAL_DMA_IRQHandler(&_lcd_dma.hdma);
+
+    /* leave interrupt */
+    rt_interrupt_leave();
+}
+
+static rt_err_t lcd_dma_init(void)
+{
+    __IO uint32_t tmpreg = 0x00U;
+
+    SET_BIT(RCC->AHB1ENR, MEMTOMEM1_DMA_RCC);
+    /* Delay after an RCC peripheral clock enabling */
+    tmpreg = READ_BIT(RCC->AHB1ENR, MEMTOMEM1_DMA_RCC);
+    UNUSED(tmpreg);
+
+    _lcd_dma.hdma.Instance = MEMTOMEM1_DMA_INSTANCE;
+    _lcd_dma.hdma.Init.Channel = MEMTOMEM1_DMA_CHANNEL;
+    _lcd_dma.hdma.Init.Direction = DMA_MEMORY_TO_MEMORY;
+    _lcd_dma.hdma.Init.PeriphInc = DMA_PINC_ENABLE;
+    _lcd_dma.hdma.Init.MemInc = DMA_MINC_DISABLE;
+    _lcd_dma.hdma.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    _lcd_dma.hdma.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    _lcd_dma.hdma.Init.Mode = DMA_NORMAL;
+    _lcd_dma.hdma.Init.Priority = DMA_PRIORITY_LOW;
+    /* memory to memory needs the fifo */
+    _lcd_dma.hdma.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+    _lcd_dma.hdma.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+    _lcd_dma.hdma.Init.MemBurst = DMA_MBURST_SINGLE;
+    _lcd_dma.hdma.Init.PeriphBurst = DMA_PBURST_SINGLE;
+    if (HAL_DMA_Init(&_lcd_dma.hdma) != HAL_OK)
+    {
+        LOG_E("dma init failed");
+        return -RT_ERROR;
+    }
+    _lcd_dma.hdma.XferCpltCallback = lcd_dma_xfer_cplt;
+    _lcd_dma.hdma.XferErrorCallback = lcd_dma_xfer_error;
+
+    rt_sem_init(&_lcd_dma.free_sem, "lcddma", LCD_DMA_QUEUE_SIZE, RT_IPC_FLAG_PRIO);
+
+    HAL_NVIC_SetPriority(MEMTOMEM1_DMA_IRQ, 1, 0);
+    HAL_NVIC_EnableIRQ(MEMTOMEM1_DMA_IRQ);
+
+    _lcd_dma.inited = RT_TRUE;
+    return RT_EOK;
+}
+
+static void lcd_dma_submit(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, const rt_uint16_t *src,
+                           rt_uint16_t stride, rt_uint16_t color, void (*done)(void *user_data), void *user_data)
+{
+    struct lcd_dma_req *req;
+    rt_base_t level;
+
+    rt_sem_take(&_lcd_dma.free_sem, RT_WAITING_FOREVER);
+
+    level = rt_hw_interrupt_disable();
+    req = &_lcd_dma.queue[(_lcd_dma.head + _lcd_dma.count) % LCD_DMA_QUEUE_SIZE];
+    req->x = x;
+    req->y = y;
+    req->width = width;
+    req->height = height;
+    req->src = src;
+    req->stride = stride;
+    req->color = color;
+    req->remain = (rt_uint32_t)width * height;
+    req->done = done;
+    req->user_data = user_data;
+    _lcd_dma.count++;
+    if (!_lcd_dma.busy)
+    {
+        _lcd_dma.busy = RT_TRUE;
+        lcd_dma_kick();
+    }
+    rt_hw_interrupt_enable(level);
+}
+
+static void lcd_dma_wakeup(void *user_data)
+{
+    rt_sem_release((rt_sem_t)user_data);
+}
+#endif /* BSP_USING_ONBOARD_LCD_DMA */
+
+/* wait until all queued rectangles are on the panel */
+void lcd_rect_sync(void)
+{
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+    struct rt_semaphore sem;
+
+    if (!_lcd_dma.busy)
+    {
+        return;
+    }
+    rt_sem_init(&sem, "lcdsync", 0, RT_IPC_FLAG_PRIO);
+    lcd_dma_submit(0, 0, 0, 0, RT_NULL, 0, 0, lcd_dma_wakeup, &sem);
+    rt_sem_take(&sem, RT_WAITING_FOREVER);
+    rt_sem_detach(&sem);
+#endif
+}
+
+static rt_err_t lcd_rect_clip(rt_uint16_t x, rt_uint16_t y, rt_uint16_t *width, rt_uint16_t *height)
+{
+    if (x >= lcddev.width || y >= lcddev.height || *width == 0 || *height == 0)
+    {
+        return -RT_EINVAL;
+    }
+    if (x + *width > lcddev.width)
+    {
+        *width = lcddev.width - x;
+    }
+    if (y + *height > lcddev.height)
+    {
+        *height = lcddev.height - y;
+    }
+    return RT_EOK;
+}
+
+/* fill a clipped rectangle on the panel */
+static rt_err_t lcd_panel_fill_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t color,
+                                    void (*done)(void *user_data), void *user_data)
+{
+    rt_uint32_t total = (rt_uint32_t)width * height;
+
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+    if (_lcd_dma.inited && total >= (done ? LCD_DMA_MIN_PIXELS : LCD_DMA_SYNC_MIN_PIXELS))
+    {
+        if (done == RT_NULL)
+        {
+            struct rt_semaphore sem;
+
+            rt_sem_init(&sem, "lcdfill", 0, RT_IPC_FLAG_PRIO);
+            lcd_dma_submit(x, y, width, height, RT_NULL, 0, color, lcd_dma_wakeup, &sem);
+            rt_sem_take(&sem, RT_WAITING_FOREVER);
+            rt_sem_detach(&sem);
+        }
+        else
+        {
+            lcd_dma_submit(x, y, width, height, RT_NULL, 0, color, done, user_data);
+        }
+        return RT_EOK;
+    }
+    lcd_rect_sync();
+#endif
+
+    LCD_Set_Window(x, y, width, height);
+    LCD_WriteRAM_Prepare();
+    while (total--)
+    {
+        LCD->RAM = color;
+    }
+    lcd_window_restore();
+    if (done)
+    {
+        done(user_data);
+    }
+    return RT_EOK;
+}
+
+/* copy a clipped rectangle to the panel, rows of the source are stride pixels apart */
+static rt_err_t lcd_panel_blit_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t stride,
+                                    const rt_uint16_t *p, void (*done)(void *user_data), void *user_data)
+{
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+    if (_lcd_dma.inited && (rt_uint32_t)width * height >= (done ? LCD_DMA_MIN_PIXELS : LCD_DMA_SYNC_MIN_PIXELS) && STM32_DMA_REACHABLE(p))
+    {
+        if (done == RT_NULL)
+        {
+            struct rt_semaphore sem;
+
+            rt_sem_init(&sem, "lcdblit", 0, RT_IPC_FLAG_PRIO);
+            lcd_dma_submit(x, y, width, height, p, stride, 0, lcd_dma_wakeup, &sem);
+            rt_sem_take(&sem, RT_WAITING_FOREVER);
+            rt_sem_detach(&sem);
+        }
+        else
+        {
+            lcd_dma_submit(x, y, width, height, p, stride, 0, done, user_data);
+        }
+        return RT_EOK;
+    }
+    lcd_rect_sync();
+#endif
+
+    LCD_Set_Window(x, y, width, height);
+    LCD_WriteRAM_Prepare();
+    for (rt_uint16_t row = 0; row < height; row++, p += stride)
+    {
+        for (rt_uint16_t col = 0; col < width; col++)
+        {
+            LCD->RAM = p[col];
+        }
+    }
+    lcd_window_restore();
+    if (done)
+    {
+        done(user_data);
+    }
+    return RT_EOK;
+}
+
+#ifdef BSP_USING_ONBOARD_LCD_FB
+static void lcd_fb_fill_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t color)
+{
+    rt_uint16_t *p = _lcd_fb.buf + (rt_uint32_t)y * _lcd_fb.stride + x;
+
+    for (rt_uint16_t row = 0; row < height; row++, p += _lcd_fb.stride)
+    {
+        for (rt_uint16_t col = 0; col < width; col++)
+        {
+            p[col] = color;
+        }
+    }
+    lcd_fb_mark(x, y, width, height);
+}
+
+static void lcd_fb_blit_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t stride,
+                             const rt_uint16_t *src)
+{
+    rt_uint16_t *p = _lcd_fb.buf + (rt_uint32_t)y * _lcd_fb.stride + x;
+
+    for (rt_uint16_t row = 0; row < height; row++, p += _lcd_fb.stride, src += stride)
+    {
+        rt_memcpy(p, src, width * sizeof(rt_uint16_t));
+    }
+    lcd_fb_mark(x, y, width, height);
+}
+
+static void lcd_fb_flushed(void *user_data)
+{
+    _lcd_fb.flush_done++;
+}
+
+/* push the dirty rectangles to the panel, returns before the dma is done */
+static void lcd_fb_flush(void)
+{
+    struct rt_device_rect_info list[LCD_FB_DIRTY_MAX];
+    rt_uint8_t num;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    num = _lcd_fb.dirty_num;
+    rt_memcpy(list, _lcd_fb.dirty, num * sizeof(list[0]));
+    _lcd_fb.dirty_num = 0;
+    rt_hw_interrupt_enable(level);
+
+    if (num == 0)
+    {
+        return;
+    }
+
+    _lcd_fb.flushes++;
+    for (rt_uint8_t i = 0; i < num; i++)
+    {
+        struct rt_device_rect_info *r = &list[i];
+
+        _lcd_fb.flush_rects++;
+        _lcd_fb.flush_pixels += (rt_uint32_t)r->width * r->height;
+        /* the shadow is kept, nothing to release when done */
+        lcd_panel_blit_rect(r->x, r->y, r->width, r->height, _lcd_fb.stride,
+                            _lcd_fb.buf + (rt_uint32_t)r->y * _lcd_fb.stride + r->x, lcd_fb_flushed, RT_NULL);
+    }
+}
+
+static rt_err_t lcd_fb_enable(rt_bool_t enable)
+{
+    if (enable == _lcd_fb.enabled)
+    {
+        return RT_EOK;
+    }
+
+    if (enable)
+    {
+        if ((rt_uint32_t)lcddev.width * lcddev.height * sizeof(rt_uint16_t) > SRAM_LCD_FB_SIZE)
+        {
+            return -RT_ENOMEM;
+        }
+        _lcd_fb.buf = (rt_uint16_t *)SRAM_LCD_FB_ADDR;
+        _lcd_fb.stride = lcddev.width;
+        _lcd_fb.dirty_num = 0;
+        /* gram can not be read back fast, start from a white screen and repaint it on first flush */
+        _lcd_fb.enabled = RT_TRUE;
+        lcd_fb_fill_rect(0, 0, lcddev.width, lcddev.height, 0xFFFF);
+    }
+    else
+    {
+        lcd_fb_flush();
+        lcd_rect_sync();
+        _lcd_fb.enabled = RT_FALSE;
+    }
+    return RT_EOK;
+}
+#endif /* BSP_USING_ONBOARD_LCD_FB */
+
+/* fill a rectangle with color, done is called when finished, RT_NULL to wait for it */
+rt_err_t lcd_fill_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t color,
+                       void (*done)(void *user_data), void *user_data)
+{
+    if (lcd_rect_clip(x, y, &width, &height) != RT_EOK)
+    {
+        return -RT_EINVAL;
+    }
+
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    if (_lcd_fb.enabled)
+    {
+        lcd_fb_fill_rect(x, y, width, height, color);
+        if (done)
+        {
+            done(user_data);
+        }
+        return RT_EOK;
+    }
+#endif
+
+    return lcd_panel_fill_rect(x, y, width, height, color, done, user_data);
+}
+
+/* copy width * height RGB565 pixels into a rectangle, pixels must stay valid until done is called */
+rt_err_t lcd_blit_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, const void *pixels,
+                       void (*done)(void *user_data), void *user_data)
+{
+    rt_uint16_t stride = width;
+
+    if (pixels == RT_NULL || lcd_rect_clip(x, y, &width, &height) != RT_EOK)
+    {
+        return -RT_EINVAL;
+    }
+
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    if (_lcd_fb.enabled)
+    {
+        lcd_fb_blit_rect(x, y, width, height, stride, (const rt_uint16_t *)pixels);
+        if (done)
+        {
+            done(user_data);
+        }
+        return RT_EOK;
+    }
+#endif
+
+    return lcd_panel_blit_rect(x, y, width, height, stride, (const rt_uint16_t *)pixels, done, user_data);
+}
+
 //清屏函数
 //color:要清屏的填充色
 void LCD_Clear(uint32_t color)
 {
-    uint32_t index = 0;
-    uint32_t totalpoint = lcddev.width;
-    totalpoint *= lcddev.height; //得到总点数
-    LCD_SetCursor(0x00, 0x0000); //设置光标位置
-    LCD_WriteRAM_Prepare();      //开始写入GRAM
-    for (index = 0; index < totalpoint; index++)
+    lcd_fill_rect(0, 0, lcddev.width, lcddev.height, color, RT_NULL, RT_NULL);
+}
+
+//快速画点
+//x,y:坐标
+//color:颜色
+static void LCD_Fast_DrawPoint(const char *pixel, int x, int y)
+{
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    if (_lcd_fb.enabled)
     {
-        LCD->RAM = color;
+        if (x < lcddev.width && y < lcddev.height)
+        {
+            _lcd_fb.buf[y * _lcd_fb.stride + x] = *((uint16_t *)pixel);
+            lcd_fb_mark(x, y, 1, 1);
+        }
+        return;
     }
+#endif
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+    //每个点都会调用, 队列空闲时不进同步
+    if (_lcd_dma.busy)
+        lcd_rect_sync();
+#endif
+    lcd_ctrl->draw_point(x, y, *((uint16_t *)pixel));
 }
 
 void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t x2, rt_uint16_t y2)
@@ -479,6 +1143,20 @@ void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t
     rt_uint16_t t;
     int xerr = 0, yerr = 0, delta_x, delta_y, distance;
     int incx, incy, uRow, uCol;
+    uint16_t color = *((uint16_t *)pixel);
+
+    //水平线和垂直线用窗口写
+    if (y1 == y2)
+    {
+        LCD_HLine(pixel, x1, x2, y1);
+        return;
+    }
+    if (x1 == x2)
+    {
+        LCD_VLine(pixel, x1, y1, y2);
+        return;
+    }
+
     delta_x = x2 - x1; //计算坐标增量
     delta_y = y2 - y1;
     uRow = x1;
@@ -486,8 +1164,6 @@ void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t
 
     if (delta_x > 0)
         incx = 1; //设置单步方向
-    else if (delta_x == 0)
-        incx = 0; //垂直线
     else
     {
         incx = -1;
@@ -496,8 +1172,6 @@ void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t
 
     if (delta_y > 0)
         incy = 1;
-    else if (delta_y == 0)
-        incy = 0; //水平线
     else
     {
         incy = -1;
@@ -509,10 +1183,45 @@ void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t
     else
         distance = delta_y;
 
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    //影子缓冲模式下画进缓冲,最后标记整条线的外框
+    if (_lcd_fb.enabled)
+    {
+        int min_x = uRow, max_x = uRow, min_y = uCol, max_y = uCol;
+
+        for (t = 0; t <= distance + 1; t++)
+        {
+            if (uRow >= 0 && uRow < lcddev.width && uCol >= 0 && uCol < lcddev.height)
+            {
+                _lcd_fb.buf[uCol * _lcd_fb.stride + uRow] = color;
+                min_x = LCD_MIN(min_x, uRow);
+                max_x = LCD_MAX(max_x, uRow);
+                min_y = LCD_MIN(min_y, uCol);
+                max_y = LCD_MAX(max_y, uCol);
+            }
+            xerr += delta_x;
+            yerr += delta_y;
+            if (xerr > distance)
+            {
+                xerr -= distance;
+                uRow += incx;
+            }
+            if (yerr > distance)
+            {
+                yerr -= distance;
+                uCol += incy;
+            }
+        }
+        if (min_x < lcddev.width && min_y < lcddev.height)
+            lcd_fb_mark(min_x, min_y, max_x - min_x + 1, max_y - min_y + 1);
+        return;
+    }
+#endif
+
+    lcd_rect_sync();
     for (t = 0; t <= distance + 1; t++) //画线输出
     {
-        // LCD_DrawPoint(uRow, uCol); //画点
-        LCD_Fast_DrawPoint(pixel, uRow, uCol);
+        lcd_ctrl->draw_point(uRow, uCol, color);
         xerr += delta_x;
         yerr += delta_y;
 
@@ -529,42 +1238,49 @@ void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t
         }
     }
 }
+
 void LCD_HLine(const char *pixel, int x1, int x2, int y)
 {
-    LCD_DrawLine(pixel, x1, y, x2, y);
+    int t;
+
+    if (x1 > x2)
+    {
+        t = x1;
+        x1 = x2;
+        x2 = t;
+    }
+    if (x2 < 0 || y < 0)
+        return;
+    if (x1 < 0)
+        x1 = 0;
+    lcd_fill_rect(x1, y, x2 - x1 + 1, 1, *((uint16_t *)pixel), RT_NULL, RT_NULL);
 }
 
 void LCD_VLine(const char *pixel, int x, int y1, int y2)
 {
-    LCD_DrawLine(pixel, x, y1, x, y2);
+    int t;
+
+    if (y1 > y2)
+    {
+        t = y1;
+        y1 = y2;
+        y2 = t;
+    }
+    if (y2 < 0 || x < 0)
+        return;
+    if (y1 < 0)
+        y1 = 0;
+    lcd_fill_rect(x, y1, 1, y2 - y1 + 1, *((uint16_t *)pixel), RT_NULL, RT_NULL);
 }
 
 void LCD_BlitLine(const char *pixel, int x, int y, rt_size_t size)
 {
-    LCD_SetCursor(x, y);
-    LCD_WriteRAM_Prepare();
-    uint16_t *p = (uint16_t *)pixel;
-    for (; size > 0; size--, p++)
-        LCD->RAM = *p;
+    lcd_blit_rect(x, y, size, 1, pixel, RT_NULL, RT_NULL);
 }
 
 void lcd_fill_array(rt_uint16_t x_start, rt_uint16_t y_start, rt_uint16_t x_end, rt_uint16_t y_end, void *pcolor)
 {
-    rt_uint16_t *pixel = RT_NULL;
-    rt_uint16_t cycle_y, x_offset = 0;
-
-    pixel = (rt_uint16_t *)pcolor;
-
-    for(cycle_y = y_start; cycle_y <= y_end; )
-    {
-        LCD_SetCursor(x_start, cycle_y);
-        LCD_WriteRAM_Prepare();
-        for(x_offset = 0;x_start + x_offset <= x_end; x_offset++)
-        {
-            LCD->RAM = *pixel++;
-        }
-        cycle_y++;
-    }
+    lcd_blit_rect(x_start, y_start, x_end - x_start + 1, y_end - y_start + 1, pcolor, RT_NULL, RT_NULL);
 }
 
 static rt_err_t drv_lcd_init(struct rt_device *device)
@@ -1927,6 +2643,13 @@ static rt_err_t drv_lcd_init(struct rt_device *device)
     }
     LCD_Display_Dir(1); //默认为横屏
 
+#ifdef BSP_USING_ONBOARD_LCD_DMA
+    if (!_lcd_dma.inited)
+    {
+        lcd_dma_init();
+    }
+#endif
+
     rt_pin_write(LCD_BL, PIN_HIGH);
 
     LCD_Clear(0xffff);
@@ -1959,8 +2682,57 @@ static rt_err_t drv_lcd_control(struct rt_device *device, int cmd, void *args)
         info->bits_per_pixel = lcd->lcd_info.bits_per_pixel;
         info->width = lcddev.width;
         info->height = lcddev.height;
+#ifdef BSP_USING_ONBOARD_LCD_FB
+        if (_lcd_fb.enabled)
+        {
+            info->pitch = _lcd_fb.stride * sizeof(rt_uint16_t);
+            info->framebuffer = (rt_uint8_t *)_lcd_fb.buf;
+            info->smem_len = info->pitch * lcddev.height;
+        }
+#endif
     }
     break;
+
+#ifdef BSP_USING_ONBOARD_LCD_FB
+    case RTGRAPHIC_CTRL_RECT_UPDATE:
+    {
+        struct rt_device_rect_info *rect = (struct rt_device_rect_info *)args;
+
+        if (!_lcd_fb.enabled)
+            break;
+        //直接写了framebuffer的区域在这里标记, RT_NULL只刷新已标记的区域
+        if (rect)
+        {
+            rt_uint16_t width = rect->width, height = rect->height;
+
+            if (lcd_rect_clip(rect->x, rect->y, &width, &height) == RT_EOK)
+                lcd_fb_mark(rect->x, rect->y, width, height);
+        }
+        lcd_fb_flush();
+    }
+    break;
+
+    case LCD_CTRL_FB_MODE:
+        RT_ASSERT(args != RT_NULL);
+        return lcd_fb_enable(*(rt_uint32_t *)args == LCD_FB_MODE_SHADOW);
+#endif
+
+    case LCD_CTRL_FILL_RECT:
+    case LCD_CTRL_BLIT_RECT:
+    {
+        struct lcd_rect_req *req = (struct lcd_rect_req *)args;
+
+        RT_ASSERT(req != RT_NULL);
+
+        if (cmd == LCD_CTRL_FILL_RECT)
+            return lcd_fill_rect(req->x, req->y, req->width, req->height, req->color, req->done, req->user_data);
+        else
+            return lcd_blit_rect(req->x, req->y, req->width, req->height, req->pixels, req->done, req->user_data);
+    }
+
+    case LCD_CTRL_RECT_SYNC:
+        lcd_rect_sync();
+        break;
     }
 
     return RT_EOK;
@@ -2042,4 +2814,247 @@ void lcd_fill(int argc, void **argv)
     }
 }
 MSH_CMD_EXPORT(lcd_fill, lcd fill test for mcu lcd);
+
+#define LCD_FPS_BAND 16
+
+static void lcd_fps_report(const char *name, rt_uint32_t frames, rt_tick_t tick)
+{
+    rt_uint32_t fps10;
+
+    if (tick == 0)
+        tick = 1;
+    fps10 = frames * RT_TICK_PER_SECOND * 10 / tick;
+    rt_kprintf("%-10s %4d frames %6d ms  %d.%d fps\n", name, frames, tick * 1000 / RT_TICK_PER_SECOND, fps10 / 10, fps10 % 10);
+}
+
+static void lcd_fps_count(void *user_data)
+{
+    (*(volatile rt_uint32_t *)user_data)++;
+}
+
+/* full screen frames per second: cpu fill, engine fill, queued fill and banded blit */
+void lcd_fps(int argc, char **argv)
+{
+    rt_device_t lcd;
+    rt_uint32_t frames = argc > 1 ? atoi(argv[1]) : 20;
+    rt_uint32_t total = (rt_uint32_t)lcddev.width * lcddev.height;
+    volatile rt_uint32_t done = 0;
+    rt_uint16_t *band;
+    rt_tick_t tick;
+
+    lcd = rt_device_find("lcd");
+    if (lcd == RT_NULL)
+        return;
+    rt_device_init(lcd);
+    if (frames == 0)
+        frames = 1;
+
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+    {
+        LCD_Set_Window(0, 0, lcddev.width, lcddev.height);
+        LCD_WriteRAM_Prepare();
+        for (rt_uint32_t n = 0; n < total; n++)
+            LCD->RAM = i & 1 ? 0xF800 : 0x001F;
+    }
+    lcd_window_restore();
+    lcd_fps_report("cpu fill", frames, rt_tick_get() - tick);
+
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+        lcd_fill_rect(0, 0, lcddev.width, lcddev.height, i & 1 ? 0x07E0 : 0xFFE0, RT_NULL, RT_NULL);
+    lcd_fps_report("fill", frames, rt_tick_get() - tick);
+
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+        lcd_fill_rect(0, 0, lcddev.width, lcddev.height, i & 1 ? 0xF81F : 0x07FF, lcd_fps_count, (void *)&done);
+    lcd_rect_sync();
+    lcd_fps_report("fill queue", frames, rt_tick_get() - tick);
+
+    band = rt_malloc(lcddev.width * LCD_FPS_BAND * sizeof(rt_uint16_t));
+    if (band == RT_NULL)
+        return;
+    for (rt_uint32_t n = 0; n < lcddev.width * LCD_FPS_BAND; n++)
+        band[n] = n;
+
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+    {
+        for (rt_uint16_t y = 0; y < lcddev.height; y += LCD_FPS_BAND)
+            lcd_blit_rect(0, y, lcddev.width, LCD_FPS_BAND, band, lcd_fps_count, (void *)&done);
+    }
+    lcd_rect_sync();
+    lcd_fps_report("blit", frames, rt_tick_get() - tick);
+
+    rt_free(band);
+}
+MSH_CMD_EXPORT(lcd_fps, lcd frames per second benchmark: lcd_fps [frames]);
+
+static void lcd_prim_report(const char *name, rt_uint32_t pixels, rt_tick_t tick)
+{
+    if (tick == 0)
+        tick = 1;
+    rt_kprintf("%-8s %8d pixels %6d ms  %d Kpixels/s\n", name, pixels, tick * 1000 / RT_TICK_PER_SECOND,
+               (pixels / tick) * RT_TICK_PER_SECOND / 1000);
+}
+
+/* pixels per second of each drawing primitive through the graphic ops and the rect api */
+void lcd_prim(int argc, char **argv)
+{
+    rt_device_t lcd;
+    struct rt_device_graphic_ops *ops;
+    rt_uint32_t loops = argc > 1 ? atoi(argv[1]) : 200;
+    rt_uint16_t w, h, color = 0;
+    rt_uint32_t pixels;
+    rt_uint16_t *bitmap;
+    rt_tick_t tick;
+
+    lcd = rt_device_find("lcd");
+    if (lcd == RT_NULL)
+        return;
+    rt_device_init(lcd);
+    ops = rt_graphix_ops(lcd);
+    w = lcddev.width;
+    h = lcddev.height;
+    if (loops == 0)
+        loops = 1;
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++, color += 0x0841)
+    {
+        for (rt_uint16_t x = 0; x < w; x++, pixels++)
+            ops->set_pixel((const char *)&color, x, (x + i) % h);
+    }
+    lcd_prim_report("point", pixels, rt_tick_get() - tick);
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++, color += 0x0841)
+    {
+        ops->draw_hline((const char *)&color, 0, w - 1, i % h);
+        pixels += w;
+    }
+    lcd_prim_report("hline", pixels, rt_tick_get() - tick);
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++, color += 0x0841)
+    {
+        ops->draw_vline((const char *)&color, i % w, 0, h - 1);
+        pixels += h;
+    }
+    lcd_prim_report("vline", pixels, rt_tick_get() - tick);
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++, color += 0x0841)
+    {
+        LCD_DrawLine((const char *)&color, 0, 0, w - 1, i % h);
+        pixels += w;
+    }
+    lcd_prim_report("line", pixels, rt_tick_get() - tick);
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++, color += 0x0841)
+    {
+        lcd_fill_rect(i % (w / 2), i % (h / 2), w / 2, h / 2, color, RT_NULL, RT_NULL);
+        pixels += (w / 2) * (h / 2);
+    }
+    lcd_prim_report("rect", pixels, rt_tick_get() - tick);
+
+    bitmap = rt_malloc(64 * 64 * sizeof(rt_uint16_t));
+    if (bitmap == RT_NULL)
+        return;
+    for (rt_uint32_t n = 0; n < 64 * 64; n++)
+        bitmap[n] = n;
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++)
+    {
+        lcd_blit_rect((i * 64) % (w - 64), (i * 64 / w * 64) % (h - 64), 64, 64, bitmap, RT_NULL, RT_NULL);
+        pixels += 64 * 64;
+    }
+    lcd_prim_report("bitmap", pixels, rt_tick_get() - tick);
+
+    pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < loops; i++)
+    {
+        for (rt_uint16_t y = 0; y < 64; y++)
+            ops->blit_line((const char *)&bitmap[y * 64], (i * 64) % (w - 64), y, 64);
+        pixels += 64 * 64;
+    }
+    lcd_prim_report("blitline", pixels, rt_tick_get() - tick);
+
+    rt_free(bitmap);
+}
+MSH_CMD_EXPORT(lcd_prim, lcd drawing primitive benchmark: lcd_prim [loops]);
+
+#ifdef BSP_USING_ONBOARD_LCD_FB
+#define LCD_FB_TEST_BOX 40
+
+/* one frame of a small ui: four boxes moving across the screen and a status bar redrawn */
+static void lcd_fb_test_frame(rt_uint32_t i)
+{
+    rt_uint16_t span = lcddev.width - LCD_FB_TEST_BOX;
+
+    for (rt_uint16_t b = 0; b < 4; b++)
+    {
+        rt_uint16_t x = (i * 4 + b * 97) % span;
+        rt_uint16_t y = 40 + b * (LCD_FB_TEST_BOX + 20);
+
+        lcd_fill_rect(x ? x - 4 : span - 4, y, LCD_FB_TEST_BOX, LCD_FB_TEST_BOX, 0xFFFF, RT_NULL, RT_NULL);
+        lcd_fill_rect(x, y, LCD_FB_TEST_BOX, LCD_FB_TEST_BOX, 0xF800 >> b, RT_NULL, RT_NULL);
+    }
+    lcd_fill_rect(0, 0, lcddev.width, 16, i & 1 ? 0x001F : 0x0010, RT_NULL, RT_NULL);
+}
+
+/* partial update: the same frames drawn direct and through the shadow framebuffer */
+void lcd_fb_test(int argc, char **argv)
+{
+    rt_device_t lcd;
+    rt_uint32_t frames = argc > 1 ? atoi(argv[1]) : 200;
+    rt_uint32_t mode;
+    rt_tick_t tick;
+
+    lcd = rt_device_find("lcd");
+    if (lcd == RT_NULL)
+        return;
+    rt_device_init(lcd);
+
+    LCD_Clear(0xFFFF);
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+        lcd_fb_test_frame(i);
+    lcd_fps_report("direct", frames, rt_tick_get() - tick);
+
+    mode = LCD_FB_MODE_SHADOW;
+    if (rt_device_control(lcd, LCD_CTRL_FB_MODE, &mode) != RT_EOK)
+    {
+        rt_kprintf("shadow framebuffer does not fit %dx%d\n", lcddev.width, lcddev.height);
+        return;
+    }
+    rt_device_control(lcd, RTGRAPHIC_CTRL_RECT_UPDATE, RT_NULL);
+    lcd_rect_sync();
+
+    _lcd_fb.marks = _lcd_fb.flushes = _lcd_fb.flush_rects = _lcd_fb.flush_pixels = 0;
+    tick = rt_tick_get();
+    for (rt_uint32_t i = 0; i < frames; i++)
+    {
+        lcd_fb_test_frame(i);
+        rt_device_control(lcd, RTGRAPHIC_CTRL_RECT_UPDATE, RT_NULL);
+    }
+    lcd_rect_sync();
+    lcd_fps_report("shadow", frames, rt_tick_get() - tick);
+    rt_kprintf("%d marks, %d flushes, %d rects, %d pixels per flush\n", _lcd_fb.marks, _lcd_fb.flushes,
+               _lcd_fb.flush_rects, _lcd_fb.flushes ? _lcd_fb.flush_pixels / _lcd_fb.flushes : 0);
+
+    mode = LCD_FB_MODE_DIRECT;
+    rt_device_control(lcd, LCD_CTRL_FB_MODE, &mode);
+}
+MSH_CMD_EXPORT(lcd_fb_test, lcd shadow framebuffer partial update test: lcd_fb_test [frames]);
+#endif
 #endif
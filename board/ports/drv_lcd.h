@@ -81,6 +81,37 @@ typedef struct
 #define SSD_VPS (SSD_VER_BACK_PORCH)
 
 
+//lcd设备控制命令,在RTGRAPHIC_CTRL_*之后扩展
+#define LCD_CTRL_FILL_RECT      (RT_DEVICE_CTRL_BASE(Graphic) + 0x40)   //填充矩形, args: struct lcd_rect_req
+#define LCD_CTRL_BLIT_RECT      (RT_DEVICE_CTRL_BASE(Graphic) + 0x41)   //拷贝矩形, args: struct lcd_rect_req
+#define LCD_CTRL_RECT_SYNC      (RT_DEVICE_CTRL_BASE(Graphic) + 0x42)   //等待队列中的矩形完成
+#define LCD_CTRL_FB_MODE        (RT_DEVICE_CTRL_BASE(Graphic) + 0x43)   //切换绘图模式, args: rt_uint32_t *, LCD_FB_MODE_*
+
+//绘图模式,影子模式下绘图只写SRAM中的缓冲, RTGRAPHIC_CTRL_RECT_UPDATE时把脏区域推到屏上
+#define LCD_FB_MODE_DIRECT      0
+#define LCD_FB_MODE_SHADOW      1
+
+struct lcd_rect_req
+{
+    rt_uint16_t x;
+    rt_uint16_t y;
+    rt_uint16_t width;
+    rt_uint16_t height;
+    const void *pixels;                 //RGB565 width*height, 完成前必须有效
+    rt_uint16_t color;                  //填充色
+    void (*done)(void *user_data);      //完成回调,在中断中调用; RT_NULL则阻塞到完成
+    void *user_data;
+};
+
 void lcd_fill_array(rt_uint16_t x_start, rt_uint16_t y_start, rt_uint16_t x_end, rt_uint16_t y_end, void *pcolor);
+void LCD_Set_Window(uint16_t sx, uint16_t sy, uint16_t width, uint16_t height);
+void LCD_DrawLine(const char *pixel, rt_uint16_t x1, rt_uint16_t y1, rt_uint16_t x2, rt_uint16_t y2);
+void LCD_HLine(const char *pixel, int x1, int x2, int y);
+void LCD_VLine(const char *pixel, int x, int y1, int y2);
+rt_err_t lcd_fill_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, rt_uint16_t color,
+                       void (*done)(void *user_data), void *user_data);
+rt_err_t lcd_blit_rect(rt_uint16_t x, rt_uint16_t y, rt_uint16_t width, rt_uint16_t height, const void *pixels,
+                       void (*done)(void *user_data), void *user_data);
+void lcd_rect_sync(void);
 
 #endif
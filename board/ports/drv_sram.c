@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2020-02-23     Malongwei    first version
+ * 2026-10-17     loogg        memheap for the bulk heap class
  */
 
 #include <rtthread.h>
@@ -19,7 +20,7 @@
 #define LOG_TAG             "drv.sram"
 #include <drv_log.h>
 
-#ifdef RT_USING_MEMHEAP_AS_HEAP
+#if defined(RT_USING_MEMHEAP_AS_HEAP) || defined(BSP_USING_HEAP_CLASS)
 static struct rt_memheap system_heap;
 #endif
 
@@ -76,9 +77,9 @@ static int rt_hw_sram_init(void)
     else
     {
         LOG_D("sram init success, mapped at 0x%X, size is %d bytes, data width is %d", SRAM_BANK_ADDR, SRAM_SIZE, SRAM_DATA_WIDTH);
-#ifdef RT_USING_MEMHEAP_AS_HEAP
-        /* If RT_USING_MEMHEAP_AS_HEAP is enabled, SRAM is initialized to the heap */
-        rt_memheap_init(&system_heap, "sram", (void *)SRAM_BANK_ADDR, SRAM_SIZE);
+#if defined(RT_USING_MEMHEAP_AS_HEAP) || defined(BSP_USING_HEAP_CLASS)
+        /* If RT_USING_MEMHEAP_AS_HEAP is enabled, SRAM is initialized to the heap, the heap classes take it for bulk buffers */
+        rt_memheap_init(&system_heap, "sram", (void *)SRAM_BANK_ADDR, SRAM_SIZE - SRAM_LCD_FB_SIZE);
 #endif
     }
 
@@ -19,4 +19,12 @@
 /* sram size */
 #define SRAM_SIZE            ((uint32_t)0x00100000)
 
+/* the top of sram is kept for the lcd shadow framebuffer, big enough for 800x480 RGB565 */
+#ifdef BSP_USING_ONBOARD_LCD_FB
+#define SRAM_LCD_FB_SIZE     ((uint32_t)(800 * 480 * 2))
+#else
+#define SRAM_LCD_FB_SIZE     ((uint32_t)0)
+#endif
+#define SRAM_LCD_FB_ADDR     (SRAM_BANK_ADDR + SRAM_SIZE - SRAM_LCD_FB_SIZE)
+
 #endif
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-12-5      SummerGift   first version
+ * 2026-10-17     loogg        add the simulated nor flash of fal_bench
  */
 
 #ifndef _FAL_CFG_H_
@@ -16,6 +17,9 @@
 
 #ifdef BSP_USING_SPI_FLASH_LITTLEFS
 extern struct fal_flash_dev w25q128;
+#ifdef BSP_USING_FAL_NOR_SIM
+extern struct fal_flash_dev nor_sim;
+#endif
 #else
 #define FLASH_SIZE_GRANULARITY_16K   (4 * 16 * 1024)
 #define FLASH_SIZE_GRANULARITY_64K   (64 * 1024)
@@ -30,11 +34,20 @@ extern const struct fal_flash_dev stm32_onchip_flash_128k;
 #endif
 
 
+#ifdef BSP_USING_FAL_NOR_SIM
+#define FAL_NOR_SIM_DEV              &nor_sim,
+#define FAL_NOR_SIM_PART             {FAL_PART_MAGIC_WROD, "norsim", "nor_sim", 0, 32 * 1024, 0},
+#else
+#define FAL_NOR_SIM_DEV
+#define FAL_NOR_SIM_PART
+#endif
+
 /* flash device table */
 #ifdef BSP_USING_SPI_FLASH_LITTLEFS
 #define FAL_FLASH_DEV_TABLE                                          \
 {                                                                    \
     &w25q128,                                                     \
+    FAL_NOR_SIM_DEV                                                  \
 }
 #else
 #define FAL_FLASH_DEV_TABLE                                          \
@@ -53,6 +66,7 @@ extern const struct fal_flash_dev stm32_onchip_flash_128k;
 #define FAL_PART_TABLE                                                                                                     \
 {                                                                                                                          \
     {FAL_PART_MAGIC_WROD, "spiflash0", "W25Q128", 0 , 16 * 1024 * 1024, 0}, \
+    FAL_NOR_SIM_PART                                                                                                       \
 }
 #else
 #define FAL_PART_TABLE                                                                                                     \
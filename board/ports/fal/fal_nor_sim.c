@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <fal.h>
+#include <board.h>
+#include <string.h>
+
+/*
+ * A NOR flash in RAM with the timing of the W25Q128 on SPI1 as the SFUD port drives it, so that
+ * fal_bench measures the FAL write path without wearing the real flash. An erase sets the block to
+ * 0xff and a program only clears bits. The bytes go out at the SPI clock with the CPU busy, then the
+ * page program and sector erase times are waited the way sfud waits for the busy bit, a status read
+ * and a tick of sleep until it clears.
+ */
+
+#define NOR_SIM_SIZE                (32 * 1024)
+#define NOR_SIM_BLK_SIZE            4096
+#define NOR_SIM_PAGE_SIZE           256
+/* SPI1 at APB2 / 2, RT_SFUD_SPI_MAX_HZ is above */
+#define NOR_SIM_SPI_HZ              42000000
+/* W25Q128JV typical page program and 4 KB sector erase times */
+#define NOR_SIM_PROGRAM_US          400
+#define NOR_SIM_ERASE_US            45000
+
+static int init(void);
+static int read(long offset, uint8_t *buf, size_t size);
+static int write(long offset, const uint8_t *buf, size_t size);
+static int erase(long offset, size_t size);
+
+static uint8_t *nor_sim_mem = RT_NULL;
+struct fal_flash_dev nor_sim =
+{
+    .name       = "nor_sim",
+    .addr       = 0,
+    .len        = NOR_SIM_SIZE,
+    .blk_size   = NOR_SIM_BLK_SIZE,
+    .ops        = {init, read, write, erase},
+    .write_gran = 1
+};
+
+/* command, address and data on the bus */
+static void nor_sim_spi(size_t bytes)
+{
+    rt_uint32_t start = DWT->CYCCNT;
+    rt_uint32_t cycles = (rt_uint64_t)(4 + bytes) * 8 * SystemCoreClock / NOR_SIM_SPI_HZ;
+
+    while (DWT->CYCCNT - start < cycles)
+    {
+    }
+}
+
+static void nor_sim_wait_busy(rt_uint32_t us)
+{
+    rt_uint32_t start = DWT->CYCCNT;
+    rt_uint32_t cycles = us * (SystemCoreClock / 1000000);
+
+    nor_sim_spi(0);
+    while (DWT->CYCCNT - start < cycles)
+    {
+        rt_thread_delay((RT_TICK_PER_SECOND * 1 + 9999) / 10000);
+        nor_sim_spi(0);
+    }
+}
+
+static int init(void)
+{
+    nor_sim_mem = rt_malloc(NOR_SIM_SIZE);
+    if (nor_sim_mem == RT_NULL)
+    {
+        return -1;
+    }
+    memset(nor_sim_mem, 0xff, NOR_SIM_SIZE);
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    return 0;
+}
+
+static int read(long offset, uint8_t *buf, size_t size)
+{
+    assert(nor_sim_mem);
+    nor_sim_spi(size);
+    memcpy(buf, nor_sim_mem + offset, size);
+
+    return size;
+}
+
+static int write(long offset, const uint8_t *buf, size_t size)
+{
+    size_t i, len, done;
+
+    assert(nor_sim_mem);
+    for (done = 0; done < size; done += len)
+    {
+        /* a page program at most to the end of the page */
+        len = NOR_SIM_PAGE_SIZE - (offset + done) % NOR_SIM_PAGE_SIZE;
+        if (len > size - done)
+        {
+            len = size - done;
+        }
+
+        nor_sim_spi(len);
+        for (i = 0; i < len; i++)
+        {
+            nor_sim_mem[offset + done + i] &= buf[done + i];
+        }
+        nor_sim_wait_busy(NOR_SIM_PROGRAM_US);
+    }
+
+    return size;
+}
+
+static int erase(long offset, size_t size)
+{
+    long addr;
+
+    assert(nor_sim_mem);
+    for (addr = offset / NOR_SIM_BLK_SIZE * NOR_SIM_BLK_SIZE; addr < offset + (long)size; addr += NOR_SIM_BLK_SIZE)
+    {
+        nor_sim_spi(0);
+        memset(nor_sim_mem + addr, 0xff, NOR_SIM_BLK_SIZE);
+        nor_sim_wait_busy(NOR_SIM_ERASE_US);
+    }
+
+    return size;
+}
@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_FAL) && defined(RT_USING_FINSH)
+
+#include <fal.h>
+
+/*
+ * The FAL write path on a partition, "norsim" of the simulated NOR flash (BSP_USING_FAL_NOR_SIM)
+ * unless one is given. The data of the partition is lost. Every block is erased and written page by
+ * page, and a page costs FAL_BENCH_MAKE_US of CPU to make first, as a sensor, a log or a download would.
+ *
+ * sync: fal_partition_erase and fal_partition_write, the caller waits for the flash.
+ * async: fal_partition_erase_async and fal_partition_write_async, the FAL thread programs a page
+ * while the caller makes the next one, fal_partition_sync at the end.
+ * ahead: the written blocks discarded and the FAL thread given the idle time to erase them, then
+ * as async and the erases are skipped.
+ *
+ * KB/s, the ms the caller spent in FAL, the erase counters of the pass and the pages read back wrong.
+ */
+
+#define FAL_BENCH_PAGE               256
+#define FAL_BENCH_MAKE_US            300
+
+#define FAL_BENCH_SYNC               0
+#define FAL_BENCH_ASYNC              1
+#define FAL_BENCH_AHEAD              2
+
+static rt_uint8_t fal_bench_page[FAL_BENCH_PAGE];
+
+static void fal_bench_make(rt_uint32_t addr, rt_uint32_t pass)
+{
+    rt_uint32_t start = DWT->CYCCNT;
+    rt_uint32_t cycles = FAL_BENCH_MAKE_US * (SystemCoreClock / 1000000);
+
+    for (rt_uint32_t i = 0; i < FAL_BENCH_PAGE; i++)
+    {
+        fal_bench_page[i] = (rt_uint8_t)(pass * 7 + (addr >> 8) + i);
+    }
+    while (DWT->CYCCNT - start < cycles)
+    {
+    }
+}
+
+static rt_uint32_t fal_bench_check(const struct fal_partition *part, rt_uint32_t bytes, rt_uint32_t pass)
+{
+    rt_uint8_t buf[FAL_BENCH_PAGE];
+    rt_uint32_t bad = 0;
+
+    for (rt_uint32_t addr = 0; addr < bytes; addr += FAL_BENCH_PAGE)
+    {
+        fal_partition_read(part, addr, buf, FAL_BENCH_PAGE);
+        for (rt_uint32_t i = 0; i < FAL_BENCH_PAGE; i++)
+        {
+            if (buf[i] != (rt_uint8_t)(pass * 7 + (addr >> 8) + i))
+            {
+                bad++;
+                break;
+            }
+        }
+    }
+
+    return bad;
+}
+
+static void fal_bench_run(const struct fal_partition *part, rt_uint32_t bytes, rt_uint32_t blk_size,
+        rt_uint32_t pass, const char *what)
+{
+    struct fal_partition_stat before, after;
+    rt_uint32_t start, caller_us = 0, ms, bad;
+    rt_uint32_t cycles_us = SystemCoreClock / 1000000;
+    rt_tick_t tick;
+    int ret = 0;
+
+    fal_partition_stat_get(part, &before);
+    tick = rt_tick_get();
+    for (rt_uint32_t addr = 0; addr < bytes && ret >= 0; addr += FAL_BENCH_PAGE)
+    {
+        fal_bench_make(addr, pass);
+
+        start = DWT->CYCCNT;
+        if (pass == FAL_BENCH_SYNC)
+        {
+            if (addr % blk_size == 0)
+            {
+                ret = fal_partition_erase(part, addr, blk_size);
+            }
+            if (ret >= 0)
+            {
+                ret = fal_partition_write(part, addr, fal_bench_page, FAL_BENCH_PAGE);
+            }
+        }
+#ifdef FAL_USING_ASYNC
+        else
+        {
+            if (addr % blk_size == 0)
+            {
+                ret = fal_partition_erase_async(part, addr, blk_size);
+            }
+            if (ret >= 0)
+            {
+                ret = fal_partition_write_async(part, addr, fal_bench_page, FAL_BENCH_PAGE);
+            }
+        }
+#endif
+        caller_us += (DWT->CYCCNT - start) / cycles_us;
+    }
+#ifdef FAL_USING_ASYNC
+    if (pass != FAL_BENCH_SYNC)
+    {
+        start = DWT->CYCCNT;
+        if (fal_partition_sync(part) < 0)
+        {
+            ret = -1;
+        }
+        caller_us += (DWT->CYCCNT - start) / cycles_us;
+    }
+#endif
+    ms = (rt_tick_get() - tick) * 1000 / RT_TICK_PER_SECOND;
+    fal_partition_stat_get(part, &after);
+
+    bad = fal_bench_check(part, bytes, pass);
+    rt_kprintf("%-5s %4d KB/s, caller in fal %5d of %5d ms, erases %4d ahead %4d skipped %4d, %d pages wrong%s\n",
+               what, ms ? (rt_uint32_t)((rt_uint64_t)bytes * 1000 / 1024 / ms) : 0, caller_us / 1000, ms,
+               after.erases - before.erases, after.erases_ahead - before.erases_ahead,
+               after.erases_skipped - before.erases_skipped, bad, ret < 0 ? ", failed" : "");
+}
+
+#ifdef FAL_USING_ASYNC
+static void fal_bench_discard(const struct fal_partition *part, rt_uint32_t bytes, rt_uint32_t blk_size)
+{
+    struct fal_partition_stat before, stat;
+    rt_tick_t tick = rt_tick_get();
+
+    fal_partition_stat_get(part, &before);
+    fal_partition_discard(part, 0, bytes);
+    do
+    {
+        rt_thread_delay(RT_TICK_PER_SECOND / 100);
+        fal_partition_stat_get(part, &stat);
+    } while (stat.erases_ahead - before.erases_ahead < bytes / blk_size &&
+             rt_tick_get() - tick < bytes / blk_size * RT_TICK_PER_SECOND);
+
+    rt_kprintf("idle  %d of %d blocks erased ahead in %d ms\n", stat.erases_ahead - before.erases_ahead,
+               bytes / blk_size, (rt_tick_get() - tick) * 1000 / RT_TICK_PER_SECOND);
+}
+#endif /* FAL_USING_ASYNC */
+
+static int fal_bench(int argc, char **argv)
+{
+    const struct fal_partition *part;
+    const struct fal_flash_dev *flash_dev;
+    struct fal_partition_stat stat;
+    rt_uint32_t bytes;
+
+    part = fal_partition_find(argc > 1 ? argv[1] : "norsim");
+    flash_dev = part ? fal_flash_device_find(part->flash_name) : RT_NULL;
+    if (flash_dev == RT_NULL || flash_dev->blk_size < FAL_BENCH_PAGE)
+    {
+        rt_kprintf("usage: fal_bench [partition] [KB], the partition data is lost\n");
+        return -RT_EINVAL;
+    }
+    bytes = argc > 2 ? atoi(argv[2]) * 1024 : part->len;
+    bytes = bytes / flash_dev->blk_size * flash_dev->blk_size;
+    if (bytes == 0 || bytes > part->len)
+    {
+        rt_kprintf("usage: fal_bench [partition] [KB], the partition data is lost\n");
+        return -RT_EINVAL;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    rt_kprintf("%s on %s, %d KB in blocks of %d, pages of %d made in %d us\n", part->name, part->flash_name,
+               bytes / 1024, flash_dev->blk_size, FAL_BENCH_PAGE, FAL_BENCH_MAKE_US);
+    fal_bench_run(part, bytes, flash_dev->blk_size, FAL_BENCH_SYNC, "sync");
+#ifdef FAL_USING_ASYNC
+    fal_bench_run(part, bytes, flash_dev->blk_size, FAL_BENCH_ASYNC, "async");
+    fal_bench_discard(part, bytes, flash_dev->blk_size);
+    fal_bench_run(part, bytes, flash_dev->blk_size, FAL_BENCH_AHEAD, "ahead");
+#else
+    rt_kprintf("no FAL_USING_ASYNC, sync only\n");
+#endif
+
+    fal_partition_stat_get(part, &stat);
+    rt_kprintf("%s since init: erases %d, ahead %d, skipped %d, %d KB written\n", part->name, stat.erases,
+               stat.erases_ahead, stat.erases_skipped, stat.write_bytes / 1024);
+
+    return 0;
+}
+MSH_CMD_EXPORT(fal_bench, FAL write path throughput: fal_bench [partition] [KB]);
+
+#endif
@@ -0,0 +1,338 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ * 2026-10-18     loogg        plain pass without the size classes
+ */
+
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(RT_USING_SMALL_MEM) && defined(RT_USING_HEAP) && defined(RT_USING_FINSH)
+
+/*
+ * smem allocation trace replayed on a private heap, plain and with the size class cache
+ * (RT_USING_SMALL_MEM_CACHE) in front. The plain pass turns the size classes off, so it allocates
+ * as a heap without the cache does.
+ *
+ * The trace is a list of {slot, size}, size 0 frees the slot. Without a recording it is made up
+ * after what the system heap sees: pbuf headers and control transfers of 20 ~ 256 bytes, 512 byte
+ * sectors, ethernet frames of about 1.5 KB and 2 ~ 4 KB usb host buffers, 32 of them alive at most.
+ * With RT_USING_HOOK "mem_bench record <n>" takes the next n rt_malloc/rt_free of the system heap
+ * instead, the following runs replay it.
+ * alloc/free: DWT cycles of every call, failed allocations are counted. After the replay the free
+ * blocks of the heap show how it is fragmented.
+ */
+
+#define MEM_BENCH_SLOTS 32
+
+struct mem_bench_op
+{
+    rt_uint16_t slot;
+    rt_uint16_t size;
+};
+
+struct mem_bench_cost
+{
+    rt_uint32_t sum;
+    rt_uint32_t num;
+    rt_uint32_t max;
+};
+
+struct mem_bench_trace
+{
+    struct mem_bench_op *ops;
+    rt_uint32_t num;
+};
+
+static struct mem_bench_trace mem_bench_recorded;
+
+rt_inline void mem_bench_add(struct mem_bench_cost *c, rt_uint32_t cycles)
+{
+    c->sum += cycles;
+    c->num++;
+    if (cycles > c->max)
+    {
+        c->max = cycles;
+    }
+}
+
+static rt_uint16_t mem_bench_size(rt_uint32_t *seed)
+{
+    rt_uint32_t r;
+
+    *seed = *seed * 1103515245 + 12345;
+    r = *seed >> 8;
+    switch (r % 20)
+    {
+    case 0: case 1: case 2: case 3: case 4: case 5: case 6:
+        return 20 + (r >> 5) % 41;
+    case 7: case 8: case 9: case 10: case 11:
+        return 64 + (r >> 5) % 193;
+    case 12: case 13: case 14:
+        return 512;
+    case 15: case 16: case 17:
+        return 1536 + (r >> 5) % 65;
+    default:
+        return 2048 + (r >> 5) % 2049;
+    }
+}
+
+static void mem_bench_make(struct mem_bench_trace *t, rt_uint32_t num)
+{
+    rt_bool_t live[MEM_BENCH_SLOTS] = { RT_FALSE };
+    rt_uint32_t seed = num;
+
+    for (t->num = 0; t->num < num; t->num++)
+    {
+        struct mem_bench_op *op = &t->ops[t->num];
+
+        seed = seed * 1103515245 + 12345;
+        op->slot = (seed >> 8) % MEM_BENCH_SLOTS;
+        op->size = live[op->slot] ? 0 : mem_bench_size(&seed);
+        live[op->slot] = !live[op->slot];
+    }
+}
+
+static void mem_bench_replay(struct mem_bench_trace *t, rt_smem_t heap, rt_bool_t cache, const char *name)
+{
+    void *ptr[MEM_BENCH_SLOTS] = { RT_NULL };
+    struct mem_bench_cost alloc, release;
+    rt_uint32_t start, fail = 0, hit = 0;
+    rt_size_t blocks, free_size, largest;
+
+    rt_memset(&alloc, 0, sizeof(alloc));
+    rt_memset(&release, 0, sizeof(release));
+#ifdef RT_USING_SMALL_MEM_CACHE
+    rt_smem_cache_enable(heap, cache);
+#endif
+    for (rt_uint32_t i = 0; i < t->num; i++)
+    {
+        struct mem_bench_op *op = &t->ops[i];
+
+        if (op->size)
+        {
+            start = DWT->CYCCNT;
+            ptr[op->slot] = RT_NULL;
+#ifdef RT_USING_SMALL_MEM_CACHE
+            if (cache)
+            {
+                ptr[op->slot] = rt_smem_cache_alloc(heap, op->size);
+            }
+#endif
+            if (ptr[op->slot] == RT_NULL)
+            {
+                ptr[op->slot] = rt_smem_alloc(heap, op->size);
+            }
+            else
+            {
+                hit++;
+            }
+            mem_bench_add(&alloc, DWT->CYCCNT - start);
+            if (ptr[op->slot] == RT_NULL)
+            {
+                fail++;
+            }
+        }
+        else if (ptr[op->slot])
+        {
+            start = DWT->CYCCNT;
+#ifdef RT_USING_SMALL_MEM_CACHE
+            if (!cache || !rt_smem_cache_free(ptr[op->slot]))
+#endif
+            {
+                rt_smem_free(ptr[op->slot]);
+            }
+            mem_bench_add(&release, DWT->CYCCNT - start);
+            ptr[op->slot] = RT_NULL;
+        }
+    }
+
+    rt_smem_frag_info(heap, &blocks, &free_size, &largest);
+
+    for (rt_uint32_t i = 0; i < MEM_BENCH_SLOTS; i++)
+    {
+        if (ptr[i])
+        {
+            rt_smem_free(ptr[i]);
+        }
+    }
+#ifdef RT_USING_SMALL_MEM_CACHE
+    rt_smem_cache_flush(heap);
+#endif
+
+    rt_kprintf("%-5s alloc %4d/%5d, free %4d/%5d, %d failed, %d%% cached, %d free in %d blocks, largest %d\n", name,
+               alloc.num ? alloc.sum / alloc.num : 0, alloc.max, release.num ? release.sum / release.num : 0, release.max,
+               fail, alloc.num ? hit * 100 / alloc.num : 0, free_size, blocks, largest);
+}
+
+#ifdef RT_USING_HOOK
+static struct
+{
+    void **ptr;
+    struct mem_bench_op *ops;
+    rt_uint32_t num;
+    rt_uint32_t max;
+} mem_bench_rec;
+
+static void mem_bench_record_op(void *p, rt_uint16_t size)
+{
+    rt_uint32_t slot;
+
+    if (mem_bench_rec.num >= mem_bench_rec.max)
+    {
+        return;
+    }
+
+    for (slot = 0; slot < MEM_BENCH_SLOTS; slot++)
+    {
+        if (mem_bench_rec.ptr[slot] == (size ? RT_NULL : p))
+        {
+            break;
+        }
+    }
+    /* too many alive, or freed what was allocated before the recording */
+    if (slot == MEM_BENCH_SLOTS)
+    {
+        return;
+    }
+
+    mem_bench_rec.ptr[slot] = size ? p : RT_NULL;
+    mem_bench_rec.ops[mem_bench_rec.num].slot = slot;
+    mem_bench_rec.ops[mem_bench_rec.num].size = size;
+    if (++mem_bench_rec.num == mem_bench_rec.max)
+    {
+        mem_bench_recorded.ops = mem_bench_rec.ops;
+        mem_bench_recorded.num = mem_bench_rec.num;
+    }
+}
+
+static void mem_bench_malloc_hook(void **ptr, rt_size_t size)
+{
+    rt_base_t level;
+
+    if (*ptr == RT_NULL)
+    {
+        return;
+    }
+    level = rt_hw_interrupt_disable();
+    mem_bench_record_op(*ptr, size > 0xffff ? 0xffff : size);
+    rt_hw_interrupt_enable(level);
+}
+
+static void mem_bench_free_hook(void **ptr)
+{
+    rt_base_t level;
+
+    if (*ptr == RT_NULL)
+    {
+        return;
+    }
+    level = rt_hw_interrupt_disable();
+    mem_bench_record_op(*ptr, 0);
+    rt_hw_interrupt_enable(level);
+}
+
+static int mem_bench_record(rt_uint32_t num)
+{
+    rt_malloc_sethook(RT_NULL);
+    rt_free_sethook(RT_NULL);
+    rt_free(mem_bench_rec.ops);
+    rt_free(mem_bench_rec.ptr);
+    rt_memset(&mem_bench_rec, 0, sizeof(mem_bench_rec));
+    mem_bench_recorded.ops = RT_NULL;
+    mem_bench_recorded.num = 0;
+
+    mem_bench_rec.ops = rt_malloc(num * sizeof(struct mem_bench_op));
+    mem_bench_rec.ptr = rt_calloc(MEM_BENCH_SLOTS, sizeof(void *));
+    if (mem_bench_rec.ops == RT_NULL || mem_bench_rec.ptr == RT_NULL)
+    {
+        rt_free(mem_bench_rec.ops);
+        rt_free(mem_bench_rec.ptr);
+        rt_memset(&mem_bench_rec, 0, sizeof(mem_bench_rec));
+        return -RT_ENOMEM;
+    }
+    mem_bench_rec.max = num;
+    rt_malloc_sethook(mem_bench_malloc_hook);
+    rt_free_sethook(mem_bench_free_hook);
+    rt_kprintf("recording the next %d rt_malloc/rt_free\n", num);
+
+    return 0;
+}
+#endif /* RT_USING_HOOK */
+
+static int mem_bench(int argc, char **argv)
+{
+    struct mem_bench_trace trace;
+    rt_uint32_t num = argc > 1 ? atoi(argv[1]) : 4000;
+    rt_uint32_t heap_size = (argc > 2 ? atoi(argv[2]) : 32) * 1024;
+    rt_smem_t heap;
+    void *buf;
+
+#ifdef RT_USING_HOOK
+    if (argc > 2 && strcmp(argv[1], "record") == 0)
+    {
+        return mem_bench_record(atoi(argv[2]));
+    }
+#endif
+    if (num == 0 || heap_size == 0)
+    {
+        rt_kprintf("usage: mem_bench [ops] [heap KB]\n");
+#ifdef RT_USING_HOOK
+        rt_kprintf("       mem_bench record <ops>\n");
+#endif
+        return -RT_EINVAL;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (mem_bench_recorded.num)
+    {
+        trace = mem_bench_recorded;
+        rt_kprintf("recorded trace, %d ops\n", trace.num);
+    }
+    else
+    {
+        trace.ops = rt_malloc(num * sizeof(struct mem_bench_op));
+        if (trace.ops == RT_NULL)
+        {
+            return -RT_ENOMEM;
+        }
+        mem_bench_make(&trace, num);
+        rt_kprintf("synthetic trace, %d ops\n", trace.num);
+    }
+
+    buf = rt_malloc(heap_size);
+    heap = buf ? rt_smem_init("mbench", buf, heap_size) : RT_NULL;
+    if (heap == RT_NULL)
+    {
+        rt_kprintf("no memory for a %d KB heap\n", heap_size / 1024);
+    }
+    else
+    {
+        rt_kprintf("%d KB heap, cycles avg/max\n", heap_size / 1024);
+        mem_bench_replay(&trace, heap, RT_FALSE, "plain");
+#ifdef RT_USING_SMALL_MEM_CACHE
+        mem_bench_replay(&trace, heap, RT_TRUE, "cache");
+#endif
+        rt_smem_detach(heap);
+    }
+    rt_free(buf);
+
+    if (trace.ops != mem_bench_recorded.ops)
+    {
+        rt_free(trace.ops);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(mem_bench, smem allocation trace replay: mem_bench [ops] [heap KB]);
+
+#endif
@@ -0,0 +1,206 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_SEMAPHORE) && defined(RT_USING_HEAP) && defined(RT_USING_FINSH)
+
+/*
+ * rt_object_find against a walk of the object list, as it was before RT_USING_OBJECT_HASH,
+ * with 10, 100, 1000 ... semaphores alive.
+ *
+ * hit: every name that is there found once, miss: as many names that are not there.
+ * DWT cycles of every call, avg/max. Then a random half is deleted and the rest created again
+ * under the same names, every name has to be found by both the same way after it.
+ */
+
+#define OBJECT_BENCH_NAME "ob%05d"
+
+struct object_bench_cost
+{
+    rt_uint32_t sum;
+    rt_uint32_t num;
+    rt_uint32_t max;
+};
+
+rt_inline void object_bench_add(struct object_bench_cost *c, rt_uint32_t cycles)
+{
+    c->sum += cycles;
+    c->num++;
+    if (cycles > c->max)
+    {
+        c->max = cycles;
+    }
+}
+
+static rt_object_t object_bench_scan(const char *name, rt_uint8_t type)
+{
+    struct rt_object_information *information;
+    struct rt_list_node *node;
+    struct rt_object *object;
+    rt_base_t level;
+
+    information = rt_object_get_information((enum rt_object_class_type)type);
+    level = rt_spin_lock_irqsave(&(information->spinlock));
+    rt_list_for_each(node, &(information->object_list))
+    {
+        object = rt_list_entry(node, struct rt_object, list);
+        if (rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
+        {
+            rt_spin_unlock_irqrestore(&(information->spinlock), level);
+            return object;
+        }
+    }
+    rt_spin_unlock_irqrestore(&(information->spinlock), level);
+
+    return RT_NULL;
+}
+
+static void object_bench_time(rt_uint32_t num, rt_uint32_t base, const char *what)
+{
+    struct object_bench_cost find, scan;
+    char name[RT_NAME_MAX];
+    rt_uint32_t start;
+
+    rt_memset(&find, 0, sizeof(find));
+    rt_memset(&scan, 0, sizeof(scan));
+    for (rt_uint32_t i = 0; i < num; i++)
+    {
+        rt_snprintf(name, sizeof(name), OBJECT_BENCH_NAME, base + i);
+
+        start = DWT->CYCCNT;
+        rt_object_find(name, RT_Object_Class_Semaphore);
+        object_bench_add(&find, DWT->CYCCNT - start);
+
+        start = DWT->CYCCNT;
+        object_bench_scan(name, RT_Object_Class_Semaphore);
+        object_bench_add(&scan, DWT->CYCCNT - start);
+    }
+
+    rt_kprintf("%5d %-4s find %5d/%5d, list %6d/%6d\n", num, what, find.sum / find.num, find.max,
+               scan.sum / scan.num, scan.max);
+}
+
+static rt_uint32_t object_bench_check(rt_sem_t *sem, rt_uint32_t num)
+{
+    char name[RT_NAME_MAX];
+    rt_uint32_t bad = 0;
+    rt_object_t object;
+
+    for (rt_uint32_t i = 0; i < num; i++)
+    {
+        rt_snprintf(name, sizeof(name), OBJECT_BENCH_NAME, i);
+        object = rt_object_find(name, RT_Object_Class_Semaphore);
+        if (object != (rt_object_t)sem[i] || object != object_bench_scan(name, RT_Object_Class_Semaphore))
+        {
+            bad++;
+        }
+    }
+
+    return bad;
+}
+
+static void object_bench_run(rt_sem_t *sem, rt_uint32_t num)
+{
+    char name[RT_NAME_MAX];
+    rt_uint32_t created, bad, seed = num;
+
+    for (created = 0; created < num; created++)
+    {
+        rt_snprintf(name, sizeof(name), OBJECT_BENCH_NAME, created);
+        sem[created] = rt_sem_create(name, 0, RT_IPC_FLAG_PRIO);
+        if (sem[created] == RT_NULL)
+        {
+            rt_kprintf("%d semaphores made, no memory for more\n", created);
+            break;
+        }
+    }
+
+    if (created == num)
+    {
+        object_bench_time(num, 0, "hit");
+        object_bench_time(num, num, "miss");
+
+        /* delete a random half, and the names of the rest must still be found */
+        for (rt_uint32_t i = 0; i < num; i++)
+        {
+            seed = seed * 1103515245 + 12345;
+            if ((seed >> 16) & 1)
+            {
+                rt_sem_delete(sem[i]);
+                sem[i] = RT_NULL;
+            }
+        }
+        bad = object_bench_check(sem, num);
+
+        /* and made again under the same names */
+        for (rt_uint32_t i = 0; i < num; i++)
+        {
+            if (sem[i] == RT_NULL)
+            {
+                rt_snprintf(name, sizeof(name), OBJECT_BENCH_NAME, i);
+                sem[i] = rt_sem_create(name, 0, RT_IPC_FLAG_PRIO);
+            }
+        }
+        bad += object_bench_check(sem, num);
+        if (bad)
+        {
+            rt_kprintf("%5d      %d lookups wrong\n", num, bad);
+        }
+        created = num;
+    }
+
+    for (rt_uint32_t i = 0; i < created; i++)
+    {
+        if (sem[i])
+        {
+            rt_sem_delete(sem[i]);
+        }
+    }
+}
+
+static int object_bench(int argc, char **argv)
+{
+    rt_uint32_t max = argc > 1 ? atoi(argv[1]) : 1000;
+    rt_sem_t *sem;
+
+    if (max == 0 || max > 99999)
+    {
+        rt_kprintf("usage: object_bench [max objects]\n");
+        return -RT_EINVAL;
+    }
+
+    sem = rt_malloc(max * sizeof(rt_sem_t));
+    if (sem == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+#ifdef RT_USING_OBJECT_HASH
+    rt_kprintf("name index of %d buckets, cycles avg/max\n", 1 << RT_OBJECT_HASH_BITS);
+#else
+    rt_kprintf("no name index, cycles avg/max\n");
+#endif
+    for (rt_uint32_t num = 10; num <= max; num *= 10)
+    {
+        object_bench_run(sem, num);
+    }
+    rt_free(sem);
+
+    return 0;
+}
+MSH_CMD_EXPORT(object_bench, rt_object_find against a list walk: object_bench [max objects]);
+
+#endif
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_PM) && defined(RT_USING_CPUTIME) && defined(RT_USING_HEAP) && defined(RT_USING_FINSH)
+
+/*
+ * Interrupt and thread wakeup jitter on the cputime clock, with the tick running and tick-less.
+ *
+ * isr: a cputimer set again from its own callback every <period> us. How late the callback runs
+ * after its timeout is the interrupt latency, a tick isr or a wakeup from sleep in the way shows
+ * in the max.
+ * thread: rt_thread_delay_until every PM_JITTER_TICKS ticks, how far each period is off.
+ * drift: rt_tick against the cputime clock over both, how well rt_tick is made up after sleeping.
+ * Runs once holding PM_SLEEP_MODE_IDLE, so the tick comes every time, and once with the modes the
+ * system asks for. The cputime clock may stand still in deep sleep, only light sleep measures right.
+ */
+
+#define PM_JITTER_TICKS 5
+
+struct pm_jitter_stat
+{
+    rt_uint64_t sum;
+    rt_uint32_t num;
+    rt_uint32_t min;
+    rt_uint32_t max;
+};
+
+struct pm_jitter
+{
+    struct rt_cputimer timer;
+    struct rt_semaphore done;
+    rt_uint64_t period;
+    rt_uint32_t count;
+    rt_uint32_t fired;
+    struct pm_jitter_stat isr;
+    struct pm_jitter_stat thread;
+};
+
+static void pm_jitter_reset(struct pm_jitter_stat *s)
+{
+    rt_memset(s, 0, sizeof(*s));
+    s->min = 0xffffffff;
+}
+
+rt_inline void pm_jitter_add(struct pm_jitter_stat *s, rt_uint32_t cputick)
+{
+    s->sum += cputick;
+    s->num++;
+    if (cputick < s->min)
+    {
+        s->min = cputick;
+    }
+    if (cputick > s->max)
+    {
+        s->max = cputick;
+    }
+}
+
+static rt_uint64_t pm_jitter_ns(rt_uint64_t cputick)
+{
+    return cputick * clock_cpu_getres() / 1000000;
+}
+
+static void pm_jitter_timeout(void *parameter)
+{
+    struct pm_jitter *j = (struct pm_jitter *)parameter;
+
+    pm_jitter_add(&j->isr, clock_cpu_gettime() - j->timer.timeout_tick);
+    if (++j->fired < j->count)
+    {
+        rt_cputimer_control(&j->timer, RT_TIMER_CTRL_SET_TIME, &j->period);
+        rt_cputimer_start(&j->timer);
+    }
+    else
+    {
+        rt_sem_release(&j->done);
+    }
+}
+
+static void pm_jitter_run(struct pm_jitter *j, const char *name)
+{
+    static const char *mode_str[] = PM_SLEEP_MODE_NAMES;
+    rt_uint64_t start, last, now, expect, diff;
+    rt_tick_t tick, tick_start;
+    rt_int32_t drift;
+
+    pm_jitter_reset(&j->isr);
+    pm_jitter_reset(&j->thread);
+    j->fired = 0;
+    expect = (rt_uint64_t)PM_JITTER_TICKS * 1000000000 / RT_TICK_PER_SECOND * 1000000 / clock_cpu_getres();
+
+    tick_start = rt_tick_get();
+    start = clock_cpu_gettime();
+
+    if (clock_cpu_issettimeout())
+    {
+        rt_cputimer_control(&j->timer, RT_TIMER_CTRL_SET_TIME, &j->period);
+        rt_cputimer_start(&j->timer);
+        rt_sem_take(&j->done, RT_WAITING_FOREVER);
+    }
+
+    /* line up with the tick first */
+    tick = rt_tick_get();
+    rt_thread_delay_until(&tick, PM_JITTER_TICKS);
+    last = clock_cpu_gettime();
+    for (rt_uint32_t i = 0; i < j->count; i++)
+    {
+        rt_thread_delay_until(&tick, PM_JITTER_TICKS);
+        now = clock_cpu_gettime();
+        diff = now - last;
+        pm_jitter_add(&j->thread, diff > expect ? diff - expect : expect - diff);
+        last = now;
+    }
+
+    now = clock_cpu_gettime();
+    tick = rt_tick_get() - tick_start;
+    drift = (rt_int32_t)((rt_int64_t)tick * (1000000 / RT_TICK_PER_SECOND) - (rt_int64_t)(pm_jitter_ns(now - start) / 1000));
+
+    if (j->isr.num)
+    {
+        rt_kprintf("%-4s isr latency min/avg/max %d/%d/%d ns\n", name, (rt_uint32_t)pm_jitter_ns(j->isr.min),
+                   (rt_uint32_t)pm_jitter_ns(j->isr.sum / j->isr.num), (rt_uint32_t)pm_jitter_ns(j->isr.max));
+    }
+    rt_kprintf("%-4s thread period error avg/max %d/%d us, rt_tick drift %d us in %d ms, %s\n", name,
+               (rt_uint32_t)pm_jitter_ns(j->thread.sum / j->thread.num) / 1000, (rt_uint32_t)pm_jitter_ns(j->thread.max) / 1000,
+               drift, tick * 1000 / RT_TICK_PER_SECOND, mode_str[rt_pm_get_handle()->sleep_mode]);
+}
+
+static int pm_jitter(int argc, char **argv)
+{
+    struct pm_jitter *j;
+    rt_thread_t self = rt_thread_self();
+    rt_uint8_t prio = self->current_priority, high = 0;
+    rt_uint32_t count = argc > 1 ? atoi(argv[1]) : 200;
+    rt_uint32_t period = argc > 2 ? atoi(argv[2]) : 2999;
+
+    if (count == 0 || period == 0)
+    {
+        rt_kprintf("usage: pm_jitter [count] [isr period us]\n");
+        return -RT_EINVAL;
+    }
+    if (clock_cpu_getres() == 0)
+    {
+        rt_kprintf("no cputime clock\n");
+        return -RT_ENOSYS;
+    }
+
+    j = rt_malloc(sizeof(struct pm_jitter));
+    if (j == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+    rt_memset(j, 0, sizeof(struct pm_jitter));
+    j->count = count;
+    j->period = (rt_uint64_t)period * 1000 * 1000000 / clock_cpu_getres();
+    rt_sem_init(&j->done, "pmjit", 0, RT_IPC_FLAG_PRIO);
+    if (clock_cpu_issettimeout())
+    {
+        rt_cputimer_init(&j->timer, "pmjit", pm_jitter_timeout, j, j->period, RT_TIMER_FLAG_ONE_SHOT);
+    }
+    else
+    {
+        rt_kprintf("cputime has no timeout, isr latency skipped\n");
+    }
+
+    rt_kprintf("%d samples, isr every %d us, thread every %d ticks\n", count, period, PM_JITTER_TICKS);
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &high);
+    rt_pm_request(PM_SLEEP_MODE_IDLE);
+    pm_jitter_run(j, "tick");
+    rt_pm_release(PM_SLEEP_MODE_IDLE);
+    pm_jitter_run(j, "pm");
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &prio);
+
+    if (clock_cpu_issettimeout())
+    {
+        rt_cputimer_detach(&j->timer);
+    }
+    rt_sem_detach(&j->done);
+    rt_free(j);
+
+    return 0;
+}
+MSH_CMD_EXPORT(pm_jitter, isr and thread wakeup jitter with and without tick: pm_jitter [count] [isr period us]);
+
+#endif
@@ -0,0 +1,174 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ * 2026-10-18     loogg        cpu load by bench_load
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include <board.h>
+#include <stdlib.h>
+#include "bench_load.h"
+
+#if defined(RT_USING_SERIAL_V1) && defined(RT_USING_HEAP)
+
+/*
+ * serial v1 throughput and cpu cost.
+ *
+ * tx: the same bytes written by poll mode (putc waits for every byte) and by interrupt mode,
+ * which is the software fifo drained in tx empty isr with RT_SERIAL_USING_TX_FIFO. The console
+ * writes by polling anyway there, the fifo needs another uart. Cpu load is sampled by bench_load.
+ * rx: the rx fifo is filled by hand and read back through rt_device_read, one byte per call is
+ * what the old per byte locking cost, a big read is the bulk copy.
+ */
+
+#define SERIAL_BENCH_CHUNK 64
+
+static void serial_bench_tx(rt_device_t dev, rt_uint16_t oflag, const char *name, rt_uint32_t total)
+{
+    char buf[SERIAL_BENCH_CHUNK];
+    rt_uint16_t saved = dev->open_flag;
+    rt_uint32_t loops;
+    rt_tick_t tick;
+
+    for (rt_uint32_t i = 0; i < sizeof(buf); i++)
+    {
+        buf[i] = '0' + i % 10;
+    }
+    buf[sizeof(buf) - 1] = '\n';
+
+    if (rt_device_open(dev, oflag) != RT_EOK)
+    {
+        rt_kprintf("%s: open failed\n", name);
+        return;
+    }
+
+    loops = bench_load_loops();
+    tick = rt_tick_get();
+    for (rt_uint32_t sent = 0; sent < total; sent += sizeof(buf))
+    {
+        rt_device_write(dev, 0, buf, sizeof(buf));
+    }
+#ifdef RT_SERIAL_USING_TX_FIFO
+    /* count until the fifo is on the wire */
+    if (oflag & RT_DEVICE_FLAG_INT_TX)
+    {
+        struct rt_serial_tx_fifo *tx_fifo = (struct rt_serial_tx_fifo *)((struct rt_serial_device *)dev)->serial_tx;
+
+        while (tx_fifo->count)
+        {
+            rt_thread_mdelay(1);
+        }
+    }
+#endif
+    tick = rt_tick_get() - tick;
+    loops = bench_load_loops() - loops;
+
+    /* the console stays open by others, close only drops the reference, put its flags back */
+    rt_device_close(dev);
+    dev->open_flag = saved;
+
+    if (tick == 0)
+    {
+        tick = 1;
+    }
+    rt_kprintf("\n%-6s tx %d bytes: %d ms, %d B/s, cpu load %d%%\n", name, total,
+               tick * 1000 / RT_TICK_PER_SECOND, total * RT_TICK_PER_SECOND / tick, bench_load_percent(loops, tick));
+}
+
+static void serial_bench_rx(struct rt_serial_device *serial, rt_uint32_t size, rt_uint32_t total)
+{
+    struct rt_serial_rx_fifo *rx_fifo = (struct rt_serial_rx_fifo *)serial->serial_rx;
+    rt_uint8_t buf[SERIAL_BENCH_CHUNK];
+    rt_uint32_t cycles = 0, got = 0, fill, start;
+    rt_base_t level;
+
+    if (rx_fifo == RT_NULL)
+    {
+        return;
+    }
+
+    while (got < total)
+    {
+        /* fill what the isr would have put, keep one slot free */
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+        fill = serial->config.bufsz - 1;
+        for (rt_uint32_t i = 0; i < fill; i++)
+        {
+            rx_fifo->buffer[rx_fifo->put_index] = i;
+            if (++rx_fifo->put_index >= serial->config.bufsz) rx_fifo->put_index = 0;
+        }
+        rx_fifo->get_index = rx_fifo->put_index + 1;
+        if (rx_fifo->get_index >= serial->config.bufsz) rx_fifo->get_index = 0;
+        rx_fifo->is_full = RT_FALSE;
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+        start = DWT->CYCCNT;
+        while (fill)
+        {
+            rt_size_t len = rt_device_read(&serial->parent, 0, buf, size);
+            if (len == 0)
+                break;
+            fill -= len;
+            got += len;
+        }
+        cycles += DWT->CYCCNT - start;
+    }
+
+    rt_kprintf("rx read %2d: %d bytes, %d.%02d cycles per byte\n", size, got,
+               cycles / got, (cycles % got) * 100 / got);
+}
+
+static int serial_bench(int argc, char **argv)
+{
+    rt_device_t dev;
+    rt_uint32_t total = argc > 2 ? atoi(argv[2]) : 8192;
+    rt_uint16_t oflag;
+
+    dev = rt_device_find(argc > 1 ? argv[1] : RT_CONSOLE_DEVICE_NAME);
+    if (dev == RT_NULL || dev->type != RT_Device_Class_Char)
+    {
+        rt_kprintf("usage: serial_bench [uart] [bytes]\n");
+        return -RT_EINVAL;
+    }
+    total = RT_ALIGN(total, SERIAL_BENCH_CHUNK);
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    if (bench_load_start() != RT_EOK)
+    {
+        return -RT_ENOMEM;
+    }
+    oflag = RT_DEVICE_OFLAG_RDWR | (dev->open_flag & (RT_DEVICE_FLAG_INT_RX | RT_DEVICE_FLAG_DMA_RX | RT_DEVICE_FLAG_STREAM));
+    serial_bench_tx(dev, oflag, "poll", total);
+#ifdef RT_SERIAL_USING_TX_FIFO
+    if (dev == rt_console_get_device())
+    {
+        rt_kprintf("console writes by polling, give another uart for int tx\n");
+    }
+    else
+#endif
+    if (dev->flag & RT_DEVICE_FLAG_INT_TX)
+    {
+        serial_bench_tx(dev, oflag | RT_DEVICE_FLAG_INT_TX, "int", total);
+    }
+    bench_load_stop();
+
+    /* rx path needs the device opened in interrupt rx mode, as finsh does */
+    if (dev->open_flag & RT_DEVICE_FLAG_INT_RX)
+    {
+        serial_bench_rx((struct rt_serial_device *)dev, 1, total);
+        serial_bench_rx((struct rt_serial_device *)dev, SERIAL_BENCH_CHUNK, total);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(serial_bench, serial tx and rx path benchmark: serial_bench [uart] [bytes]);
+
+#endif
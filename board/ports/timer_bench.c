@@ -0,0 +1,204 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_HEAP) && defined(RT_USING_FINSH)
+
+/*
+ * rt_timer cost with 10, 100 and 1000 active hard timers, for the skip list and the timing wheel
+ * (RT_TIMER_USING_WHEEL) backend alike.
+ *
+ * start/stop: DWT cycles of every rt_timer_start/rt_timer_stop, timeouts spread over a minute.
+ * tick isr: a thread above everything else only reads the cycle counter, a gap in it is an
+ * interrupt, almost all of them the tick. Measured once with nothing due ("idle") and once with
+ * periodic timers of 1 ~ 16 ticks ("expire"), so every tick calls about n / 8 timeout functions.
+ */
+
+#define TIMER_BENCH_GAP   200        /* cycles, a loop pass without interrupt is far shorter */
+#define TIMER_BENCH_TICKS 200
+
+struct timer_bench
+{
+    struct rt_timer *timers;
+    rt_uint32_t num;
+    rt_uint32_t seed;
+    volatile rt_uint32_t fired;
+};
+
+struct timer_bench_cost
+{
+    rt_uint32_t sum;
+    rt_uint32_t num;
+    rt_uint32_t max;
+};
+
+static void timer_bench_timeout(void *parameter)
+{
+    ((struct timer_bench *)parameter)->fired++;
+}
+
+static rt_uint32_t timer_bench_rand(struct timer_bench *b)
+{
+    b->seed = b->seed * 1103515245 + 12345;
+    return b->seed >> 8;
+}
+
+rt_inline void timer_bench_add(struct timer_bench_cost *c, rt_uint32_t cycles)
+{
+    c->sum += cycles;
+    c->num++;
+    if (cycles > c->max)
+    {
+        c->max = cycles;
+    }
+}
+
+static void timer_bench_isr(struct timer_bench_cost *c)
+{
+    rt_uint32_t last, now;
+    rt_tick_t tick, end;
+
+    rt_memset(c, 0, sizeof(*c));
+
+    /* start right after a tick */
+    tick = rt_tick_get();
+    while (rt_tick_get() == tick);
+    end = tick + 1 + TIMER_BENCH_TICKS;
+
+    last = DWT->CYCCNT;
+    while (rt_tick_get() != end)
+    {
+        now = DWT->CYCCNT;
+        if (now - last > TIMER_BENCH_GAP)
+        {
+            timer_bench_add(c, now - last);
+        }
+        last = now;
+    }
+}
+
+static void timer_bench_start_all(struct timer_bench *b, rt_uint32_t range, rt_uint32_t min, struct timer_bench_cost *c)
+{
+    rt_tick_t time;
+    rt_uint32_t start;
+
+    for (rt_uint32_t i = 0; i < b->num; i++)
+    {
+        time = min + timer_bench_rand(b) % range;
+        rt_timer_control(&b->timers[i], RT_TIMER_CTRL_SET_TIME, &time);
+
+        start = DWT->CYCCNT;
+        rt_timer_start(&b->timers[i]);
+        if (c)
+        {
+            timer_bench_add(c, DWT->CYCCNT - start);
+        }
+    }
+}
+
+static void timer_bench_stop_all(struct timer_bench *b, struct timer_bench_cost *c)
+{
+    rt_uint32_t start;
+
+    for (rt_uint32_t i = 0; i < b->num; i++)
+    {
+        start = DWT->CYCCNT;
+        rt_timer_stop(&b->timers[i]);
+        if (c)
+        {
+            timer_bench_add(c, DWT->CYCCNT - start);
+        }
+    }
+}
+
+static void timer_bench_run(rt_uint32_t num)
+{
+    struct timer_bench b;
+    struct timer_bench_cost start, stop, idle, expire;
+
+    rt_memset(&start, 0, sizeof(start));
+    rt_memset(&stop, 0, sizeof(stop));
+    b.num = num;
+    b.seed = num;
+    b.fired = 0;
+    b.timers = rt_malloc(num * sizeof(struct rt_timer));
+    if (b.timers == RT_NULL)
+    {
+        rt_kprintf("%4d timers: no memory\n", num);
+        return;
+    }
+    for (rt_uint32_t i = 0; i < num; i++)
+    {
+        rt_timer_init(&b.timers[i], "tbench", timer_bench_timeout, &b, 1, RT_TIMER_FLAG_ONE_SHOT | RT_TIMER_FLAG_HARD_TIMER);
+    }
+
+    /* far away, nothing expires while measuring */
+    timer_bench_start_all(&b, 60 * RT_TICK_PER_SECOND, RT_TICK_PER_SECOND, &start);
+    timer_bench_isr(&idle);
+    timer_bench_stop_all(&b, &stop);
+
+    for (rt_uint32_t i = 0; i < num; i++)
+    {
+        rt_timer_control(&b.timers[i], RT_TIMER_CTRL_SET_PERIODIC, RT_NULL);
+    }
+    timer_bench_start_all(&b, 16, 1, RT_NULL);
+    b.fired = 0;
+    timer_bench_isr(&expire);
+    timer_bench_stop_all(&b, RT_NULL);
+
+    for (rt_uint32_t i = 0; i < num; i++)
+    {
+        rt_timer_detach(&b.timers[i]);
+    }
+    rt_free(b.timers);
+
+    rt_kprintf("%4d timers: start %4d/%5d, stop %4d/%5d, tick isr idle %5d/%6d, expire %6d/%6d (%d per tick)\n", num,
+               start.sum / start.num, start.max, stop.sum / stop.num, stop.max,
+               idle.num ? idle.sum / idle.num : 0, idle.max,
+               expire.num ? expire.sum / expire.num : 0, expire.max, b.fired / TIMER_BENCH_TICKS);
+}
+
+static int timer_bench(int argc, char **argv)
+{
+    static const rt_uint32_t nums[] = { 10, 100, 1000 };
+    rt_thread_t self = rt_thread_self();
+    rt_uint8_t prio = self->current_priority, high = 0;
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    rt_kprintf("%s backend, cycles avg/max\n",
+#ifdef RT_TIMER_USING_WHEEL
+               "timing wheel"
+#else
+               "skip list"
+#endif
+              );
+
+    /* nothing but interrupts may stop the gap loop */
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &high);
+    for (rt_uint32_t i = 0; i < sizeof(nums) / sizeof(nums[0]); i++)
+    {
+        if (argc > 1 && nums[i] > (rt_uint32_t)atoi(argv[1]))
+        {
+            break;
+        }
+        timer_bench_run(nums[i]);
+    }
+    rt_thread_control(self, RT_THREAD_CTRL_CHANGE_PRIORITY, &prio);
+
+    return 0;
+}
+MSH_CMD_EXPORT(timer_bench, rt_timer start stop and tick isr cost: timer_bench [max timers]);
+
+#endif
@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <rtthread.h>
+#include <board.h>
+#include <stdlib.h>
+
+#if defined(RT_USING_ULOG) && defined(ULOG_USING_ASYNC_OUTPUT) && defined(RT_USING_FINSH)
+
+#define LOG_TAG              "ulog.bench"
+#define LOG_LVL              LOG_LVL_DBG
+#include <ulog.h>
+
+/*
+ * What a log line costs the caller, formatted text into the async rbb against a binary
+ * record (ULOG_USING_BINARY), and what the async output pays later to format and hand it to
+ * the backends. The lines are debug level, the console backend is held at info meanwhile and
+ * a backend of the bench counts what comes out. DWT cycles avg/max.
+ *
+ * Then one line every tick for 2 seconds against the rate limit (ULOG_USING_RATE_LIMIT)
+ * of 20 a second after a burst of 10.
+ */
+
+#define ULOG_BENCH_BATCH     16
+
+struct ulog_bench_cost
+{
+    rt_uint32_t sum;
+    rt_uint32_t num;
+    rt_uint32_t max;
+};
+
+static struct ulog_backend ulog_bench_be;
+static rt_uint32_t ulog_bench_lines, ulog_bench_notices;
+
+rt_inline void ulog_bench_add(struct ulog_bench_cost *c, rt_uint32_t cycles)
+{
+    c->sum += cycles;
+    c->num++;
+    if (cycles > c->max)
+    {
+        c->max = cycles;
+    }
+}
+
+static void ulog_bench_output(struct ulog_backend *backend, rt_uint32_t level, const char *tag, rt_bool_t is_raw,
+        const char *log, rt_size_t len)
+{
+    if (is_raw || rt_strcmp(tag, LOG_TAG) != 0)
+    {
+        return;
+    }
+    if (rt_strstr(log, "dropped"))
+    {
+        ulog_bench_notices++;
+    }
+    else
+    {
+        ulog_bench_lines++;
+    }
+}
+
+static void ulog_bench_run(const char *what, rt_uint32_t lines)
+{
+    struct ulog_bench_cost caller, drain;
+    rt_uint32_t start, batch;
+
+    rt_memset(&caller, 0, sizeof(caller));
+    rt_memset(&drain, 0, sizeof(drain));
+    ulog_bench_lines = 0;
+
+    for (rt_uint32_t i = 0; i < lines; i += batch)
+    {
+        batch = lines - i < ULOG_BENCH_BATCH ? lines - i : ULOG_BENCH_BATCH;
+        for (rt_uint32_t j = 0; j < batch; j++)
+        {
+            start = DWT->CYCCNT;
+            ulog_output(LOG_LVL_DBG, LOG_TAG, RT_TRUE, "line %d of %d, %s ep 0x%02x len %d", i + j, lines, "bulk",
+                        0x81, 512);
+            ulog_bench_add(&caller, DWT->CYCCNT - start);
+        }
+        start = DWT->CYCCNT;
+        ulog_async_output();
+        ulog_bench_add(&drain, (DWT->CYCCNT - start) / batch);
+    }
+
+    rt_kprintf("%-6s caller %5d/%6d, async output %6d/%6d per line, %d of %d lines out\n", what,
+               caller.sum / caller.num, caller.max, drain.sum / drain.num, drain.max, ulog_bench_lines, lines);
+}
+
+#ifdef ULOG_USING_RATE_LIMIT
+static void ulog_bench_rate(void)
+{
+    rt_uint32_t tried = 0;
+    rt_tick_t start;
+
+    ulog_bench_lines = 0;
+    ulog_bench_notices = 0;
+    ulog_rate_limit_set(20, 10);
+
+    start = rt_tick_get();
+    while (rt_tick_get() - start < 2 * RT_TICK_PER_SECOND)
+    {
+        ulog_output(LOG_LVL_DBG, LOG_TAG, RT_TRUE, "flood %d", tried++);
+        if (tried % ULOG_BENCH_BATCH == 0)
+        {
+            ulog_async_output();
+        }
+        rt_thread_delay(1);
+    }
+    ulog_async_output();
+
+    rt_kprintf("rate 20/s burst 10: %d of %d lines out in 2 s, %d drop notices\n", ulog_bench_lines, tried,
+               ulog_bench_notices);
+}
+#endif /* ULOG_USING_RATE_LIMIT */
+
+static int ulog_bench(int argc, char **argv)
+{
+    rt_uint32_t lines = argc > 1 ? atoi(argv[1]) : 256;
+    ulog_backend_t console;
+    rt_uint32_t console_level = 0;
+
+    if (lines == 0)
+    {
+        rt_kprintf("usage: ulog_bench [lines]\n");
+        return -RT_EINVAL;
+    }
+
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    /* whatever is waiting goes out first */
+    ulog_flush();
+    console = ulog_backend_find("console");
+    if (console)
+    {
+        console_level = console->out_level;
+        console->out_level = LOG_LVL_INFO;
+    }
+    ulog_bench_be.output = ulog_bench_output;
+    ulog_backend_register(&ulog_bench_be, "bench", RT_FALSE);
+#ifdef ULOG_USING_RATE_LIMIT
+    ulog_rate_limit_set(0, 0);
+#endif
+
+    rt_kprintf("cycles avg/max\n");
+#ifdef ULOG_USING_BINARY
+    ulog_binary_enabled(RT_FALSE);
+#endif
+    ulog_bench_run("text", lines);
+#ifdef ULOG_USING_BINARY
+    ulog_binary_enabled(RT_TRUE);
+    ulog_bench_run("binary", lines);
+    rt_kprintf("%d binary logs lost since init\n", ulog_binary_lost_get());
+#endif
+#ifdef ULOG_USING_RATE_LIMIT
+    ulog_bench_rate();
+    ulog_rate_limit_set(ULOG_RATE_LIMIT_PER_SECOND, ULOG_RATE_LIMIT_BURST);
+#endif
+
+    ulog_backend_unregister(&ulog_bench_be);
+    if (console)
+    {
+        console->out_level = console_level;
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(ulog_bench, ulog caller cost of text and binary logs: ulog_bench [lines]);
+
+#endif
@@ -9,12 +9,19 @@
  * 2018-12-25     zylx         fix some bugs
  * 2019-06-10     SummerGift   optimize PHY state detection process
  * 2019-09-03     xiaofan      optimize link change detection process
+ * 2026-10-17     loogg        zero copy rx descriptor ring, pbuf chain tx, batched rx delivery
+ * 2026-10-18     loogg        tx never sleeps under the lwip core lock
+ * 2026-10-18     loogg        eth_bench cpu load by bench_load, built with BSP_USING_BENCH
  */
 
 #include "drv_config.h"
 #include "drv_eth.h"
+#include <drv_common.h>
 #include <netif/ethernetif.h>
+#include <netif/etharp.h>
 #include <lwipopts.h>
+#include <lwip/pbuf.h>
+#include <lwip/tcpip.h>
 
 /*
 * Emac driver uses CubeMX tool to generate emac and phy's configuration,
@@ -35,6 +42,31 @@
 #define PHY_100M         (1 << 1)
 #define PHY_FULL_DUPLEX  (1 << 2)
 
+/*
+ * Rx: the descriptors point at pool buffers which go up to lwip as custom pbufs, without a copy.
+ * A descriptor is re-armed with a fresh pool buffer when its frame is taken, a hole left by an
+ * empty pool is re-armed by the next pbuf free. A frame always fits in one buffer.
+ * Tx: one descriptor per pbuf of the chain, the chain is referenced until the dma is done.
+ * Done descriptors are reclaimed by the next frame, a full ring fails the frame instead of waiting.
+ */
+#ifndef ETH_RX_POOL_NUM
+#define ETH_RX_POOL_NUM     (ETH_RXBUFNB * 2)
+#endif
+#define ETH_RX_BATCH        ETH_RXBUFNB
+
+#ifdef RT_LWIP_USING_HW_CHECKSUM
+#define ETH_TX_DESC_FLAGS   (ETH_DMATXDESC_TCH | ETH_DMATXDESC_CIC_TCPUDPICMP_FULL)
+#else
+#define ETH_TX_DESC_FLAGS   ETH_DMATXDESC_TCH
+#endif
+
+#ifndef RT_LWIP_ETHTHREAD_PRIORITY
+#define RT_LWIP_ETHTHREAD_PRIORITY  12
+#endif
+#ifndef RT_LWIP_ETHTHREAD_STACKSIZE
+#define RT_LWIP_ETHTHREAD_STACKSIZE 1024
+#endif
+
 struct rt_stm32_eth
 {
     /* inherit from ethernet device */
@@ -51,11 +83,44 @@ struct rt_stm32_eth
     rt_uint32_t    ETH_Mode;
 };
 
+struct eth_rx_buf
+{
+    struct pbuf_custom pc;
+    struct eth_rx_buf *next;
+    rt_uint8_t data[ETH_RX_BUF_SIZE];
+};
+
 static ETH_DMADescTypeDef *DMARxDscrTab, *DMATxDscrTab;
-static rt_uint8_t *Rx_Buff, *Tx_Buff;
+static rt_uint8_t *Tx_Buff;
 static  ETH_HandleTypeDef EthHandle;
 static struct rt_stm32_eth stm32_eth_device;
 
+static struct eth_rx_buf *eth_rx_pool, *eth_rx_free;
+static struct eth_rx_buf *eth_rx_slot[ETH_RXBUFNB];
+static rt_uint32_t eth_rx_cur, eth_rx_fill;
+static struct rt_spinlock eth_rx_lock;
+/* frames taken by this hook do not go to lwip */
+static rt_bool_t (*eth_rx_hook)(struct pbuf *p);
+
+static struct pbuf *eth_tx_slot[ETH_TXBUFNB];
+static rt_uint32_t eth_tx_cur, eth_tx_clean, eth_tx_used;
+
+#ifdef LWIP_NO_RX_THREAD
+static struct rt_semaphore eth_rx_sem;
+#endif
+
+static struct
+{
+    rt_uint32_t rx_frames;
+    rt_uint32_t rx_errors;
+    rt_uint32_t rx_nobuf;
+    rt_uint32_t rx_batches;
+    rt_uint32_t tx_frames;
+    rt_uint32_t tx_zerocopy;
+    rt_uint32_t tx_copy;
+    rt_uint32_t tx_busy;
+} eth_stat;
+
 #if defined(ETH_RX_DUMP) || defined(ETH_TX_DUMP)
 #define __is_print(ch) ((unsigned int)((ch) - ' ') < 127u - ' ')
 static void dump_hex(const rt_uint8_t *ptr, rt_size_t buflen)
@@ -82,6 +147,88 @@ static void dump_hex(const rt_uint8_t *ptr, rt_size_t buflen)
 }
 #endif
 
+/* arm the empty descriptors from eth_rx_fill on, with buf first and then from the pool, lock held */
+static void eth_rx_refill(struct eth_rx_buf *buf)
+{
+    ETH_DMADescTypeDef *desc;
+
+    while (eth_rx_slot[eth_rx_fill] == RT_NULL)
+    {
+        if (buf == RT_NULL)
+        {
+            buf = eth_rx_free;
+            if (buf == RT_NULL)
+            {
+                eth_stat.rx_nobuf++;
+                break;
+            }
+            eth_rx_free = buf->next;
+        }
+
+        desc = &DMARxDscrTab[eth_rx_fill];
+        desc->Buffer1Addr = (uint32_t)buf->data;
+        eth_rx_slot[eth_rx_fill] = buf;
+        buf = RT_NULL;
+        __DMB();
+        desc->Status = ETH_DMARXDESC_OWN;
+
+        eth_rx_fill = (eth_rx_fill + 1) % ETH_RXBUFNB;
+    }
+
+    if (buf != RT_NULL)
+    {
+        buf->next = eth_rx_free;
+        eth_rx_free = buf;
+    }
+
+    /* When Rx Buffer unavailable flag is set: clear it and resume reception */
+    if ((EthHandle.Instance->DMASR & ETH_DMASR_RBUS) != (uint32_t)RESET)
+    {
+        EthHandle.Instance->DMASR = ETH_DMASR_RBUS;
+        EthHandle.Instance->DMARPDR = 0;
+    }
+}
+
+/* the last reference of a received frame is gone, its buffer re-arms a descriptor */
+static void eth_rx_pbuf_free(struct pbuf *p)
+{
+    rt_base_t level;
+
+    level = rt_spin_lock_irqsave(&eth_rx_lock);
+    eth_rx_refill((struct eth_rx_buf *)p);
+    rt_spin_unlock_irqrestore(&eth_rx_lock, level);
+}
+
+static void eth_rx_ring_init(void)
+{
+    rt_base_t level;
+
+    for (rt_uint32_t i = 0; i < ETH_RXBUFNB; i++)
+    {
+        DMARxDscrTab[i].Status = 0;
+        DMARxDscrTab[i].ControlBufferSize = ETH_DMARXDESC_RCH | ETH_RX_BUF_SIZE;
+        DMARxDscrTab[i].Buffer2NextDescAddr = (uint32_t)&DMARxDscrTab[(i + 1) % ETH_RXBUFNB];
+    }
+    EthHandle.RxDesc = DMARxDscrTab;
+    EthHandle.Instance->DMARDLAR = (uint32_t)DMARxDscrTab;
+
+    level = rt_spin_lock_irqsave(&eth_rx_lock);
+    eth_rx_refill(RT_NULL);
+    rt_spin_unlock_irqrestore(&eth_rx_lock, level);
+}
+
+static void eth_tx_ring_init(void)
+{
+    for (rt_uint32_t i = 0; i < ETH_TXBUFNB; i++)
+    {
+        DMATxDscrTab[i].Status = ETH_TX_DESC_FLAGS;
+        DMATxDscrTab[i].Buffer1Addr = (uint32_t)&Tx_Buff[i * ETH_TX_BUF_SIZE];
+        DMATxDscrTab[i].Buffer2NextDescAddr = (uint32_t)&DMATxDscrTab[(i + 1) % ETH_TXBUFNB];
+    }
+    EthHandle.TxDesc = DMATxDscrTab;
+    EthHandle.Instance->DMATDLAR = (uint32_t)DMATxDscrTab;
+}
+
 extern void phy_reset(void);
 /* EMAC initialization function */
 static rt_err_t rt_stm32_eth_init(rt_device_t dev)
@@ -116,11 +263,9 @@ static rt_err_t rt_stm32_eth_init(rt_device_t dev)
         LOG_D("eth hardware init success");
     }
 
-    /* Initialize Tx Descriptors list: Chain Mode */
-    HAL_ETH_DMATxDescListInit(&EthHandle, DMATxDscrTab, Tx_Buff, ETH_TXBUFNB);
-
-    /* Initialize Rx Descriptors list: Chain Mode  */
-    HAL_ETH_DMARxDescListInit(&EthHandle, DMARxDscrTab, Rx_Buff, ETH_RXBUFNB);
+    /* Initialize Tx and Rx Descriptors list: Chain Mode, rx buffers come from the pool */
+    eth_tx_ring_init();
+    eth_rx_ring_init();
 
     /* ETH interrupt Init */
     HAL_NVIC_SetPriority(ETH_IRQn, 0x07, 0);
@@ -189,195 +334,262 @@ static rt_err_t rt_stm32_eth_control(rt_device_t dev, int cmd, void *args)
     return RT_EOK;
 }
 
+/* give back the descriptors the dma is done with and release their frames */
+static void eth_tx_reclaim(void)
+{
+    while (eth_tx_used && (DMATxDscrTab[eth_tx_clean].Status & ETH_DMATXDESC_OWN) == (uint32_t)RESET)
+    {
+        if (eth_tx_slot[eth_tx_clean] != RT_NULL)
+        {
+            pbuf_free(eth_tx_slot[eth_tx_clean]);
+            eth_tx_slot[eth_tx_clean] = RT_NULL;
+        }
+        eth_tx_clean = (eth_tx_clean + 1) % ETH_TXBUFNB;
+        eth_tx_used--;
+    }
+}
+
+/* descriptors for num buffers, never waits: lwip holds the core lock, a full ring is ERR_MEM to it */
+static rt_err_t eth_tx_reserve(rt_uint32_t num)
+{
+    eth_tx_reclaim();
+    if (ETH_TXBUFNB - eth_tx_used < num)
+    {
+        return -RT_EBUSY;
+    }
+
+    return RT_EOK;
+}
+
 /* ethernet device interface */
-/* transmit data*/
+/* transmit data, called by lwip with the core locked */
 rt_err_t rt_stm32_eth_tx(rt_device_t dev, struct pbuf *p)
 {
-    rt_err_t ret = -RT_ERROR;
-    HAL_StatusTypeDef state;
     struct pbuf *q;
-    uint8_t *buffer = (uint8_t *)(EthHandle.TxDesc->Buffer1Addr);
-    __IO ETH_DMADescTypeDef *DmaTxDesc;
-    uint32_t framelength = 0;
-    uint32_t bufferoffset = 0;
-    uint32_t byteslefttocopy = 0;
-    uint32_t payloadoffset = 0;
-
-    DmaTxDesc = EthHandle.TxDesc;
-    bufferoffset = 0;
+    rt_uint32_t num = 0, first, last = 0;
+    rt_bool_t copy = RT_FALSE;
+    ETH_DMADescTypeDef *desc;
 
-    /* copy frame from pbufs to driver buffers */
     for (q = p; q != NULL; q = q->next)
     {
-        /* Is this buffer available? If not, goto error */
-        if ((DmaTxDesc->Status & ETH_DMATXDESC_OWN) != (uint32_t)RESET)
+        if (q->len == 0)
+        {
+            continue;
+        }
+        num++;
+        if (!STM32_DMA_REACHABLE(q->payload))
         {
-            LOG_D("buffer not valid");
-            ret = ERR_USE;
-            goto error;
+            copy = RT_TRUE;
         }
+    }
 
-        /* Get bytes in current lwIP buffer */
-        byteslefttocopy = q->len;
-        payloadoffset = 0;
+    RT_ASSERT(num > 0);
 
-        /* Check if the length of data to copy is bigger than Tx buffer size*/
-        while ((byteslefttocopy + bufferoffset) > ETH_TX_BUF_SIZE)
-        {
-            /* Copy data to Tx buffer*/
-            SMEMCPY((uint8_t *)((uint8_t *)buffer + bufferoffset), (uint8_t *)((uint8_t *)q->payload + payloadoffset), (ETH_TX_BUF_SIZE - bufferoffset));
+    /* a chain longer than the ring or data the dma can not read goes through the bounce buffer */
+    if (num > ETH_TXBUFNB || copy)
+    {
+        RT_ASSERT(p->tot_len <= ETH_TX_BUF_SIZE);
+        copy = RT_TRUE;
+        num = 1;
+    }
 
-            /* Point to next descriptor */
-            DmaTxDesc = (ETH_DMADescTypeDef *)(DmaTxDesc->Buffer2NextDescAddr);
+    if (eth_tx_reserve(num) != RT_EOK)
+    {
+        LOG_D("dma tx desc buffer is not valid");
+        eth_stat.tx_busy++;
+        return -RT_EBUSY;
+    }
 
-            /* Check if the buffer is available */
-            if ((DmaTxDesc->Status & ETH_DMATXDESC_OWN) != (uint32_t)RESET)
+    first = eth_tx_cur;
+    if (copy)
+    {
+        desc = &DMATxDscrTab[eth_tx_cur];
+        desc->Buffer1Addr = (uint32_t)&Tx_Buff[eth_tx_cur * ETH_TX_BUF_SIZE];
+        desc->ControlBufferSize = pbuf_copy_partial(p, (void *)desc->Buffer1Addr, p->tot_len, 0) & ETH_DMATXDESC_TBS1;
+        last = eth_tx_cur;
+        eth_tx_cur = (eth_tx_cur + 1) % ETH_TXBUFNB;
+        eth_stat.tx_copy++;
+    }
+    else
+    {
+        for (q = p; q != NULL; q = q->next)
+        {
+            if (q->len == 0)
             {
-                LOG_E("dma tx desc buffer is not valid");
-                ret = ERR_USE;
-                goto error;
+                continue;
             }
-
-            buffer = (uint8_t *)(DmaTxDesc->Buffer1Addr);
-
-            byteslefttocopy = byteslefttocopy - (ETH_TX_BUF_SIZE - bufferoffset);
-            payloadoffset = payloadoffset + (ETH_TX_BUF_SIZE - bufferoffset);
-            framelength = framelength + (ETH_TX_BUF_SIZE - bufferoffset);
-            bufferoffset = 0;
+            desc = &DMATxDscrTab[eth_tx_cur];
+            desc->Buffer1Addr = (uint32_t)q->payload;
+            desc->ControlBufferSize = q->len & ETH_DMATXDESC_TBS1;
+            last = eth_tx_cur;
+            eth_tx_cur = (eth_tx_cur + 1) % ETH_TXBUFNB;
         }
 
-        /* Copy the remaining bytes */
-        SMEMCPY((uint8_t *)((uint8_t *)buffer + bufferoffset), (uint8_t *)((uint8_t *)q->payload + payloadoffset), byteslefttocopy);
-        bufferoffset = bufferoffset + byteslefttocopy;
-        framelength = framelength + byteslefttocopy;
+        /* lwip leaves a referenced pbuf alone (no tcp retransmit into it) until the dma is done */
+        pbuf_ref(p);
+        eth_tx_slot[last] = p;
+        eth_stat.tx_zerocopy++;
     }
+    eth_tx_used += num;
 
 #ifdef ETH_TX_DUMP
-    dump_hex(buffer, p->tot_len);
+    for (q = p; q != NULL; q = q->next)
+    {
+        dump_hex(q->payload, q->len);
+    }
 #endif
 
-    /* Prepare transmit descriptors to give to DMA */
-    /* TODO Optimize data send speed*/
-    LOG_D("transmit frame length :%d", framelength);
-
-    /* wait for unlocked */
-    while (EthHandle.Lock == HAL_LOCKED);
+    LOG_D("transmit frame length :%d, %d descriptors", p->tot_len, num);
 
-    state = HAL_ETH_TransmitFrame(&EthHandle, framelength);
-    if (state != HAL_OK)
+    /* hand over back to front, the dma must not own the first one before the rest is ready */
+    for (rt_uint32_t i = last; i != first; i = (i + ETH_TXBUFNB - 1) % ETH_TXBUFNB)
     {
-        LOG_E("eth transmit frame faild: %d", state);
+        DMATxDscrTab[i].Status = ETH_TX_DESC_FLAGS | ETH_DMATXDESC_OWN |
+                                 (i == last ? ETH_DMATXDESC_LS | ETH_DMATXDESC_IC : 0);
     }
-
-    ret = ERR_OK;
-
-error:
-
-    /* When Transmit Underflow flag is set, clear it and issue a Transmit Poll Demand to resume transmission */
-    if ((EthHandle.Instance->DMASR & ETH_DMASR_TUS) != (uint32_t)RESET)
+    __DMB();
+    DMATxDscrTab[first].Status = ETH_TX_DESC_FLAGS | ETH_DMATXDESC_OWN | ETH_DMATXDESC_FS |
+                                 (first == last ? ETH_DMATXDESC_LS | ETH_DMATXDESC_IC : 0);
+    __DMB();
+    eth_stat.tx_frames++;
+
+    /* When Transmit buffer unavailable or underflow flag is set, clear it and issue a Transmit Poll Demand to resume transmission */
+    if ((EthHandle.Instance->DMASR & (ETH_DMASR_TBUS | ETH_DMASR_TUS)) != (uint32_t)RESET)
     {
-        /* Clear TUS ETHERNET DMA flag */
-        EthHandle.Instance->DMASR = ETH_DMASR_TUS;
-
-        /* Resume DMA transmission*/
-        EthHandle.Instance->DMATPDR = 0;
+        EthHandle.Instance->DMASR = ETH_DMASR_TBUS | ETH_DMASR_TUS;
     }
+    EthHandle.Instance->DMATPDR = 0;
 
-    return ret;
+    return RT_EOK;
 }
 
-/* receive data*/
-struct pbuf *rt_stm32_eth_rx(rt_device_t dev)
+/* next received frame as a custom pbuf over its descriptor buffer */
+static struct pbuf *eth_rx_take(void)
 {
-
-    struct pbuf *p = NULL;
-    struct pbuf *q = NULL;
-    HAL_StatusTypeDef state;
-    uint16_t len = 0;
-    uint8_t *buffer;
-    __IO ETH_DMADescTypeDef *dmarxdesc;
-    uint32_t bufferoffset = 0;
-    uint32_t payloadoffset = 0;
-    uint32_t byteslefttocopy = 0;
-    uint32_t i = 0;
-
-    /* Get received frame */
-    state = HAL_ETH_GetReceivedFrame_IT(&EthHandle);
-    if (state != HAL_OK)
+    struct pbuf *p = RT_NULL;
+    struct eth_rx_buf *buf;
+    ETH_DMADescTypeDef *desc;
+    uint32_t status, len;
+    rt_base_t level;
+
+    level = rt_spin_lock_irqsave(&eth_rx_lock);
+    while (p == RT_NULL)
     {
-        LOG_D("receive frame faild");
-        return NULL;
-    }
-
-    /* Obtain the size of the packet and put it into the "len" variable. */
-    len = EthHandle.RxFrameInfos.length;
-    buffer = (uint8_t *)EthHandle.RxFrameInfos.buffer;
+        buf = eth_rx_slot[eth_rx_cur];
+        desc = &DMARxDscrTab[eth_rx_cur];
+        if (buf == RT_NULL || (desc->Status & ETH_DMARXDESC_OWN) != (uint32_t)RESET)
+        {
+            break;
+        }
 
-    LOG_D("receive frame len : %d", len);
+        status = desc->Status;
+        eth_rx_slot[eth_rx_cur] = RT_NULL;
+        eth_rx_cur = (eth_rx_cur + 1) % ETH_RXBUFNB;
 
-    if (len > 0)
-    {
-        /* We allocate a pbuf chain of pbufs from the Lwip buffer pool */
-        p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+        if ((status & (ETH_DMARXDESC_ES | ETH_DMARXDESC_FS | ETH_DMARXDESC_LS)) == (ETH_DMARXDESC_FS | ETH_DMARXDESC_LS))
+        {
+            /* without the crc */
+            len = ((status & ETH_DMARXDESC_FL) >> ETH_DMARXDESC_FRAMELENGTHSHIFT) - 4;
+            buf->pc.custom_free_function = eth_rx_pbuf_free;
+            p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &buf->pc, buf->data, ETH_RX_BUF_SIZE);
+            eth_stat.rx_frames++;
+            eth_rx_refill(RT_NULL);
+        }
+        else
+        {
+            /* errored or split frame, the buffer goes straight back */
+            eth_stat.rx_errors++;
+            eth_rx_refill(buf);
+        }
     }
+    rt_spin_unlock_irqrestore(&eth_rx_lock, level);
 
 #ifdef ETH_RX_DUMP
-    dump_hex(buffer, p->tot_len);
+    if (p != RT_NULL)
+    {
+        dump_hex(p->payload, p->tot_len);
+    }
 #endif
 
-    if (p != NULL)
+    return p;
+}
+
+static struct pbuf *eth_rx_next(void)
+{
+    struct pbuf *p;
+
+    while ((p = eth_rx_take()) != RT_NULL)
     {
-        dmarxdesc = EthHandle.RxFrameInfos.FSRxDesc;
-        bufferoffset = 0;
-        for (q = p; q != NULL; q = q->next)
+        if (eth_rx_hook == RT_NULL || !eth_rx_hook(p))
         {
-            byteslefttocopy = q->len;
-            payloadoffset = 0;
+            break;
+        }
+    }
 
-            /* Check if the length of bytes to copy in current pbuf is bigger than Rx buffer size*/
-            while ((byteslefttocopy + bufferoffset) > ETH_RX_BUF_SIZE)
-            {
-                /* Copy data to pbuf */
-                SMEMCPY((uint8_t *)((uint8_t *)q->payload + payloadoffset), (uint8_t *)((uint8_t *)buffer + bufferoffset), (ETH_RX_BUF_SIZE - bufferoffset));
+    return p;
+}
 
-                /* Point to next descriptor */
-                dmarxdesc = (ETH_DMADescTypeDef *)(dmarxdesc->Buffer2NextDescAddr);
-                buffer = (uint8_t *)(dmarxdesc->Buffer1Addr);
+/* receive data*/
+struct pbuf *rt_stm32_eth_rx(rt_device_t dev)
+{
+    return eth_rx_next();
+}
 
-                byteslefttocopy = byteslefttocopy - (ETH_RX_BUF_SIZE - bufferoffset);
-                payloadoffset = payloadoffset + (ETH_RX_BUF_SIZE - bufferoffset);
-                bufferoffset = 0;
-            }
-            /* Copy remaining data in pbuf */
-            SMEMCPY((uint8_t *)((uint8_t *)q->payload + payloadoffset), (uint8_t *)((uint8_t *)buffer + bufferoffset), byteslefttocopy);
-            bufferoffset = bufferoffset + byteslefttocopy;
-        }
-    }
+#ifdef LWIP_NO_RX_THREAD
+/*
+ * Without the ethernetif rx thread frames are delivered from here, the stack is entered
+ * once for a batch instead of a tcpip mailbox message for every frame.
+ */
+static void eth_rx_thread_entry(void *parameter)
+{
+    struct pbuf *batch[ETH_RX_BATCH];
+    struct netif *netif;
+    rt_uint32_t num;
 
-    /* Release descriptors to DMA */
-    /* Point to first descriptor */
-    dmarxdesc = EthHandle.RxFrameInfos.FSRxDesc;
-    /* Set Own bit in Rx descriptors: gives the buffers back to DMA */
-    for (i = 0; i < EthHandle.RxFrameInfos.SegCount; i++)
+    while (1)
     {
-        dmarxdesc->Status |= ETH_DMARXDESC_OWN;
-        dmarxdesc = (ETH_DMADescTypeDef *)(dmarxdesc->Buffer2NextDescAddr);
-    }
+        rt_sem_take(&eth_rx_sem, RT_WAITING_FOREVER);
 
-    /* Clear Segment_Count */
-    EthHandle.RxFrameInfos.SegCount = 0;
+        do
+        {
+            for (num = 0; num < ETH_RX_BATCH; num++)
+            {
+                batch[num] = eth_rx_next();
+                if (batch[num] == RT_NULL)
+                {
+                    break;
+                }
+            }
+            if (num == 0)
+            {
+                break;
+            }
+            eth_stat.rx_batches++;
 
-    /* When Rx Buffer unavailable flag is set: clear it and resume reception */
-    if ((EthHandle.Instance->DMASR & ETH_DMASR_RBUS) != (uint32_t)RESET)
-    {
-        /* Clear RBUS ETHERNET DMA flag */
-        EthHandle.Instance->DMASR = ETH_DMASR_RBUS;
-        /* Resume DMA reception */
-        EthHandle.Instance->DMARPDR = 0;
+            netif = stm32_eth_device.parent.netif;
+#if LWIP_TCPIP_CORE_LOCKING
+            LOCK_TCPIP_CORE();
+            for (rt_uint32_t i = 0; i < num; i++)
+            {
+                if (netif == RT_NULL || ethernet_input(batch[i], netif) != ERR_OK)
+                {
+                    pbuf_free(batch[i]);
+                }
+            }
+            UNLOCK_TCPIP_CORE();
+#else
+            for (rt_uint32_t i = 0; i < num; i++)
+            {
+                if (netif == RT_NULL || netif->input(batch[i], netif) != ERR_OK)
+                {
+                    pbuf_free(batch[i]);
+                }
+            }
+#endif /* LWIP_TCPIP_CORE_LOCKING */
+        } while (num == ETH_RX_BATCH);
     }
-
-    return p;
 }
+#endif /* LWIP_NO_RX_THREAD */
 
 /* interrupt service routine */
 void ETH_IRQHandler(void)
@@ -393,12 +605,16 @@ void ETH_IRQHandler(void)
 
 void HAL_ETH_RxCpltCallback(ETH_HandleTypeDef *heth)
 {
+#ifdef LWIP_NO_RX_THREAD
+    rt_sem_release(&eth_rx_sem);
+#else
     rt_err_t result;
     result = eth_device_ready(&(stm32_eth_device.parent));
     if (result != RT_EOK)
     {
         LOG_I("RxCpltCallback err = %d", result);
     }
+#endif /* LWIP_NO_RX_THREAD */
 }
 
 void HAL_ETH_ErrorCallback(ETH_HandleTypeDef *heth)
@@ -554,17 +770,25 @@ static void phy_monitor_thread_entry(void *parameter)
 static int rt_hw_stm32_eth_init(void)
 {
     rt_err_t state = RT_EOK;
+    rt_thread_t tid;
+
+    rt_spin_lock_init(&eth_rx_lock);
 
     /* Prepare receive and send buffers */
-    Rx_Buff = (rt_uint8_t *)rt_calloc(ETH_RXBUFNB, ETH_MAX_PACKET_SIZE);
-    if (Rx_Buff == RT_NULL)
+    eth_rx_pool = (struct eth_rx_buf *)rt_malloc(ETH_RX_POOL_NUM * sizeof(struct eth_rx_buf));
+    if (eth_rx_pool == RT_NULL)
     {
         LOG_E("No memory");
         state = -RT_ENOMEM;
         goto __exit;
     }
+    for (rt_uint32_t i = 0; i < ETH_RX_POOL_NUM; i++)
+    {
+        eth_rx_pool[i].next = eth_rx_free;
+        eth_rx_free = &eth_rx_pool[i];
+    }
 
-    Tx_Buff = (rt_uint8_t *)rt_calloc(ETH_TXBUFNB, ETH_MAX_PACKET_SIZE);
+    Tx_Buff = (rt_uint8_t *)rt_calloc(ETH_TXBUFNB, ETH_TX_BUF_SIZE);
     if (Tx_Buff == RT_NULL)
     {
         LOG_E("No memory");
@@ -611,6 +835,19 @@ static int rt_hw_stm32_eth_init(void)
     stm32_eth_device.parent.eth_rx     = rt_stm32_eth_rx;
     stm32_eth_device.parent.eth_tx     = rt_stm32_eth_tx;
 
+#ifdef LWIP_NO_RX_THREAD
+    rt_sem_init(&eth_rx_sem, "erx", 0, RT_IPC_FLAG_FIFO);
+    tid = rt_thread_create("erx", eth_rx_thread_entry, RT_NULL,
+                           RT_LWIP_ETHTHREAD_STACKSIZE, RT_LWIP_ETHTHREAD_PRIORITY, 16);
+    if (tid == RT_NULL)
+    {
+        LOG_E("No memory");
+        state = -RT_ENOMEM;
+        goto __exit;
+    }
+    rt_thread_startup(tid);
+#endif /* LWIP_NO_RX_THREAD */
+
     /* register eth device */
     state = eth_device_init(&(stm32_eth_device.parent), "e0");
     if (RT_EOK == state)
@@ -625,7 +862,6 @@ static int rt_hw_stm32_eth_init(void)
     }
 
     /* start phy monitor */
-    rt_thread_t tid;
     tid = rt_thread_create("phy",
                            phy_monitor_thread_entry,
                            RT_NULL,
@@ -643,9 +879,9 @@ static int rt_hw_stm32_eth_init(void)
 __exit:
     if (state != RT_EOK)
     {
-        if (Rx_Buff)
+        if (eth_rx_pool)
         {
-            rt_free(Rx_Buff);
+            rt_free(eth_rx_pool);
         }
 
         if (Tx_Buff)
@@ -667,3 +903,125 @@ __exit:
     return state;
 }
 INIT_DEVICE_EXPORT(rt_hw_stm32_eth_init);
+
+#if defined(RT_USING_FINSH) && defined(BSP_USING_BENCH)
+#include <stdlib.h>
+#include "bench_load.h"
+
+/*
+ * Loopback throughput: the mac is put in loopback mode and frames addressed to ourselves
+ * (local experimental ethertype) are sent through linkoutput as the stack does, the rx hook
+ * counts and drops them before lwip. Cpu load is sampled by bench_load. Other traffic is looped back too while it runs.
+ */
+#define ETH_BENCH_TYPE      0x88B5
+
+static volatile rt_uint32_t eth_bench_rx_bytes, eth_bench_rx_frames;
+
+static rt_bool_t eth_bench_hook(struct pbuf *p)
+{
+    rt_uint8_t *hdr = (rt_uint8_t *)p->payload;
+
+    if (p->len < 14 || hdr[12] != (ETH_BENCH_TYPE >> 8) || hdr[13] != (ETH_BENCH_TYPE & 0xFF))
+    {
+        return RT_FALSE;
+    }
+
+    eth_bench_rx_bytes += p->tot_len;
+    eth_bench_rx_frames++;
+    pbuf_free(p);
+    return RT_TRUE;
+}
+
+static int eth_bench(int argc, char **argv)
+{
+    struct netif *netif = stm32_eth_device.parent.netif;
+    rt_uint32_t seconds = argc > 1 ? atoi(argv[1]) : 5;
+    rt_uint32_t size = argc > 2 ? atoi(argv[2]) : 1500;
+    rt_uint32_t tx_bytes = 0, tx_frames = 0, loops, rx_frames, rx_batches, ms;
+    rt_uint32_t tx_kbps, rx_kbps, zerocopy, copy;
+    rt_tick_t tick, end;
+    struct pbuf *p;
+    err_t ret;
+
+    if (netif == RT_NULL || seconds == 0 || size < 46 || size > 1500)
+    {
+        rt_kprintf("usage: eth_bench [seconds] [payload 46~1500]\n");
+        return -RT_EINVAL;
+    }
+
+    if (bench_load_start() != RT_EOK)
+    {
+        return -RT_ENOMEM;
+    }
+
+    eth_bench_rx_bytes = eth_bench_rx_frames = 0;
+    rx_frames = eth_stat.rx_frames;
+    rx_batches = eth_stat.rx_batches;
+    zerocopy = eth_stat.tx_zerocopy;
+    copy = eth_stat.tx_copy;
+    eth_rx_hook = eth_bench_hook;
+    /* frames to our own address come straight back through the mac */
+    EthHandle.Instance->MACCR |= ETH_MACCR_LM;
+
+    loops = bench_load_loops();
+    tick = rt_tick_get();
+    end = tick + seconds * RT_TICK_PER_SECOND;
+    while ((rt_int32_t)(rt_tick_get() - end) < 0)
+    {
+        LOCK_TCPIP_CORE();
+        p = pbuf_alloc(PBUF_RAW, size + 14, PBUF_RAM);
+        if (p != RT_NULL)
+        {
+            rt_uint8_t *hdr = (rt_uint8_t *)p->payload;
+
+            rt_memcpy(&hdr[0], stm32_eth_device.dev_addr, 6);
+            rt_memcpy(&hdr[6], stm32_eth_device.dev_addr, 6);
+            hdr[12] = ETH_BENCH_TYPE >> 8;
+            hdr[13] = ETH_BENCH_TYPE & 0xFF;
+            ret = netif->linkoutput(netif, p);
+            pbuf_free(p);
+        }
+        UNLOCK_TCPIP_CORE();
+
+        if (p == RT_NULL)
+        {
+            rt_thread_mdelay(1);
+        }
+        else if (ret == ERR_OK)
+        {
+            tx_bytes += size + 14;
+            tx_frames++;
+        }
+    }
+    /* let the last frames come back */
+    rt_thread_mdelay(10);
+    tick = rt_tick_get() - tick;
+    loops = bench_load_loops() - loops;
+
+    EthHandle.Instance->MACCR &= ~ETH_MACCR_LM;
+    eth_rx_hook = RT_NULL;
+    bench_load_stop();
+
+    ms = tick * 1000 / RT_TICK_PER_SECOND;
+    ms = ms ? ms : 1;
+    tx_kbps = (rt_uint32_t)((rt_uint64_t)tx_bytes * 8 / ms);
+    rx_kbps = (rt_uint32_t)((rt_uint64_t)eth_bench_rx_bytes * 8 / ms);
+    rx_frames = eth_stat.rx_frames - rx_frames;
+    rx_batches = eth_stat.rx_batches - rx_batches;
+
+    rt_kprintf("payload %d, %d ms, cpu load %d%%\n", size, ms, bench_load_percent(loops, tick));
+    rt_kprintf("tx %d frames, %d.%02d Mbit/s, zero copy %d, copied %d\n", tx_frames,
+               tx_kbps / 1000, tx_kbps % 1000 / 10, eth_stat.tx_zerocopy - zerocopy, eth_stat.tx_copy - copy);
+    rt_kprintf("rx %d frames, %d.%02d Mbit/s, lost %d\n", eth_bench_rx_frames,
+               rx_kbps / 1000, rx_kbps % 1000 / 10, tx_frames - eth_bench_rx_frames);
+    rt_kprintf("rx errors %d, refill misses %d, tx busy %d", eth_stat.rx_errors, eth_stat.rx_nobuf, eth_stat.tx_busy);
+    if (rx_batches)
+    {
+        rt_kprintf(", %d.%02d frames per batch", rx_frames / rx_batches, rx_frames % rx_batches * 100 / rx_batches);
+    }
+    rt_kprintf("\n");
+
+    return 0;
+}
+MSH_CMD_EXPORT(eth_bench, eth mac loopback throughput and cpu load: eth_bench [seconds] [payload]);
+#endif /* RT_USING_FINSH && BSP_USING_BENCH */
@@ -0,0 +1,504 @@
+/*
+ * Copyright (c) 2006-2023, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ */
+
+#include <board.h>
+#include <rthw.h>
+#include <rtdevice.h>
+
+#if defined(BSP_USING_TIM5) || defined(BSP_USING_PWM5)
+#error "TIM5 is the pm timer, it can not be used as hwtimer or pwm"
+#endif
+
+/*
+ * Tick-less sleep for STM32F4.
+ *
+ * LIGHT is sleep mode, all clocks keep running. TIM5 counts free at the APB1 timer clock, compare 1
+ * wakes the cpu and the counter tells how long it slept. The same counter is the cputime clock and
+ * compare 2 the cputimer timeout, so cputime goes on through light sleep.
+ * DEEP is stop mode, only the RTC runs. Its wakeup timer (RTCCLK / 16) wakes the cpu, the calendar
+ * sub seconds tell how long it slept, also when an EXTI line woke it earlier. The system clock is
+ * set up again after stop, TIM5 and so cputime stand still in it.
+ *
+ * Systick keeps counting while sleeping, only its interrupt is held back. The part of the current
+ * tick already gone is taken off the sleep and counted in again on wakeup, what is left below one
+ * tick is carried to the next sleep, so rt_tick does not drift.
+ */
+
+#define PM_RTC_CLOCK        32768               /* LSE, see SystemClock_Config */
+#define PM_RTC_WUT_CLOCK    (PM_RTC_CLOCK / 16)
+#define PM_RTC_WUT_MAX      0x10000UL
+#define PM_RTC_DAY_NS       (86400ULL * PM_NS_PER_SEC)
+#define PM_TIM_MAX          0x7fffffffUL        /* half the counter, compare can not be missed */
+#define PM_NS_PER_SEC       1000000000ULL
+#define PM_NS_PER_TICK      (PM_NS_PER_SEC / RT_TICK_PER_SECOND)
+
+struct stm32_pm_timer
+{
+    rt_uint32_t tim_freq;
+    rt_uint32_t tim_start;
+    rt_uint64_t rtc_start;                      /* ns of the day */
+    rt_uint64_t sleep_ns;                       /* programmed, at least this long when woken by it */
+    rt_uint64_t tick_gone;                      /* ns of the current tick when going to sleep */
+    rt_uint64_t remain;                         /* ns below one tick, carried to the next sleep */
+
+    volatile rt_uint32_t tim_high;
+    rt_uint64_t timeout_tick;
+    void (*timeout)(void *param);
+    void *param;
+};
+
+static struct stm32_pm_timer _pm_timer;
+
+rt_inline void stm32_rtc_unlock(void)
+{
+    RTC->WPR = 0xca;
+    RTC->WPR = 0x53;
+}
+
+rt_inline void stm32_rtc_lock(void)
+{
+    RTC->WPR = 0xff;
+}
+
+static rt_err_t stm32_pm_rtc_init(void)
+{
+    rt_uint32_t timeout = 0x100000;
+
+    HAL_PWR_EnableBkUpAccess();
+    __HAL_RCC_RTC_ENABLE();
+
+    stm32_rtc_unlock();
+    if ((RTC->ISR & RTC_ISR_INITS) == 0)
+    {
+        /* nobody has set the calendar, any time of day does, only fine sub seconds are wanted */
+        RTC->ISR = RTC_ISR_INIT;
+        while ((RTC->ISR & RTC_ISR_INITF) == 0)
+        {
+            if (--timeout == 0)
+            {
+                stm32_rtc_lock();
+                return -RT_ETIMEOUT;
+            }
+        }
+        RTC->PRER = PM_RTC_CLOCK / 8 - 1;
+        RTC->PRER |= (8 - 1) << RTC_PRER_PREDIV_A_Pos;
+        RTC->ISR &= ~RTC_ISR_INIT;
+    }
+    /* read the counters, not the shadows which are stale after stop */
+    RTC->CR |= RTC_CR_BYPSHAD;
+    stm32_rtc_lock();
+
+    EXTI->IMR |= EXTI_IMR_MR22;
+    EXTI->RTSR |= EXTI_RTSR_TR22;
+    HAL_NVIC_SetPriority(RTC_WKUP_IRQn, 0, 0);
+    HAL_NVIC_EnableIRQ(RTC_WKUP_IRQn);
+
+    return RT_EOK;
+}
+
+static rt_uint64_t stm32_rtc_get_ns(void)
+{
+    rt_uint32_t tr, ssr, sync;
+    rt_uint64_t sec;
+
+    do
+    {
+        tr = RTC->TR;
+        ssr = RTC->SSR;
+    } while (tr != RTC->TR);
+
+    sec = (((tr >> 20) & 0x3) * 10 + ((tr >> 16) & 0xf)) * 3600
+          + (((tr >> 12) & 0x7) * 10 + ((tr >> 8) & 0xf)) * 60
+          + ((tr >> 4) & 0x7) * 10 + (tr & 0xf);
+    sync = (RTC->PRER & RTC_PRER_PREDIV_S) + 1;
+
+    /* sub second counts down */
+    return sec * PM_NS_PER_SEC + (sync - 1 - ssr) * PM_NS_PER_SEC / sync;
+}
+
+static void stm32_rtc_wakeup_start(rt_uint32_t count)
+{
+    stm32_rtc_unlock();
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    while ((RTC->ISR & RTC_ISR_WUTWF) == 0);
+    RTC->WUTR = count - 1;
+    RTC->CR &= ~RTC_CR_WUCKSEL;
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT);
+    EXTI->PR = EXTI_PR_PR22;
+    RTC->CR |= RTC_CR_WUTIE | RTC_CR_WUTE;
+    stm32_rtc_lock();
+}
+
+static void stm32_rtc_wakeup_stop(void)
+{
+    stm32_rtc_unlock();
+    RTC->CR &= ~(RTC_CR_WUTE | RTC_CR_WUTIE);
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT);
+    EXTI->PR = EXTI_PR_PR22;
+    stm32_rtc_lock();
+}
+
+void RTC_WKUP_IRQHandler(void)
+{
+    rt_interrupt_enter();
+
+    /* the wakeup itself is all, rt_tick is set by the pm */
+    RTC->ISR = ~(RTC_ISR_WUTF | RTC_ISR_INIT);
+    EXTI->PR = EXTI_PR_PR22;
+
+    rt_interrupt_leave();
+}
+
+static void stm32_pm_tim_init(void)
+{
+    RCC_ClkInitTypeDef clk;
+    rt_uint32_t latency;
+
+    HAL_RCC_GetClockConfig(&clk, &latency);
+    _pm_timer.tim_freq = HAL_RCC_GetPCLK1Freq();
+    if (clk.APB1CLKDivider != RCC_HCLK_DIV1)
+    {
+        _pm_timer.tim_freq *= 2;
+    }
+
+    __HAL_RCC_TIM5_CLK_ENABLE();
+    TIM5->CR1 = 0;
+    TIM5->PSC = 0;
+    TIM5->ARR = 0xffffffff;
+    TIM5->EGR = TIM_EGR_UG;
+    TIM5->SR = 0;
+    TIM5->DIER = TIM_DIER_UIE;
+    HAL_NVIC_SetPriority(TIM5_IRQn, 1, 0);
+    HAL_NVIC_EnableIRQ(TIM5_IRQn);
+    TIM5->CR1 = TIM_CR1_CEN;
+}
+
+static rt_uint64_t stm32_tim_get_count(void)
+{
+    rt_uint32_t high, count;
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    high = _pm_timer.tim_high;
+    count = TIM5->CNT;
+    /* wrapped, the update interrupt is still to come */
+    if ((TIM5->SR & TIM_SR_UIF) && count < 0x80000000UL)
+    {
+        high++;
+    }
+    rt_hw_interrupt_enable(level);
+
+    return ((rt_uint64_t)high << 32) | count;
+}
+
+/* far timeouts go in steps of half the counter */
+static void stm32_tim_arm_timeout(void)
+{
+    rt_uint64_t now = stm32_tim_get_count();
+    rt_uint64_t left = _pm_timer.timeout_tick - now;
+
+    TIM5->CCR2 = (rt_uint32_t)now + (left > PM_TIM_MAX ? PM_TIM_MAX : (rt_uint32_t)left);
+    TIM5->SR = ~TIM_SR_CC2IF;
+    TIM5->DIER |= TIM_DIER_CC2IE;
+
+    /* gone already or gone while writing the compare */
+    if ((rt_int64_t)(_pm_timer.timeout_tick - stm32_tim_get_count()) <= 0 && (TIM5->SR & TIM_SR_CC2IF) == 0)
+    {
+        TIM5->EGR = TIM_EGR_CC2G;
+    }
+}
+
+void TIM5_IRQHandler(void)
+{
+    void (*timeout)(void *param);
+    rt_uint32_t status;
+
+    rt_interrupt_enter();
+
+    status = TIM5->SR & TIM5->DIER;
+    TIM5->SR = ~status;
+
+    if (status & TIM_SR_UIF)
+    {
+        _pm_timer.tim_high++;
+    }
+    if (status & TIM_SR_CC1IF)
+    {
+        /* light sleep is over, rt_tick is set by the pm */
+        TIM5->DIER &= ~TIM_DIER_CC1IE;
+    }
+    if (status & TIM_SR_CC2IF)
+    {
+        TIM5->DIER &= ~TIM_DIER_CC2IE;
+        if ((rt_int64_t)(_pm_timer.timeout_tick - stm32_tim_get_count()) > 0)
+        {
+            stm32_tim_arm_timeout();
+        }
+        else if (_pm_timer.timeout != RT_NULL)
+        {
+            /* the callback may set the next timeout */
+            timeout = _pm_timer.timeout;
+            _pm_timer.timeout = RT_NULL;
+            timeout(_pm_timer.param);
+        }
+    }
+
+    rt_interrupt_leave();
+}
+
+#if defined(RT_USING_CPUTIME) && !defined(RT_USING_CPUTIME_CORTEXM)
+static uint64_t stm32_cputime_getres(void)
+{
+    return PM_NS_PER_SEC * 1000000ULL / _pm_timer.tim_freq;
+}
+
+static uint64_t stm32_cputime_gettime(void)
+{
+    return stm32_tim_get_count();
+}
+
+static int stm32_cputime_settimeout(uint64_t tick, void (*timeout)(void *param), void *param)
+{
+    rt_base_t level;
+
+    level = rt_hw_interrupt_disable();
+    TIM5->DIER &= ~TIM_DIER_CC2IE;
+    _pm_timer.timeout = timeout;
+    _pm_timer.param = param;
+    if (timeout != RT_NULL)
+    {
+        _pm_timer.timeout_tick = tick;
+        stm32_tim_arm_timeout();
+    }
+    rt_hw_interrupt_enable(level);
+
+    return 0;
+}
+
+static const struct rt_clock_cputime_ops _cputime_ops =
+{
+    stm32_cputime_getres,
+    stm32_cputime_gettime,
+    stm32_cputime_settimeout
+};
+#endif /* defined(RT_USING_CPUTIME) && !defined(RT_USING_CPUTIME_CORTEXM) */
+
+/**
+ * This function will put STM32F4xx into sleep mode.
+ *
+ * @param pm pointer to power manage structure
+ */
+static void sleep(struct rt_pm *pm, uint8_t mode)
+{
+    switch (mode)
+    {
+    case PM_SLEEP_MODE_NONE:
+        break;
+
+    case PM_SLEEP_MODE_IDLE:
+        // __WFI();
+        break;
+
+    case PM_SLEEP_MODE_LIGHT:
+        /* Enter SLEEP Mode, Main regulator is ON */
+        HAL_PWR_EnterSLEEPMode(PWR_MAINREGULATOR_ON, PWR_SLEEPENTRY_WFI);
+        break;
+
+    case PM_SLEEP_MODE_DEEP:
+        /* Enter STOP mode, low power regulator */
+        HAL_PWR_EnterSTOPMode(PWR_LOWPOWERREGULATOR_ON, PWR_STOPENTRY_WFI);
+        /* Re-configure the system clock, it is HSI after stop */
+        SystemClock_Config();
+        break;
+
+    case PM_SLEEP_MODE_STANDBY:
+    case PM_SLEEP_MODE_SHUTDOWN:
+        /* Enter STANDBY mode, there is no shutdown on F4 */
+        HAL_PWR_EnterSTANDBYMode();
+        break;
+
+    default:
+        RT_ASSERT(0);
+        break;
+    }
+}
+
+static void run(struct rt_pm *pm, uint8_t mode)
+{
+    /* one speed only, peripherals and the tick are set up for 168 MHz */
+}
+
+/**
+ * This function start the timer of pm
+ *
+ * @param pm Pointer to power manage structure
+ * @param timeout How many OS Ticks that MCU can sleep
+ */
+static void pm_timer_start(struct rt_pm *pm, rt_uint32_t timeout)
+{
+    rt_uint64_t count;
+
+    RT_ASSERT(pm != RT_NULL);
+    RT_ASSERT(timeout > 0);
+
+    SysTick->CTRL &= ~SysTick_CTRL_TICKINT_Msk;
+    _pm_timer.tick_gone = (rt_uint64_t)(SysTick->LOAD - SysTick->VAL) * PM_NS_PER_SEC / SystemCoreClock;
+    _pm_timer.sleep_ns = (rt_uint64_t)timeout * PM_NS_PER_TICK - _pm_timer.tick_gone;
+
+    /* round up, waking before the tick would miss it */
+    if (pm->sleep_mode == PM_SLEEP_MODE_LIGHT)
+    {
+        if (_pm_timer.sleep_ns >= PM_TIM_MAX * PM_NS_PER_SEC / _pm_timer.tim_freq)
+        {
+            count = PM_TIM_MAX;
+        }
+        else
+        {
+            count = (_pm_timer.sleep_ns * _pm_timer.tim_freq + PM_NS_PER_SEC - 1) / PM_NS_PER_SEC;
+        }
+        _pm_timer.sleep_ns = count * PM_NS_PER_SEC / _pm_timer.tim_freq;
+
+        _pm_timer.tim_start = TIM5->CNT;
+        TIM5->CCR1 = _pm_timer.tim_start + (rt_uint32_t)count;
+        TIM5->SR = ~TIM_SR_CC1IF;
+        TIM5->DIER |= TIM_DIER_CC1IE;
+    }
+    else
+    {
+        if (_pm_timer.sleep_ns >= PM_RTC_WUT_MAX * PM_NS_PER_SEC / PM_RTC_WUT_CLOCK)
+        {
+            count = PM_RTC_WUT_MAX;
+        }
+        else
+        {
+            count = (_pm_timer.sleep_ns * PM_RTC_WUT_CLOCK + PM_NS_PER_SEC - 1) / PM_NS_PER_SEC;
+        }
+        _pm_timer.sleep_ns = count * PM_NS_PER_SEC / PM_RTC_WUT_CLOCK;
+
+        _pm_timer.rtc_start = stm32_rtc_get_ns();
+        stm32_rtc_wakeup_start((rt_uint32_t)count);
+    }
+}
+
+/**
+ * This function stop the timer of pm
+ *
+ * @param pm Pointer to power manage structure
+ */
+static void pm_timer_stop(struct rt_pm *pm)
+{
+    RT_ASSERT(pm != RT_NULL);
+
+    if (pm->sleep_mode == PM_SLEEP_MODE_LIGHT)
+    {
+        TIM5->DIER &= ~TIM_DIER_CC1IE;
+        TIM5->SR = ~TIM_SR_CC1IF;
+    }
+    else
+    {
+        stm32_rtc_wakeup_stop();
+    }
+
+    /* a whole tick from now, what was left of the old one is in remain */
+    SysTick->VAL = 0;
+    SCB->ICSR = SCB_ICSR_PENDSTCLR_Msk;
+    SysTick->CTRL |= SysTick_CTRL_TICKINT_Msk;
+}
+
+/**
+ * This function calculate how many OS Ticks that MCU have suspended
+ *
+ * @param pm Pointer to power manage structure
+ *
+ * @return OS Ticks
+ */
+static rt_tick_t pm_timer_get_tick(struct rt_pm *pm)
+{
+    rt_uint64_t slept;
+    rt_bool_t timed_out;
+    rt_tick_t tick;
+
+    RT_ASSERT(pm != RT_NULL);
+
+    if (pm->sleep_mode == PM_SLEEP_MODE_LIGHT)
+    {
+        slept = (rt_uint64_t)(TIM5->CNT - _pm_timer.tim_start) * PM_NS_PER_SEC / _pm_timer.tim_freq;
+        timed_out = (TIM5->SR & TIM_SR_CC1IF) != 0;
+    }
+    else
+    {
+        slept = stm32_rtc_get_ns();
+        if (slept < _pm_timer.rtc_start)
+        {
+            slept += PM_RTC_DAY_NS;
+        }
+        slept -= _pm_timer.rtc_start;
+        timed_out = (RTC->ISR & RTC_ISR_WUTF) != 0;
+    }
+    /* sub seconds are coarser than the wakeup timer */
+    if (timed_out && slept < _pm_timer.sleep_ns)
+    {
+        slept = _pm_timer.sleep_ns;
+    }
+
+    slept += _pm_timer.tick_gone + _pm_timer.remain;
+    tick = slept / PM_NS_PER_TICK;
+    _pm_timer.remain = slept % PM_NS_PER_TICK;
+
+    /* HAL_GetTick() counts on systick too */
+    uwTick += tick * 1000 / RT_TICK_PER_SECOND;
+
+    return tick;
+}
+
+/**
+ * This function initialize the power manager
+ */
+int drv_pm_hw_init(void)
+{
+    static const struct rt_pm_ops _ops =
+    {
+        sleep,
+        run,
+        pm_timer_start,
+        pm_timer_stop,
+        pm_timer_get_tick
+    };
+
+    rt_uint8_t timer_mask = 0;
+
+    /* Enable Power Clock */
+    __HAL_RCC_PWR_CLK_ENABLE();
+
+    /* initialize timer mask */
+    stm32_pm_tim_init();
+    timer_mask = 1UL << PM_SLEEP_MODE_LIGHT;
+    if (stm32_pm_rtc_init() == RT_EOK)
+    {
+        timer_mask |= 1UL << PM_SLEEP_MODE_DEEP;
+    }
+
+    /* initialize system pm module */
+    rt_system_pm_init(&_ops, timer_mask, RT_NULL);
+
+#if defined(RT_USING_CPUTIME) && !defined(RT_USING_CPUTIME_CORTEXM)
+    clock_cpu_setops(&_cputime_ops);
+#endif
+
+#ifdef BSP_PM_USING_TICKLESS
+    /* sleep tick-less whenever idle, until somebody asks for more */
+    rt_pm_request(PM_SLEEP_MODE_LIGHT);
+    rt_pm_release(PM_SLEEP_MODE_NONE);
+#endif
+
+    return 0;
+}
+
+INIT_BOARD_EXPORT(drv_pm_hw_init);
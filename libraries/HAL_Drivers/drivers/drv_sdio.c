@@ -9,6 +9,10 @@
  * 2018-12-12     balanceTWK   first version
  * 2019-06-11     WillianChan  Add SD card hot plug detection
  * 2020-11-09     whj4674672   fix sdio non-aligned access problem
+ * 2026-10-17     loogg        dma on any caller buffer, stop command issued from the data end irq
+ * 2026-10-17     loogg        bounce buffers the dma cannot reach
+ * 2026-10-18     loogg        transfers fit the 16 bit NDTR, no memory burst across 1 KB
+ * 2026-10-18     loogg        bounce in chunks through a static buffer
  */
 
 #include "board.h"
@@ -30,11 +34,25 @@ static struct rt_mmcsd_host *host;
 #define RTHW_SDIO_LOCK(_sdio)   rt_mutex_take(&_sdio->mutex, RT_WAITING_FOREVER)
 #define RTHW_SDIO_UNLOCK(_sdio) rt_mutex_release(&_sdio->mutex);
 
+#if defined(SOC_SERIES_STM32F2) || defined(SOC_SERIES_STM32F4)
+/* the dma fifo packs bytes into words, any caller buffer goes straight to the dma */
+#define SDIO_DMA_ANY_ALIGN
+/* words of a transfer in the 16 bit NDTR */
+#define SDIO_MAX_BLK_COUNT   511
+#define SDIO_MAX_SEG_SIZE    (SDIO_MAX_BLK_COUNT * 512)
+#else
+#define SDIO_MAX_BLK_COUNT   512
+#define SDIO_MAX_SEG_SIZE    SDIO_BUFF_SIZE
+#endif
+
 struct sdio_pkg
 {
     struct rt_mmcsd_cmd *cmd;
     void *buff;
     rt_uint32_t flag;
+    /* stop command sent by the irq right at data end */
+    struct rt_mmcsd_cmd *stop;
+    volatile rt_bool_t stopping;
 };
 
 struct rthw_sdio
@@ -46,8 +64,14 @@ struct rthw_sdio
     struct sdio_pkg *pkg;
 };
 
+#ifndef SDIO_DMA_ANY_ALIGN
 rt_align(SDIO_ALIGN_LEN)
 static rt_uint8_t cache_buf[SDIO_BUFF_SIZE];
+#else
+/* for buffers the dma cannot reach, 16 byte aligned for the memory burst */
+rt_align(16)
+static rt_uint8_t bounce_buf[SDIO_BUFF_SIZE];
+#endif
 
 static rt_uint32_t stm32_sdio_clk_get(struct stm32_sdio *hw_sdio)
 {
@@ -143,6 +167,14 @@ static void rthw_sdio_wait_completed(struct rthw_sdio *sdio)
         return;
     }
 
+    if (sdio->pkg->stopping)
+    {
+        /* data went through, what is left is the stop command, its response is in the registers */
+        data = RT_NULL;
+        cmd->err = RT_EOK;
+        cmd = sdio->pkg->stop;
+    }
+
     cmd->resp[0] = hw_sdio->resp1;
     cmd->resp[1] = hw_sdio->resp2;
     cmd->resp[2] = hw_sdio->resp3;
@@ -164,12 +196,12 @@ static void rthw_sdio_wait_completed(struct rthw_sdio *sdio)
             cmd->err = -RT_ETIMEOUT;
         }
 
-        if (status & HW_SDIO_IT_DCRCFAIL)
+        if ((status & HW_SDIO_IT_DCRCFAIL) && data)
         {
             data->err = -RT_ERROR;
         }
 
-        if (status & HW_SDIO_IT_DTIMEOUT)
+        if ((status & HW_SDIO_IT_DTIMEOUT) && data)
         {
             data->err = -RT_ETIMEOUT;
         }
@@ -351,6 +383,137 @@ static void rthw_sdio_send_command(struct rthw_sdio *sdio, struct sdio_pkg *pkg)
     sdio->pkg = RT_NULL;
 }
 
+/**
+  * @brief  This function sends the stop command the irq did not get to send.
+  * @param  sdio  rthw_sdio
+  * @param  stop  stop command of the request
+  * @param  done  package of the data command
+  * @retval None
+  */
+static void rthw_sdio_send_stop(struct rthw_sdio *sdio, struct rt_mmcsd_cmd *stop, struct sdio_pkg *done)
+{
+    struct sdio_pkg pkg;
+
+    /* the command or its data failed before data end */
+    if ((stop == RT_NULL) || done->stopping)
+    {
+        return;
+    }
+
+    rt_memset(&pkg, 0, sizeof(pkg));
+    pkg.cmd = stop;
+    rthw_sdio_send_command(sdio, &pkg);
+}
+
+#ifdef SDIO_DMA_ANY_ALIGN
+/**
+  * @brief  This function waits for the card to leave programming after a write.
+  * @param  sdio  rthw_sdio
+  * @retval RT_EOK or the error of the status command
+  */
+static rt_err_t rthw_sdio_wait_ready(struct rthw_sdio *sdio)
+{
+    struct rt_mmcsd_cmd cmd;
+    struct sdio_pkg pkg;
+    rt_tick_t end = rt_tick_get() + rt_tick_from_millisecond(1000);
+
+    do
+    {
+        rt_memset(&cmd, 0, sizeof(cmd));
+        cmd.cmd_code = SEND_STATUS;
+        cmd.arg = sdio->host->card->rca << 16;
+        cmd.flags = RESP_R1 | CMD_AC;
+        rt_memset(&pkg, 0, sizeof(pkg));
+        pkg.cmd = &cmd;
+        rthw_sdio_send_command(sdio, &pkg);
+        if (cmd.err != RT_EOK)
+        {
+            return cmd.err;
+        }
+        /* ready for data and out of the programming state */
+        if ((cmd.resp[0] & R1_READY_FOR_DATA) && (R1_CURRENT_STATE(cmd.resp[0]) != 7))
+        {
+            return RT_EOK;
+        }
+    } while ((rt_int32_t)(rt_tick_get() - end) < 0);
+
+    return -RT_ETIMEOUT;
+}
+
+/**
+  * @brief  This function sends a request whose buffer the dma cannot reach, through bounce_buf.
+  *         A multi block read or write larger than bounce_buf is sent again for each chunk.
+  * @param  sdio  rthw_sdio
+  * @param  req   request
+  * @retval None
+  */
+static void rthw_sdio_request_bounce(struct rthw_sdio *sdio, struct rt_mmcsd_req *req)
+{
+    struct rt_mmcsd_cmd *cmd = req->cmd;
+    struct rt_mmcsd_data *data = cmd->data;
+    struct rt_mmcsd_cmd chunk_cmd;
+    struct rt_mmcsd_data chunk_data;
+    struct sdio_pkg pkg;
+    rt_uint32_t chunk_blks = SDIO_BUFF_SIZE / data->blksize;
+    rt_uint32_t blks, done, step;
+
+    if ((data->blks > chunk_blks) &&
+        (cmd->cmd_code != READ_MULTIPLE_BLOCK) && (cmd->cmd_code != WRITE_MULTIPLE_BLOCK))
+    {
+        LOG_E("no bounce buffer for %d bytes", data->blks * data->blksize);
+        cmd->err = -RT_ENOMEM;
+        return;
+    }
+    /* address of the next chunk, in blocks on sdhc, else in bytes */
+    step = (sdio->host->card->flags & CARD_FLAG_SDHC) ? 1 : data->blksize;
+
+    for (done = 0; done < data->blks; done += blks)
+    {
+        blks = data->blks - done;
+        if (blks > chunk_blks)
+        {
+            blks = chunk_blks;
+        }
+
+        if (data->flags & DATA_DIR_WRITE)
+        {
+            if ((done != 0) && ((cmd->err = rthw_sdio_wait_ready(sdio)) != RT_EOK))
+            {
+                break;
+            }
+            rt_memcpy(bounce_buf, (rt_uint8_t *)data->buf + done * data->blksize, blks * data->blksize);
+        }
+
+        chunk_data = *data;
+        chunk_data.blks = blks;
+        chunk_data.buf = (rt_uint32_t *)bounce_buf;
+        chunk_cmd = *cmd;
+        chunk_cmd.arg = cmd->arg + done * step;
+        chunk_cmd.data = &chunk_data;
+
+        rt_memset(&pkg, 0, sizeof(pkg));
+        pkg.cmd = &chunk_cmd;
+        pkg.buff = bounce_buf;
+        pkg.stop = req->stop;
+        rthw_sdio_send_command(sdio, &pkg);
+        rthw_sdio_send_stop(sdio, req->stop, &pkg);
+
+        rt_memcpy(cmd->resp, chunk_cmd.resp, sizeof(cmd->resp));
+        cmd->err = chunk_cmd.err;
+        data->err = chunk_data.err;
+        if ((cmd->err != RT_EOK) || (data->err != RT_EOK) || ((req->stop != RT_NULL) && (req->stop->err != RT_EOK)))
+        {
+            break;
+        }
+
+        if (data->flags & DATA_DIR_READ)
+        {
+            rt_memcpy((rt_uint8_t *)data->buf + done * data->blksize, bounce_buf, blks * data->blksize);
+        }
+    }
+}
+#endif
+
 /**
   * @brief  This function send sdio request.
   * @param  host  rt_mmcsd_host
@@ -365,43 +528,51 @@ static void rthw_sdio_request(struct rt_mmcsd_host *host, struct rt_mmcsd_req *r
 
     RTHW_SDIO_LOCK(sdio);
 
+    rt_memset(&pkg, 0, sizeof(pkg));
     if (req->cmd != RT_NULL)
     {
-        rt_memset(&pkg, 0, sizeof(pkg));
         data = req->cmd->data;
         pkg.cmd = req->cmd;
 
-        if (data != RT_NULL)
+#ifdef SDIO_DMA_ANY_ALIGN
+        if ((data != RT_NULL) && !STM32_DMA_REACHABLE(data->buf))
         {
-            rt_uint32_t size = data->blks * data->blksize;
-
-            RT_ASSERT(size <= SDIO_BUFF_SIZE);
+            rthw_sdio_request_bounce(sdio, req);
+            RTHW_SDIO_UNLOCK(sdio);
+            mmcsd_req_complete(sdio->host);
+            return;
+        }
+#endif
 
+        if (data != RT_NULL)
+        {
             pkg.buff = data->buf;
+            pkg.stop = req->stop;
+#ifndef SDIO_DMA_ANY_ALIGN
             if ((rt_uint32_t)data->buf & (SDIO_ALIGN_LEN - 1))
             {
+                RT_ASSERT(data->blks * data->blksize <= SDIO_BUFF_SIZE);
+
                 pkg.buff = cache_buf;
                 if (data->flags & DATA_DIR_WRITE)
                 {
-                    rt_memcpy(cache_buf, data->buf, size);
+                    rt_memcpy(cache_buf, data->buf, data->blks * data->blksize);
                 }
             }
+#endif
         }
 
         rthw_sdio_send_command(sdio, &pkg);
 
+#ifndef SDIO_DMA_ANY_ALIGN
         if ((data != RT_NULL) && (data->flags & DATA_DIR_READ) && ((rt_uint32_t)data->buf & (SDIO_ALIGN_LEN - 1)))
         {
             rt_memcpy(data->buf, cache_buf, data->blksize * data->blks);
         }
+#endif
     }
 
-    if (req->stop != RT_NULL)
-    {
-        rt_memset(&pkg, 0, sizeof(pkg));
-        pkg.cmd = req->stop;
-        rthw_sdio_send_command(sdio, &pkg);
-    }
+    rthw_sdio_send_stop(sdio, req->stop, &pkg);
 
     RTHW_SDIO_UNLOCK(sdio);
 
@@ -560,13 +731,24 @@ void rthw_sdio_irq_process(struct rt_mmcsd_host *host)
 
             if (sdio->pkg != RT_NULL)
             {
-                if (!sdio->pkg->cmd->data)
+                struct rt_mmcsd_cmd *cmd = sdio->pkg->cmd;
+
+                if (sdio->pkg->stopping)
                 {
                     complete = 1;
                 }
-                else if ((sdio->pkg->cmd->data->flags & DATA_DIR_WRITE))
+                else if (!cmd->data)
                 {
-                    hw_sdio->dctrl |= HW_SDIO_DPSM_ENABLE;
+                    complete = 1;
+                }
+                else
+                {
+                    /* a stop command will overwrite the response registers */
+                    cmd->resp[0] = hw_sdio->resp1;
+                    if (cmd->data->flags & DATA_DIR_WRITE)
+                    {
+                        hw_sdio->dctrl |= HW_SDIO_DPSM_ENABLE;
+                    }
                 }
             }
         }
@@ -575,7 +757,7 @@ void rthw_sdio_irq_process(struct rt_mmcsd_host *host)
         {
             hw_sdio->icr = HW_SDIO_IT_CMDSENT;
 
-            if (resp_type(sdio->pkg->cmd) == RESP_NONE)
+            if (sdio->pkg != RT_NULL && !sdio->pkg->stopping && resp_type(sdio->pkg->cmd) == RESP_NONE)
             {
                 complete = 1;
             }
@@ -584,7 +766,18 @@ void rthw_sdio_irq_process(struct rt_mmcsd_host *host)
         if (intstatus & HW_SDIO_IT_DATAEND)
         {
             hw_sdio->icr = HW_SDIO_IT_DATAEND;
-            complete = 1;
+
+            if (sdio->pkg != RT_NULL && sdio->pkg->stop != RT_NULL && !sdio->pkg->stopping)
+            {
+                /* send the stop now instead of after the thread wakes up, the next command gets the card sooner */
+                sdio->pkg->stopping = RT_TRUE;
+                hw_sdio->arg = sdio->pkg->stop->arg;
+                hw_sdio->cmd = sdio->pkg->stop->cmd_code | HW_SDIO_CPSM_ENABLE | HW_SDIO_RESPONSE_SHORT;
+            }
+            else
+            {
+                complete = 1;
+            }
         }
     }
 
@@ -662,10 +855,10 @@ struct rt_mmcsd_host *sdio_host_create(struct stm32_sdio_des *sdio_des)
 #else
     host->flags = MMCSD_MUTBLKWRITE | MMCSD_SUP_SDIO_IRQ;
 #endif
-    host->max_seg_size = SDIO_BUFF_SIZE;
+    host->max_seg_size = SDIO_MAX_SEG_SIZE;
     host->max_dma_segs = 1;
     host->max_blk_size = 512;
-    host->max_blk_count = 512;
+    host->max_blk_count = SDIO_MAX_BLK_COUNT;
 
     /* link up host and sdio */
     sdio->host = host;
@@ -732,12 +925,28 @@ void SD_LowLevel_DMA_TxConfig(uint32_t *src, uint32_t *dst, uint32_t BufferSize)
     sdio_obj.dma.handle_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
     sdio_obj.dma.handle_tx.Init.MemInc              = DMA_MINC_ENABLE;
     sdio_obj.dma.handle_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
-    sdio_obj.dma.handle_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
     sdio_obj.dma.handle_tx.Init.Mode                = DMA_PFCTRL;
     sdio_obj.dma.handle_tx.Init.Priority            = DMA_PRIORITY_MEDIUM;
     sdio_obj.dma.handle_tx.Init.FIFOMode            = DMA_FIFOMODE_ENABLE;
     sdio_obj.dma.handle_tx.Init.FIFOThreshold       = DMA_FIFO_THRESHOLD_FULL;
-    sdio_obj.dma.handle_tx.Init.MemBurst            = DMA_MBURST_INC4;
+    /* unaligned buffer: byte reads packed to words in the fifo */
+    if ((rt_uint32_t)src & 0x03)
+    {
+        sdio_obj.dma.handle_tx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    }
+    else
+    {
+        sdio_obj.dma.handle_tx.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    }
+    /* a 16 byte burst must not cross a 1 KB boundary, only a 16 byte aligned buffer keeps it inside */
+    if ((rt_uint32_t)src & 0x0F)
+    {
+        sdio_obj.dma.handle_tx.Init.MemBurst         = DMA_MBURST_SINGLE;
+    }
+    else
+    {
+        sdio_obj.dma.handle_tx.Init.MemBurst         = DMA_MBURST_INC4;
+    }
     sdio_obj.dma.handle_tx.Init.PeriphBurst         = DMA_PBURST_INC4;
     /* DMA_PFCTRL */
     HAL_DMA_DeInit(&sdio_obj.dma.handle_tx);
@@ -793,12 +1002,28 @@ void SD_LowLevel_DMA_RxConfig(uint32_t *src, uint32_t *dst, uint32_t BufferSize)
     sdio_obj.dma.handle_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
     sdio_obj.dma.handle_rx.Init.MemInc              = DMA_MINC_ENABLE;
     sdio_obj.dma.handle_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
-    sdio_obj.dma.handle_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_WORD;
     sdio_obj.dma.handle_rx.Init.Mode                = DMA_PFCTRL;
     sdio_obj.dma.handle_rx.Init.Priority            = DMA_PRIORITY_MEDIUM;
     sdio_obj.dma.handle_rx.Init.FIFOMode            = DMA_FIFOMODE_ENABLE;
     sdio_obj.dma.handle_rx.Init.FIFOThreshold       = DMA_FIFO_THRESHOLD_FULL;
-    sdio_obj.dma.handle_rx.Init.MemBurst            = DMA_MBURST_INC4;
+    /* unaligned buffer: words from the fifo unpacked to byte writes */
+    if ((rt_uint32_t)dst & 0x03)
+    {
+        sdio_obj.dma.handle_rx.Init.MemDataAlignment = DMA_MDATAALIGN_BYTE;
+    }
+    else
+    {
+        sdio_obj.dma.handle_rx.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    }
+    /* a 16 byte burst must not cross a 1 KB boundary, only a 16 byte aligned buffer keeps it inside */
+    if ((rt_uint32_t)dst & 0x0F)
+    {
+        sdio_obj.dma.handle_rx.Init.MemBurst         = DMA_MBURST_SINGLE;
+    }
+    else
+    {
+        sdio_obj.dma.handle_rx.Init.MemBurst         = DMA_MBURST_INC4;
+    }
     sdio_obj.dma.handle_rx.Init.PeriphBurst         = DMA_PBURST_INC4;
 
     HAL_DMA_DeInit(&sdio_obj.dma.handle_rx);
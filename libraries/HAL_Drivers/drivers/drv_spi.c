@@ -11,6 +11,7 @@
  * 2020-01-15     whj4674672   Porting for stm32h7xx
  * 2020-06-18     thread-liu   Porting for stm32mp1xx
  * 2020-10-14     Dozingfiretruck   Porting for stm32wbxx
+ * 2026-10-17     loogg        bounce tx buffers in ccm ram
  */
 
 #include <rtthread.h>
@@ -361,7 +362,7 @@ static rt_ssize_t spixfer(struct rt_spi_device *device, struct rt_spi_message *m
             }
             rt_hw_cpu_dcache_ops(RT_HW_CACHE_FLUSH, dma_aligned_buffer, send_length);
 #else
-            if (RT_IS_ALIGN((rt_uint32_t)send_buf, 4) && send_buf != RT_NULL) /* aligned with 4 bytes? */
+            if (RT_IS_ALIGN((rt_uint32_t)send_buf, 4) && send_buf != RT_NULL && STM32_DMA_REACHABLE(send_buf)) /* aligned with 4 bytes, not in ccm? */
             {
                 p_txrx_buffer = (rt_uint32_t *)send_buf; /* send_buf aligns with 4 bytes, no more operations */
             }
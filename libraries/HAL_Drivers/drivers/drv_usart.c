@@ -11,6 +11,9 @@
  * 2020-05-02     whj4674672   support stm32h7 uart dma
  * 2020-09-09     forest-rain  support stm32wl uart
  * 2020-10-14     Dozingfiretruck   Porting for stm32wbxx
+ * 2026-10-17     loogg        tx empty interrupt for serial tx fifo
+ * 2026-10-17     loogg        dma tx arena statistics
+ * 2026-10-17     loogg        no zero copy dma tx from ccm ram
  */
 
 #include "board.h"
@@ -248,6 +251,14 @@ static rt_err_t stm32_control(struct rt_serial_device *serial, int cmd, void *ar
     {
     /* disable interrupt */
     case RT_DEVICE_CTRL_CLR_INT:
+#ifdef RT_SERIAL_USING_TX_FIFO
+        /* tx fifo drained, only stop the tx empty interrupt */
+        if ((rt_ubase_t)arg == RT_DEVICE_FLAG_INT_TX)
+        {
+            __HAL_UART_DISABLE_IT(&(uart->handle), UART_IT_TXE);
+            break;
+        }
+#endif
         /* disable rx irq */
         NVIC_DisableIRQ(uart->config->irq_type);
         /* disable interrupt */
@@ -284,6 +295,14 @@ static rt_err_t stm32_control(struct rt_serial_device *serial, int cmd, void *ar
         /* enable rx irq */
         HAL_NVIC_SetPriority(uart->config->irq_type, 1, 0);
         HAL_NVIC_EnableIRQ(uart->config->irq_type);
+#ifdef RT_SERIAL_USING_TX_FIFO
+        /* tx fifo has data, the tx empty interrupt drains it */
+        if ((rt_ubase_t)arg == RT_DEVICE_FLAG_INT_TX)
+        {
+            __HAL_UART_ENABLE_IT(&(uart->handle), UART_IT_TXE);
+            break;
+        }
+#endif
         /* enable interrupt */
         __HAL_UART_ENABLE_IT(&(uart->handle), UART_IT_RXNE);
         break;
@@ -313,6 +332,26 @@ static int stm32_putc(struct rt_serial_device *serial, char c)
     RT_ASSERT(serial != RT_NULL);
 
     uart = rt_container_of(serial, struct stm32_uart, serial);
+#ifdef RT_SERIAL_USING_TX_FIFO
+    /* tx empty interrupt drains the fifo, never wait for the shifter, a polled writer retries */
+    if ((serial->parent.open_flag & RT_DEVICE_FLAG_INT_TX) &&
+        (__HAL_UART_GET_IT_SOURCE(&(uart->handle), UART_IT_TXE) != RESET))
+    {
+        if (__HAL_UART_GET_FLAG(&(uart->handle), UART_FLAG_TXE) == RESET)
+        {
+            return -1;
+        }
+#if defined(SOC_SERIES_STM32L4) || defined(SOC_SERIES_STM32WL) || defined(SOC_SERIES_STM32F7) || defined(SOC_SERIES_STM32F0) \
+    || defined(SOC_SERIES_STM32L0) || defined(SOC_SERIES_STM32G0) || defined(SOC_SERIES_STM32H7) || defined(SOC_SERIES_STM32L5) \
+    || defined(SOC_SERIES_STM32G4) || defined(SOC_SERIES_STM32MP1) || defined(SOC_SERIES_STM32WB) || defined(SOC_SERIES_STM32F3)  \
+    || defined(SOC_SERIES_STM32U5) || defined(SOC_SERIES_STM32H5) || defined(SOC_SERIES_STM32H7RS)
+        uart->handle.Instance->TDR = c;
+#else
+        uart->handle.Instance->DR = c;
+#endif
+        return 1;
+    }
+#endif
     UART_INSTANCE_CLEAR_FUNCTION(&(uart->handle), UART_FLAG_TC);
 #if defined(SOC_SERIES_STM32L4) || defined(SOC_SERIES_STM32WL) || defined(SOC_SERIES_STM32F7) || defined(SOC_SERIES_STM32F0) \
     || defined(SOC_SERIES_STM32L0) || defined(SOC_SERIES_STM32G0) || defined(SOC_SERIES_STM32H7) || defined(SOC_SERIES_STM32L5) \
@@ -348,6 +387,13 @@ static int stm32_getc(struct rt_serial_device *serial)
     return ch;
 }
 
+#if defined(RT_SERIAL_USING_DMA) && defined(RT_SERIAL_USING_DMA_TX_ARENA)
+rt_bool_t rt_hw_serial_dma_reachable(struct rt_serial_device *serial, const void *buf)
+{
+    return STM32_DMA_REACHABLE(buf);
+}
+#endif
+
 static rt_ssize_t stm32_dma_transmit(struct rt_serial_device *serial, rt_uint8_t *buf, rt_size_t size, int direction)
 {
     struct stm32_uart *uart;
@@ -439,6 +485,14 @@ static void uart_isr(struct rt_serial_device *serial)
     {
         rt_hw_serial_isr(serial, RT_SERIAL_EVENT_RX_IND);
     }
+#ifdef RT_SERIAL_USING_TX_FIFO
+    /* UART in mode Transmitter by software fifo -----------------------------*/
+    else if ((__HAL_UART_GET_FLAG(&(uart->handle), UART_FLAG_TXE) != RESET) &&
+            (__HAL_UART_GET_IT_SOURCE(&(uart->handle), UART_IT_TXE) != RESET))
+    {
+        rt_hw_serial_isr(serial, RT_SERIAL_EVENT_TX_DONE);
+    }
+#endif
 #ifdef RT_SERIAL_USING_DMA
     else if ((uart->uart_dma_flag) && (__HAL_UART_GET_FLAG(&(uart->handle), UART_FLAG_IDLE) != RESET)
              && (__HAL_UART_GET_IT_SOURCE(&(uart->handle), UART_IT_IDLE) != RESET))
@@ -1212,6 +1266,31 @@ void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
     uart = (struct stm32_uart *)huart;
     _dma_tx_complete(&uart->serial);
 }
+
+#if defined(RT_SERIAL_USING_DMA_TX_ARENA) && defined(RT_USING_FINSH)
+static int uart_dma_stat(void)
+{
+    struct rt_serial_tx_dma *tx_dma;
+
+    rt_kprintf("uart    writes   bursts  zerocopy  avg/burst  max  stalls  stall ms  pending\n");
+    for (rt_size_t i = 0; i < sizeof(uart_obj) / sizeof(struct stm32_uart); i++)
+    {
+        if (!(uart_obj[i].serial.parent.open_flag & RT_DEVICE_FLAG_DMA_TX))
+        {
+            continue;
+        }
+
+        tx_dma = (struct rt_serial_tx_dma *)uart_obj[i].serial.serial_tx;
+        rt_kprintf("%-6s %7d  %7d  %8d  %9d  %4d  %6d  %8d  %7d\n", uart_obj[i].config->name,
+                   tx_dma->writes, tx_dma->bursts, tx_dma->zc_bursts,
+                   tx_dma->bursts ? tx_dma->burst_bytes / tx_dma->bursts : 0, tx_dma->burst_max,
+                   tx_dma->stalls, tx_dma->stall_ticks * 1000 / RT_TICK_PER_SECOND, tx_dma->count);
+    }
+
+    return 0;
+}
+MSH_CMD_EXPORT(uart_dma_stat, show dma tx bursts and stall time of opened uarts);
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA && RT_USING_FINSH */
 #endif  /* RT_SERIAL_USING_DMA */
 
 static const struct rt_uart_ops stm32_uart_ops =
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-11-7      SummerGift   first version
+ * 2026-10-18     loogg        interrupt disabled state from PRIMASK
  */
 
 #include "drv_common.h"
@@ -133,6 +134,15 @@ void _Error_Handler(char *s, int num)
     /* USER CODE END Error_Handler */
 }
 
+/**
+ * The kernel default always says enabled, callers that must not sleep
+ * with interrupts masked (serial tx fifo, ulog) check it.
+ */
+rt_bool_t rt_hw_interrupt_is_disabled(void)
+{
+    return (__get_PRIMASK() & 0x1) ? RT_TRUE : RT_FALSE;
+}
+
 /**
  * This function will delay for some us.
  *
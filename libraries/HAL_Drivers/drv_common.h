@@ -27,6 +27,13 @@ void _Error_Handler(char *s, int num);
 
 #define DMA_NOT_AVAILABLE ((DMA_INSTANCE_TYPE *)0xFFFFFFFFU)
 
+#ifdef CCMDATARAM_BASE
+/* the ccm ram sits on the cpu data bus only, no dma master reaches it */
+#define STM32_DMA_REACHABLE(addr) (((rt_ubase_t)(addr) & 0xFFFF0000) != CCMDATARAM_BASE)
+#else
+#define STM32_DMA_REACHABLE(addr) RT_TRUE
+#endif
+
 #ifdef __cplusplus
 }
 #endif
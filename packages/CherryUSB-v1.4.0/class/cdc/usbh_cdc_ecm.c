@@ -24,11 +24,15 @@
 #define CONFIG_USBHOST_CDC_ECM_PKT_FILTER   0x000C
 #define CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE 1514U
 
-static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_rx_buffer[CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE];
+/* a full frame always ends with a short packet, slot is rounded up to keep slots aligned */
+#define USBH_CDC_ECM_RX_SLOT_SIZE 1536U
+
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_rx_buffer[CONFIG_USBHOST_BULKIN_RING_DEPTH][USBH_CDC_ECM_RX_SLOT_SIZE];
 static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_tx_buffer[CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE];
 static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ecm_inttx_buffer[16];
 
 static struct usbh_cdc_ecm g_cdc_ecm_class;
+static struct usbh_bulkin_ring g_cdc_ecm_rx_ring;
 
 static int usbh_cdc_ecm_set_eth_packet_filter(struct usbh_cdc_ecm *cdc_ecm_class, uint16_t filter_value)
 {
@@ -209,7 +213,7 @@ static int usbh_cdc_ecm_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
     if (cdc_ecm_class) {
         if (cdc_ecm_class->bulkin) {
-            usbh_kill_urb(&cdc_ecm_class->bulkin_urb);
+            usbh_bulkin_ring_stop(&g_cdc_ecm_rx_ring);
         }
 
         if (cdc_ecm_class->bulkout) {
@@ -233,7 +237,7 @@ static int usbh_cdc_ecm_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
 void usbh_cdc_ecm_rx_thread(void *argument)
 {
-    uint32_t g_cdc_ecm_rx_length;
+    struct usbh_bulkin_slot *slot;
     int ret;
 
     (void)argument;
@@ -255,31 +259,30 @@ find_class:
         usb_osal_msleep(128);
     }
 
-    g_cdc_ecm_rx_length = 0;
+    ret = usbh_bulkin_ring_init(&g_cdc_ecm_rx_ring, g_cdc_ecm_class.hport, g_cdc_ecm_class.bulkin, &g_cdc_ecm_rx_buffer[0][0], USBH_CDC_ECM_RX_SLOT_SIZE);
+    if (ret < 0) {
+        goto delete;
+    }
+    g_cdc_ecm_class.rx_ring = &g_cdc_ecm_rx_ring;
+
     while (1) {
-        usbh_bulk_urb_fill(&g_cdc_ecm_class.bulkin_urb, g_cdc_ecm_class.hport, g_cdc_ecm_class.bulkin, g_cdc_ecm_rx_buffer, CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE, USB_OSAL_WAITING_FOREVER, NULL, NULL);
-        ret = usbh_submit_urb(&g_cdc_ecm_class.bulkin_urb);
+        ret = usbh_bulkin_ring_wait(&g_cdc_ecm_rx_ring, &slot, USB_OSAL_WAITING_FOREVER);
         if (ret < 0) {
+            g_cdc_ecm_class.rx_ring = NULL;
+            usbh_bulkin_ring_deinit(&g_cdc_ecm_rx_ring);
             goto find_class;
         }
 
-        g_cdc_ecm_rx_length = g_cdc_ecm_class.bulkin_urb.actual_length;
+        /* One frame per transfer, it is complete because last packet is a short packet.
+         * Zero length is a zlp after a frame of multiple wMaxPacketSize, just skip it.
+         */
+        if ((ret > 0) && (ret <= CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE)) {
+            USB_LOG_DBG("rxlen:%d\r\n", ret);
 
-        /* A transfer is complete because last packet is a short packet.
-         * Short packet is not zero, match g_cdc_ecm_rx_length % USB_GET_MAXPACKETSIZE(g_cdc_ecm_class.bulkin->wMaxPacketSize).
-         * Short packet is zero, check if g_cdc_ecm_class.bulkin_urb.actual_length < transfer_size, for example transfer is complete with size is 512 < 1514.
-         * This case is always true
-        */
-        if (g_cdc_ecm_rx_length % USB_GET_MAXPACKETSIZE(g_cdc_ecm_class.bulkin->wMaxPacketSize) ||
-            (g_cdc_ecm_class.bulkin_urb.actual_length < CONFIG_USBHOST_CDC_ECM_ETH_MAX_SIZE)) {
-            USB_LOG_DBG("rxlen:%d\r\n", g_cdc_ecm_rx_length);
-
-            usbh_cdc_ecm_eth_input(g_cdc_ecm_rx_buffer, g_cdc_ecm_rx_length);
-
-            g_cdc_ecm_rx_length = 0;
-        } else {
-            /* There's no way to run here. */
+            usbh_cdc_ecm_eth_input(slot->buf, ret);
         }
+
+        usbh_bulkin_ring_release(slot);
     }
     // clang-format off
 delete:
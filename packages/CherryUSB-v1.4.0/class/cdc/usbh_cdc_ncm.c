@@ -23,13 +23,20 @@
 
 #define CONFIG_USBHOST_CDC_NCM_ETH_MAX_SEGSZE 1514U
 
-static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ncm_rx_buffer[CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE];
+#if CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE <= (16 * 1024)
+#define USBH_CDC_NCM_RX_SLOT_SIZE CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE
+#else
+#define USBH_CDC_NCM_RX_SLOT_SIZE (16 * 1024)
+#endif
+
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ncm_rx_buffer[CONFIG_USBHOST_BULKIN_RING_DEPTH][USBH_CDC_NCM_RX_SLOT_SIZE];
 static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ncm_tx_buffer[CONFIG_USBHOST_CDC_NCM_ETH_MAX_TX_SIZE];
 static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ncm_inttx_buffer[16];
 
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_cdc_ncm_buf[32];
 
 static struct usbh_cdc_ncm g_cdc_ncm_class;
+static struct usbh_bulkin_ring g_cdc_ncm_rx_ring;
 
 static int usbh_cdc_ncm_get_ntb_parameters(struct usbh_cdc_ncm *cdc_ncm_class, struct cdc_ncm_ntb_parameters *param)
 {
@@ -56,6 +63,25 @@ static int usbh_cdc_ncm_get_ntb_parameters(struct usbh_cdc_ncm *cdc_ncm_class, s
     return 0;
 }
 
+static int usbh_cdc_ncm_set_ntb_input_size(struct usbh_cdc_ncm *cdc_ncm_class, uint32_t size)
+{
+    struct usb_setup_packet *setup;
+
+    if (!cdc_ncm_class || !cdc_ncm_class->hport) {
+        return -USB_ERR_INVAL;
+    }
+    setup = cdc_ncm_class->hport->setup;
+
+    setup->bmRequestType = USB_REQUEST_DIR_OUT | USB_REQUEST_CLASS | USB_REQUEST_RECIPIENT_INTERFACE;
+    setup->bRequest = CDC_REQUEST_SET_NTB_INPUT_SIZE;
+    setup->wValue = 0;
+    setup->wIndex = cdc_ncm_class->ctrl_intf;
+    setup->wLength = 4;
+
+    memcpy(g_cdc_ncm_buf, &size, 4);
+    return usbh_control_transfer(cdc_ncm_class->hport, setup, g_cdc_ncm_buf);
+}
+
 static void print_ntb_parameters(struct cdc_ncm_ntb_parameters *param)
 {
     USB_LOG_RAW("CDC NCM ntb parameters:\r\n");
@@ -180,6 +206,14 @@ get_mac:
     usbh_cdc_ncm_get_ntb_parameters(cdc_ncm_class, &cdc_ncm_class->ntb_param);
     print_ntb_parameters(&cdc_ncm_class->ntb_param);
 
+    /* one ntb must fit in one rx slot */
+    if (cdc_ncm_class->ntb_param.dwNtbInMaxSize > USBH_CDC_NCM_RX_SLOT_SIZE) {
+        ret = usbh_cdc_ncm_set_ntb_input_size(cdc_ncm_class, USBH_CDC_NCM_RX_SLOT_SIZE);
+        if (ret < 0) {
+            USB_LOG_WRN("Fail to set ntb input size to %u\r\n", USBH_CDC_NCM_RX_SLOT_SIZE);
+        }
+    }
+
     /* enable int ep */
     ep_desc = &hport->config.intf[intf].altsetting[0].ep[0].ep_desc;
     USBH_EP_INIT(cdc_ncm_class->intin, ep_desc);
@@ -227,7 +261,7 @@ static int usbh_cdc_ncm_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
     if (cdc_ncm_class) {
         if (cdc_ncm_class->bulkin) {
-            usbh_kill_urb(&cdc_ncm_class->bulkin_urb);
+            usbh_bulkin_ring_stop(&g_cdc_ncm_rx_ring);
         }
 
         if (cdc_ncm_class->bulkout) {
@@ -251,13 +285,9 @@ static int usbh_cdc_ncm_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
 void usbh_cdc_ncm_rx_thread(void *argument)
 {
-    uint32_t g_cdc_ncm_rx_length;
+    struct usbh_bulkin_slot *slot;
+    uint32_t rx_length;
     int ret;
-#if CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE <= (16 * 1024)
-    uint32_t transfer_size = CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE;
-#else
-    uint32_t transfer_size = (16 * 1024);
-#endif
 
     (void)argument;
     USB_LOG_INFO("Create cdc ncm rx thread\r\n");
@@ -277,65 +307,64 @@ find_class:
         }
     }
 
-    g_cdc_ncm_rx_length = 0;
+    ret = usbh_bulkin_ring_init(&g_cdc_ncm_rx_ring, g_cdc_ncm_class.hport, g_cdc_ncm_class.bulkin, &g_cdc_ncm_rx_buffer[0][0], USBH_CDC_NCM_RX_SLOT_SIZE);
+    if (ret < 0) {
+        goto delete;
+    }
+    g_cdc_ncm_class.rx_ring = &g_cdc_ncm_rx_ring;
+
     while (1) {
-        usbh_bulk_urb_fill(&g_cdc_ncm_class.bulkin_urb, g_cdc_ncm_class.hport, g_cdc_ncm_class.bulkin, &g_cdc_ncm_rx_buffer[g_cdc_ncm_rx_length], transfer_size, USB_OSAL_WAITING_FOREVER, NULL, NULL);
-        ret = usbh_submit_urb(&g_cdc_ncm_class.bulkin_urb);
+        ret = usbh_bulkin_ring_wait(&g_cdc_ncm_rx_ring, &slot, USB_OSAL_WAITING_FOREVER);
         if (ret < 0) {
+            g_cdc_ncm_class.rx_ring = NULL;
+            usbh_bulkin_ring_deinit(&g_cdc_ncm_rx_ring);
             goto find_class;
         }
 
-        g_cdc_ncm_rx_length += g_cdc_ncm_class.bulkin_urb.actual_length;
-
-        /* A transfer is complete because last packet is a short packet.
-         * Short packet is not zero, match g_cdc_ncm_rx_length % USB_GET_MAXPACKETSIZE(g_cdc_ncm_class.bulkin->wMaxPacketSize).
-         * Short packet is zero, check if g_cdc_ncm_class.bulkin_urb.actual_length < transfer_size, for example transfer is complete with size is 1024 < 2048.
-        */
-        if ((g_cdc_ncm_rx_length % USB_GET_MAXPACKETSIZE(g_cdc_ncm_class.bulkin->wMaxPacketSize)) ||
-            (g_cdc_ncm_class.bulkin_urb.actual_length < transfer_size)) {
-            USB_LOG_DBG("rxlen:%d\r\n", g_cdc_ncm_rx_length);
-
-            struct cdc_ncm_nth16 *nth16 = (struct cdc_ncm_nth16 *)&g_cdc_ncm_rx_buffer[0];
-            if ((nth16->dwSignature != CDC_NCM_NTH16_SIGNATURE) ||
-                (nth16->wHeaderLength != 12) ||
-                (nth16->wBlockLength != g_cdc_ncm_rx_length)) {
-                USB_LOG_ERR("invalid rx nth16\r\n");
-                g_cdc_ncm_rx_length = 0;
-                continue;
-            }
+        /* A transfer is complete because last packet is a short packet or the slot is full,
+         * ntb input size has been limited to one slot. Zero length is a zlp, just skip it.
+         */
+        rx_length = ret;
+        if (rx_length == 0) {
+            usbh_bulkin_ring_release(slot);
+            continue;
+        }
 
-            struct cdc_ncm_ndp16 *ndp16 = (struct cdc_ncm_ndp16 *)&g_cdc_ncm_rx_buffer[nth16->wNdpIndex];
-            if ((ndp16->dwSignature != CDC_NCM_NDP16_SIGNATURE_NCM0) && (ndp16->dwSignature != CDC_NCM_NDP16_SIGNATURE_NCM1)) {
-                USB_LOG_ERR("invalid rx ndp16\r\n");
-                g_cdc_ncm_rx_length = 0;
-                continue;
-            }
+        USB_LOG_DBG("rxlen:%d\r\n", rx_length);
 
-            uint16_t datagram_num = (ndp16->wLength - 8) / 4;
+        struct cdc_ncm_nth16 *nth16 = (struct cdc_ncm_nth16 *)slot->buf;
+        if ((nth16->dwSignature != CDC_NCM_NTH16_SIGNATURE) ||
+            (nth16->wHeaderLength != 12) ||
+            (nth16->wBlockLength != rx_length) ||
+            (nth16->wNdpIndex + 8 > rx_length)) {
+            USB_LOG_ERR("invalid rx nth16\r\n");
+            usbh_bulkin_ring_release(slot);
+            continue;
+        }
 
-            USB_LOG_DBG("datagram num:%02x\r\n", datagram_num);
-            for (uint16_t i = 0; i < datagram_num; i++) {
-                struct cdc_ncm_ndp16_datagram *ndp16_datagram = (struct cdc_ncm_ndp16_datagram *)&g_cdc_ncm_rx_buffer[nth16->wNdpIndex + 8 + 4 * i];
-                if (ndp16_datagram->wDatagramIndex && ndp16_datagram->wDatagramLength) {
-                    USB_LOG_DBG("ndp16_datagram index:%02x, length:%02x\r\n", ndp16_datagram->wDatagramIndex, ndp16_datagram->wDatagramLength);
+        struct cdc_ncm_ndp16 *ndp16 = (struct cdc_ncm_ndp16 *)&slot->buf[nth16->wNdpIndex];
+        if ((ndp16->dwSignature != CDC_NCM_NDP16_SIGNATURE_NCM0) && (ndp16->dwSignature != CDC_NCM_NDP16_SIGNATURE_NCM1)) {
+            USB_LOG_ERR("invalid rx ndp16\r\n");
+            usbh_bulkin_ring_release(slot);
+            continue;
+        }
 
-                    uint8_t *buf = (uint8_t *)&g_cdc_ncm_rx_buffer[ndp16_datagram->wDatagramIndex];
-                    usbh_cdc_ncm_eth_input(buf, ndp16_datagram->wDatagramLength);
-                }
-            }
+        uint16_t datagram_num = (ndp16->wLength - 8) / 4;
 
-            g_cdc_ncm_rx_length = 0;
-        } else {
-#if CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE <= (16 * 1024)
-            if (g_cdc_ncm_rx_length == CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE) {
-#else
-            if ((g_cdc_ncm_rx_length + (16 * 1024)) > CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE) {
-#endif
-                USB_LOG_ERR("Rx packet is overflow, please reduce tcp window size or increase CONFIG_USBHOST_CDC_NCM_ETH_MAX_RX_SIZE\r\n");
-                while (1) {
-                }
+        USB_LOG_DBG("datagram num:%02x\r\n", datagram_num);
+        for (uint16_t i = 0; i < datagram_num; i++) {
+            struct cdc_ncm_ndp16_datagram *ndp16_datagram = (struct cdc_ncm_ndp16_datagram *)&slot->buf[nth16->wNdpIndex + 8 + 4 * i];
+            if (ndp16_datagram->wDatagramIndex && ndp16_datagram->wDatagramLength &&
+                (ndp16_datagram->wDatagramIndex + ndp16_datagram->wDatagramLength <= rx_length)) {
+                USB_LOG_DBG("ndp16_datagram index:%02x, length:%02x\r\n", ndp16_datagram->wDatagramIndex, ndp16_datagram->wDatagramLength);
+
+                uint8_t *buf = (uint8_t *)&slot->buf[ndp16_datagram->wDatagramIndex];
+                usbh_cdc_ncm_eth_input(buf, ndp16_datagram->wDatagramLength);
             }
         }
+
+        /* datagrams handed to lwip zero-copy keep their own reference */
+        usbh_bulkin_ring_release(slot);
     }
     // clang-format off
 delete:
@@ -14,7 +14,7 @@ struct usbh_cdc_ncm {
     struct usb_endpoint_descriptor *bulkout; /* Bulk OUT endpoint */
     struct usb_endpoint_descriptor *intin;   /* Interrupt IN endpoint */
     struct usbh_urb bulkout_urb;             /* Bulk out endpoint */
-    struct usbh_urb bulkin_urb;              /* Bulk IN endpoint */
+    struct usbh_bulkin_ring *rx_ring;        /* Bulk IN receive ring */
     struct usbh_urb intin_urb;               /* Interrupt IN endpoint */
 
     uint8_t ctrl_intf; /* Control interface number */
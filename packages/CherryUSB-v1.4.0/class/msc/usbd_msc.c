@@ -10,9 +10,28 @@
 #if defined(CONFIG_USBDEV_MSC_THREAD)
 #include "usb_osal.h"
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
+#include "usb_osal.h"
 #include "chry_ringbuffer.h"
 #endif
 
+/* the buffers only overlap when media access runs out of the isr */
+#ifndef CONFIG_USBDEV_MSC_BUFFER_NUM
+#if defined(CONFIG_USBDEV_MSC_THREAD) || defined(CONFIG_USBDEV_MSC_POLLING)
+#define CONFIG_USBDEV_MSC_BUFFER_NUM 2
+#else
+#define CONFIG_USBDEV_MSC_BUFFER_NUM 1
+#endif
+#endif
+
+/* media access runs out of the usb isr, the isr and it share the block buffers */
+#if defined(CONFIG_USBDEV_MSC_THREAD) || defined(CONFIG_USBDEV_MSC_POLLING)
+#define usbd_msc_lock()       usb_osal_enter_critical_section()
+#define usbd_msc_unlock(flag) usb_osal_leave_critical_section(flag)
+#else
+#define usbd_msc_lock()       0
+#define usbd_msc_unlock(flag) (void)(flag)
+#endif
+
 #define MSD_OUT_EP_IDX 0
 #define MSD_IN_EP_IDX  1
 
@@ -46,16 +65,25 @@ USB_NOCACHE_RAM_SECTION struct usbd_msc_priv {
     uint32_t scsi_blk_size[CONFIG_USBDEV_MSC_MAX_LUN];
     uint32_t scsi_blk_nbr[CONFIG_USBDEV_MSC_MAX_LUN];
 
-    USB_MEM_ALIGNX uint8_t block_buffer[CONFIG_USBDEV_MSC_MAX_BUFSIZE];
+    /*
+     * Ring of block buffers between the media and the bulk endpoints. Data in: buffers read from the media
+     * wait from block_head on, the oldest one is on bulk in while the next is read. Data out: received
+     * buffers wait from block_head on to be written to the media, while the next free one is on bulk out.
+     */
+    USB_MEM_ALIGNX uint8_t block_buffer[CONFIG_USBDEV_MSC_BUFFER_NUM][CONFIG_USBDEV_MSC_MAX_BUFSIZE];
+    uint32_t block_len[CONFIG_USBDEV_MSC_BUFFER_NUM];
+    uint8_t block_head;
+    uint8_t block_count;
+    bool block_busy;        /* a data transfer is on the bus */
+    bool block_error;       /* media failed, fail the command once the bus is idle */
+    uint32_t usb_nsectors;  /* data out: sectors not asked from the host yet */
 
 #if defined(CONFIG_USBDEV_MSC_THREAD)
     usb_osal_mq_t usbd_msc_mq;
     usb_osal_thread_t usbd_msc_thread;
-    uint32_t nbytes;
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
     chry_ringbuffer_t msc_rb;
     uint8_t msc_rb_pool[2];
-    uint32_t nbytes;
 #endif
 } g_usbd_msc[CONFIG_USBDEV_MAX_BUS];
 
@@ -178,8 +206,10 @@ static void usbd_msc_send_info(uint8_t busid, uint8_t *buffer, uint8_t size)
     g_usbd_msc[busid].csw.bStatus = CSW_STATUS_CMD_PASSED;
 }
 
-static bool SCSI_processWrite(uint8_t busid, uint32_t nbytes);
+static bool SCSI_processWrite(uint8_t busid);
 static bool SCSI_processRead(uint8_t busid);
+static void usbd_msc_block_reset(uint8_t busid);
+static void usbd_msc_start_out(uint8_t busid);
 
 /**
 * @brief  SCSI_SetSenseData
@@ -535,6 +565,7 @@ static bool SCSI_read10(uint8_t busid, uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc[busid].stage = MSC_DATA_IN;
+    usbd_msc_block_reset(busid);
 #if defined(CONFIG_USBDEV_MSC_THREAD)
     usb_osal_mq_send(g_usbd_msc[busid].usbd_msc_mq, MSC_DATA_IN);
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
@@ -572,6 +603,7 @@ static bool SCSI_read12(uint8_t busid, uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc[busid].stage = MSC_DATA_IN;
+    usbd_msc_block_reset(busid);
 #if defined(CONFIG_USBDEV_MSC_THREAD)
     usb_osal_mq_send(g_usbd_msc[busid].usbd_msc_mq, MSC_DATA_IN);
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
@@ -610,8 +642,9 @@ static bool SCSI_write10(uint8_t busid, uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc[busid].stage = MSC_DATA_OUT;
-    data_len = MIN(data_len, CONFIG_USBDEV_MSC_MAX_BUFSIZE);
-    usbd_ep_start_read(busid, mass_ep_data[busid][MSD_OUT_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer, data_len);
+    usbd_msc_block_reset(busid);
+    g_usbd_msc[busid].usb_nsectors = g_usbd_msc[busid].nsectors;
+    usbd_msc_start_out(busid);
     return true;
 }
 
@@ -643,8 +676,9 @@ static bool SCSI_write12(uint8_t busid, uint8_t **data, uint32_t *len)
         return false;
     }
     g_usbd_msc[busid].stage = MSC_DATA_OUT;
-    data_len = MIN(data_len, CONFIG_USBDEV_MSC_MAX_BUFSIZE);
-    usbd_ep_start_read(busid, mass_ep_data[busid][MSD_OUT_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer, data_len);
+    usbd_msc_block_reset(busid);
+    g_usbd_msc[busid].usb_nsectors = g_usbd_msc[busid].nsectors;
+    usbd_msc_start_out(busid);
     return true;
 }
 /* do not use verify to reduce code size */
@@ -694,59 +728,196 @@ static bool SCSI_verify10(uint8_t busid, uint8_t **data, uint32_t *len)
 }
 #endif
 
-static bool SCSI_processRead(uint8_t busid)
+static void usbd_msc_block_reset(uint8_t busid)
 {
-    uint32_t transfer_len;
+    g_usbd_msc[busid].block_head = 0;
+    g_usbd_msc[busid].block_count = 0;
+    g_usbd_msc[busid].block_busy = false;
+    g_usbd_msc[busid].block_error = false;
+}
 
-    USB_LOG_DBG("read lba:%d\r\n", g_usbd_msc[busid].start_sector);
+/* whole sectors that fit a block buffer */
+static uint32_t usbd_msc_block_chunk(uint8_t busid, uint32_t nsectors)
+{
+    uint32_t blk_size = g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN];
 
-    transfer_len = MIN(g_usbd_msc[busid].nsectors * g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN], CONFIG_USBDEV_MSC_MAX_BUFSIZE);
+    return MIN(nsectors, CONFIG_USBDEV_MSC_MAX_BUFSIZE / blk_size) * blk_size;
+}
 
-    if (usbd_msc_sector_read(busid, g_usbd_msc[busid].cbw.bLUN, g_usbd_msc[busid].start_sector, g_usbd_msc[busid].block_buffer, transfer_len) != 0) {
-        SCSI_SetSenseData(busid, SCSI_KCQHE_UREINRESERVEDAREA);
-        return false;
-    }
+/* send the oldest buffer read from the media, called locked */
+static void usbd_msc_start_in(uint8_t busid)
+{
+    uint8_t idx = g_usbd_msc[busid].block_head;
 
-    g_usbd_msc[busid].start_sector += (transfer_len / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
-    g_usbd_msc[busid].nsectors -= (transfer_len / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
-    g_usbd_msc[busid].csw.dDataResidue -= transfer_len;
+    if (g_usbd_msc[busid].block_busy || (g_usbd_msc[busid].block_count == 0)) {
+        return;
+    }
 
-    if (g_usbd_msc[busid].nsectors == 0) {
+    g_usbd_msc[busid].block_busy = true;
+    g_usbd_msc[busid].csw.dDataResidue -= g_usbd_msc[busid].block_len[idx];
+    if ((g_usbd_msc[busid].nsectors == 0) && (g_usbd_msc[busid].block_count == 1) && !g_usbd_msc[busid].block_error) {
         g_usbd_msc[busid].stage = MSC_SEND_CSW;
     }
 
-    usbd_ep_start_write(busid, mass_ep_data[busid][MSD_IN_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer, transfer_len);
+    usbd_ep_start_write(busid, mass_ep_data[busid][MSD_IN_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer[idx], g_usbd_msc[busid].block_len[idx]);
+}
+
+/* bulk in of the oldest buffer is done, it is free again. called from the isr */
+static void usbd_msc_in_done(uint8_t busid)
+{
+    g_usbd_msc[busid].block_busy = false;
+    g_usbd_msc[busid].block_head = (g_usbd_msc[busid].block_head + 1) % CONFIG_USBDEV_MSC_BUFFER_NUM;
+    g_usbd_msc[busid].block_count--;
+}
+
+/* ask the host for the next chunk into a free buffer, called locked */
+static void usbd_msc_start_out(uint8_t busid)
+{
+    uint8_t idx;
+    uint32_t data_len;
+
+    if (g_usbd_msc[busid].block_busy || g_usbd_msc[busid].block_error || (g_usbd_msc[busid].usb_nsectors == 0) ||
+        (g_usbd_msc[busid].block_count == CONFIG_USBDEV_MSC_BUFFER_NUM)) {
+        return;
+    }
+
+    idx = (g_usbd_msc[busid].block_head + g_usbd_msc[busid].block_count) % CONFIG_USBDEV_MSC_BUFFER_NUM;
+    data_len = usbd_msc_block_chunk(busid, g_usbd_msc[busid].usb_nsectors);
+    g_usbd_msc[busid].usb_nsectors -= data_len / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN];
+    g_usbd_msc[busid].block_len[idx] = data_len;
+    g_usbd_msc[busid].block_busy = true;
+
+    usbd_ep_start_read(busid, mass_ep_data[busid][MSD_OUT_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer[idx], data_len);
+}
+
+/* bulk out filled the next buffer, ask for the one after it before the media write. called from the isr */
+static void usbd_msc_out_done(uint8_t busid, uint32_t nbytes)
+{
+    uint32_t blk_size = g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN];
+    uint8_t idx = (g_usbd_msc[busid].block_head + g_usbd_msc[busid].block_count) % CONFIG_USBDEV_MSC_BUFFER_NUM;
+
+    /* short packet, ask the rest again */
+    if (nbytes < g_usbd_msc[busid].block_len[idx]) {
+        g_usbd_msc[busid].usb_nsectors += g_usbd_msc[busid].block_len[idx] / blk_size - nbytes / blk_size;
+        g_usbd_msc[busid].block_len[idx] = nbytes;
+    }
+
+    g_usbd_msc[busid].block_busy = false;
+    g_usbd_msc[busid].block_count++;
+    usbd_msc_start_out(busid);
+}
+
+static bool SCSI_processRead(uint8_t busid)
+{
+    uint32_t transfer_len;
+    size_t flags;
+    uint8_t idx;
+    int ret;
+
+    flags = usbd_msc_lock();
+    /* an event queued before a reset or the end of the command, the buffers are not this read's */
+    if ((g_usbd_msc[busid].stage != MSC_DATA_IN) ||
+        ((g_usbd_msc[busid].cbw.CB[0] != SCSI_CMD_READ10) && (g_usbd_msc[busid].cbw.CB[0] != SCSI_CMD_READ12))) {
+        usbd_msc_unlock(flags);
+        return true;
+    }
+    usbd_msc_start_in(busid);
+
+    /* fill the free buffers while the oldest one is on the bus */
+    while (!g_usbd_msc[busid].block_error && (g_usbd_msc[busid].nsectors != 0) &&
+           (g_usbd_msc[busid].block_count < CONFIG_USBDEV_MSC_BUFFER_NUM)) {
+        idx = (g_usbd_msc[busid].block_head + g_usbd_msc[busid].block_count) % CONFIG_USBDEV_MSC_BUFFER_NUM;
+        transfer_len = usbd_msc_block_chunk(busid, g_usbd_msc[busid].nsectors);
+        usbd_msc_unlock(flags);
+
+        USB_LOG_DBG("read lba:%d\r\n", g_usbd_msc[busid].start_sector);
+        ret = usbd_msc_sector_read(busid, g_usbd_msc[busid].cbw.bLUN, g_usbd_msc[busid].start_sector, g_usbd_msc[busid].block_buffer[idx], transfer_len);
+
+        flags = usbd_msc_lock();
+        if (ret != 0) {
+            SCSI_SetSenseData(busid, SCSI_KCQHE_UREINRESERVEDAREA);
+            g_usbd_msc[busid].block_error = true;
+            break;
+        }
+        g_usbd_msc[busid].block_len[idx] = transfer_len;
+        g_usbd_msc[busid].start_sector += (transfer_len / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
+        g_usbd_msc[busid].nsectors -= (transfer_len / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
+        g_usbd_msc[busid].block_count++;
+        usbd_msc_start_in(busid);
+    }
+
+    if (g_usbd_msc[busid].block_error) {
+        /* drop what is not on the bus yet, fail once the bus is idle */
+        g_usbd_msc[busid].block_count = g_usbd_msc[busid].block_busy ? 1 : 0;
+        if (!g_usbd_msc[busid].block_busy) {
+            usbd_msc_unlock(flags);
+            return false;
+        }
+    }
+    usbd_msc_unlock(flags);
 
     return true;
 }
 
-static bool SCSI_processWrite(uint8_t busid, uint32_t nbytes)
+static bool SCSI_processWrite(uint8_t busid)
 {
-    uint32_t data_len = 0;
-    USB_LOG_DBG("write lba:%d\r\n", g_usbd_msc[busid].start_sector);
+    uint32_t nbytes;
+    size_t flags;
+    uint8_t idx;
+    int ret;
 
-    if (usbd_msc_sector_write(busid, g_usbd_msc[busid].cbw.bLUN, g_usbd_msc[busid].start_sector, g_usbd_msc[busid].block_buffer, nbytes) != 0) {
-        SCSI_SetSenseData(busid, SCSI_KCQHE_WRITEFAULT);
-        return false;
+    flags = usbd_msc_lock();
+    /* an event queued before a reset or the end of the command, the buffers are not this write's */
+    if ((g_usbd_msc[busid].stage != MSC_DATA_OUT) ||
+        ((g_usbd_msc[busid].cbw.CB[0] != SCSI_CMD_WRITE10) && (g_usbd_msc[busid].cbw.CB[0] != SCSI_CMD_WRITE12))) {
+        usbd_msc_unlock(flags);
+        return true;
+    }
+
+    /* write the received buffers while the host sends the next one */
+    while (!g_usbd_msc[busid].block_error && (g_usbd_msc[busid].block_count != 0)) {
+        idx = g_usbd_msc[busid].block_head;
+        nbytes = g_usbd_msc[busid].block_len[idx];
+        usbd_msc_unlock(flags);
+
+        USB_LOG_DBG("write lba:%d\r\n", g_usbd_msc[busid].start_sector);
+        ret = usbd_msc_sector_write(busid, g_usbd_msc[busid].cbw.bLUN, g_usbd_msc[busid].start_sector, g_usbd_msc[busid].block_buffer[idx], nbytes);
+
+        flags = usbd_msc_lock();
+        if (ret != 0) {
+            SCSI_SetSenseData(busid, SCSI_KCQHE_WRITEFAULT);
+            g_usbd_msc[busid].block_error = true;
+            break;
+        }
+        g_usbd_msc[busid].start_sector += (nbytes / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
+        g_usbd_msc[busid].nsectors -= (nbytes / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
+        g_usbd_msc[busid].csw.dDataResidue -= nbytes;
+        g_usbd_msc[busid].block_head = (idx + 1) % CONFIG_USBDEV_MSC_BUFFER_NUM;
+        g_usbd_msc[busid].block_count--;
+        usbd_msc_start_out(busid);
     }
 
-    g_usbd_msc[busid].start_sector += (nbytes / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
-    g_usbd_msc[busid].nsectors -= (nbytes / g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN]);
-    g_usbd_msc[busid].csw.dDataResidue -= nbytes;
+    if (g_usbd_msc[busid].block_error) {
+        /* a bulk out still on the bus would take the next cbw, fail once it is done */
+        g_usbd_msc[busid].block_count = 0;
+        ret = g_usbd_msc[busid].block_busy;
+        usbd_msc_unlock(flags);
+        return ret;
+    }
 
-    if (g_usbd_msc[busid].nsectors == 0) {
+    if ((g_usbd_msc[busid].nsectors == 0) && (g_usbd_msc[busid].stage == MSC_DATA_OUT)) {
+        usbd_msc_unlock(flags);
         usbd_msc_send_csw(busid, CSW_STATUS_CMD_PASSED);
-    } else {
-        data_len = MIN(g_usbd_msc[busid].nsectors * g_usbd_msc[busid].scsi_blk_size[g_usbd_msc[busid].cbw.bLUN], CONFIG_USBDEV_MSC_MAX_BUFSIZE);
-        usbd_ep_start_read(busid, mass_ep_data[busid][MSD_OUT_EP_IDX].ep_addr, g_usbd_msc[busid].block_buffer, data_len);
+        return true;
     }
+    usbd_msc_unlock(flags);
 
     return true;
 }
 
 static bool SCSI_CBWDecode(uint8_t busid, uint32_t nbytes)
 {
-    uint8_t *buf2send = g_usbd_msc[busid].block_buffer;
+    uint8_t *buf2send = g_usbd_msc[busid].block_buffer[0];
     uint32_t len2send = 0;
     bool ret = false;
 
@@ -845,14 +1016,13 @@ void mass_storage_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes)
             switch (g_usbd_msc[busid].cbw.CB[0]) {
                 case SCSI_CMD_WRITE10:
                 case SCSI_CMD_WRITE12:
+                    usbd_msc_out_done(busid, nbytes);
 #if defined(CONFIG_USBDEV_MSC_THREAD)
-                    g_usbd_msc[busid].nbytes = nbytes;
                     usb_osal_mq_send(g_usbd_msc[busid].usbd_msc_mq, MSC_DATA_OUT);
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
-                    g_usbd_msc[busid].nbytes = nbytes;
                     chry_ringbuffer_write_byte(&g_usbd_msc[busid].msc_rb, MSC_DATA_OUT);
 #else
-                    if (SCSI_processWrite(busid, nbytes) == false) {
+                    if (SCSI_processWrite(busid) == false) {
                         usbd_msc_send_csw(busid, CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
                     }
 #endif
@@ -876,9 +1046,12 @@ void mass_storage_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
             switch (g_usbd_msc[busid].cbw.CB[0]) {
                 case SCSI_CMD_READ10:
                 case SCSI_CMD_READ12:
+                    usbd_msc_in_done(busid);
 #if defined(CONFIG_USBDEV_MSC_THREAD)
+                    usbd_msc_start_in(busid);
                     usb_osal_mq_send(g_usbd_msc[busid].usbd_msc_mq, MSC_DATA_IN);
 #elif defined(CONFIG_USBDEV_MSC_POLLING)
+                    usbd_msc_start_in(busid);
                     chry_ringbuffer_write_byte(&g_usbd_msc[busid].msc_rb, MSC_DATA_IN);
 #else
                     if (SCSI_processRead(busid) == false) {
@@ -922,7 +1095,7 @@ static void usbdev_msc_thread(void *argument)
         }
         USB_LOG_DBG("event:%d\r\n", event);
         if (event == MSC_DATA_OUT) {
-            if (SCSI_processWrite(busid, g_usbd_msc[busid].nbytes) == false) {
+            if (SCSI_processWrite(busid) == false) {
                 usbd_msc_send_csw(busid, CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
         } else if (event == MSC_DATA_IN) {
@@ -941,7 +1114,7 @@ void usbd_msc_polling(uint8_t busid)
     if (chry_ringbuffer_read_byte(&g_usbd_msc[busid].msc_rb, &event)) {
         USB_LOG_DBG("event:%d\r\n", event);
         if (event == MSC_DATA_OUT) {
-            if (SCSI_processWrite(busid, g_usbd_msc[busid].nbytes) == false) {
+            if (SCSI_processWrite(busid) == false) {
                 usbd_msc_send_csw(busid, CSW_STATUS_CMD_FAILED); /* send fail status to host,and the host will retry*/
             }
         } else if (event == MSC_DATA_IN) {
@@ -15,9 +15,16 @@
 
 #define MSC_INQUIRY_TIMEOUT 500
 
+/* Command result before the engine finishes it */
+#define MSC_CMD_PENDING 1
+
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_msc_buf[CONFIG_USBHOST_MAX_MSC_CLASS][USB_ALIGN_UP(64, CONFIG_USB_ALIGN_SIZE)];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_msc_cbw_buf[CONFIG_USBHOST_MAX_MSC_CLASS][CONFIG_USBHOST_MSC_QUEUE_DEPTH][USB_ALIGN_UP(USB_SIZEOF_MSC_CBW, CONFIG_USB_ALIGN_SIZE)];
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_msc_csw_buf[CONFIG_USBHOST_MAX_MSC_CLASS][CONFIG_USBHOST_MSC_QUEUE_DEPTH][USB_ALIGN_UP(USB_SIZEOF_MSC_CSW, CONFIG_USB_ALIGN_SIZE)];
 
 static struct usbh_msc g_msc_class[CONFIG_USBHOST_MAX_MSC_CLASS];
+/* indexed by the class of lun 0 */
+static struct usbh_msc_bot g_msc_bot[CONFIG_USBHOST_MAX_MSC_CLASS];
 static uint32_t g_devinuse = 0;
 static struct usbh_msc_modeswitch_config *g_msc_modeswitch_config = NULL;
 
@@ -96,167 +103,512 @@ static void usbh_msc_csw_dump(struct CSW *csw)
     USB_LOG_DBG("  status:    0x%02x\r\n", csw->bStatus);
 }
 
-static inline int usbh_msc_bulk_in_transfer(struct usbh_msc *msc_class, uint8_t *buffer, uint32_t buflen, uint32_t timeout)
+/*
+ * Bot engine: every stage is submitted from the completion of the previous one, the caller only
+ * wakes up when the csw is back. Commands of all luns of an interface go through one queue, while
+ * the csw of the active command is read, the cbw of the next one is already sent on bulk out, the
+ * device naks it until the csw is gone so the next command starts without a round trip.
+ * All engine functions run in irq or with critical section held.
+ */
+static void usbh_msc_bot_cbw_complete(void *arg, int nbytes);
+static void usbh_msc_bot_data_complete(void *arg, int nbytes);
+static void usbh_msc_bot_csw_complete(void *arg, int nbytes);
+
+static void usbh_msc_bot_done(struct usbh_msc_cmd *cmd, int result)
 {
+    cmd->result = result;
+    usb_osal_sem_give(cmd->waitsem);
+}
+
+static struct usbh_msc_cmd *usbh_msc_bot_pop(struct usbh_msc_bot *bot)
+{
+    struct usbh_msc_cmd *cmd;
+
+    cmd = usb_slist_first_entry_or_null(&bot->queue, struct usbh_msc_cmd, list);
+    if (cmd) {
+        usb_slist_remove(&bot->queue, &cmd->list);
+    }
+    return cmd;
+}
+
+static int usbh_msc_bot_send_cbw(struct usbh_msc_bot *bot, struct usbh_msc_cmd *cmd)
+{
+    cmd->cbw_done = false;
+    usbh_bulk_urb_fill(&bot->bulkout_urb, bot->hport, bot->bulkout, (uint8_t *)cmd->cbw, USB_SIZEOF_MSC_CBW, 0, usbh_msc_bot_cbw_complete, cmd);
+    return usbh_submit_urb(&bot->bulkout_urb);
+}
+
+static void usbh_msc_bot_kick(struct usbh_msc_bot *bot)
+{
+    struct usbh_msc_cmd *cmd;
     int ret;
-    struct usbh_urb *urb = &msc_class->bulkin_urb;
 
-    usbh_bulk_urb_fill(urb, msc_class->hport, msc_class->bulkin, buffer, buflen, timeout, NULL, NULL);
-    ret = usbh_submit_urb(urb);
-    if (ret == 0) {
-        ret = urb->actual_length;
+    while (bot->active == NULL) {
+        if (bot->next) {
+            /* cbw already sent ahead */
+            bot->active = bot->next;
+            bot->next = NULL;
+            if (bot->active->cbw_done) {
+                usbh_msc_bot_cbw_complete(bot->active, USB_SIZEOF_MSC_CBW);
+            }
+            return;
+        }
+
+        cmd = usbh_msc_bot_pop(bot);
+        if (cmd == NULL) {
+            return;
+        }
+
+        bot->active = cmd;
+        ret = usbh_msc_bot_send_cbw(bot, cmd);
+        if (ret < 0) {
+            bot->active = NULL;
+            usbh_msc_bot_done(cmd, ret);
+        }
     }
-    return ret;
 }
 
-static inline int usbh_msc_bulk_out_transfer(struct usbh_msc *msc_class, uint8_t *buffer, uint32_t buflen, uint32_t timeout)
+static void usbh_msc_bot_abort(struct usbh_msc_bot *bot, int result)
+{
+    usbh_kill_urb(&bot->bulkin_urb);
+    usbh_kill_urb(&bot->bulkout_urb);
+
+    if (bot->active) {
+        usbh_msc_bot_done(bot->active, result);
+        bot->active = NULL;
+    }
+    if (bot->next) {
+        usbh_msc_bot_done(bot->next, result);
+        bot->next = NULL;
+    }
+}
+
+/* Stage failed on the active command, go on with the queue */
+static void usbh_msc_bot_fail(struct usbh_msc_bot *bot, struct usbh_msc_cmd *cmd, int result)
+{
+    if (bot->next) {
+        /* bulk out may still carry the cbw sent ahead */
+        usbh_kill_urb(&bot->bulkout_urb);
+        usbh_msc_bot_done(bot->next, result);
+        bot->next = NULL;
+    }
+    bot->active = NULL;
+    usbh_msc_bot_done(cmd, result);
+    usbh_msc_bot_kick(bot);
+}
+
+static void usbh_msc_bot_csw_stage(struct usbh_msc_bot *bot, struct usbh_msc_cmd *cmd)
 {
     int ret;
-    struct usbh_urb *urb = &msc_class->bulkout_urb;
 
-    usbh_bulk_urb_fill(urb, msc_class->hport, msc_class->bulkout, buffer, buflen, timeout, NULL, NULL);
+    memset(cmd->csw, 0, USB_SIZEOF_MSC_CSW);
+    usbh_bulk_urb_fill(&bot->bulkin_urb, bot->hport, bot->bulkin, (uint8_t *)cmd->csw, USB_SIZEOF_MSC_CSW, 0, usbh_msc_bot_csw_complete, cmd);
+    ret = usbh_submit_urb(&bot->bulkin_urb);
+    if (ret < 0) {
+        usbh_msc_bot_fail(bot, cmd, ret);
+        return;
+    }
+
+#ifdef CONFIG_USBHOST_MSC_CBW_AHEAD
+    /* bulk out is idle now */
+    if (bot->next == NULL) {
+        struct usbh_msc_cmd *next = usbh_msc_bot_pop(bot);
+
+        if (next) {
+            bot->next = next;
+            ret = usbh_msc_bot_send_cbw(bot, next);
+            if (ret < 0) {
+                bot->next = NULL;
+                usbh_msc_bot_done(next, ret);
+            }
+        }
+    }
+#endif
+}
+
+static void usbh_msc_bot_cbw_complete(void *arg, int nbytes)
+{
+    struct usbh_msc_cmd *cmd = (struct usbh_msc_cmd *)arg;
+    struct usbh_msc_bot *bot = cmd->msc_class->bot;
+    struct usbh_urb *urb;
+    int ret;
+
+    if (nbytes < 0) {
+        if (cmd == bot->next) {
+            bot->next = NULL;
+            usbh_msc_bot_done(cmd, nbytes);
+        } else if (cmd == bot->active) {
+            usbh_msc_bot_fail(bot, cmd, nbytes);
+        }
+        return;
+    }
+
+    cmd->cbw_done = true;
+    if (cmd != bot->active) {
+        /* sent ahead, data stage starts after csw of active */
+        return;
+    }
+
+    if (cmd->cbw->dDataLength == 0 || cmd->buffer == NULL) {
+        usbh_msc_bot_csw_stage(bot, cmd);
+        return;
+    }
+
+    if (cmd->cbw->bmFlags & 0x80) {
+        urb = &bot->bulkin_urb;
+        usbh_bulk_urb_fill(urb, bot->hport, bot->bulkin, cmd->buffer, cmd->cbw->dDataLength, 0, usbh_msc_bot_data_complete, cmd);
+    } else {
+        urb = &bot->bulkout_urb;
+        usbh_bulk_urb_fill(urb, bot->hport, bot->bulkout, cmd->buffer, cmd->cbw->dDataLength, 0, usbh_msc_bot_data_complete, cmd);
+    }
     ret = usbh_submit_urb(urb);
-    if (ret == 0) {
-        ret = urb->actual_length;
+    if (ret < 0) {
+        usbh_msc_bot_fail(bot, cmd, ret);
     }
-    return ret;
 }
 
-static int usbh_bulk_cbw_csw_xfer(struct usbh_msc *msc_class, struct CBW *cbw, struct CSW *csw, uint8_t *buffer, uint32_t timeout)
+static void usbh_msc_bot_data_complete(void *arg, int nbytes)
 {
-    int nbytes;
+    struct usbh_msc_cmd *cmd = (struct usbh_msc_cmd *)arg;
+    struct usbh_msc_bot *bot = cmd->msc_class->bot;
 
-    usbh_msc_cbw_dump(cbw);
+    if (cmd != bot->active) {
+        return;
+    }
 
-    /* Send the CBW */
-    nbytes = usbh_msc_bulk_out_transfer(msc_class, (uint8_t *)cbw, USB_SIZEOF_MSC_CBW, timeout);
     if (nbytes < 0) {
-        USB_LOG_ERR("cbw transfer error\r\n");
-        goto __err_exit;
-    }
-
-    if (cbw->dDataLength != 0) {
-        if (cbw->CB[0] == SCSI_CMD_WRITE10) {
-            nbytes = usbh_msc_bulk_out_transfer(msc_class, buffer, cbw->dDataLength, timeout);
-        } else if (cbw->CB[0] == SCSI_CMD_READCAPACITY10) {
-            nbytes = usbh_msc_bulk_in_transfer(msc_class, buffer, cbw->dDataLength, timeout);
-            if (nbytes >= 0) {
-                /* Save the capacity information */
-                msc_class->blocknum = GET_BE32(&buffer[0]) + 1;
-                msc_class->blocksize = GET_BE32(&buffer[4]);
-            }
-        } else {
-            nbytes = usbh_msc_bulk_in_transfer(msc_class, buffer, cbw->dDataLength, timeout);
+        usbh_msc_bot_fail(bot, cmd, nbytes);
+        return;
+    }
+
+    usbh_msc_bot_csw_stage(bot, cmd);
+}
+
+static void usbh_msc_bot_csw_complete(void *arg, int nbytes)
+{
+    struct usbh_msc_cmd *cmd = (struct usbh_msc_cmd *)arg;
+    struct usbh_msc_bot *bot = cmd->msc_class->bot;
+    int result = 0;
+
+    if (cmd != bot->active) {
+        return;
+    }
+
+    if (nbytes < 0) {
+        usbh_msc_bot_fail(bot, cmd, nbytes);
+        return;
+    }
+
+    if ((nbytes != USB_SIZEOF_MSC_CSW) || (cmd->csw->dSignature != MSC_CSW_Signature) || (cmd->csw->dTag != cmd->cbw->dTag)) {
+        result = -USB_ERR_INVAL;
+    } else if (cmd->csw->bStatus != 0) {
+        result = -USB_ERR_INVAL;
+    }
+
+    bot->active = NULL;
+    usbh_msc_bot_done(cmd, result);
+    usbh_msc_bot_kick(bot);
+}
+
+static int usbh_msc_cmd_alloc(struct usbh_msc *msc_class, struct usbh_msc_cmd **cmd_out)
+{
+    struct usbh_msc_cmd *cmd = NULL;
+    size_t flags;
+
+    if (!msc_class->cmd_sem || usb_osal_sem_take(msc_class->cmd_sem, CONFIG_USBHOST_MSC_TIMEOUT) < 0) {
+        return -USB_ERR_BUSY;
+    }
+
+    flags = usb_osal_enter_critical_section();
+    for (uint8_t i = 0; i < CONFIG_USBHOST_MSC_QUEUE_DEPTH; i++) {
+        if (!msc_class->cmd[i].inuse) {
+            cmd = &msc_class->cmd[i];
+            cmd->inuse = true;
+            break;
         }
+    }
+    usb_osal_leave_critical_section(flags);
+
+    if (cmd == NULL) {
+        /* semaphore and pool out of step, give back what was taken */
+        usb_osal_sem_give(msc_class->cmd_sem);
+        return -USB_ERR_NOMEM;
+    }
+
+    memset(cmd->cbw, 0, USB_SIZEOF_MSC_CBW);
+    cmd->cbw->dSignature = MSC_CBW_Signature;
+    cmd->cbw->bLUN = msc_class->lun;
+    cmd->buffer = NULL;
+    *cmd_out = cmd;
+    return 0;
+}
+
+static void usbh_msc_cmd_free(struct usbh_msc_cmd *cmd)
+{
+    cmd->inuse = false;
+    usb_osal_sem_give(cmd->msc_class->cmd_sem);
+}
+
+static int usbh_msc_bot_xfer(struct usbh_msc_cmd *cmd, uint8_t *buffer, uint32_t timeout)
+{
+    struct usbh_msc *msc_class = cmd->msc_class;
+    struct usbh_msc_bot *bot = msc_class->bot;
+    size_t flags;
+    int ret;
+
+    cmd->buffer = buffer;
+    cmd->result = MSC_CMD_PENDING;
+    usb_osal_sem_reset(cmd->waitsem);
+
+    flags = usb_osal_enter_critical_section();
+    if (!bot->connected) {
+        usb_osal_leave_critical_section(flags);
+        usbh_msc_cmd_free(cmd);
+        return -USB_ERR_NOTCONN;
+    }
+    cmd->cbw->dTag = ++bot->tag;
+    msc_class->queue_depth++;
+    if (msc_class->queue_depth > msc_class->max_queue_depth) {
+        msc_class->max_queue_depth = msc_class->queue_depth;
+    }
+    usb_slist_add_tail(&bot->queue, &cmd->list);
+    usbh_msc_bot_kick(bot);
+    usb_osal_leave_critical_section(flags);
+
+    usbh_msc_cbw_dump(cmd->cbw);
+
+    usb_osal_sem_take(cmd->waitsem, timeout);
 
-        if (nbytes < 0) {
-            USB_LOG_ERR("msc data transfer error\r\n");
-            goto __err_exit;
+    flags = usb_osal_enter_critical_section();
+    if (cmd->result == MSC_CMD_PENDING) {
+        if ((cmd == bot->active) || (cmd == bot->next)) {
+            usbh_msc_bot_abort(bot, -USB_ERR_TIMEOUT);
+            usbh_msc_bot_kick(bot);
+        } else {
+            usb_slist_remove(&bot->queue, &cmd->list);
+            cmd->result = -USB_ERR_TIMEOUT;
         }
     }
+    ret = cmd->result;
+    msc_class->queue_depth--;
+    msc_class->cmd_count++;
+    usb_osal_leave_critical_section(flags);
 
-    /* Receive the CSW */
-    memset(csw, 0, USB_SIZEOF_MSC_CSW);
-    nbytes = usbh_msc_bulk_in_transfer(msc_class, (uint8_t *)csw, USB_SIZEOF_MSC_CSW, timeout);
-    if (nbytes < 0) {
-        USB_LOG_ERR("csw transfer error\r\n");
-        goto __err_exit;
+    if (ret < 0) {
+        USB_LOG_ERR("lun %u cmd 0x%02x error %d, csw bStatus %d\r\n", msc_class->lun, cmd->cbw->CB[0], ret, cmd->csw->bStatus);
+    } else {
+        usbh_msc_csw_dump(cmd->csw);
     }
 
-    usbh_msc_csw_dump(csw);
+    usbh_msc_cmd_free(cmd);
+    return ret;
+}
 
-    /* check csw status */
-    if (csw->dSignature != MSC_CSW_Signature) {
-        USB_LOG_ERR("csw signature error\r\n");
-        return -USB_ERR_INVAL;
+static int usbh_msc_lun_init(struct usbh_msc *msc_class, struct usbh_msc_bot *bot, uint8_t lun)
+{
+    int devno = msc_class->sdchar - 'a';
+
+    msc_class->hport = bot->hport;
+    msc_class->bulkin = bot->bulkin;
+    msc_class->bulkout = bot->bulkout;
+    msc_class->bot = bot;
+    msc_class->lun = lun;
+
+    msc_class->cmd_sem = usb_osal_sem_create(CONFIG_USBHOST_MSC_QUEUE_DEPTH);
+    if (msc_class->cmd_sem == NULL) {
+        return -USB_ERR_NOMEM;
     }
 
-    if (csw->bStatus != 0) {
-        USB_LOG_ERR("csw bStatus %d\r\n", csw->bStatus);
-        return -USB_ERR_INVAL;
+    for (uint8_t i = 0; i < CONFIG_USBHOST_MSC_QUEUE_DEPTH; i++) {
+        msc_class->cmd[i].msc_class = msc_class;
+        msc_class->cmd[i].cbw = (struct CBW *)g_msc_cbw_buf[devno][i];
+        msc_class->cmd[i].csw = (struct CSW *)g_msc_csw_buf[devno][i];
+        msc_class->cmd[i].waitsem = usb_osal_sem_create(0);
+        if (msc_class->cmd[i].waitsem == NULL) {
+            return -USB_ERR_NOMEM;
+        }
+    }
+    return 0;
+}
+
+static void usbh_msc_lun_deinit(struct usbh_msc *msc_class)
+{
+    for (uint8_t i = 0; i < CONFIG_USBHOST_MSC_QUEUE_DEPTH; i++) {
+        if (msc_class->cmd[i].waitsem) {
+            usb_osal_sem_delete(msc_class->cmd[i].waitsem);
+        }
+    }
+    if (msc_class->cmd_sem) {
+        usb_osal_sem_delete(msc_class->cmd_sem);
     }
-__err_exit:
-    return nbytes < 0 ? (int)nbytes : 0;
 }
 
 static inline int usbh_msc_scsi_testunitready(struct usbh_msc *msc_class)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+    int ret;
 
-    /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
 
-    cbw->bCBLength = SCSICMD_TESTUNITREADY_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_TESTUNITREADY;
+    /* Construct the CBW */
+    cmd->cbw->bCBLength = SCSICMD_TESTUNITREADY_SIZEOF;
+    cmd->cbw->CB[0] = SCSI_CMD_TESTUNITREADY;
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], NULL, MSC_INQUIRY_TIMEOUT);
+    return usbh_msc_bot_xfer(cmd, NULL, MSC_INQUIRY_TIMEOUT);
 }
 
 static inline int usbh_msc_scsi_requestsense(struct usbh_msc *msc_class)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+    int ret;
 
-    /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
 
-    cbw->bmFlags = 0x80;
-    cbw->dDataLength = SCSIRESP_FIXEDSENSEDATA_SIZEOF;
-    cbw->bCBLength = SCSICMD_REQUESTSENSE_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_REQUESTSENSE;
-    cbw->CB[4] = SCSIRESP_FIXEDSENSEDATA_SIZEOF;
+    /* Construct the CBW */
+    cmd->cbw->bmFlags = 0x80;
+    cmd->cbw->dDataLength = SCSIRESP_FIXEDSENSEDATA_SIZEOF;
+    cmd->cbw->bCBLength = SCSICMD_REQUESTSENSE_SIZEOF;
+    cmd->cbw->CB[0] = SCSI_CMD_REQUESTSENSE;
+    cmd->cbw->CB[4] = SCSIRESP_FIXEDSENSEDATA_SIZEOF;
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], g_msc_buf[msc_class->sdchar - 'a'], MSC_INQUIRY_TIMEOUT);
+    return usbh_msc_bot_xfer(cmd, g_msc_buf[msc_class->sdchar - 'a'], MSC_INQUIRY_TIMEOUT);
 }
 
 static inline int usbh_msc_scsi_inquiry(struct usbh_msc *msc_class)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+    int ret;
 
-    /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
 
-    cbw->dDataLength = SCSIRESP_INQUIRY_SIZEOF;
-    cbw->bmFlags = 0x80;
-    cbw->bCBLength = SCSICMD_INQUIRY_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_INQUIRY;
-    cbw->CB[4] = SCSIRESP_INQUIRY_SIZEOF;
+    /* Construct the CBW */
+    cmd->cbw->dDataLength = SCSIRESP_INQUIRY_SIZEOF;
+    cmd->cbw->bmFlags = 0x80;
+    cmd->cbw->bCBLength = SCSICMD_INQUIRY_SIZEOF;
+    cmd->cbw->CB[0] = SCSI_CMD_INQUIRY;
+    cmd->cbw->CB[4] = SCSIRESP_INQUIRY_SIZEOF;
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], g_msc_buf[msc_class->sdchar - 'a'], MSC_INQUIRY_TIMEOUT);
+    return usbh_msc_bot_xfer(cmd, g_msc_buf[msc_class->sdchar - 'a'], MSC_INQUIRY_TIMEOUT);
 }
 
 static inline int usbh_msc_scsi_readcapacity10(struct usbh_msc *msc_class)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+    uint8_t *buffer = g_msc_buf[msc_class->sdchar - 'a'];
+    int ret;
+
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
 
     /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
+    cmd->cbw->dDataLength = SCSIRESP_READCAPACITY10_SIZEOF;
+    cmd->cbw->bmFlags = 0x80;
+    cmd->cbw->bCBLength = SCSICMD_READCAPACITY10_SIZEOF;
+    cmd->cbw->CB[0] = SCSI_CMD_READCAPACITY10;
 
-    cbw->dDataLength = SCSIRESP_READCAPACITY10_SIZEOF;
-    cbw->bmFlags = 0x80;
-    cbw->bCBLength = SCSICMD_READCAPACITY10_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_READCAPACITY10;
+    ret = usbh_msc_bot_xfer(cmd, buffer, MSC_INQUIRY_TIMEOUT);
+    if (ret == 0) {
+        /* Save the capacity information, 0xffffffff means READ CAPACITY(16) is needed */
+        msc_class->blocknum = (uint64_t)GET_BE32(&buffer[0]) + 1;
+        msc_class->blocksize = GET_BE32(&buffer[4]);
+    }
+    return ret;
+}
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], g_msc_buf[msc_class->sdchar - 'a'], MSC_INQUIRY_TIMEOUT);
+static inline int usbh_msc_scsi_readcapacity16(struct usbh_msc *msc_class)
+{
+    struct usbh_msc_cmd *cmd;
+    uint8_t *buffer = g_msc_buf[msc_class->sdchar - 'a'];
+    int ret;
+
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
+
+    /* Construct the CBW */
+    cmd->cbw->dDataLength = SCSIRESP_READCAPACITY16_SIZEOF;
+    cmd->cbw->bmFlags = 0x80;
+    cmd->cbw->bCBLength = SCSICMD_READCAPACITY16_SIZEOF;
+    cmd->cbw->CB[0] = SCSI_CMD_READCAPACITY16;
+    cmd->cbw->CB[1] = SCSICMD_READCAPACITY16_ACTION;
+    SET_BE32(&cmd->cbw->CB[10], SCSIRESP_READCAPACITY16_SIZEOF);
+
+    ret = usbh_msc_bot_xfer(cmd, buffer, MSC_INQUIRY_TIMEOUT);
+    if (ret == 0) {
+        msc_class->blocknum = (((uint64_t)GET_BE32(&buffer[0]) << 32) | GET_BE32(&buffer[4])) + 1;
+        msc_class->blocksize = GET_BE32(&buffer[8]);
+    }
+    return ret;
 }
 
 static inline void usbh_msc_modeswitch(struct usbh_msc *msc_class, const uint8_t *message)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+
+    if (usbh_msc_cmd_alloc(msc_class, &cmd) < 0) {
+        return;
+    }
 
     /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
+    memcpy(cmd->cbw, message, USB_SIZEOF_MSC_CBW);
+
+    usbh_msc_bot_xfer(cmd, NULL, MSC_INQUIRY_TIMEOUT);
+}
 
-    memcpy(g_msc_buf[msc_class->sdchar - 'a'], message, 31);
+static int usbh_msc_lun_probe(struct usbh_msc *msc_class)
+{
+    int ret;
 
-    usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], NULL, MSC_INQUIRY_TIMEOUT);
+    ret = usbh_msc_scsi_testunitready(msc_class);
+    if (ret < 0) {
+        ret = usbh_msc_scsi_requestsense(msc_class);
+        if (ret < 0) {
+            USB_LOG_ERR("Fail to scsi_testunitready\r\n");
+            return ret;
+        }
+    }
+
+    ret = usbh_msc_scsi_inquiry(msc_class);
+    if (ret < 0) {
+        USB_LOG_ERR("Fail to scsi_inquiry\r\n");
+        return ret;
+    }
+    ret = usbh_msc_scsi_readcapacity10(msc_class);
+    if (ret < 0) {
+        USB_LOG_ERR("Fail to scsi_readcapacity10\r\n");
+        return ret;
+    }
+
+    if (msc_class->blocknum > 0xFFFFFFFFULL) {
+        ret = usbh_msc_scsi_readcapacity16(msc_class);
+        if (ret < 0) {
+            USB_LOG_ERR("Fail to scsi_readcapacity16\r\n");
+            return ret;
+        }
+        msc_class->use_cmd16 = true;
+    }
+
+    if (msc_class->blocksize > 0) {
+        USB_LOG_INFO("Capacity info:\r\n");
+        USB_LOG_INFO("Block num:%u%s,block size:%d,%u MB\r\n", (unsigned int)msc_class->blocknum, msc_class->use_cmd16 ? "(64 bit)" : "",
+                     (unsigned int)msc_class->blocksize, (unsigned int)((msc_class->blocknum * msc_class->blocksize) >> 20));
+    } else {
+        USB_LOG_ERR("Invalid block size\r\n");
+        return -USB_ERR_RANGE;
+    }
+    return 0;
 }
 
 static int usbh_msc_connect(struct usbh_hubport *hport, uint8_t intf)
@@ -264,6 +616,9 @@ static int usbh_msc_connect(struct usbh_hubport *hport, uint8_t intf)
     struct usb_endpoint_descriptor *ep_desc;
     int ret;
     struct usbh_msc_modeswitch_config *config;
+    struct usbh_msc_bot *bot;
+    struct usbh_msc *lun_class[CONFIG_USBHOST_MAX_MSC_CLASS];
+    uint8_t lun_num;
 
     struct usbh_msc *msc_class = usbh_msc_class_alloc();
     if (msc_class == NULL) {
@@ -283,14 +638,26 @@ static int usbh_msc_connect(struct usbh_hubport *hport, uint8_t intf)
 
     USB_LOG_INFO("Get max LUN:%u\r\n", g_msc_buf[msc_class->sdchar - 'a'][0] + 1);
 
+    bot = &g_msc_bot[msc_class->sdchar - 'a'];
+    memset(bot, 0, sizeof(struct usbh_msc_bot));
+    bot->hport = hport;
+    bot->max_lun = g_msc_buf[msc_class->sdchar - 'a'][0];
+    usb_slist_init(&bot->queue);
+
     for (uint8_t i = 0; i < hport->config.intf[intf].altsetting[0].intf_desc.bNumEndpoints; i++) {
         ep_desc = &hport->config.intf[intf].altsetting[0].ep[i].ep_desc;
         if (ep_desc->bEndpointAddress & 0x80) {
-            USBH_EP_INIT(msc_class->bulkin, ep_desc);
+            USBH_EP_INIT(bot->bulkin, ep_desc);
         } else {
-            USBH_EP_INIT(msc_class->bulkout, ep_desc);
+            USBH_EP_INIT(bot->bulkout, ep_desc);
         }
     }
+    bot->connected = true;
+
+    ret = usbh_msc_lun_init(msc_class, bot, 0);
+    if (ret < 0) {
+        return ret;
+    }
 
     if (g_msc_modeswitch_config) {
         uint8_t num = 0;
@@ -310,55 +677,77 @@ static int usbh_msc_connect(struct usbh_hubport *hport, uint8_t intf)
         }
     }
 
-    ret = usbh_msc_scsi_testunitready(msc_class);
+    ret = usbh_msc_lun_probe(msc_class);
     if (ret < 0) {
-        ret = usbh_msc_scsi_requestsense(msc_class);
-        if (ret < 0) {
-            USB_LOG_ERR("Fail to scsi_testunitready\r\n");
-            return ret;
-        }
-    }
-
-    ret = usbh_msc_scsi_inquiry(msc_class);
-    if (ret < 0) {
-        USB_LOG_ERR("Fail to scsi_inquiry\r\n");
         return ret;
     }
-    ret = usbh_msc_scsi_readcapacity10(msc_class);
-    if (ret < 0) {
-        USB_LOG_ERR("Fail to scsi_readcapacity10\r\n");
-        return ret;
-    }
-
-    if (msc_class->blocksize > 0) {
-        USB_LOG_INFO("Capacity info:\r\n");
-        USB_LOG_INFO("Block num:%d,block size:%d\r\n", (unsigned int)msc_class->blocknum, (unsigned int)msc_class->blocksize);
-    } else {
-        USB_LOG_ERR("Invalid block size\r\n");
-        return -USB_ERR_RANGE;
-    }
 
     snprintf(hport->config.intf[intf].devname, CONFIG_USBHOST_DEV_NAMELEN, DEV_FORMAT, msc_class->sdchar);
 
     USB_LOG_INFO("Register MSC Class:%s\r\n", hport->config.intf[intf].devname);
 
-    usbh_msc_run(msc_class);
-    return ret;
+    /* other luns take free class slots, they share the bot with lun 0 */
+    lun_class[0] = msc_class;
+    lun_num = 1;
+    for (uint8_t lun = 1; lun <= bot->max_lun && lun_num < CONFIG_USBHOST_MAX_MSC_CLASS; lun++) {
+        struct usbh_msc *lun_msc = usbh_msc_class_alloc();
+
+        if (lun_msc == NULL) {
+            break;
+        }
+        lun_msc->intf = intf;
+
+        ret = usbh_msc_lun_init(lun_msc, bot, lun);
+        if (ret == 0) {
+            ret = usbh_msc_lun_probe(lun_msc);
+        }
+        if (ret < 0) {
+            USB_LOG_WRN("Skip lun %u\r\n", lun);
+            usbh_msc_lun_deinit(lun_msc);
+            usbh_msc_class_free(lun_msc);
+            continue;
+        }
+
+        USB_LOG_INFO("Register MSC Class:" DEV_FORMAT " (lun %u)\r\n", lun_msc->sdchar, lun);
+        lun_class[lun_num++] = lun_msc;
+    }
+
+    for (uint8_t i = 0; i < lun_num; i++) {
+        usbh_msc_run(lun_class[i]);
+    }
+    return 0;
 }
 
 static int usbh_msc_disconnect(struct usbh_hubport *hport, uint8_t intf)
 {
     int ret = 0;
+    size_t flags;
+    struct usbh_msc_bot *bot;
+    struct usbh_msc_cmd *cmd;
 
     struct usbh_msc *msc_class = (struct usbh_msc *)hport->config.intf[intf].priv;
 
     if (msc_class) {
-        if (msc_class->bulkin) {
-            usbh_kill_urb(&msc_class->bulkin_urb);
-        }
+        bot = msc_class->bot;
+        if (bot) {
+            flags = usb_osal_enter_critical_section();
+            bot->connected = false;
+            usbh_msc_bot_abort(bot, -USB_ERR_SHUTDOWN);
+            while ((cmd = usbh_msc_bot_pop(bot)) != NULL) {
+                usbh_msc_bot_done(cmd, -USB_ERR_SHUTDOWN);
+            }
+            usb_osal_leave_critical_section(flags);
 
-        if (msc_class->bulkout) {
-            usbh_kill_urb(&msc_class->bulkout_urb);
+            for (uint8_t devno = 0; devno < CONFIG_USBHOST_MAX_MSC_CLASS; devno++) {
+                struct usbh_msc *lun_msc = &g_msc_class[devno];
+
+                if ((g_devinuse & (1 << devno)) && (lun_msc != msc_class) && (lun_msc->bot == bot)) {
+                    USB_LOG_INFO("Unregister MSC Class:" DEV_FORMAT " (lun %u)\r\n", lun_msc->sdchar, lun_msc->lun);
+                    usbh_msc_stop(lun_msc);
+                    usbh_msc_lun_deinit(lun_msc);
+                    usbh_msc_class_free(lun_msc);
+                }
+            }
         }
 
         if (hport->config.intf[intf].devname[0] != '\0') {
@@ -366,50 +755,65 @@ static int usbh_msc_disconnect(struct usbh_hubport *hport, uint8_t intf)
             usbh_msc_stop(msc_class);
         }
 
+        usbh_msc_lun_deinit(msc_class);
         usbh_msc_class_free(msc_class);
     }
 
     return ret;
 }
 
-
-int usbh_msc_scsi_write10(struct usbh_msc *msc_class, uint32_t start_sector, const uint8_t *buffer, uint32_t nsectors)
+static int usbh_msc_scsi_rw(struct usbh_msc *msc_class, uint64_t start_sector, const uint8_t *buffer, uint32_t nsectors, bool is_write, bool cmd16)
 {
-    struct CBW *cbw;
+    struct usbh_msc_cmd *cmd;
+    int ret;
 
-    /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
+    if (!msc_class || !msc_class->bot) {
+        return -USB_ERR_INVAL;
+    }
+
+    ret = usbh_msc_cmd_alloc(msc_class, &cmd);
+    if (ret < 0) {
+        return ret;
+    }
 
-    cbw->dDataLength = (msc_class->blocksize * nsectors);
-    cbw->bCBLength = SCSICMD_WRITE10_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_WRITE10;
+    /* Construct the CBW */
+    cmd->cbw->dDataLength = (msc_class->blocksize * nsectors);
+    cmd->cbw->bmFlags = is_write ? 0x00 : 0x80;
+
+    if (cmd16 || msc_class->use_cmd16 || (start_sector + nsectors) > 0xFFFFFFFFULL || nsectors > 0xFFFF) {
+        cmd->cbw->bCBLength = is_write ? SCSICMD_WRITE16_SIZEOF : SCSICMD_READ16_SIZEOF;
+        cmd->cbw->CB[0] = is_write ? SCSI_CMD_WRITE16 : SCSI_CMD_READ16;
+        SET_BE32(&cmd->cbw->CB[2], (uint32_t)(start_sector >> 32));
+        SET_BE32(&cmd->cbw->CB[6], (uint32_t)start_sector);
+        SET_BE32(&cmd->cbw->CB[10], nsectors);
+    } else {
+        cmd->cbw->bCBLength = is_write ? SCSICMD_WRITE10_SIZEOF : SCSICMD_READ10_SIZEOF;
+        cmd->cbw->CB[0] = is_write ? SCSI_CMD_WRITE10 : SCSI_CMD_READ10;
+        SET_BE32(&cmd->cbw->CB[2], (uint32_t)start_sector);
+        SET_BE16(&cmd->cbw->CB[7], nsectors);
+    }
 
-    SET_BE32(&cbw->CB[2], start_sector);
-    SET_BE16(&cbw->CB[7], nsectors);
+    return usbh_msc_bot_xfer(cmd, (uint8_t *)buffer, CONFIG_USBHOST_MSC_TIMEOUT);
+}
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], (uint8_t *)buffer, CONFIG_USBHOST_MSC_TIMEOUT);
+int usbh_msc_scsi_write10(struct usbh_msc *msc_class, uint32_t start_sector, const uint8_t *buffer, uint32_t nsectors)
+{
+    return usbh_msc_scsi_rw(msc_class, start_sector, buffer, nsectors, true, false);
 }
 
 int usbh_msc_scsi_read10(struct usbh_msc *msc_class, uint32_t start_sector, const uint8_t *buffer, uint32_t nsectors)
 {
-    struct CBW *cbw;
-
-    /* Construct the CBW */
-    cbw = (struct CBW *)g_msc_buf[msc_class->sdchar - 'a'];
-    memset(cbw, 0, USB_SIZEOF_MSC_CBW);
-    cbw->dSignature = MSC_CBW_Signature;
-
-    cbw->dDataLength = (msc_class->blocksize * nsectors);
-    cbw->bmFlags = 0x80;
-    cbw->bCBLength = SCSICMD_READ10_SIZEOF;
-    cbw->CB[0] = SCSI_CMD_READ10;
+    return usbh_msc_scsi_rw(msc_class, start_sector, buffer, nsectors, false, false);
+}
 
-    SET_BE32(&cbw->CB[2], start_sector);
-    SET_BE16(&cbw->CB[7], nsectors);
+int usbh_msc_scsi_write16(struct usbh_msc *msc_class, uint64_t start_sector, const uint8_t *buffer, uint32_t nsectors)
+{
+    return usbh_msc_scsi_rw(msc_class, start_sector, buffer, nsectors, true, true);
+}
 
-    return usbh_bulk_cbw_csw_xfer(msc_class, cbw, (struct CSW *)g_msc_buf[msc_class->sdchar - 'a'], (uint8_t *)buffer, CONFIG_USBHOST_MSC_TIMEOUT);
+int usbh_msc_scsi_read16(struct usbh_msc *msc_class, uint64_t start_sector, const uint8_t *buffer, uint32_t nsectors)
+{
+    return usbh_msc_scsi_rw(msc_class, start_sector, buffer, nsectors, false, true);
 }
 
 void usbh_msc_modeswitch_enable(struct usbh_msc_modeswitch_config *config)
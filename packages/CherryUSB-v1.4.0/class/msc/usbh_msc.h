@@ -9,18 +9,61 @@
 #include "usb_msc.h"
 #include "usb_scsi.h"
 
+/* Commands one lun can have queued in the bot engine, each one holds a cbw and a csw buffer */
+#ifndef CONFIG_USBHOST_MSC_QUEUE_DEPTH
+#define CONFIG_USBHOST_MSC_QUEUE_DEPTH 2
+#endif
+
+struct usbh_msc;
+
+struct usbh_msc_cmd {
+    usb_slist_t list;
+    struct usbh_msc *msc_class;
+    struct CBW *cbw;
+    struct CSW *csw;
+    uint8_t *buffer;
+    usb_osal_sem_t waitsem;
+    volatile int result;
+    volatile bool cbw_done; /* cbw is on the device */
+    bool inuse;
+};
+
+/* Bulk only transport of one interface, shared by all luns of it */
+struct usbh_msc_bot {
+    struct usbh_hubport *hport;
+    struct usb_endpoint_descriptor *bulkin;  /* Bulk IN endpoint */
+    struct usb_endpoint_descriptor *bulkout; /* Bulk OUT endpoint */
+    struct usbh_urb bulkin_urb;              /* Bulk IN urb, data in and csw */
+    struct usbh_urb bulkout_urb;             /* Bulk OUT urb, cbw and data out */
+
+    usb_slist_t queue;           /* commands waiting for cbw */
+    struct usbh_msc_cmd *active; /* command in data or csw stage */
+    struct usbh_msc_cmd *next;   /* cbw sent ahead while active waits for csw */
+    uint32_t tag;
+    uint8_t max_lun;
+    bool connected;
+};
+
 struct usbh_msc {
     struct usbh_hubport *hport;
     struct usb_endpoint_descriptor *bulkin;  /* Bulk IN endpoint */
     struct usb_endpoint_descriptor *bulkout; /* Bulk OUT endpoint */
-    struct usbh_urb bulkin_urb;              /* Bulk IN urb */
-    struct usbh_urb bulkout_urb;             /* Bulk OUT urb */
+    struct usbh_msc_bot *bot;
+
+    struct usbh_msc_cmd cmd[CONFIG_USBHOST_MSC_QUEUE_DEPTH];
+    usb_osal_sem_t cmd_sem; /* free command slots */
 
     uint8_t intf; /* Data interface number */
+    uint8_t lun;
     uint8_t sdchar;
-    uint32_t blocknum;  /* Number of blocks on the USB mass storage device */
+    bool use_cmd16;     /* capacity needs READ(16)/WRITE(16) */
+    uint64_t blocknum;  /* Number of blocks on the USB mass storage device */
     uint16_t blocksize; /* Block size of USB mass storage device */
 
+    uint32_t queue_depth;     /* commands queued or in flight */
+    uint32_t max_queue_depth; /* peak of queue_depth */
+    uint32_t cmd_count;       /* commands completed */
+
     void *user_data;
 };
 
@@ -34,6 +77,8 @@ struct usbh_msc_modeswitch_config {
 void usbh_msc_modeswitch_enable(struct usbh_msc_modeswitch_config *config);
 int usbh_msc_scsi_write10(struct usbh_msc *msc_class, uint32_t start_sector, const uint8_t *buffer, uint32_t nsectors);
 int usbh_msc_scsi_read10(struct usbh_msc *msc_class, uint32_t start_sector, const uint8_t *buffer, uint32_t nsectors);
+int usbh_msc_scsi_write16(struct usbh_msc *msc_class, uint64_t start_sector, const uint8_t *buffer, uint32_t nsectors);
+int usbh_msc_scsi_read16(struct usbh_msc *msc_class, uint64_t start_sector, const uint8_t *buffer, uint32_t nsectors);
 
 void usbh_msc_run(struct usbh_msc *msc_class);
 void usbh_msc_stop(struct usbh_msc *msc_class);
@@ -696,6 +696,15 @@
 #define VIDEO_SET_CUR_EU_ERROR_RESILIENCY_CONTROL    0x0194U
 #endif
 
+/* bmHeaderInfo bits of the payload header */
+#define VIDEO_PAYLOAD_HEADER_FID (1 << 0)
+#define VIDEO_PAYLOAD_HEADER_EOF (1 << 1)
+#define VIDEO_PAYLOAD_HEADER_PTS (1 << 2)
+#define VIDEO_PAYLOAD_HEADER_SCR (1 << 3)
+#define VIDEO_PAYLOAD_HEADER_STI (1 << 5)
+#define VIDEO_PAYLOAD_HEADER_ERR (1 << 6)
+#define VIDEO_PAYLOAD_HEADER_EOH (1 << 7)
+
 /*! @brief The payload header structure. */
 struct video_payload_header {
     uint8_t bHeaderLength; /*!< The payload header length. */
@@ -12,12 +12,27 @@ struct video_entity_info {
     uint16_t wTerminalType;
 };
 
+/* payloads of the frame in flight, cut straight from the caller's frame */
+struct usbd_video_stream {
+    const uint8_t *frame;
+    uint32_t frame_len;
+    uint32_t offset;
+    uint32_t pts;
+    uint32_t scr_stc;
+    uint16_t scr_sof;
+    uint8_t flags;
+    uint8_t fid;
+    bool frame_done;
+    uint8_t header[sizeof(struct video_payload_header)];
+};
+
 struct usbd_video_priv {
     struct video_probe_and_commit_controls probe;
     struct video_probe_and_commit_controls commit;
     uint8_t power_mode;
     uint8_t error_code;
     struct video_entity_info info[3];
+    struct usbd_video_stream stream;
 } g_usbd_video[CONFIG_USBDEV_MAX_BUS];
 
 static int usbd_video_control_request_handler(uint8_t busid, struct usb_setup_packet *setup, uint8_t **data, uint32_t *len)
@@ -760,31 +775,116 @@ struct usbd_interface *usbd_video_init_intf(uint8_t busid, struct usbd_interface
     g_usbd_video[busid].info[2].wTerminalType = 0x00;
 
     usbd_video_probe_and_commit_controls_init(busid, dwFrameInterval, dwMaxVideoFrameSize, dwMaxPayloadTransferSize);
+    usbd_video_stream_start(busid, 0, 0);
     return intf;
 }
 
+void usbd_video_stream_start(uint8_t busid, uint8_t flags, uint32_t dwClockFrequency)
+{
+    struct usbd_video_stream *stream = &g_usbd_video[busid].stream;
+
+    memset(stream, 0, sizeof(struct usbd_video_stream));
+    stream->flags = flags & (VIDEO_PAYLOAD_HEADER_PTS | VIDEO_PAYLOAD_HEADER_SCR);
+    stream->fid = VIDEO_PAYLOAD_HEADER_FID; /* toggled by the first frame */
+    stream->frame_done = true;
+
+    g_usbd_video[busid].probe.dwClockFrequency = dwClockFrequency;
+    g_usbd_video[busid].commit.dwClockFrequency = dwClockFrequency;
+}
+
+void usbd_video_stream_frame(uint8_t busid, const uint8_t *frame, uint32_t frame_len, uint32_t pts)
+{
+    struct usbd_video_stream *stream = &g_usbd_video[busid].stream;
+
+    stream->frame = frame;
+    stream->frame_len = frame_len;
+    stream->offset = 0;
+    stream->pts = pts;
+    stream->fid ^= VIDEO_PAYLOAD_HEADER_FID;
+    stream->frame_done = false;
+}
+
+void usbd_video_stream_scr(uint8_t busid, uint32_t stc, uint16_t sof)
+{
+    g_usbd_video[busid].stream.scr_stc = stc;
+    g_usbd_video[busid].stream.scr_sof = sof & 0x7ff;
+}
+
+/* Cuts the next payload of the frame, returns header + data length or 0 when the frame is done.
+ * A frame always gives at least one payload, the last one carries EOF.
+ */
+uint32_t usbd_video_stream_next(uint8_t busid, struct usbd_video_payload *payload)
+{
+    struct usbd_video_stream *stream = &g_usbd_video[busid].stream;
+    uint32_t max_data_len;
+    uint32_t data_len;
+    uint8_t header_len = 2;
+    uint8_t *header = stream->header;
+
+    if (stream->frame_done) {
+        return 0;
+    }
+
+    header[1] = VIDEO_PAYLOAD_HEADER_EOH | stream->fid | stream->flags;
+    if (stream->flags & VIDEO_PAYLOAD_HEADER_PTS) {
+        header[header_len++] = (uint8_t)stream->pts;
+        header[header_len++] = (uint8_t)(stream->pts >> 8);
+        header[header_len++] = (uint8_t)(stream->pts >> 16);
+        header[header_len++] = (uint8_t)(stream->pts >> 24);
+    }
+    if (stream->flags & VIDEO_PAYLOAD_HEADER_SCR) {
+        header[header_len++] = (uint8_t)stream->scr_stc;
+        header[header_len++] = (uint8_t)(stream->scr_stc >> 8);
+        header[header_len++] = (uint8_t)(stream->scr_stc >> 16);
+        header[header_len++] = (uint8_t)(stream->scr_stc >> 24);
+        header[header_len++] = (uint8_t)stream->scr_sof;
+        header[header_len++] = (uint8_t)(stream->scr_sof >> 8);
+    }
+    header[0] = header_len;
+
+    USB_ASSERT(g_usbd_video[busid].probe.dwMaxPayloadTransferSize > header_len);
+    max_data_len = g_usbd_video[busid].probe.dwMaxPayloadTransferSize - header_len;
+    data_len = stream->frame_len - stream->offset;
+    if (data_len > max_data_len) {
+        data_len = max_data_len;
+    } else {
+        header[1] |= VIDEO_PAYLOAD_HEADER_EOF;
+        stream->frame_done = true;
+    }
+
+    payload->header = header;
+    payload->header_len = header_len;
+    payload->data = &stream->frame[stream->offset];
+    payload->data_len = data_len;
+    stream->offset += data_len;
+
+    return header_len + data_len;
+}
+
+/* The next payload copied into output, which holds dwMaxPayloadTransferSize bytes */
+uint32_t usbd_video_stream_fill(uint8_t busid, uint8_t *output)
+{
+    struct usbd_video_payload payload;
+    uint32_t len;
+
+    len = usbd_video_stream_next(busid, &payload);
+    if (len) {
+        memcpy(output, payload.header, payload.header_len);
+        memcpy(&output[payload.header_len], payload.data, payload.data_len);
+    }
+    return len;
+}
+
 uint32_t usbd_video_payload_fill(uint8_t busid, uint8_t *input, uint32_t input_len, uint8_t *output, uint32_t *out_len)
 {
-    uint32_t packets;
-    uint32_t last_packet_size;
-    uint32_t picture_pos = 0;
-    static uint8_t uvc_header[2] = { 0x02, 0x80 };
-
-    packets = (input_len + (g_usbd_video[busid].probe.dwMaxPayloadTransferSize - 2) ) / (g_usbd_video[busid].probe.dwMaxPayloadTransferSize - 2);
-    last_packet_size = input_len - ((packets - 1) * (g_usbd_video[busid].probe.dwMaxPayloadTransferSize - 2));
-
-    for (size_t i = 0; i < packets; i++) {
-        output[g_usbd_video[busid].probe.dwMaxPayloadTransferSize * i] = uvc_header[0];
-        output[g_usbd_video[busid].probe.dwMaxPayloadTransferSize * i + 1] = uvc_header[1];
-        if (i == (packets - 1)) {
-            memcpy(&output[2 + g_usbd_video[busid].probe.dwMaxPayloadTransferSize * i], &input[picture_pos], last_packet_size);
-            output[g_usbd_video[busid].probe.dwMaxPayloadTransferSize * i + 1] |= (1 << 1);
-        } else {
-            memcpy(&output[2 + g_usbd_video[busid].probe.dwMaxPayloadTransferSize * i], &input[picture_pos], g_usbd_video[busid].probe.dwMaxPayloadTransferSize - 2);
-            picture_pos += g_usbd_video[busid].probe.dwMaxPayloadTransferSize - 2;
-        }
+    uint32_t packets = 0;
+    uint32_t len;
+
+    *out_len = 0;
+    usbd_video_stream_frame(busid, input, input_len, g_usbd_video[busid].stream.pts);
+    while ((len = usbd_video_stream_fill(busid, &output[g_usbd_video[busid].probe.dwMaxPayloadTransferSize * packets])) > 0) {
+        *out_len += len;
+        packets++;
     }
-    uvc_header[1] ^= 1;
-    *out_len = (input_len + 2 * packets);
     return packets;
-}
\ No newline at end of file
+}
@@ -12,6 +12,14 @@
 extern "C" {
 #endif
 
+/* One payload of a frame: the header lives in the class until the next call, data points into the frame */
+struct usbd_video_payload {
+    const uint8_t *header;
+    uint32_t header_len;
+    const uint8_t *data;
+    uint32_t data_len;
+};
+
 /* Init video interface driver */
 struct usbd_interface *usbd_video_init_intf(uint8_t busid, struct usbd_interface *intf,
                                             uint32_t dwFrameInterval,
@@ -22,6 +30,13 @@ void usbd_video_open(uint8_t busid, uint8_t intf);
 void usbd_video_close(uint8_t busid, uint8_t intf);
 uint32_t usbd_video_payload_fill(uint8_t busid, uint8_t *input, uint32_t input_len, uint8_t *output, uint32_t *out_len);
 
+/* Payload packer, flags are VIDEO_PAYLOAD_HEADER_PTS and/or VIDEO_PAYLOAD_HEADER_SCR in dwClockFrequency units */
+void usbd_video_stream_start(uint8_t busid, uint8_t flags, uint32_t dwClockFrequency);
+void usbd_video_stream_frame(uint8_t busid, const uint8_t *frame, uint32_t frame_len, uint32_t pts);
+void usbd_video_stream_scr(uint8_t busid, uint32_t stc, uint16_t sof);
+uint32_t usbd_video_stream_next(uint8_t busid, struct usbd_video_payload *payload);
+uint32_t usbd_video_stream_fill(uint8_t busid, uint8_t *output);
+
 #ifdef __cplusplus
 }
 #endif
@@ -6,6 +6,11 @@
 #include "usbd_core.h"
 #include "usbd_rndis.h"
 #include "rndis_protocol.h"
+#include "usb_osal.h"
+#ifdef CONFIG_USBDEV_RNDIS_USING_LWIP
+#include <lwip/pbuf.h>
+#include <lwip/memp.h>
+#endif
 
 #define RNDIS_OUT_EP_IDX 0
 #define RNDIS_IN_EP_IDX  1
@@ -17,6 +22,18 @@ static struct usbd_endpoint rndis_ep_data[3];
 #define RNDIS_INQUIRY_PUT(src, len)   (memcpy(infomation_buffer, src, len))
 #define RNDIS_INQUIRY_PUT_LE32(value) (*(uint32_t *)infomation_buffer = (value))
 
+#ifndef CONFIG_USBDEV_RNDIS_RX_RING_DEPTH
+#define CONFIG_USBDEV_RNDIS_RX_RING_DEPTH 3
+#endif
+
+#ifndef CONFIG_USBDEV_RNDIS_RX_PBUF_NUM
+#define CONFIG_USBDEV_RNDIS_RX_PBUF_NUM 8
+#endif
+
+/* messages the host packs into one transfer start on 1 << RNDIS_PACKET_ALIGN, the device pads its own the same */
+#define RNDIS_PACKET_ALIGN 2
+#define RNDIS_MSG_ALIGN(len) (((len) + (1 << RNDIS_PACKET_ALIGN) - 1) & ~((1 << RNDIS_PACKET_ALIGN) - 1))
+
 /* Device data structure */
 struct usbd_rndis_priv {
     uint32_t drv_version;
@@ -25,6 +42,30 @@ struct usbd_rndis_priv {
     usb_eth_stat_t eth_state;
     rndis_state_t init_state;
     uint8_t mac[6];
+    uint32_t host_max_transfer_size;
+
+    /*
+     * Rx slots. Any free slot is armed on bulk out, received slots are parsed in the order they were
+     * filled. A slot is owned from arming until its last message is parsed, and lent while lwip holds
+     * frames in it. It is free when neither.
+     */
+    uint32_t rx_len[CONFIG_USBDEV_RNDIS_RX_RING_DEPTH];
+    uint8_t rx_lent[CONFIG_USBDEV_RNDIS_RX_RING_DEPTH];
+    bool rx_own[CONFIG_USBDEV_RNDIS_RX_RING_DEPTH];
+    uint8_t rx_order[CONFIG_USBDEV_RNDIS_RX_RING_DEPTH]; /* received slots in fill order */
+    uint32_t rx_offset;  /* next message in slot rx_order[rx_read] */
+    uint8_t rx_arm;      /* slot on bulk out */
+    uint8_t rx_read;     /* oldest received slot in rx_order */
+    uint8_t rx_filled;   /* received slots not parsed to the end */
+    bool rx_stalled;     /* bulk out waits for a free slot */
+
+    /* Tx, frames are packed into tx buffer tx_fill while the other one is on bulk in */
+    uint32_t tx_len[2];
+    uint8_t tx_fill;
+    bool tx_busy;
+    bool tx_filling;
+
+    struct usbd_rndis_stat stat;
 } g_usbd_rndis;
 
 #if CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE < 140
@@ -37,16 +78,12 @@ struct usbd_rndis_priv {
 #define CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE 1580
 #endif
 
-static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE];
-static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_tx_buffer[CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE];
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBDEV_RNDIS_RX_RING_DEPTH][CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE];
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_tx_buffer[2][CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE];
 
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t rndis_encapsulated_resp_buffer[CONFIG_USBDEV_RNDIS_RESP_BUFFER_SIZE];
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t NOTIFY_RESPONSE_AVAILABLE[8];
 
-volatile uint8_t *g_rndis_rx_data_buffer;
-volatile uint32_t g_rndis_rx_data_length;
-volatile uint32_t g_rndis_tx_data_length;
-
 /* RNDIS options list */
 const uint32_t oid_supported_list[] = {
     /* General OIDs */
@@ -167,10 +204,11 @@ static int rndis_init_cmd_handler(uint8_t *data, uint32_t len)
     resp->Medium = RNDIS_MEDIUM_802_3;
     resp->MaxPacketsPerTransfer = CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE / 1580;
     resp->MaxTransferSize = CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE;
-    resp->PacketAlignmentFactor = 0;
+    resp->PacketAlignmentFactor = RNDIS_PACKET_ALIGN;
     resp->AfListOffset = 0;
     resp->AfListSize = 0;
 
+    g_usbd_rndis.host_max_transfer_size = cmd->MaxTransferSize;
     g_usbd_rndis.init_state = rndis_initialized;
 
     rndis_notify_rsp();
@@ -439,8 +477,46 @@ static int rndis_keepalive_cmd_handler(uint8_t *data, uint32_t len)
     return 0;
 }
 
+/* arm bulk out on any free slot, a slot lwip holds frames in does not stall the others. called locked */
+static void rndis_rx_arm(void)
+{
+    uint8_t idx;
+
+    for (idx = 0; idx < CONFIG_USBDEV_RNDIS_RX_RING_DEPTH; idx++) {
+        if (!g_usbd_rndis.rx_own[idx] && !g_usbd_rndis.rx_lent[idx]) {
+            break;
+        }
+    }
+    if (idx == CONFIG_USBDEV_RNDIS_RX_RING_DEPTH) {
+        g_usbd_rndis.rx_stalled = true;
+        return;
+    }
+
+    g_usbd_rndis.rx_stalled = false;
+    g_usbd_rndis.rx_own[idx] = true;
+    g_usbd_rndis.rx_arm = idx;
+    usbd_ep_start_read(0, rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer[idx], CONFIG_USBDEV_RNDIS_ETH_MAX_FRAME_SIZE);
+}
+
+/* send the tx buffer being filled when bulk in is idle, called locked */
+static void rndis_tx_start(void)
+{
+    uint8_t idx = g_usbd_rndis.tx_fill;
+
+    if (g_usbd_rndis.tx_busy || g_usbd_rndis.tx_filling || (g_usbd_rndis.tx_len[idx] == 0)) {
+        return;
+    }
+
+    g_usbd_rndis.tx_busy = true;
+    g_usbd_rndis.tx_fill = idx ^ 1;
+    g_usbd_rndis.stat.tx_transfers++;
+    usbd_ep_start_write(0, rndis_ep_data[RNDIS_IN_EP_IDX].ep_addr, g_rndis_tx_buffer[idx], g_usbd_rndis.tx_len[idx]);
+}
+
 static void rndis_notify_handler(uint8_t busid, uint8_t event, void *arg)
 {
+    size_t flags;
+
     (void)busid;
     (void)arg;
 
@@ -449,10 +525,18 @@ static void rndis_notify_handler(uint8_t busid, uint8_t event, void *arg)
             g_usbd_rndis.link_status = NDIS_MEDIA_STATE_DISCONNECTED;
             break;
         case USBD_EVENT_CONFIGURED:
-            g_rndis_rx_data_length = 0;
-            g_rndis_tx_data_length = 0;
+            flags = usb_osal_enter_critical_section();
+            /* slots lent to lwip stay lent until their pbufs are freed */
+            memset(g_usbd_rndis.rx_own, 0, sizeof(g_usbd_rndis.rx_own));
+            g_usbd_rndis.rx_offset = 0;
+            g_usbd_rndis.rx_read = 0;
+            g_usbd_rndis.rx_filled = 0;
+            g_usbd_rndis.tx_len[0] = 0;
+            g_usbd_rndis.tx_len[1] = 0;
+            g_usbd_rndis.tx_busy = false;
             g_usbd_rndis.link_status = NDIS_MEDIA_STATE_CONNECTED;
-            usbd_ep_start_read(0, rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
+            rndis_rx_arm();
+            usb_osal_leave_critical_section(flags);
             break;
 
         default:
@@ -462,21 +546,17 @@ static void rndis_notify_handler(uint8_t busid, uint8_t event, void *arg)
 
 void rndis_bulk_out(uint8_t busid, uint8_t ep, uint32_t nbytes)
 {
-    rndis_data_packet_t *hdr;
+    uint8_t idx = g_usbd_rndis.rx_arm;
 
     (void)busid;
     (void)ep;
 
-    hdr = (rndis_data_packet_t *)g_rndis_rx_buffer;
-    g_rndis_rx_data_buffer = g_rndis_rx_buffer;
-    if ((hdr->MessageType != REMOTE_NDIS_PACKET_MSG) || (nbytes < hdr->MessageLength)) {
-        usbd_ep_start_read(0, rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
-        return;
-    }
-
-    /* Point to the payload and update the message length */
-    g_rndis_rx_data_buffer += hdr->DataOffset + sizeof(rndis_generic_msg_t);
-    g_rndis_rx_data_length = hdr->DataLength;
+    /* keep the slot for parsing after the ones filled before, and go on receiving into a free one */
+    g_usbd_rndis.rx_len[idx] = nbytes;
+    g_usbd_rndis.rx_order[(g_usbd_rndis.rx_read + g_usbd_rndis.rx_filled) % CONFIG_USBDEV_RNDIS_RX_RING_DEPTH] = idx;
+    g_usbd_rndis.rx_filled++;
+    g_usbd_rndis.stat.rx_transfers++;
+    rndis_rx_arm();
 
     usbd_rndis_data_recv_done();
 }
@@ -489,7 +569,9 @@ void rndis_bulk_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
         /* send zlp */
         usbd_ep_start_write(0, ep, NULL, 0);
     } else {
-        g_rndis_tx_data_length = 0;
+        g_usbd_rndis.tx_busy = false;
+        g_usbd_rndis.tx_len[g_usbd_rndis.tx_fill ^ 1] = 0;
+        rndis_tx_start();
     }
 }
 
@@ -502,66 +584,195 @@ void rndis_int_in(uint8_t busid, uint8_t ep, uint32_t nbytes)
     //USB_LOG_DBG("len:%d\r\n", nbytes);
 }
 
+void usbd_rndis_get_stat(struct usbd_rndis_stat *stat, bool clear)
+{
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    memcpy(stat, &g_usbd_rndis.stat, sizeof(struct usbd_rndis_stat));
+    if (clear) {
+        memset(&g_usbd_rndis.stat, 0, sizeof(struct usbd_rndis_stat));
+    }
+    usb_osal_leave_critical_section(flags);
+}
+
 #ifdef CONFIG_USBDEV_RNDIS_USING_LWIP
-#include <lwip/pbuf.h>
+#if LWIP_SUPPORT_CUSTOM_PBUF
+struct usbd_rndis_rx_pbuf {
+    struct pbuf_custom p;
+    uint8_t slot;
+};
 
-struct pbuf *usbd_rndis_eth_rx(void)
+LWIP_MEMPOOL_DECLARE(USBD_RNDIS_RX_PBUF, CONFIG_USBDEV_RNDIS_RX_PBUF_NUM, sizeof(struct usbd_rndis_rx_pbuf), "usbd rndis rx pbuf");
+
+static void usbd_rndis_rx_pbuf_free(struct pbuf *p)
 {
-    struct pbuf *p;
+    struct usbd_rndis_rx_pbuf *rx_pbuf = (struct usbd_rndis_rx_pbuf *)p;
+    size_t flags;
 
-    if (g_rndis_rx_data_length == 0) {
-        return NULL;
+    flags = usb_osal_enter_critical_section();
+    g_usbd_rndis.rx_lent[rx_pbuf->slot]--;
+    if (g_usbd_rndis.rx_stalled) {
+        rndis_rx_arm();
     }
-    p = pbuf_alloc(PBUF_RAW, g_rndis_rx_data_length, PBUF_POOL);
-    if (p == NULL) {
-        return NULL;
+    usb_osal_leave_critical_section(flags);
+
+    LWIP_MEMPOOL_FREE(USBD_RNDIS_RX_PBUF, rx_pbuf);
+}
+#endif
+
+/* lend the slot when another one is free for bulk out, so lwip holding frames never stalls rx. called locked */
+static bool rndis_rx_lend(uint8_t idx)
+{
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    for (uint8_t i = 0; i < CONFIG_USBDEV_RNDIS_RX_RING_DEPTH; i++) {
+        if ((i != idx) && !g_usbd_rndis.rx_own[i] && !g_usbd_rndis.rx_lent[i]) {
+            g_usbd_rndis.rx_lent[idx]++;
+            return true;
+        }
     }
-    usb_memcpy(p->payload, (uint8_t *)g_rndis_rx_data_buffer, g_rndis_rx_data_length);
-    p->len = g_rndis_rx_data_length;
+#else
+    (void)idx;
+#endif
+    return false;
+}
 
-    USB_LOG_DBG("rxlen:%d\r\n", g_rndis_rx_data_length);
-    g_rndis_rx_data_length = 0;
-    usbd_ep_start_read(0, rndis_ep_data[RNDIS_OUT_EP_IDX].ep_addr, g_rndis_rx_buffer, sizeof(g_rndis_rx_buffer));
+static struct pbuf *rndis_rx_pbuf(uint8_t idx, uint8_t *buf, uint32_t len, bool lend)
+{
+    struct pbuf *p;
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    struct usbd_rndis_rx_pbuf *rx_pbuf;
+    size_t flags;
+
+    if (lend) {
+        rx_pbuf = (struct usbd_rndis_rx_pbuf *)LWIP_MEMPOOL_ALLOC(USBD_RNDIS_RX_PBUF);
+        if (rx_pbuf) {
+            rx_pbuf->p.custom_free_function = usbd_rndis_rx_pbuf_free;
+            rx_pbuf->slot = idx;
+            return pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rx_pbuf->p, buf, len);
+        }
+
+        flags = usb_osal_enter_critical_section();
+        g_usbd_rndis.rx_lent[idx]--;
+        usb_osal_leave_critical_section(flags);
+    }
+#else
+    (void)idx;
+    (void)lend;
+#endif
 
+    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+    if (p != NULL) {
+        pbuf_take(p, buf, len);
+    }
     return p;
 }
 
+struct pbuf *usbd_rndis_eth_rx(void)
+{
+    rndis_data_packet_t *hdr;
+    struct pbuf *p;
+    uint32_t remain;
+    size_t flags;
+    uint8_t idx;
+    bool lend;
+
+    flags = usb_osal_enter_critical_section();
+    while (g_usbd_rndis.rx_filled) {
+        idx = g_usbd_rndis.rx_order[g_usbd_rndis.rx_read];
+        hdr = (rndis_data_packet_t *)&g_rndis_rx_buffer[idx][g_usbd_rndis.rx_offset];
+        remain = g_usbd_rndis.rx_len[idx] - g_usbd_rndis.rx_offset;
+
+        if ((remain >= sizeof(rndis_data_packet_t)) && (hdr->MessageType == REMOTE_NDIS_PACKET_MSG) &&
+            (hdr->MessageLength >= sizeof(rndis_data_packet_t)) && (hdr->MessageLength <= remain) &&
+            (hdr->DataOffset <= hdr->MessageLength - sizeof(rndis_generic_msg_t)) &&
+            (hdr->DataLength <= hdr->MessageLength - sizeof(rndis_generic_msg_t) - hdr->DataOffset)) {
+            g_usbd_rndis.rx_offset += hdr->MessageLength;
+            lend = rndis_rx_lend(idx);
+            usb_osal_leave_critical_section(flags);
+
+            p = rndis_rx_pbuf(idx, (uint8_t *)hdr + sizeof(rndis_generic_msg_t) + hdr->DataOffset, hdr->DataLength, lend);
+            flags = usb_osal_enter_critical_section();
+            if (p == NULL) {
+                g_usbd_rndis.stat.rx_dropped++;
+                continue;
+            }
+            g_usbd_rndis.eth_state.rxok++;
+            g_usbd_rndis.stat.rx_frames++;
+            g_usbd_rndis.stat.rx_copied += lend ? 0 : 1;
+            usb_osal_leave_critical_section(flags);
+            USB_LOG_DBG("rxlen:%d\r\n", hdr->DataLength);
+            return p;
+        }
+
+        /* end of the transfer, the host may pad it with a byte or so */
+        if (remain >= sizeof(rndis_data_packet_t)) {
+            g_usbd_rndis.eth_state.rxbad++;
+        }
+        g_usbd_rndis.rx_own[idx] = false;
+        g_usbd_rndis.rx_offset = 0;
+        g_usbd_rndis.rx_read = (g_usbd_rndis.rx_read + 1) % CONFIG_USBDEV_RNDIS_RX_RING_DEPTH;
+        g_usbd_rndis.rx_filled--;
+        if (g_usbd_rndis.rx_stalled) {
+            rndis_rx_arm();
+        }
+    }
+    usb_osal_leave_critical_section(flags);
+
+    return NULL;
+}
+
 int usbd_rndis_eth_tx(struct pbuf *p)
 {
-    struct pbuf *q;
-    uint8_t *buffer;
     rndis_data_packet_t *hdr;
+    uint32_t max_size, msg_len, offset;
+    size_t flags;
+    uint8_t idx;
 
     if (g_usbd_rndis.link_status == NDIS_MEDIA_STATE_DISCONNECTED) {
         return -USB_ERR_NOTCONN;
     }
 
-    if (g_rndis_tx_data_length > 0) {
-        return -USB_ERR_BUSY;
+    max_size = sizeof(g_rndis_tx_buffer[0]);
+    if (g_usbd_rndis.host_max_transfer_size && (g_usbd_rndis.host_max_transfer_size < max_size)) {
+        max_size = g_usbd_rndis.host_max_transfer_size;
     }
-
-    if (p->tot_len > sizeof(g_rndis_tx_buffer)) {
-        p->tot_len = sizeof(g_rndis_tx_buffer);
+    msg_len = RNDIS_MSG_ALIGN(sizeof(rndis_data_packet_t) + p->tot_len);
+    if (msg_len > max_size) {
+        g_usbd_rndis.eth_state.txbad++;
+        return -USB_ERR_INVAL;
     }
 
-    buffer = (uint8_t *)(g_rndis_tx_buffer + sizeof(rndis_data_packet_t));
-    for (q = p; q != NULL; q = q->next) {
-        usb_memcpy(buffer, q->payload, q->len);
-        buffer += q->len;
+    /* pack the frame behind those waiting for bulk in */
+    flags = usb_osal_enter_critical_section();
+    idx = g_usbd_rndis.tx_fill;
+    offset = g_usbd_rndis.tx_len[idx];
+    if (g_usbd_rndis.tx_filling || (offset + msg_len > max_size)) {
+        g_usbd_rndis.stat.tx_busy++;
+        usb_osal_leave_critical_section(flags);
+        return -USB_ERR_BUSY;
     }
+    g_usbd_rndis.tx_filling = true;
+    usb_osal_leave_critical_section(flags);
 
-    hdr = (rndis_data_packet_t *)g_rndis_tx_buffer;
-
+    hdr = (rndis_data_packet_t *)&g_rndis_tx_buffer[idx][offset];
     memset(hdr, 0, sizeof(rndis_data_packet_t));
     hdr->MessageType = REMOTE_NDIS_PACKET_MSG;
-    hdr->MessageLength = sizeof(rndis_data_packet_t) + p->tot_len;
+    hdr->MessageLength = msg_len;
     hdr->DataOffset = sizeof(rndis_data_packet_t) - sizeof(rndis_generic_msg_t);
     hdr->DataLength = p->tot_len;
+    pbuf_copy_partial(p, (uint8_t *)hdr + sizeof(rndis_data_packet_t), p->tot_len, 0);
 
-    g_rndis_tx_data_length = sizeof(rndis_data_packet_t) + p->tot_len;
+    USB_LOG_DBG("txlen:%d\r\n", p->tot_len);
+    flags = usb_osal_enter_critical_section();
+    g_usbd_rndis.tx_len[idx] = offset + msg_len;
+    g_usbd_rndis.tx_filling = false;
+    g_usbd_rndis.eth_state.txok++;
+    g_usbd_rndis.stat.tx_frames++;
+    rndis_tx_start();
+    usb_osal_leave_critical_section(flags);
 
-    USB_LOG_DBG("txlen:%d\r\n", g_rndis_tx_data_length);
-    return usbd_ep_start_write(0, rndis_ep_data[RNDIS_IN_EP_IDX].ep_addr, g_rndis_tx_buffer, g_rndis_tx_data_length);
+    return 0;
 }
 #endif
 struct usbd_interface *usbd_rndis_init_intf(struct usbd_interface *intf,
@@ -571,6 +782,15 @@ struct usbd_interface *usbd_rndis_init_intf(struct usbd_interface *intf,
 {
     memcpy(g_usbd_rndis.mac, mac, 6);
 
+#if defined(CONFIG_USBDEV_RNDIS_USING_LWIP) && LWIP_SUPPORT_CUSTOM_PBUF
+    static bool rx_pbuf_inited = false;
+
+    if (!rx_pbuf_inited) {
+        LWIP_MEMPOOL_INIT(USBD_RNDIS_RX_PBUF);
+        rx_pbuf_inited = true;
+    }
+#endif
+
     g_usbd_rndis.drv_version = 0x0001;
     g_usbd_rndis.link_status = NDIS_MEDIA_STATE_DISCONNECTED;
 
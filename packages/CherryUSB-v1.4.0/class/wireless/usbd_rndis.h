@@ -8,6 +8,17 @@
 
 #include "usb_cdc.h"
 
+/* frame and transfer counters of the data path */
+struct usbd_rndis_stat {
+    uint32_t rx_frames;
+    uint32_t rx_transfers;
+    uint32_t rx_copied;  /* frames copied into pool pbufs instead of lending the rx slot */
+    uint32_t rx_dropped; /* no pbuf for the frame */
+    uint32_t tx_frames;
+    uint32_t tx_transfers;
+    uint32_t tx_busy;    /* frames refused, both tx buffers full */
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -19,6 +30,7 @@ struct usbd_interface *usbd_rndis_init_intf(struct usbd_interface *intf,
                                              const uint8_t int_ep, uint8_t mac[6]);
 
 void usbd_rndis_data_recv_done(void);
+void usbd_rndis_get_stat(struct usbd_rndis_stat *stat, bool clear);
 
 #ifdef CONFIG_USBDEV_RNDIS_USING_LWIP
 struct pbuf *usbd_rndis_eth_rx(void);
@@ -18,11 +18,18 @@ USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_buf[4096];
 #define CONFIG_USBHOST_RNDIS_ETH_MAX_FRAME_SIZE 1514
 #define CONFIG_USBHOST_RNDIS_ETH_MSG_SIZE       (CONFIG_USBHOST_RNDIS_ETH_MAX_FRAME_SIZE + 44)
 
-static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE];
+#if CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE <= (16 * 1024)
+#define USBH_RNDIS_RX_SLOT_SIZE CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE
+#else
+#define USBH_RNDIS_RX_SLOT_SIZE (16 * 1024)
+#endif
+
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_rx_buffer[CONFIG_USBHOST_BULKIN_RING_DEPTH][USBH_RNDIS_RX_SLOT_SIZE];
 static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_tx_buffer[CONFIG_USBHOST_RNDIS_ETH_MAX_TX_SIZE];
 // static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_rndis_inttx_buffer[16];
 
 static struct usbh_rndis g_rndis_class;
+static struct usbh_bulkin_ring g_rndis_rx_ring;
 
 static int usbh_rndis_get_notification(struct usbh_rndis *rndis_class)
 {
@@ -58,7 +65,8 @@ static int usbh_rndis_init_msg_transfer(struct usbh_rndis *rndis_class)
     cmd->RequestId = rndis_class->request_id++;
     cmd->MajorVersion = 1;
     cmd->MinorVersion = 0;
-    cmd->MaxTransferSize = 0x4000;
+    /* device must not send more than one rx slot in a transfer */
+    cmd->MaxTransferSize = USBH_RNDIS_RX_SLOT_SIZE;
 
     setup->bmRequestType = USB_REQUEST_DIR_OUT | USB_REQUEST_CLASS | USB_REQUEST_RECIPIENT_INTERFACE;
     setup->bRequest = CDC_REQUEST_SEND_ENCAPSULATED_COMMAND;
@@ -90,6 +98,8 @@ static int usbh_rndis_init_msg_transfer(struct usbh_rndis *rndis_class)
 
     rndis_class->max_transfer_pkts = resp->MaxPacketsPerTransfer;
     rndis_class->max_transfer_size = resp->MaxTransferSize;
+    /* messages in one transfer start at this alignment, at least word aligned for header access */
+    rndis_class->packet_align = MAX(1 << MIN(resp->PacketAlignmentFactor, 7), 4);
     USB_LOG_INFO("MaxPacketsPerTransfer:%d\r\n", resp->MaxPacketsPerTransfer);
     USB_LOG_INFO("MaxTransferSize:%d\r\n", resp->MaxTransferSize);
 
@@ -426,7 +436,7 @@ static int usbh_rndis_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
     if (rndis_class) {
         if (rndis_class->bulkin) {
-            usbh_kill_urb(&rndis_class->bulkin_urb);
+            usbh_bulkin_ring_stop(&g_rndis_rx_ring);
         }
 
         if (rndis_class->bulkout) {
@@ -450,16 +460,12 @@ static int usbh_rndis_disconnect(struct usbh_hubport *hport, uint8_t intf)
 
 void usbh_rndis_rx_thread(void *argument)
 {
-    uint32_t g_rndis_rx_length;
+    struct usbh_bulkin_slot *slot;
+    uint32_t rx_length;
     int ret;
     uint32_t pmg_offset;
     rndis_data_packet_t *pmsg;
     rndis_data_packet_t temp;
-#if CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE <= (16 * 1024)
-    uint32_t transfer_size = CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE;
-#else
-    uint32_t transfer_size = (16 * 1024);
-#endif
 
     (void)argument;
 
@@ -481,64 +487,57 @@ find_class:
         usb_osal_msleep(128);
     }
 
-    g_rndis_rx_length = 0;
+    ret = usbh_bulkin_ring_init(&g_rndis_rx_ring, g_rndis_class.hport, g_rndis_class.bulkin, &g_rndis_rx_buffer[0][0], USBH_RNDIS_RX_SLOT_SIZE);
+    if (ret < 0) {
+        goto delete;
+    }
+    g_rndis_class.rx_ring = &g_rndis_rx_ring;
+
     while (1) {
-        usbh_bulk_urb_fill(&g_rndis_class.bulkin_urb, g_rndis_class.hport, g_rndis_class.bulkin, &g_rndis_rx_buffer[g_rndis_rx_length], transfer_size, USB_OSAL_WAITING_FOREVER, NULL, NULL);
-        ret = usbh_submit_urb(&g_rndis_class.bulkin_urb);
+        ret = usbh_bulkin_ring_wait(&g_rndis_rx_ring, &slot, USB_OSAL_WAITING_FOREVER);
         if (ret < 0) {
+            g_rndis_class.rx_ring = NULL;
+            usbh_bulkin_ring_deinit(&g_rndis_rx_ring);
             goto find_class;
         }
 
-        g_rndis_rx_length += g_rndis_class.bulkin_urb.actual_length;
-
-        /* A transfer is complete because last packet is a short packet.
-         * Short packet is not zero, match g_rndis_rx_length % USB_GET_MAXPACKETSIZE(g_rndis_class.bulkin->wMaxPacketSize).
-         * Short packet cannot be zero.
-        */
-        if (g_rndis_rx_length % USB_GET_MAXPACKETSIZE(g_rndis_class.bulkin->wMaxPacketSize)) {
-            pmg_offset = 0;
+        /* A transfer is complete because last packet is a short packet or the slot is full,
+         * device never sends more than MaxTransferSize (one slot) in a transfer.
+         */
+        rx_length = ret;
+        pmg_offset = 0;
 
-            uint32_t total_len = g_rndis_rx_length;
+        while (rx_length > 0) {
+            USB_LOG_DBG("rxlen:%d\r\n", rx_length);
 
-            while (g_rndis_rx_length > 0) {
-                USB_LOG_DBG("rxlen:%d\r\n", g_rndis_rx_length);
+            pmsg = (rndis_data_packet_t *)(slot->buf + pmg_offset);
 
-                pmsg = (rndis_data_packet_t *)(g_rndis_rx_buffer + pmg_offset);
-
-                /* Not word-aligned case */
-                if (pmg_offset & 0x3) {
-                    usb_memcpy(&temp, pmsg, sizeof(rndis_data_packet_t));
-                    pmsg = &temp;
-                }
+            /* Not word-aligned case */
+            if (pmg_offset & 0x3) {
+                usb_memcpy(&temp, pmsg, sizeof(rndis_data_packet_t));
+                pmsg = &temp;
+            }
 
-                if (pmsg->MessageType == REMOTE_NDIS_PACKET_MSG) {
-                    uint8_t *buf = (uint8_t *)(g_rndis_rx_buffer + pmg_offset + sizeof(rndis_generic_msg_t) + pmsg->DataOffset);
+            if ((pmsg->MessageType == REMOTE_NDIS_PACKET_MSG) && (pmsg->MessageLength <= rx_length)) {
+                uint8_t *buf = (uint8_t *)(slot->buf + pmg_offset + sizeof(rndis_generic_msg_t) + pmsg->DataOffset);
 
-                    usbh_rndis_eth_input(buf, pmsg->DataLength);
-                    pmg_offset += pmsg->MessageLength;
-                    g_rndis_rx_length -= pmsg->MessageLength;
+                usbh_rndis_eth_input(buf, pmsg->DataLength);
+                pmg_offset += pmsg->MessageLength;
+                rx_length -= pmsg->MessageLength;
 
-                    /* drop the last dummy byte, it is a short packet to tell us we have received a multiple of wMaxPacketSize */
-                    if (g_rndis_rx_length < 4) {
-                        g_rndis_rx_length = 0;
-                    }
-                } else {
-                    USB_LOG_ERR("offset:%d,remain:%d,total:%d\r\n", pmg_offset, g_rndis_rx_length, total_len);
-                    g_rndis_rx_length = 0;
-                    USB_LOG_ERR("Error rndis packet message\r\n");
-                }
-            }
-        } else {
-#if CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE <= (16 * 1024)
-            if (g_rndis_rx_length == CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE) {
-#else
-            if ((g_rndis_rx_length + (16 * 1024)) > CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE) {
-#endif
-                USB_LOG_ERR("Rx packet is overflow, please reduce tcp window size or increase CONFIG_USBHOST_RNDIS_ETH_MAX_RX_SIZE\r\n");
-                while (1) {
+                /* drop the last dummy byte, it is a short packet to tell us we have received a multiple of wMaxPacketSize */
+                if (rx_length < 4) {
+                    rx_length = 0;
                 }
+            } else {
+                USB_LOG_ERR("offset:%d,remain:%d,total:%d\r\n", pmg_offset, rx_length, ret);
+                rx_length = 0;
+                USB_LOG_ERR("Error rndis packet message\r\n");
             }
         }
+
+        /* frames handed to lwip zero-copy keep their own reference */
+        usbh_bulkin_ring_release(slot);
     }
 
     // clang-format off
@@ -553,35 +552,54 @@ uint8_t *usbh_rndis_get_eth_txbuf(void)
     return (g_rndis_tx_buffer + sizeof(rndis_data_packet_t));
 }
 
-int usbh_rndis_eth_output(uint32_t buflen)
+uint32_t usbh_rndis_eth_fill_header(uint8_t *msg, uint32_t pad, uint32_t buflen, uint32_t align)
 {
     rndis_data_packet_t *hdr;
-    uint32_t len;
-
-    if (g_rndis_class.connect_status == false) {
-        return -USB_ERR_NOTCONN;
-    }
 
-    hdr = (rndis_data_packet_t *)g_rndis_tx_buffer;
+    hdr = (rndis_data_packet_t *)msg;
     memset(hdr, 0, sizeof(rndis_data_packet_t));
 
     hdr->MessageType = REMOTE_NDIS_PACKET_MSG;
-    hdr->MessageLength = sizeof(rndis_data_packet_t) + buflen;
-    hdr->DataOffset = sizeof(rndis_data_packet_t) - sizeof(rndis_generic_msg_t);
+    hdr->MessageLength = USB_ALIGN_UP(sizeof(rndis_data_packet_t) + pad + buflen, align);
+    hdr->DataOffset = sizeof(rndis_data_packet_t) + pad - sizeof(rndis_generic_msg_t);
     hdr->DataLength = buflen;
 
-    len = hdr->MessageLength;
+    return hdr->MessageLength;
+}
+
+uint8_t *usbh_rndis_get_eth_aggbuf(uint32_t *size, uint32_t *pkts)
+{
+    /* keep one byte for the short packet */
+    *size = MIN(CONFIG_USBHOST_RNDIS_ETH_MAX_TX_SIZE - 1, g_rndis_class.max_transfer_size);
+    *pkts = MAX(g_rndis_class.max_transfer_pkts, 1);
+    return g_rndis_tx_buffer;
+}
+
+int usbh_rndis_eth_output_msg(uint8_t *buf, uint32_t len)
+{
+    if (g_rndis_class.connect_status == false) {
+        return -USB_ERR_NOTCONN;
+    }
+
     /* if message length is the multiple of wMaxPacketSize, we should add a short packet to tell device transfer is over. */
-    if (!(len % g_rndis_class.bulkout->wMaxPacketSize)) {
+    if (!(len % USB_GET_MAXPACKETSIZE(g_rndis_class.bulkout->wMaxPacketSize))) {
         len += 1;
     }
 
     USB_LOG_DBG("txlen:%d\r\n", len);
 
-    usbh_bulk_urb_fill(&g_rndis_class.bulkout_urb, g_rndis_class.hport, g_rndis_class.bulkout, g_rndis_tx_buffer, len, USB_OSAL_WAITING_FOREVER, NULL, NULL);
+    usbh_bulk_urb_fill(&g_rndis_class.bulkout_urb, g_rndis_class.hport, g_rndis_class.bulkout, buf, len, USB_OSAL_WAITING_FOREVER, NULL, NULL);
     return usbh_submit_urb(&g_rndis_class.bulkout_urb);
 }
 
+int usbh_rndis_eth_output(uint32_t buflen)
+{
+    uint32_t len;
+
+    len = usbh_rndis_eth_fill_header(g_rndis_tx_buffer, 0, buflen, 1);
+    return usbh_rndis_eth_output_msg(g_rndis_tx_buffer, len);
+}
+
 __WEAK void usbh_rndis_run(struct usbh_rndis *rndis_class)
 {
     (void)rndis_class;
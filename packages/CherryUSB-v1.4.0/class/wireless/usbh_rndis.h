@@ -8,12 +8,15 @@
 
 #include "usb_cdc.h"
 
+/* sizeof(rndis_data_packet_t), REMOTE_NDIS_PACKET_MSG header in front of every frame */
+#define USBH_RNDIS_ETH_HDR_SIZE 44
+
 struct usbh_rndis {
     struct usbh_hubport *hport;
     struct usb_endpoint_descriptor *bulkin;  /* Bulk IN endpoint */
     struct usb_endpoint_descriptor *bulkout; /* Bulk OUT endpoint */
     struct usb_endpoint_descriptor *intin;   /* INTR endpoint */
-    struct usbh_urb bulkin_urb;              /* Bulk IN urb */
+    struct usbh_bulkin_ring *rx_ring;        /* Bulk IN receive ring */
     struct usbh_urb bulkout_urb;             /* Bulk OUT urb */
     struct usbh_urb intin_urb;               /* INTR IN urb */
 
@@ -25,6 +28,7 @@ struct usbh_rndis {
     uint32_t tx_offset;
     uint32_t max_transfer_pkts; /* max packets in one transfer */
     uint32_t max_transfer_size; /* max size in one transfer */
+    uint32_t packet_align;      /* alignment of each message in one transfer */
 
     uint32_t link_speed;
     bool connect_status;
@@ -45,6 +49,9 @@ void usbh_rndis_stop(struct usbh_rndis *rndis_class);
 
 uint8_t *usbh_rndis_get_eth_txbuf(void);
 int usbh_rndis_eth_output(uint32_t buflen);
+uint32_t usbh_rndis_eth_fill_header(uint8_t *msg, uint32_t pad, uint32_t buflen, uint32_t align);
+uint8_t *usbh_rndis_get_eth_aggbuf(uint32_t *size, uint32_t *pkts);
+int usbh_rndis_eth_output_msg(uint8_t *buf, uint32_t len);
 void usbh_rndis_eth_input(uint8_t *buf, uint32_t buflen);
 void usbh_rndis_rx_thread(void *argument);
 
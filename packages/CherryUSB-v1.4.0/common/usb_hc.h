@@ -28,6 +28,22 @@ struct usbh_iso_frame_packet {
     int errorcode;
 };
 
+/**
+ * @brief USB Iso statistics.
+ *
+ * Structure containing the isochronous schedule counters of a bus.
+ */
+struct usbh_iso_stat {
+    uint32_t missed_frames; /* (micro)frames in which a due iso packet was not transferred */
+    uint32_t late_submits;  /* stream iso urbs completed with no next urb queued on the same endpoint */
+};
+
+/* urb transfer_flags */
+/* iso urb of a running stream, a next urb is due before it completes.
+ * class leaves it off on the last urb when it stops the stream, so that the stop is not counted late.
+ */
+#define USBH_URB_ISO_STREAM (1 << 0)
+
 /**
  * @brief USB Urb Configuration.
  *
@@ -108,6 +124,14 @@ int usbh_submit_urb(struct usbh_urb *urb);
  */
 int usbh_kill_urb(struct usbh_urb *urb);
 
+/**
+ * @brief Get isochronous schedule statistics.
+ *
+ * @param stat Iso statistics.
+ * @return  On success will return 0, and -USB_ERR_NOTSUPP if the port does not implement it.
+ */
+int usbh_get_iso_stat(struct usbh_bus *bus, struct usbh_iso_stat *stat);
+
 #ifdef __cplusplus
 }
 #endif
@@ -658,6 +658,13 @@ int usbh_deinitialize(uint8_t busid)
     return 0;
 }
 
+__WEAK int usbh_get_iso_stat(struct usbh_bus *bus, struct usbh_iso_stat *stat)
+{
+    (void)bus;
+    memset(stat, 0, sizeof(struct usbh_iso_stat));
+    return -USB_ERR_NOTSUPP;
+}
+
 int usbh_control_transfer(struct usbh_hubport *hport, struct usb_setup_packet *setup, uint8_t *buffer)
 {
     struct usbh_urb *urb;
@@ -725,6 +732,210 @@ int usbh_set_interface(struct usbh_hubport *hport, uint8_t intf, uint8_t altsett
     return usbh_control_transfer(hport, setup, NULL);
 }
 
+static void usbh_bulkin_ring_free_push(struct usbh_bulkin_ring *ring, struct usbh_bulkin_slot *slot)
+{
+    uint8_t tail = (ring->free_head + ring->free_count) % CONFIG_USBHOST_BULKIN_RING_DEPTH;
+
+    ring->free_idx[tail] = slot - ring->slot;
+    ring->free_count++;
+}
+
+static void usbh_bulkin_ring_complete(void *arg, int nbytes);
+
+static void usbh_bulkin_ring_submit(struct usbh_bulkin_ring *ring)
+{
+    struct usbh_bulkin_slot *slot;
+    size_t flags;
+    int ret;
+
+    flags = usb_osal_enter_critical_section();
+    if (!ring->running || ring->active || (ring->free_count == 0)) {
+        usb_osal_leave_critical_section(flags);
+        return;
+    }
+    slot = &ring->slot[ring->free_idx[ring->free_head]];
+    ring->free_head = (ring->free_head + 1) % CONFIG_USBHOST_BULKIN_RING_DEPTH;
+    ring->free_count--;
+    ring->active = slot;
+    usb_osal_leave_critical_section(flags);
+
+    usbh_bulk_urb_fill(&slot->urb, ring->hport, ring->ep, slot->buf, ring->slot_size, 0, usbh_bulkin_ring_complete, slot);
+    slot->urb.data_toggle = ring->data_toggle;
+
+    ret = usbh_submit_urb(&slot->urb);
+    if (ret < 0) {
+        flags = usb_osal_enter_critical_section();
+        ring->active = NULL;
+        ring->running = false;
+        slot->nbytes = ret;
+        slot->ref = 1;
+        usb_osal_leave_critical_section(flags);
+
+        usb_osal_mq_send(ring->done_mq, (uintptr_t)slot);
+    }
+}
+
+static void usbh_bulkin_ring_complete(void *arg, int nbytes)
+{
+    struct usbh_bulkin_slot *slot = (struct usbh_bulkin_slot *)arg;
+    struct usbh_bulkin_ring *ring = slot->ring;
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    ring->active = NULL;
+    ring->data_toggle = slot->urb.data_toggle;
+    slot->nbytes = nbytes;
+    slot->ref = 1;
+    if (nbytes < 0) {
+        ring->running = false;
+    }
+    usb_osal_leave_critical_section(flags);
+
+    /* re-arm before handing out, so the bus is busy while consumer parses */
+    usbh_bulkin_ring_submit(ring);
+    usb_osal_mq_send(ring->done_mq, (uintptr_t)slot);
+}
+
+int usbh_bulkin_ring_init(struct usbh_bulkin_ring *ring, struct usbh_hubport *hport, struct usb_endpoint_descriptor *ep, uint8_t *buf, uint32_t slot_size)
+{
+    struct usbh_bulkin_slot *slot;
+    size_t flags;
+
+    if (!ring || !hport || !ep || !buf || (slot_size & 0x03)) {
+        return -USB_ERR_INVAL;
+    }
+
+    ring->done_mq = usb_osal_mq_create(CONFIG_USBHOST_BULKIN_RING_DEPTH + 1);
+    if (ring->done_mq == NULL) {
+        return -USB_ERR_NOMEM;
+    }
+
+    flags = usb_osal_enter_critical_section();
+    ring->hport = hport;
+    ring->ep = ep;
+    ring->slot_size = slot_size;
+    ring->active = NULL;
+    ring->free_head = 0;
+    ring->free_count = 0;
+    ring->data_toggle = 0;
+
+    for (uint8_t i = 0; i < CONFIG_USBHOST_BULKIN_RING_DEPTH; i++) {
+        slot = &ring->slot[i];
+        slot->ring = ring;
+        slot->buf = buf + i * slot_size;
+        /* still lent out from last connection */
+        if (slot->ref == 0) {
+            memset(&slot->urb, 0, sizeof(struct usbh_urb));
+            usbh_bulkin_ring_free_push(ring, slot);
+        }
+    }
+    ring->running = true;
+    usb_osal_leave_critical_section(flags);
+
+    usbh_bulkin_ring_submit(ring);
+    return 0;
+}
+
+int usbh_bulkin_ring_deinit(struct usbh_bulkin_ring *ring)
+{
+    struct usbh_bulkin_slot *slot;
+    uintptr_t addr;
+
+    if (!ring->done_mq) {
+        return -USB_ERR_INVAL;
+    }
+
+    usbh_bulkin_ring_stop(ring);
+
+    while (usb_osal_mq_recv(ring->done_mq, &addr, 0) == 0) {
+        slot = (struct usbh_bulkin_slot *)addr;
+        if (slot) {
+            usbh_bulkin_ring_release(slot);
+        }
+    }
+
+    usb_osal_mq_delete(ring->done_mq);
+    ring->done_mq = NULL;
+    return 0;
+}
+
+void usbh_bulkin_ring_stop(struct usbh_bulkin_ring *ring)
+{
+    struct usbh_bulkin_slot *slot;
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    if (!ring->done_mq) {
+        usb_osal_leave_critical_section(flags);
+        return;
+    }
+    ring->running = false;
+    slot = ring->active;
+    ring->active = NULL;
+    if (slot) {
+        usbh_kill_urb(&slot->urb);
+        usbh_bulkin_ring_free_push(ring, slot);
+    }
+    usb_osal_leave_critical_section(flags);
+
+    usb_osal_mq_send(ring->done_mq, 0);
+}
+
+int usbh_bulkin_ring_wait(struct usbh_bulkin_ring *ring, struct usbh_bulkin_slot **slot, uint32_t timeout)
+{
+    uintptr_t addr;
+    int ret;
+
+    ret = usb_osal_mq_recv(ring->done_mq, &addr, timeout);
+    if (ret < 0) {
+        return ret;
+    }
+    if (addr == 0) {
+        return -USB_ERR_SHUTDOWN;
+    }
+
+    *slot = (struct usbh_bulkin_slot *)addr;
+    ret = (*slot)->nbytes;
+    if (ret < 0) {
+        usbh_bulkin_ring_release(*slot);
+        *slot = NULL;
+    }
+    return ret;
+}
+
+void usbh_bulkin_ring_hold(struct usbh_bulkin_slot *slot)
+{
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    slot->ref++;
+    usb_osal_leave_critical_section(flags);
+}
+
+void usbh_bulkin_ring_release(struct usbh_bulkin_slot *slot)
+{
+    struct usbh_bulkin_ring *ring = slot->ring;
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    if (--slot->ref == 0) {
+        usbh_bulkin_ring_free_push(ring, slot);
+    }
+    usb_osal_leave_critical_section(flags);
+
+    usbh_bulkin_ring_submit(ring);
+}
+
+struct usbh_bulkin_slot *usbh_bulkin_ring_find(struct usbh_bulkin_ring *ring, uint8_t *buf)
+{
+    for (uint8_t i = 0; i < CONFIG_USBHOST_BULKIN_RING_DEPTH; i++) {
+        if ((buf >= ring->slot[i].buf) && (buf < ring->slot[i].buf + ring->slot_size)) {
+            return &ring->slot[i];
+        }
+    }
+    return NULL;
+}
+
 static void *usbh_list_all_interface_name(struct usbh_hub *hub, const char *devname)
 {
     struct usbh_hubport *hport;
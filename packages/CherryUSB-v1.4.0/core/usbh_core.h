@@ -169,6 +169,38 @@ struct usbh_bus {
     usb_osal_mq_t hub_mq;
 };
 
+#ifndef CONFIG_USBHOST_BULKIN_RING_DEPTH
+#define CONFIG_USBHOST_BULKIN_RING_DEPTH 3
+#endif
+
+struct usbh_bulkin_ring;
+
+struct usbh_bulkin_slot {
+    struct usbh_urb urb;
+    struct usbh_bulkin_ring *ring;
+    uint8_t *buf;
+    int nbytes;  /* received length or negative error */
+    uint8_t ref; /* owners of buf, slot is re-armed when it drops to zero */
+};
+
+/* N-deep bulk IN receive ring, one transfer per slot.
+ * Only one slot is on the bus at a time (a single endpoint keeps its data toggle and order),
+ * next free slot is submitted from the completion callback so the link does not wait for the consumer.
+ */
+struct usbh_bulkin_ring {
+    struct usbh_hubport *hport;
+    struct usb_endpoint_descriptor *ep;
+    struct usbh_bulkin_slot slot[CONFIG_USBHOST_BULKIN_RING_DEPTH];
+    struct usbh_bulkin_slot *active;
+    uint32_t slot_size;
+    usb_osal_mq_t done_mq;
+    uint8_t free_idx[CONFIG_USBHOST_BULKIN_RING_DEPTH];
+    uint8_t free_head;
+    uint8_t free_count;
+    uint8_t data_toggle;
+    bool running;
+};
+
 static inline void usbh_control_urb_fill(struct usbh_urb *urb,
                                          struct usbh_hubport *hport,
                                          struct usb_setup_packet *setup,
@@ -272,6 +304,39 @@ int usbh_get_string_desc(struct usbh_hubport *hport, uint8_t index, uint8_t *out
  */
 int usbh_set_interface(struct usbh_hubport *hport, uint8_t intf, uint8_t altsetting);
 
+/**
+ * @brief Start a bulk IN receive ring on an endpoint.
+ *
+ * Slot buffers are carved from buf, so buf must hold CONFIG_USBHOST_BULKIN_RING_DEPTH * slot_size bytes
+ * and slot_size must keep every slot aligned. Slots still referenced from a previous run stay
+ * owned by their holders and join the ring when they are released.
+ *
+ * @param ring Pointer to the ring, must stay valid while any slot is referenced.
+ * @param hport Pointer to the USB hub port structure.
+ * @param ep Bulk IN endpoint.
+ * @param buf Backing memory of all slots.
+ * @param slot_size Transfer length of one slot.
+ * @return On success will return 0, and others indicate fail.
+ */
+int usbh_bulkin_ring_init(struct usbh_bulkin_ring *ring, struct usbh_hubport *hport, struct usb_endpoint_descriptor *ep, uint8_t *buf, uint32_t slot_size);
+int usbh_bulkin_ring_deinit(struct usbh_bulkin_ring *ring);
+
+/**
+ * @brief Kill the transfer on the bus and wake up the consumer with -USB_ERR_SHUTDOWN.
+ * Safe to call from class disconnect.
+ */
+void usbh_bulkin_ring_stop(struct usbh_bulkin_ring *ring);
+
+/**
+ * @brief Wait for the next completed slot, the caller owns one reference of it and must release it.
+ *
+ * @return Received length on success, negative error if the ring has stopped.
+ */
+int usbh_bulkin_ring_wait(struct usbh_bulkin_ring *ring, struct usbh_bulkin_slot **slot, uint32_t timeout);
+void usbh_bulkin_ring_hold(struct usbh_bulkin_slot *slot);
+void usbh_bulkin_ring_release(struct usbh_bulkin_slot *slot);
+struct usbh_bulkin_slot *usbh_bulkin_ring_find(struct usbh_bulkin_ring *ring, uint8_t *buf);
+
 int usbh_initialize(uint8_t busid, uintptr_t reg_base);
 int usbh_deinitialize(uint8_t busid);
 void *usbh_find_class_instance(const char *devname);
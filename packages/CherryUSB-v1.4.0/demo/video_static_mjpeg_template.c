@@ -202,48 +202,32 @@ void video_init(uint8_t busid, uintptr_t reg_base)
     usbd_initialize(busid, reg_base, usbd_event_handler);
 }
 
-USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t packet_buffer[40 * 1024];
+/* two payloads: the next one is cut from the frame while the other is on the bus */
+USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t packet_buffer[2][MAX_PAYLOAD_SIZE];
 
 void video_test(uint8_t busid)
 {
-    uint32_t out_len;
-    uint32_t packets;
+    uint32_t len;
+    uint8_t fill = 0;
 
-    (void)packets;
-    memset(packet_buffer, 0, 40 * 1024);
     while (1) {
         if (tx_flag) {
-            packets = usbd_video_payload_fill(busid, (uint8_t *)cherryusb_mjpeg, sizeof(cherryusb_mjpeg), packet_buffer, &out_len);
-#if 1
-            iso_tx_busy = true;
-            usbd_ep_start_write(busid, VIDEO_IN_EP, packet_buffer, out_len);
-            while (iso_tx_busy) {
+            usbd_video_stream_frame(busid, cherryusb_mjpeg, sizeof(cherryusb_mjpeg), 0);
+            len = usbd_video_stream_fill(busid, packet_buffer[fill]);
+            while (len) {
+                iso_tx_busy = true;
+                usbd_ep_start_write(busid, VIDEO_IN_EP, packet_buffer[fill], len);
+                fill ^= 1;
+                len = usbd_video_stream_fill(busid, packet_buffer[fill]);
+                while (iso_tx_busy) {
+                    if (tx_flag == 0) {
+                        break;
+                    }
+                }
                 if (tx_flag == 0) {
                     break;
                 }
             }
-#else
-            /* dwc2 must use this method */
-            for (uint32_t i = 0; i < packets; i++) {
-                if (i == (packets - 1)) {
-                    iso_tx_busy = true;
-                    usbd_ep_start_write(busid, VIDEO_IN_EP, &packet_buffer[i * MAX_PAYLOAD_SIZE], out_len - (packets - 1) * MAX_PAYLOAD_SIZE);
-                    while (iso_tx_busy) {
-                        if (tx_flag == 0) {
-                            break;
-                        }
-                    }
-                } else {
-                    iso_tx_busy = true;
-                    usbd_ep_start_write(busid, VIDEO_IN_EP, &packet_buffer[i * MAX_PAYLOAD_SIZE], MAX_PAYLOAD_SIZE);
-                    while (iso_tx_busy) {
-                        if (tx_flag == 0) {
-                            break;
-                        }
-                    }
-                }
-            }
-#endif
         }
     }
-}
\ No newline at end of file
+}
@@ -41,7 +41,30 @@ int usbh_deinit(int argc, char **argv)
     return 0;
 }
 
+int usbh_iso_stat(int argc, char **argv)
+{
+    struct usbh_iso_stat stat;
+    uint8_t busid;
+
+    if (argc < 2) {
+        USB_LOG_ERR("please input correct command: usbh_iso_stat <busid>\r\n");
+        return -1;
+    }
+
+    busid = atoi(argv[1]);
+    if (usbh_get_iso_stat(&g_usbhost_bus[busid], &stat) < 0) {
+        USB_LOG_ERR("iso statistics is not supported\r\n");
+        return -1;
+    }
+
+    USB_LOG_RAW("missed frames: %u\r\n", (unsigned int)stat.missed_frames);
+    USB_LOG_RAW("late submits: %u\r\n", (unsigned int)stat.late_submits);
+
+    return 0;
+}
+
 MSH_CMD_EXPORT(usbh_init, init usb host);
 MSH_CMD_EXPORT(usbh_deinit, deinit usb host);
 MSH_CMD_EXPORT(lsusb, ls usb devices);
+MSH_CMD_EXPORT(usbh_iso_stat, show usb host iso statistics);
 #endif
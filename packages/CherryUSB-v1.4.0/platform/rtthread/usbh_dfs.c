@@ -7,6 +7,7 @@
 #include "usbh_msc.h"
 
 #include "rtthread.h"
+#include <rtdevice.h>
 #include <dfs_fs.h>
 
 #define DEV_FORMAT "/sd%c"
@@ -40,107 +41,293 @@ void rt_hw_cpu_dcache_ops(int ops, void *addr, int size)
 
 USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t msc_sector[512];
 
+/* sequential writes are collected up to this size and sent as one WRITE10 */
+#ifndef CONFIG_USB_DFS_MERGE_SIZE
+#define CONFIG_USB_DFS_MERGE_SIZE (8 * 1024)
+#endif
+
+/* sequential reads fetch this size ahead */
+#ifndef CONFIG_USB_DFS_READAHEAD_SIZE
+#define CONFIG_USB_DFS_READAHEAD_SIZE (8 * 1024)
+#endif
+
+/* merged writes idle this long are flushed, 0 leaves them to sync, close or the next flush */
+#ifndef CONFIG_USB_DFS_FLUSH_MS
+#define CONFIG_USB_DFS_FLUSH_MS 1000
+#endif
+
+#if (CONFIG_USB_DFS_FLUSH_MS > 0) && defined(RT_USING_DEVICE_IPC) && defined(RT_USING_HEAP)
+#define UDISK_USING_IDLE_FLUSH
+#endif
+
+/* max sectors of one READ10/WRITE10 going straight to caller buffer */
+#define UDISK_MAX_XFER_SECTORS 1024
+
+#ifdef RT_USING_CACHE
+#define UDISK_ALIGN_MASK (RT_ALIGN_SIZE - 1)
+#else
+#define UDISK_ALIGN_MASK 0x03
+#endif
+
+/*
+ * udisk block layer, requests are serialized by lock.
+ * Write merge buffer holds sequential writes and is flushed on a non adjacent write, a read overlapping it,
+ * when full, CONFIG_USB_DFS_FLUSH_MS after the last write, on RT_DEVICE_CTRL_BLK_SYNC and on close.
+ * A merged write that fails is not reported to the call that happened to flush it, its data was taken by
+ * an earlier write that returned success. The error is latched: every write fails from then on, and the
+ * next sync or close returns it and clears it. Without the idle flush (no RT_USING_DEVICE_IPC, or
+ * CONFIG_USB_DFS_FLUSH_MS 0) up to CONFIG_USB_DFS_MERGE_SIZE written data waits for one of the others,
+ * and is lost if the disk goes away before.
+ * Read-ahead buffer is filled when reads are sequential. Both buffers are allocated at mount and are the
+ * bounce buffers of unaligned requests, so nothing is allocated in io path.
+ * A disk unplugged while its filesystem can not be unmounted leaves the device registered with its io
+ * failing, it is unmounted and freed when a disk comes again under the same name.
+ */
+struct rt_udisk {
+    struct rt_device parent;
+    struct usbh_msc *msc_class;
+    struct rt_mutex lock;
+
+    uint8_t *wbuf;
+    uint32_t wpos;
+    uint32_t wcount;
+    uint32_t wmax;
+    int werr; /* a merged write failed since the last sync, writes fail until then */
+#ifdef UDISK_USING_IDLE_FLUSH
+    struct rt_work flush_work;
+#endif
+
+    uint8_t *rbuf;
+    uint32_t rpos;
+    uint32_t rcount;
+    uint32_t rmax;
+    uint32_t last_end; /* sector after last read */
+};
+
+#ifdef UDISK_USING_IDLE_FLUSH
+static struct rt_workqueue *udisk_workq;
+#endif
+
 static rt_err_t rt_udisk_init(rt_device_t dev)
 {
     return RT_EOK;
 }
 
-static ssize_t rt_udisk_read(rt_device_t dev, rt_off_t pos, void *buffer,
-                                rt_size_t size)
+static int udisk_write_sectors(struct rt_udisk *udisk, uint32_t pos, uint8_t *buf, uint32_t count)
 {
-    struct usbh_msc *msc_class = (struct usbh_msc *)dev->user_data;
-    int ret;
-
 #ifdef RT_USING_CACHE
-    rt_uint32_t *align_buf;
+    rt_hw_cpu_dcache_ops(RT_HW_CACHE_FLUSH, buf, count * udisk->msc_class->blocksize);
+#endif
+    return usbh_msc_scsi_write10(udisk->msc_class, pos, buf, count);
+}
 
-    if ((uint32_t)buffer & (RT_ALIGN_SIZE - 1)) {
-        align_buf = rt_malloc_align(size * msc_class->blocksize, RT_ALIGN_SIZE);
-        if (!align_buf) {
-            rt_kprintf("msc get align buf failed\n");
-            return 0;
-        }
-    } else {
-        align_buf = (rt_uint32_t *)buffer;
+static int udisk_flush(struct rt_udisk *udisk)
+{
+    int ret;
+
+    if (udisk->wcount == 0) {
+        return 0;
     }
 
-    ret = usbh_msc_scsi_read10(msc_class, pos, (uint8_t *)align_buf, size);
+    ret = udisk_write_sectors(udisk, udisk->wpos, udisk->wbuf, udisk->wcount);
+    udisk->wcount = 0;
     if (ret < 0) {
-        rt_kprintf("usb mass_storage read failed\n");
-        return 0;
+        rt_kprintf("usb mass_storage write failed\n");
+        udisk->werr = ret;
     }
-    rt_hw_cpu_dcache_ops(RT_HW_CACHE_INVALIDATE, align_buf, size * msc_class->blocksize);
-    if ((uint32_t)buffer & (RT_ALIGN_SIZE - 1)) {
-        rt_memcpy(buffer, align_buf, size * msc_class->blocksize);
-        rt_free_align(align_buf);
+    return ret;
+}
+
+/* flush and take the error latched since the last sync */
+static int udisk_sync(struct rt_udisk *udisk)
+{
+    int ret;
+
+    rt_mutex_take(&udisk->lock, RT_WAITING_FOREVER);
+    if (udisk->msc_class) {
+        udisk_flush(udisk);
     }
-#else
-    ret = usbh_msc_scsi_read10(msc_class, pos, buffer, size);
-    if (ret < 0) {
-        rt_kprintf("usb mass_storage read failed\n");
-        return 0;
+    ret = udisk->werr;
+    udisk->werr = 0;
+    rt_mutex_release(&udisk->lock);
+
+    return ret;
+}
+
+#ifdef UDISK_USING_IDLE_FLUSH
+static void udisk_idle_flush(struct rt_work *work, void *work_data)
+{
+    struct rt_udisk *udisk = (struct rt_udisk *)work_data;
+
+    rt_mutex_take(&udisk->lock, RT_WAITING_FOREVER);
+    if (udisk->msc_class) {
+        udisk_flush(udisk);
     }
-#endif
-    return size;
+    rt_mutex_release(&udisk->lock);
 }
+#endif
 
-static ssize_t rt_udisk_write(rt_device_t dev, rt_off_t pos, const void *buffer,
-                                 rt_size_t size)
+static int udisk_read_sectors(struct rt_udisk *udisk, uint32_t pos, uint8_t *buf, uint32_t count)
 {
-    struct usbh_msc *msc_class = (struct usbh_msc *)dev->user_data;
     int ret;
 
+    /* merged writes must reach the disk before reading them back, a failure is latched for sync */
+    if (udisk->wcount && (pos < udisk->wpos + udisk->wcount) && (pos + count > udisk->wpos)) {
+        udisk_flush(udisk);
+    }
+
+    ret = usbh_msc_scsi_read10(udisk->msc_class, pos, buf, count);
+    if (ret < 0) {
+        rt_kprintf("usb mass_storage read failed\n");
+        return ret;
+    }
 #ifdef RT_USING_CACHE
-    rt_uint32_t *align_buf;
+    rt_hw_cpu_dcache_ops(RT_HW_CACHE_INVALIDATE, buf, count * udisk->msc_class->blocksize);
+#endif
+    return ret;
+}
 
-    if ((uint32_t)buffer & (RT_ALIGN_SIZE - 1)) {
-        align_buf = rt_malloc_align(size * msc_class->blocksize, RT_ALIGN_SIZE);
-        if (!align_buf) {
-            rt_kprintf("msc get align buf failed\n");
-            return 0;
+static ssize_t rt_udisk_read(rt_device_t dev, rt_off_t pos, void *buffer,
+                                rt_size_t size)
+{
+    struct rt_udisk *udisk = (struct rt_udisk *)dev;
+    uint8_t *buf = (uint8_t *)buffer;
+    rt_size_t remain = size;
+    uint32_t blocksize;
+    uint32_t n;
+    int ret = 0;
+
+    rt_mutex_take(&udisk->lock, RT_WAITING_FOREVER);
+    /* the disk went away while mounted */
+    if (!udisk->msc_class || ((pos + size) > udisk->msc_class->blocknum)) {
+        rt_mutex_release(&udisk->lock);
+        return 0;
+    }
+    blocksize = udisk->msc_class->blocksize;
+
+    while (remain > 0) {
+        if ((pos >= udisk->rpos) && (pos < udisk->rpos + udisk->rcount)) {
+            n = MIN(remain, udisk->rpos + udisk->rcount - pos);
+            rt_memcpy(buf, udisk->rbuf + (pos - udisk->rpos) * blocksize, n * blocksize);
+        } else if (!((uint32_t)buf & UDISK_ALIGN_MASK) && ((remain >= udisk->rmax) || (pos != udisk->last_end))) {
+            /* large or random read goes straight into caller buffer */
+            n = MIN(remain, UDISK_MAX_XFER_SECTORS);
+            ret = udisk_read_sectors(udisk, pos, buf, n);
+            if (ret < 0) {
+                break;
+            }
+        } else {
+            /* sequential or unaligned read goes through read-ahead buffer */
+            n = (pos == udisk->last_end) ? udisk->rmax : MIN(remain, udisk->rmax);
+            n = MIN(n, udisk->msc_class->blocknum - pos);
+            udisk->rcount = 0;
+            ret = udisk_read_sectors(udisk, pos, udisk->rbuf, n);
+            if (ret < 0) {
+                break;
+            }
+            udisk->rpos = pos;
+            udisk->rcount = n;
+            continue;
         }
 
-        rt_memcpy(align_buf, buffer, size * msc_class->blocksize);
-    } else {
-        align_buf = (rt_uint32_t *)buffer;
+        pos += n;
+        buf += n * blocksize;
+        remain -= n;
+        udisk->last_end = pos;
     }
+    rt_mutex_release(&udisk->lock);
 
-    rt_hw_cpu_dcache_ops(RT_HW_CACHE_FLUSH, align_buf, size * msc_class->blocksize);
-    ret = usbh_msc_scsi_write10(msc_class, pos, (uint8_t *)align_buf, size);
-    if (ret < 0) {
-        rt_kprintf("usb mass_storage write failed\n");
+    return ret < 0 ? 0 : size;
+}
+
+static ssize_t rt_udisk_write(rt_device_t dev, rt_off_t pos, const void *buffer,
+                                 rt_size_t size)
+{
+    struct rt_udisk *udisk = (struct rt_udisk *)dev;
+    const uint8_t *buf = (const uint8_t *)buffer;
+    rt_size_t remain = size;
+    uint32_t blocksize;
+    uint32_t n;
+    int ret = 0;
+
+    rt_mutex_take(&udisk->lock, RT_WAITING_FOREVER);
+    if (!udisk->msc_class || udisk->werr || ((pos + size) > udisk->msc_class->blocknum)) {
+        rt_mutex_release(&udisk->lock);
         return 0;
     }
-    if ((uint32_t)buffer & (RT_ALIGN_SIZE - 1)) {
-        rt_free_align(align_buf);
+    blocksize = udisk->msc_class->blocksize;
+
+    /* drop read-ahead data this write makes stale */
+    if (udisk->rcount && (pos < udisk->rpos + udisk->rcount) && (pos + size > udisk->rpos)) {
+        udisk->rcount = 0;
     }
-#else
-    ret = usbh_msc_scsi_write10(msc_class, pos, buffer, size);
-    if (ret < 0) {
-        rt_kprintf("usb mass_storage write failed\n");
-        return 0;
+
+    while (remain > 0) {
+        if ((udisk->wcount == 0) && !((uint32_t)buf & UDISK_ALIGN_MASK) && (remain >= udisk->wmax)) {
+            /* large write goes straight from caller buffer */
+            n = MIN(remain, UDISK_MAX_XFER_SECTORS);
+            ret = udisk_write_sectors(udisk, pos, (uint8_t *)buf, n);
+            if (ret < 0) {
+                rt_kprintf("usb mass_storage write failed\n");
+                break;
+            }
+        } else if ((udisk->wcount == 0) || (pos == udisk->wpos + udisk->wcount)) {
+            if (udisk->wcount == 0) {
+                udisk->wpos = pos;
+            }
+            n = MIN(remain, udisk->wmax - udisk->wcount);
+            rt_memcpy(udisk->wbuf + udisk->wcount * blocksize, buf, n * blocksize);
+            udisk->wcount += n;
+            if (udisk->wcount == udisk->wmax) {
+                /* a failure is latched for sync */
+                udisk_flush(udisk);
+            }
+        } else {
+            udisk_flush(udisk);
+            continue;
+        }
+
+        pos += n;
+        buf += n * blocksize;
+        remain -= n;
+    }
+#ifdef UDISK_USING_IDLE_FLUSH
+    if (udisk->wcount && udisk_workq) {
+        rt_workqueue_submit_work(udisk_workq, &udisk->flush_work, rt_tick_from_millisecond(CONFIG_USB_DFS_FLUSH_MS));
     }
 #endif
+    rt_mutex_release(&udisk->lock);
 
-    return size;
+    return ret < 0 ? 0 : size;
+}
+
+static rt_err_t rt_udisk_close(rt_device_t dev)
+{
+    return udisk_sync((struct rt_udisk *)dev) < 0 ? -RT_ERROR : RT_EOK;
 }
 
 static rt_err_t rt_udisk_control(rt_device_t dev, int cmd, void *args)
 {
     /* check parameter */
     RT_ASSERT(dev != RT_NULL);
-    struct usbh_msc *msc_class = (struct usbh_msc *)dev->user_data;
+    struct rt_udisk *udisk = (struct rt_udisk *)dev;
+    struct usbh_msc *msc_class = udisk->msc_class;
 
     if (cmd == RT_DEVICE_CTRL_BLK_GETGEOME) {
         struct rt_device_blk_geometry *geometry;
 
         geometry = (struct rt_device_blk_geometry *)args;
-        if (geometry == RT_NULL)
+        if ((geometry == RT_NULL) || (msc_class == RT_NULL))
             return -RT_ERROR;
 
         geometry->bytes_per_sector = msc_class->blocksize;
         geometry->block_size = msc_class->blocksize;
-        geometry->sector_count = msc_class->blocknum;
+        /* dfs addresses 32 bit sectors, larger drives expose their first 2^32 sectors */
+        geometry->sector_count = MIN(msc_class->blocknum, 0xFFFFFFFFULL);
+    } else if (cmd == RT_DEVICE_CTRL_BLK_SYNC) {
+        if (udisk_sync(udisk) < 0) {
+            return -RT_ERROR;
+        }
     }
 
     return RT_EOK;
@@ -150,31 +337,90 @@ static rt_err_t rt_udisk_control(rt_device_t dev, int cmd, void *args)
 const static struct rt_device_ops udisk_device_ops = {
     rt_udisk_init,
     RT_NULL,
-    RT_NULL,
+    rt_udisk_close,
     rt_udisk_read,
     rt_udisk_write,
     rt_udisk_control
 };
 #endif
 
+static void udisk_free_buffers(struct rt_udisk *udisk)
+{
+    if (udisk->wbuf) {
+        rt_free_align(udisk->wbuf);
+        udisk->wbuf = RT_NULL;
+    }
+    if (udisk->rbuf) {
+        rt_free_align(udisk->rbuf);
+        udisk->rbuf = RT_NULL;
+    }
+}
+
+static void udisk_free(struct rt_udisk *udisk)
+{
+    udisk_free_buffers(udisk);
+    rt_free(udisk);
+}
+
+/* unregister and free a udisk, its filesystem unmounted */
+static void udisk_release(struct rt_udisk *udisk)
+{
+#ifdef UDISK_USING_IDLE_FLUSH
+    if (udisk_workq) {
+        rt_workqueue_cancel_work_sync(udisk_workq, &udisk->flush_work);
+    }
+#endif
+    rt_device_unregister(&udisk->parent);
+    rt_mutex_detach(&udisk->lock);
+    udisk_free(udisk);
+}
+
+/* a device left by a disk unplugged while in use, unmount and free it for the disk taking its name */
+static int udisk_reclaim(const char *name, const char *mount_point)
+{
+    struct rt_udisk *udisk = (struct rt_udisk *)rt_device_find(name);
+
+    if (udisk == RT_NULL) {
+        return 0;
+    }
+    if (dfs_filesystem_get_mounted_path(&udisk->parent) && (dfs_unmount(mount_point) < 0)) {
+        rt_kprintf("udisk: %s of the disk before still in use\n", name);
+        return -RT_EBUSY;
+    }
+    udisk_release(udisk);
+    return 0;
+}
+
 int udisk_init(struct usbh_msc *msc_class)
 {
     rt_err_t ret = 0;
     rt_uint8_t i;
     struct dfs_partition part0;
+    struct rt_udisk *udisk;
     struct rt_device *dev;
     char name[CONFIG_USBHOST_DEV_NAMELEN];
     char mount_point[CONFIG_USBHOST_DEV_NAMELEN];
 
-    dev = rt_malloc(sizeof(struct rt_device));
-    memset(dev, 0, sizeof(struct rt_device));
+    udisk = rt_malloc(sizeof(struct rt_udisk));
+    if (udisk == RT_NULL) {
+        return -RT_ENOMEM;
+    }
+    memset(udisk, 0, sizeof(struct rt_udisk));
+    dev = &udisk->parent;
 
     snprintf(name, CONFIG_USBHOST_DEV_NAMELEN, DEV_FORMAT, msc_class->sdchar);
     snprintf(mount_point, CONFIG_USBHOST_DEV_NAMELEN, CONFIG_USB_DFS_MOUNT_POINT, msc_class->sdchar);
 
+    ret = udisk_reclaim(name, mount_point);
+    if (ret != RT_EOK) {
+        udisk_free(udisk);
+        return ret;
+    }
+
     ret = usbh_msc_scsi_read10(msc_class, 0, msc_sector, 1);
     if (ret != RT_EOK) {
         rt_kprintf("usb mass_storage read failed\n");
+        udisk_free(udisk);
         return ret;
     }
 
@@ -189,11 +435,30 @@ int udisk_init(struct usbh_msc *msc_class)
         }
     }
 
+    udisk->msc_class = msc_class;
+    udisk->wmax = MAX(CONFIG_USB_DFS_MERGE_SIZE / msc_class->blocksize, 1);
+    udisk->rmax = MAX(CONFIG_USB_DFS_READAHEAD_SIZE / msc_class->blocksize, 1);
+    udisk->wbuf = rt_malloc_align(udisk->wmax * msc_class->blocksize, RT_ALIGN_SIZE);
+    udisk->rbuf = rt_malloc_align(udisk->rmax * msc_class->blocksize, RT_ALIGN_SIZE);
+    if (!udisk->wbuf || !udisk->rbuf) {
+        rt_kprintf("udisk: no memory for block buffers\n");
+        udisk_free(udisk);
+        return -RT_ENOMEM;
+    }
+    rt_mutex_init(&udisk->lock, name, RT_IPC_FLAG_PRIO);
+#ifdef UDISK_USING_IDLE_FLUSH
+    if (udisk_workq == RT_NULL) {
+        udisk_workq = rt_workqueue_create("udisk", 1024, RT_THREAD_PRIORITY_MAX / 2);
+    }
+    rt_work_init(&udisk->flush_work, udisk_idle_flush, udisk);
+#endif
+
     dev->type = RT_Device_Class_Block;
 #ifdef RT_USING_DEVICE_OPS
     dev->ops = &udisk_device_ops;
 #else
     dev->init = rt_udisk_init;
+    dev->close = rt_udisk_close;
     dev->read = rt_udisk_read;
     dev->write = rt_udisk_write;
     dev->control = rt_udisk_control;
@@ -221,10 +486,30 @@ void usbh_msc_stop(struct usbh_msc *msc_class)
 {
     char name[CONFIG_USBHOST_DEV_NAMELEN];
     char mount_point[CONFIG_USBHOST_DEV_NAMELEN];
+    struct rt_udisk *udisk;
 
     snprintf(name, CONFIG_USBHOST_DEV_NAMELEN, DEV_FORMAT, msc_class->sdchar);
     snprintf(mount_point, CONFIG_USBHOST_DEV_NAMELEN, CONFIG_USB_DFS_MOUNT_POINT, msc_class->sdchar);
 
-    dfs_unmount(mount_point);
-    rt_device_unregister(rt_device_find(name));
+    udisk = (struct rt_udisk *)rt_device_find(name);
+    if (udisk == RT_NULL) {
+        return;
+    }
+
+    if (dfs_filesystem_get_mounted_path(&udisk->parent) && (dfs_unmount(mount_point) < 0)) {
+        /* the filesystem still uses the device, keep it with its io failing until udisk_reclaim */
+        rt_kprintf("udisk: %s unmount failed, device kept\n", name);
+        rt_mutex_take(&udisk->lock, RT_WAITING_FOREVER);
+        udisk->msc_class = RT_NULL;
+        if (udisk->wcount) {
+            udisk->werr = -USB_ERR_NODEV;
+        }
+        udisk->wcount = 0;
+        udisk->rcount = 0;
+        udisk_free_buffers(udisk);
+        rt_mutex_release(&udisk->lock);
+        return;
+    }
+
+    udisk_release(udisk);
 }
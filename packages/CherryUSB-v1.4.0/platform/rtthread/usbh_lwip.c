@@ -6,6 +6,7 @@
 #include "netif/etharp.h"
 #include "lwip/netif.h"
 #include "lwip/pbuf.h"
+#include "lwip/memp.h"
 #include "lwip/tcpip.h"
 #if LWIP_DHCP
 #include "lwip/dhcp.h"
@@ -88,10 +89,181 @@ void usbh_lwip_eth_input_common(struct netif *netif, uint8_t *buf, uint32_t len)
     }
 }
 
+#ifndef CONFIG_USBHOST_LWIP_RX_PBUF_NUM
+#define CONFIG_USBHOST_LWIP_RX_PBUF_NUM 16
+#endif
+
+#if LWIP_SUPPORT_CUSTOM_PBUF
+struct usbh_lwip_rx_pbuf {
+    struct pbuf_custom p;
+    struct usbh_bulkin_slot *slot;
+};
+
+LWIP_MEMPOOL_DECLARE(USBH_RX_PBUF, CONFIG_USBHOST_LWIP_RX_PBUF_NUM, sizeof(struct usbh_lwip_rx_pbuf), "usbh rx pbuf");
+
+static void usbh_lwip_rx_pbuf_free(struct pbuf *p)
+{
+    struct usbh_lwip_rx_pbuf *rx_pbuf = (struct usbh_lwip_rx_pbuf *)p;
+
+    usbh_bulkin_ring_release(rx_pbuf->slot);
+    LWIP_MEMPOOL_FREE(USBH_RX_PBUF, rx_pbuf);
+}
+#endif
+
+void usbh_lwip_rx_pbuf_init(void)
+{
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    static bool inited = false;
+
+    if (!inited) {
+        LWIP_MEMPOOL_INIT(USBH_RX_PBUF);
+        inited = true;
+    }
+#endif
+}
+
+/* Input a frame that lives in a bulk in ring slot. The slot is lent to lwip as a custom pbuf and
+ * re-armed on pbuf_free; the last free slot is never lent so that queued pbufs cannot stall the ring,
+ * such frame is copied into a pool pbuf instead.
+ */
+void usbh_lwip_eth_input_ring(struct netif *netif, struct usbh_bulkin_ring *ring, uint8_t *buf, uint32_t len)
+{
+    err_t err;
+    struct pbuf *p;
+#if LWIP_SUPPORT_CUSTOM_PBUF
+    struct usbh_bulkin_slot *slot;
+    struct usbh_lwip_rx_pbuf *rx_pbuf;
+
+    slot = ring ? usbh_bulkin_ring_find(ring, buf) : NULL;
+    if (slot && (ring->free_count > 0)) {
+        rx_pbuf = (struct usbh_lwip_rx_pbuf *)LWIP_MEMPOOL_ALLOC(USBH_RX_PBUF);
+        if (rx_pbuf) {
+            rx_pbuf->p.custom_free_function = usbh_lwip_rx_pbuf_free;
+            rx_pbuf->slot = slot;
+            usbh_bulkin_ring_hold(slot);
+
+            p = pbuf_alloced_custom(PBUF_RAW, len, PBUF_REF, &rx_pbuf->p, buf, len);
+            err = netif->input(p, netif);
+            if (err != ERR_OK) {
+                pbuf_free(p);
+            }
+            return;
+        }
+    }
+#else
+    (void)ring;
+#endif
+
+    /* slot is re-armed as soon as the rx thread has parsed it, so the frame must be copied */
+    p = pbuf_alloc(PBUF_RAW, len, PBUF_POOL);
+    if (p != NULL) {
+        pbuf_take(p, buf, len);
+        err = netif->input(p, netif);
+        if (err != ERR_OK) {
+            pbuf_free(p);
+        }
+    } else {
+        USB_LOG_ERR("No memory to alloc pbuf\r\n");
+    }
+}
+
+#ifndef CONFIG_USBHOST_LWIP_TX_QUEUE_NUM
+#define CONFIG_USBHOST_LWIP_TX_QUEUE_NUM 8
+#endif
+
+/* Async tx queue, netif only takes a reference of the pbuf and the usb transfer runs in txq thread,
+ * so tcpip thread never waits for the bus. When the queue is full, frame is dropped and tcp backs off.
+ */
+struct usbh_lwip_txq {
+    usb_osal_mq_t mq;
+    struct pbuf *pending; /* dequeued but not fit in last transfer */
+    void (*xmit)(struct usbh_lwip_txq *txq, struct pbuf *p);
+};
+
+struct pbuf *usbh_lwip_txq_get(struct usbh_lwip_txq *txq, uint32_t timeout)
+{
+    struct pbuf *p;
+    uintptr_t addr;
+
+    p = txq->pending;
+    if (p) {
+        txq->pending = NULL;
+        return p;
+    }
+
+    if (usb_osal_mq_recv(txq->mq, &addr, timeout) < 0) {
+        return NULL;
+    }
+    return (struct pbuf *)addr;
+}
+
+static void usbh_lwip_txq_thread(void *argument)
+{
+    struct usbh_lwip_txq *txq = (struct usbh_lwip_txq *)argument;
+    struct pbuf *p;
+
+    while (1) {
+        p = usbh_lwip_txq_get(txq, USB_OSAL_WAITING_FOREVER);
+        if (p) {
+            txq->xmit(txq, p);
+        }
+    }
+}
+
+/* txq thread stays across reconnection, frames queued while disconnected fail and are freed */
+int usbh_lwip_txq_init(struct usbh_lwip_txq *txq, const char *name, void (*xmit)(struct usbh_lwip_txq *txq, struct pbuf *p))
+{
+    if (txq->mq) {
+        return 0;
+    }
+
+    txq->xmit = xmit;
+    txq->pending = NULL;
+    txq->mq = usb_osal_mq_create(CONFIG_USBHOST_LWIP_TX_QUEUE_NUM);
+    if (txq->mq == NULL) {
+        return -USB_ERR_NOMEM;
+    }
+
+    if (usb_osal_thread_create(name, 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_lwip_txq_thread, txq) == NULL) {
+        usb_osal_mq_delete(txq->mq);
+        txq->mq = NULL;
+        return -USB_ERR_NOMEM;
+    }
+    return 0;
+}
+
+rt_err_t usbh_lwip_txq_put(struct usbh_lwip_txq *txq, struct pbuf *p)
+{
+    if (txq->mq == NULL) {
+        return -RT_ERROR;
+    }
+
+    pbuf_ref(p);
+    if (usb_osal_mq_send(txq->mq, (uintptr_t)p) < 0) {
+        pbuf_free(p);
+        LINK_STATS_INC(link.drop);
+        return -RT_EFULL;
+    }
+    return RT_EOK;
+}
+
+/* copy path for class which sends one frame from its own tx buffer */
+static void usbh_lwip_txq_copy_xmit(struct pbuf *p, uint8_t *txbuf, int (*output)(uint32_t buflen))
+{
+    usbh_lwip_eth_output_common(p, txbuf);
+    if (output(p->tot_len) < 0) {
+        LINK_STATS_INC(link.err);
+    } else {
+        LINK_STATS_INC(link.xmit);
+    }
+    pbuf_free(p);
+}
+
 #ifdef CONFIG_USBHOST_PLATFORM_CDC_ECM
 #include "usbh_cdc_ecm.h"
 
 static struct eth_device g_cdc_ecm_dev;
+static struct usbh_lwip_txq g_cdc_ecm_txq;
 
 static rt_err_t rt_usbh_cdc_ecm_control(rt_device_t dev, int cmd, void *args)
 {
@@ -115,27 +287,33 @@ static rt_err_t rt_usbh_cdc_ecm_control(rt_device_t dev, int cmd, void *args)
     return RT_EOK;
 }
 
+static void usbh_cdc_ecm_lwip_xmit(struct usbh_lwip_txq *txq, struct pbuf *p)
+{
+    (void)txq;
+
+    usbh_lwip_txq_copy_xmit(p, usbh_cdc_ecm_get_eth_txbuf(), usbh_cdc_ecm_eth_output);
+}
+
 static rt_err_t rt_usbh_cdc_ecm_eth_tx(rt_device_t dev, struct pbuf *p)
 {
-    int ret;
-    (void)dev;
+    struct usbh_cdc_ecm *cdc_ecm_class = (struct usbh_cdc_ecm *)dev->user_data;
 
-    usbh_lwip_eth_output_common(p, usbh_cdc_ecm_get_eth_txbuf());
-    ret = usbh_cdc_ecm_eth_output(p->tot_len);
-    if (ret < 0) {
+    if (cdc_ecm_class->connect_status == false) {
         return -RT_ERROR;
-    } else {
-        return RT_EOK;
     }
+    return usbh_lwip_txq_put(&g_cdc_ecm_txq, p);
 }
 
 void usbh_cdc_ecm_eth_input(uint8_t *buf, uint32_t buflen)
 {
-    usbh_lwip_eth_input_common(g_cdc_ecm_dev.netif, buf, buflen);
+    struct usbh_cdc_ecm *cdc_ecm_class = (struct usbh_cdc_ecm *)g_cdc_ecm_dev.parent.user_data;
+
+    usbh_lwip_eth_input_ring(g_cdc_ecm_dev.netif, cdc_ecm_class->rx_ring, buf, buflen);
 }
 
 void usbh_cdc_ecm_run(struct usbh_cdc_ecm *cdc_ecm_class)
 {
+    usbh_lwip_rx_pbuf_init();
     memset(&g_cdc_ecm_dev, 0, sizeof(struct eth_device));
 
     g_cdc_ecm_dev.parent.control = rt_usbh_cdc_ecm_control;
@@ -146,6 +324,7 @@ void usbh_cdc_ecm_run(struct usbh_cdc_ecm *cdc_ecm_class)
     eth_device_init(&g_cdc_ecm_dev, "u0");
     eth_device_linkchange(&g_cdc_ecm_dev, RT_TRUE);
 
+    usbh_lwip_txq_init(&g_cdc_ecm_txq, "usbh_cdc_ecm_tx", usbh_cdc_ecm_lwip_xmit);
     usb_osal_thread_create("usbh_cdc_ecm_rx", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_cdc_ecm_rx_thread, NULL);
 }
 
@@ -161,6 +340,7 @@ void usbh_cdc_ecm_stop(struct usbh_cdc_ecm *cdc_ecm_class)
 #include "usbh_rndis.h"
 
 static struct eth_device g_rndis_dev;
+static struct usbh_lwip_txq g_rndis_txq;
 
 static rt_timer_t keep_timer = RT_NULL;
 
@@ -204,27 +384,128 @@ static rt_err_t rt_usbh_rndis_control(rt_device_t dev, int cmd, void *args)
     return RT_EOK;
 }
 
-static rt_err_t rt_usbh_rndis_eth_tx(rt_device_t dev, struct pbuf *p)
+/* Single frame in one pbuf is sent in place, packet message header goes into pbuf headroom
+ * (PBUF_LINK_ENCAPSULATION_HLEN) with a few pad bytes to keep the transfer word aligned.
+ */
+static bool usbh_rndis_lwip_xmit_ref(struct usbh_rndis *rndis_class, struct pbuf *p)
 {
+    uint32_t pad;
+    uint32_t len;
+
+    /* only a frame of one segment nobody but the queue holds anymore, lwip may still share the
+     * others (tcp unsent and unacked segments) and change them under the tcpip thread lock
+     */
+    if (p->next || (p->ref != 1)) {
+        return false;
+    }
+
+    pad = ((uintptr_t)p->payload - USBH_RNDIS_ETH_HDR_SIZE) & 0x03;
+    len = USBH_RNDIS_ETH_HDR_SIZE + pad + p->len;
+    /* short packet needs one more byte, which pbuf does not own */
+    if (!(len % USB_GET_MAXPACKETSIZE(rndis_class->bulkout->wMaxPacketSize))) {
+        return false;
+    }
+    if (pbuf_add_header(p, USBH_RNDIS_ETH_HDR_SIZE + pad)) {
+        return false;
+    }
+
+    usbh_rndis_eth_fill_header(p->payload, pad, p->len - USBH_RNDIS_ETH_HDR_SIZE - pad, 1);
+    if (usbh_rndis_eth_output_msg(p->payload, len) < 0) {
+        LINK_STATS_INC(link.err);
+    } else {
+        LINK_STATS_INC(link.xmit);
+    }
+
+    pbuf_remove_header(p, USBH_RNDIS_ETH_HDR_SIZE + pad);
+    pbuf_free(p);
+    return true;
+}
+
+/* Frames waiting in the queue are aggregated into one transfer, limited by device MaxTransferSize
+ * and MaxPacketsPerTransfer. Dma needs one contiguous buffer, so aggregated frames are copied.
+ */
+static void usbh_rndis_lwip_xmit(struct usbh_lwip_txq *txq, struct pbuf *p)
+{
+    struct usbh_rndis *rndis_class = (struct usbh_rndis *)g_rndis_dev.parent.user_data;
+    uint8_t *buf;
+    uint32_t max_size;
+    uint32_t max_pkts;
+    uint32_t msglen;
+    uint32_t len = 0;
+    uint32_t pkts = 0;
     int ret;
-    (void)dev;
 
-    usbh_lwip_eth_output_common(p, usbh_rndis_get_eth_txbuf());
-    ret = usbh_rndis_eth_output(p->tot_len);
+    if (rndis_class->connect_status == false) {
+        pbuf_free(p);
+        LINK_STATS_INC(link.drop);
+        return;
+    }
+
+    buf = usbh_rndis_get_eth_aggbuf(&max_size, &max_pkts);
+
+    while (p) {
+        if (pkts == 0) {
+            struct pbuf *next = usbh_lwip_txq_get(txq, 0);
+
+            if ((next == NULL) && usbh_rndis_lwip_xmit_ref(rndis_class, p)) {
+                return;
+            }
+            txq->pending = next;
+        }
+
+        msglen = USB_ALIGN_UP(USBH_RNDIS_ETH_HDR_SIZE + p->tot_len, rndis_class->packet_align);
+        if ((pkts > 0) && ((len + msglen > max_size) || (pkts >= max_pkts))) {
+            txq->pending = p;
+            break;
+        }
+
+        if (msglen > max_size) {
+            pbuf_free(p);
+            LINK_STATS_INC(link.lenerr);
+        } else {
+            pbuf_copy_partial(p, buf + len + USBH_RNDIS_ETH_HDR_SIZE, p->tot_len, 0);
+            len += usbh_rndis_eth_fill_header(buf + len, 0, p->tot_len, rndis_class->packet_align);
+            pkts++;
+            pbuf_free(p);
+        }
+
+        p = usbh_lwip_txq_get(txq, 0);
+    }
+
+    if (pkts == 0) {
+        return;
+    }
+
+    ret = usbh_rndis_eth_output_msg(buf, len);
     if (ret < 0) {
-        return -RT_ERROR;
+        LINK_STATS_INC(link.err);
     } else {
-        return RT_EOK;
+        while (pkts--) {
+            LINK_STATS_INC(link.xmit);
+        }
     }
 }
 
+static rt_err_t rt_usbh_rndis_eth_tx(rt_device_t dev, struct pbuf *p)
+{
+    struct usbh_rndis *rndis_class = (struct usbh_rndis *)dev->user_data;
+
+    if (rndis_class->connect_status == false) {
+        return -RT_ERROR;
+    }
+    return usbh_lwip_txq_put(&g_rndis_txq, p);
+}
+
 void usbh_rndis_eth_input(uint8_t *buf, uint32_t buflen)
 {
-    usbh_lwip_eth_input_common(g_rndis_dev.netif, buf, buflen);
+    struct usbh_rndis *rndis_class = (struct usbh_rndis *)g_rndis_dev.parent.user_data;
+
+    usbh_lwip_eth_input_ring(g_rndis_dev.netif, rndis_class->rx_ring, buf, buflen);
 }
 
 void usbh_rndis_run(struct usbh_rndis *rndis_class)
 {
+    usbh_lwip_rx_pbuf_init();
     memset(&g_rndis_dev, 0, sizeof(struct eth_device));
 
     g_rndis_dev.parent.control = rt_usbh_rndis_control;
@@ -235,6 +516,7 @@ void usbh_rndis_run(struct usbh_rndis *rndis_class)
     eth_device_init(&g_rndis_dev, "u2");
     eth_device_linkchange(&g_rndis_dev, RT_TRUE);
 
+    usbh_lwip_txq_init(&g_rndis_txq, "usbh_rndis_tx", usbh_rndis_lwip_xmit);
     usb_osal_thread_create("usbh_rndis_rx", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_rndis_rx_thread, NULL);
     //timer_init(rndis_class);
 }
@@ -253,6 +535,7 @@ void usbh_rndis_stop(struct usbh_rndis *rndis_class)
 #include "usbh_cdc_ncm.h"
 
 static struct eth_device g_cdc_ncm_dev;
+static struct usbh_lwip_txq g_cdc_ncm_txq;
 
 static rt_err_t rt_usbh_cdc_ncm_control(rt_device_t dev, int cmd, void *args)
 {
@@ -276,27 +559,33 @@ static rt_err_t rt_usbh_cdc_ncm_control(rt_device_t dev, int cmd, void *args)
     return RT_EOK;
 }
 
+static void usbh_cdc_ncm_lwip_xmit(struct usbh_lwip_txq *txq, struct pbuf *p)
+{
+    (void)txq;
+
+    usbh_lwip_txq_copy_xmit(p, usbh_cdc_ncm_get_eth_txbuf(), usbh_cdc_ncm_eth_output);
+}
+
 static rt_err_t rt_usbh_cdc_ncm_eth_tx(rt_device_t dev, struct pbuf *p)
 {
-    int ret;
-    (void)dev;
+    struct usbh_cdc_ncm *cdc_ncm_class = (struct usbh_cdc_ncm *)dev->user_data;
 
-    usbh_lwip_eth_output_common(p, usbh_cdc_ncm_get_eth_txbuf());
-    ret = usbh_cdc_ncm_eth_output(p->tot_len);
-    if (ret < 0) {
+    if (cdc_ncm_class->connect_status == false) {
         return -RT_ERROR;
-    } else {
-        return RT_EOK;
     }
+    return usbh_lwip_txq_put(&g_cdc_ncm_txq, p);
 }
 
 void usbh_cdc_ncm_eth_input(uint8_t *buf, uint32_t buflen)
 {
-    usbh_lwip_eth_input_common(g_cdc_ncm_dev.netif, buf, buflen);
+    struct usbh_cdc_ncm *cdc_ncm_class = (struct usbh_cdc_ncm *)g_cdc_ncm_dev.parent.user_data;
+
+    usbh_lwip_eth_input_ring(g_cdc_ncm_dev.netif, cdc_ncm_class->rx_ring, buf, buflen);
 }
 
 void usbh_cdc_ncm_run(struct usbh_cdc_ncm *cdc_ncm_class)
 {
+    usbh_lwip_rx_pbuf_init();
     memset(&g_cdc_ncm_dev, 0, sizeof(struct eth_device));
 
     g_cdc_ncm_dev.parent.control = rt_usbh_cdc_ncm_control;
@@ -307,6 +596,7 @@ void usbh_cdc_ncm_run(struct usbh_cdc_ncm *cdc_ncm_class)
     eth_device_init(&g_cdc_ncm_dev, "u1");
     eth_device_linkchange(&g_cdc_ncm_dev, RT_TRUE);
 
+    usbh_lwip_txq_init(&g_cdc_ncm_txq, "usbh_cdc_ncm_tx", usbh_cdc_ncm_lwip_xmit);
     usb_osal_thread_create("usbh_cdc_ncm_rx", 2048, CONFIG_USBHOST_PSC_PRIO + 1, usbh_cdc_ncm_rx_thread, NULL);
 }
 
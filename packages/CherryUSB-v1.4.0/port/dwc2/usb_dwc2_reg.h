@@ -1702,6 +1702,7 @@ typedef struct
 #define HC_PID_DATA2                           1U
 #define HC_PID_DATA1                           2U
 #define HC_PID_SETUP                           3U
+#define HC_PID_MDATA                           3U
 
 #define GRXSTS_PKTSTS_IN                       2U
 #define GRXSTS_PKTSTS_IN_XFER_COMP             3U
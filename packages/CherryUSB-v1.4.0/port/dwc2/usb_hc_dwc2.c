@@ -29,6 +29,26 @@
 #define CONFIG_USB_DWC2_RX_FIFO_SIZE ((1012 - CONFIG_USB_DWC2_NPTX_FIFO_SIZE - CONFIG_USB_DWC2_PTX_FIFO_SIZE) / 4)
 #endif
 
+/* bounce buffers used when urb buffer is not 4 bytes aligned, size must be a multiple of ep mps */
+#ifndef CONFIG_USB_DWC2_BOUNCE_BUFFER_NUM
+#define CONFIG_USB_DWC2_BOUNCE_BUFFER_NUM 2
+#endif
+
+#ifndef CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE
+#define CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE 512
+#endif
+
+/* memory the internal dma cannot reach goes through bounce buffers as well */
+#ifndef CONFIG_USB_DWC2_DMA_REACHABLE
+#define CONFIG_USB_DWC2_DMA_REACHABLE(addr) 1
+#endif
+
+/* max packets programmed into HCTSIZ at a time, larger urb will be split into several dma segments */
+#define DWC2_HC_MAX_PACKET_NUM 256
+
+/* HFNUM.FRNUM wraps at 0x3fff */
+#define DWC2_FRAME_NUM_MASK 0x3fff
+
 #define USB_OTG_GLB     ((DWC2_GlobalTypeDef *)(bus->hcd.reg_base))
 #define USB_OTG_PCGCCTL *(__IO uint32_t *)((uint32_t)bus->hcd.reg_base + USB_OTG_PCGCCTL_BASE)
 #define USB_OTG_HPRT    *(__IO uint32_t *)((uint32_t)bus->hcd.reg_base + USB_OTG_HOST_PORT_BASE)
@@ -44,15 +64,27 @@ struct dwc2_chan {
     usb_osal_sem_t waitsem;
     struct usbh_urb *urb;
     uint32_t iso_frame_idx;
+    uint32_t seglen;  /* urb data length of current dma segment */
+    uint8_t *bounce;  /* NULL means dma directly into urb buffer */
+    usb_slist_t iso_queue;   /* iso urbs waiting behind chan->urb on the same ep */
+    uint16_t iso_interval;   /* in (micro)frames */
+    uint16_t iso_next_frame; /* (micro)frame the next iso packet is due */
+    bool iso_started;
+    bool iso_wait_sof;
 };
 
 struct dwc2_hcd {
     volatile bool port_csc;
     volatile bool port_pec;
     volatile bool port_occ;
+    uint32_t bounce_bitmap;
+    uint32_t iso_missed_frames;
+    uint32_t iso_late_submits;
     struct dwc2_chan chan_pool[CONFIG_USBHOST_PIPE_NUM];
 } g_dwc2_hcd[CONFIG_USBHOST_MAX_BUS];
 
+static USB_NOCACHE_RAM_SECTION USB_MEM_ALIGNX uint8_t g_dwc2_bounce_buf[CONFIG_USBHOST_MAX_BUS][CONFIG_USB_DWC2_BOUNCE_BUFFER_NUM][CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE];
+
 #define DWC2_EP0_STATE_SETUP     0
 #define DWC2_EP0_STATE_INDATA    1
 #define DWC2_EP0_STATE_OUTDATA   2
@@ -250,7 +282,7 @@ static void dwc2_chan_init(struct usbh_bus *bus, uint8_t ch_num, uint8_t devaddr
 }
 
 /* For IN channel HCTSIZ.XferSize is expected to be an integer multiple of ep_mps size.*/
-static inline void dwc2_chan_transfer(struct usbh_bus *bus, uint8_t ch_num, uint8_t ep_addr, uint32_t *buf, uint32_t size, uint8_t num_packets, uint8_t pid)
+static inline void dwc2_chan_transfer(struct usbh_bus *bus, uint8_t ch_num, uint8_t ep_addr, uint32_t *buf, uint32_t size, uint16_t num_packets, uint8_t pid)
 {
     __IO uint32_t tmpreg;
     uint8_t is_oddframe;
@@ -361,14 +393,14 @@ static void dwc2_chan_free(struct dwc2_chan *chan)
     usb_osal_leave_critical_section(flags);
 }
 
-static uint8_t dwc2_calculate_packet_num(uint32_t input_size, uint8_t ep_addr, uint16_t ep_mps, uint32_t *output_size)
+static uint16_t dwc2_calculate_packet_num(uint32_t input_size, uint8_t ep_addr, uint16_t ep_mps, uint32_t *output_size)
 {
     uint16_t num_packets;
 
     num_packets = (uint16_t)((input_size + ep_mps - 1U) / ep_mps);
 
-    if (num_packets > 256) {
-        num_packets = 256;
+    if (num_packets > DWC2_HC_MAX_PACKET_NUM) {
+        num_packets = DWC2_HC_MAX_PACKET_NUM;
     }
 
     if (input_size == 0) {
@@ -384,12 +416,48 @@ static uint8_t dwc2_calculate_packet_num(uint32_t input_size, uint8_t ep_addr, u
     return num_packets;
 }
 
+static uint8_t *dwc2_bounce_alloc(struct usbh_bus *bus)
+{
+    size_t flags;
+
+    flags = usb_osal_enter_critical_section();
+    for (uint8_t i = 0; i < CONFIG_USB_DWC2_BOUNCE_BUFFER_NUM; i++) {
+        if (!(g_dwc2_hcd[bus->hcd.hcd_id].bounce_bitmap & (1U << i))) {
+            g_dwc2_hcd[bus->hcd.hcd_id].bounce_bitmap |= (1U << i);
+            usb_osal_leave_critical_section(flags);
+            return g_dwc2_bounce_buf[bus->hcd.hcd_id][i];
+        }
+    }
+    usb_osal_leave_critical_section(flags);
+    return NULL;
+}
+
+static void dwc2_bounce_free(struct usbh_bus *bus, uint8_t *bounce)
+{
+    size_t flags;
+    uint8_t i;
+
+    if (bounce == NULL) {
+        return;
+    }
+
+    i = (bounce - g_dwc2_bounce_buf[bus->hcd.hcd_id][0]) / CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE;
+
+    flags = usb_osal_enter_critical_section();
+    g_dwc2_hcd[bus->hcd.hcd_id].bounce_bitmap &= ~(1U << i);
+    usb_osal_leave_critical_section(flags);
+}
+
 static void dwc2_control_urb_init(struct usbh_bus *bus, uint8_t chidx, struct usbh_urb *urb, struct usb_setup_packet *setup, uint8_t *buffer, uint32_t buflen)
 {
     struct dwc2_chan *chan;
 
     chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
 
+    if (chan->bounce) {
+        buffer = chan->bounce;
+    }
+
     if (chan->ep0_state == DWC2_EP0_STATE_SETUP) /* fill setup */
     {
         chan->num_packets = dwc2_calculate_packet_num(8, 0x00, USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize), &chan->xferlen);
@@ -418,26 +486,100 @@ static void dwc2_control_urb_init(struct usbh_bus *bus, uint8_t chidx, struct us
     }
 }
 
+/* Start next dma segment from urb->actual_length, urb larger than one segment will be restarted in irq */
 static void dwc2_bulk_intr_urb_init(struct usbh_bus *bus, uint8_t chidx, struct usbh_urb *urb, uint8_t *buffer, uint32_t buflen)
 {
     struct dwc2_chan *chan;
+    uint16_t ep_mps;
+    uint32_t seglen;
 
     chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
+    ep_mps = USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize);
+
+    seglen = MIN(buflen, (uint32_t)DWC2_HC_MAX_PACKET_NUM * ep_mps);
 
-    chan->num_packets = dwc2_calculate_packet_num(buflen, urb->ep->bEndpointAddress, USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize), &chan->xferlen);
-    dwc2_chan_init(bus, chidx, urb->hport->dev_addr, urb->ep->bEndpointAddress, USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes), USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize), urb->hport->speed);
+    if (chan->bounce) {
+        seglen = MIN(seglen, (CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE / ep_mps) * ep_mps);
+        if (!(urb->ep->bEndpointAddress & 0x80)) {
+            usb_memcpy(chan->bounce, buffer, seglen);
+        }
+        buffer = chan->bounce;
+    }
+
+    chan->seglen = seglen;
+    chan->num_packets = dwc2_calculate_packet_num(seglen, urb->ep->bEndpointAddress, ep_mps, &chan->xferlen);
+    dwc2_chan_init(bus, chidx, urb->hport->dev_addr, urb->ep->bEndpointAddress, USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes), ep_mps, urb->hport->speed);
     dwc2_chan_transfer(bus, chidx, urb->ep->bEndpointAddress, (uint32_t *)buffer, chan->xferlen, chan->num_packets, urb->data_toggle == 0 ? HC_PID_DATA0 : HC_PID_DATA1);
 }
 
+/* Arm one iso packet for the next (micro)frame, frames skipped since the packet was due are counted as missed */
 static void dwc2_iso_urb_init(struct usbh_bus *bus, uint8_t chidx, struct usbh_urb *urb, struct usbh_iso_frame_packet *iso_packet)
 {
     struct dwc2_chan *chan;
+    uint16_t next_frame;
+    uint16_t late;
+    uint8_t mult;
+    uint8_t pid;
 
     chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
 
+    /* dwc2_chan_transfer selects the parity of the frame following the current one */
+    next_frame = (usbh_get_frame_number(bus) + 1) & DWC2_FRAME_NUM_MASK;
+    if (chan->iso_started) {
+        late = (next_frame - chan->iso_next_frame) & DWC2_FRAME_NUM_MASK;
+        if (late && (late < (DWC2_FRAME_NUM_MASK / 2))) {
+            g_dwc2_hcd[bus->hcd.hcd_id].iso_missed_frames += (late + chan->iso_interval - 1) / chan->iso_interval;
+        }
+    }
+    chan->iso_started = true;
+    chan->iso_next_frame = (next_frame + chan->iso_interval) & DWC2_FRAME_NUM_MASK;
+
+    if (chan->iso_frame_idx == 0) {
+        urb->start_frame = next_frame;
+    }
+
+    /* high bandwidth endpoint sends up to 3 transactions per microframe */
+    mult = USB_GET_MULT(urb->ep->wMaxPacketSize);
+    if (urb->ep->bEndpointAddress & 0x80) {
+        pid = (mult == 2) ? HC_PID_DATA2 : ((mult == 1) ? HC_PID_DATA1 : HC_PID_DATA0);
+    } else {
+        pid = mult ? HC_PID_MDATA : HC_PID_DATA0;
+    }
+
     chan->num_packets = dwc2_calculate_packet_num(iso_packet->transfer_buffer_length, urb->ep->bEndpointAddress, USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize), &chan->xferlen);
     dwc2_chan_init(bus, chidx, urb->hport->dev_addr, urb->ep->bEndpointAddress, USB_ENDPOINT_TYPE_ISOCHRONOUS, USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize), urb->hport->speed);
-    dwc2_chan_transfer(bus, chidx, urb->ep->bEndpointAddress, (uint32_t *)iso_packet->transfer_buffer, chan->xferlen, chan->num_packets, HC_PID_DATA0);
+    USB_OTG_HC(chidx)->HCCHAR = (USB_OTG_HC(chidx)->HCCHAR & ~USB_OTG_HCCHAR_MC) | (((uint32_t)mult + 1) << USB_OTG_HCCHAR_MC_Pos);
+    dwc2_chan_transfer(bus, chidx, urb->ep->bEndpointAddress, (uint32_t *)iso_packet->transfer_buffer, chan->xferlen, chan->num_packets, pid);
+}
+
+/* Start current iso packet now if it is due in the next frame, otherwise wait for it in sof irq */
+static void dwc2_iso_schedule(struct usbh_bus *bus, struct dwc2_chan *chan)
+{
+    uint16_t next_frame;
+    uint16_t wait;
+
+    next_frame = (usbh_get_frame_number(bus) + 1) & DWC2_FRAME_NUM_MASK;
+    wait = (chan->iso_next_frame - next_frame) & DWC2_FRAME_NUM_MASK;
+
+    if (!chan->iso_started || (wait == 0) || (wait >= (DWC2_FRAME_NUM_MASK / 2))) {
+        dwc2_iso_urb_init(bus, chan->chidx, chan->urb, &chan->urb->iso_packet[chan->iso_frame_idx]);
+    } else {
+        chan->iso_wait_sof = true;
+        USB_OTG_GLB->GINTMSK |= USB_OTG_GINTMSK_SOFM;
+    }
+}
+
+static struct dwc2_chan *dwc2_iso_chan_find(struct usbh_bus *bus, struct usbh_urb *urb)
+{
+    struct dwc2_chan *chan;
+
+    for (uint8_t chidx = 0; chidx < CONFIG_USBHOST_PIPE_NUM; chidx++) {
+        chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
+        if (chan->inuse && chan->urb && (chan->urb->hport == urb->hport) && (chan->urb->ep == urb->ep)) {
+            return chan;
+        }
+    }
+    return NULL;
 }
 
 __WEAK void usb_hc_low_level_init(struct usbh_bus *bus)
@@ -593,6 +735,13 @@ uint16_t usbh_get_frame_number(struct usbh_bus *bus)
     return (USB_OTG_HOST->HFNUM & USB_OTG_HFNUM_FRNUM);
 }
 
+int usbh_get_iso_stat(struct usbh_bus *bus, struct usbh_iso_stat *stat)
+{
+    stat->missed_frames = g_dwc2_hcd[bus->hcd.hcd_id].iso_missed_frames;
+    stat->late_submits = g_dwc2_hcd[bus->hcd.hcd_id].iso_late_submits;
+    return 0;
+}
+
 int usbh_roothub_control(struct usbh_bus *bus, struct usb_setup_packet *setup, uint8_t *buf)
 {
     __IO uint32_t hprt0;
@@ -734,6 +883,7 @@ int usbh_submit_urb(struct usbh_urb *urb)
 {
     struct dwc2_chan *chan;
     struct usbh_bus *bus;
+    uint8_t *bounce = NULL;
     size_t flags;
     int ret = 0;
     int chidx;
@@ -743,7 +893,7 @@ int usbh_submit_urb(struct usbh_urb *urb)
     }
 
     /* dma addr must be aligned 4 bytes */
-    if ((((uint32_t)urb->setup) & 0x03) || (((uint32_t)urb->transfer_buffer) & 0x03)) {
+    if ((((uint32_t)urb->setup) & 0x03) || !CONFIG_USB_DWC2_DMA_REACHABLE(urb->setup)) {
         return -USB_ERR_INVAL;
     }
 
@@ -757,11 +907,6 @@ int usbh_submit_urb(struct usbh_urb *urb)
         return -USB_ERR_BUSY;
     }
 
-    chidx = dwc2_chan_alloc(bus);
-    if (chidx == -1) {
-        return -USB_ERR_NOMEM;
-    }
-
     if (urb->ep->bEndpointAddress & 0x80) {
         /* Check if pipe rx fifo is overflow */
         if (USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize) > (CONFIG_USB_DWC2_RX_FIFO_SIZE * 4)) {
@@ -781,11 +926,60 @@ int usbh_submit_urb(struct usbh_urb *urb)
         }
     }
 
+    if (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+        /* iso urb is async only, so that next urb can be queued while current one is streaming */
+        if (urb->timeout || (urb->num_of_iso_packets == 0)) {
+            return -USB_ERR_INVAL;
+        }
+        for (uint32_t i = 0; i < urb->num_of_iso_packets; i++) {
+            if ((((uint32_t)urb->iso_packet[i].transfer_buffer) & 0x03) ||
+                !CONFIG_USB_DWC2_DMA_REACHABLE(urb->iso_packet[i].transfer_buffer)) {
+                return -USB_ERR_INVAL;
+            }
+        }
+
+        flags = usb_osal_enter_critical_section();
+        chan = dwc2_iso_chan_find(bus, urb);
+        if (chan) {
+            urb->hcpriv = chan;
+            urb->errorcode = -USB_ERR_BUSY;
+            urb->actual_length = 0;
+            usb_slist_add_tail(&chan->iso_queue, &urb->list);
+            usb_osal_leave_critical_section(flags);
+            return 0;
+        }
+        usb_osal_leave_critical_section(flags);
+    }
+
+    /* unaligned urb buffer goes through bounce buffer, bulk and intr urb will be split by bounce buffer size */
+    if ((USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) != USB_ENDPOINT_TYPE_ISOCHRONOUS) &&
+        ((((uint32_t)urb->transfer_buffer) & 0x03) || !CONFIG_USB_DWC2_DMA_REACHABLE(urb->transfer_buffer))) {
+        if (USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize) > CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE) {
+            return -USB_ERR_RANGE;
+        }
+        if ((USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_CONTROL) &&
+            (urb->setup->wLength > CONFIG_USB_DWC2_BOUNCE_BUFFER_SIZE)) {
+            return -USB_ERR_RANGE;
+        }
+
+        bounce = dwc2_bounce_alloc(bus);
+        if (bounce == NULL) {
+            return -USB_ERR_NOMEM;
+        }
+    }
+
+    chidx = dwc2_chan_alloc(bus);
+    if (chidx == -1) {
+        dwc2_bounce_free(bus, bounce);
+        return -USB_ERR_NOMEM;
+    }
+
     flags = usb_osal_enter_critical_section();
 
     chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
     chan->chidx = chidx;
     chan->urb = urb;
+    chan->bounce = bounce;
 
     urb->hcpriv = chan;
     urb->errorcode = -USB_ERR_BUSY;
@@ -796,6 +990,9 @@ int usbh_submit_urb(struct usbh_urb *urb)
     switch (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes)) {
         case USB_ENDPOINT_TYPE_CONTROL:
             chan->ep0_state = DWC2_EP0_STATE_SETUP;
+            if (chan->bounce && !(urb->setup->bmRequestType & 0x80)) {
+                usb_memcpy(chan->bounce, urb->transfer_buffer, urb->setup->wLength);
+            }
             dwc2_control_urb_init(bus, chidx, urb, urb->setup, urb->transfer_buffer, urb->transfer_buffer_length);
             break;
         case USB_ENDPOINT_TYPE_BULK:
@@ -803,6 +1000,12 @@ int usbh_submit_urb(struct usbh_urb *urb)
             dwc2_bulk_intr_urb_init(bus, chidx, urb, urb->transfer_buffer, urb->transfer_buffer_length);
             break;
         case USB_ENDPOINT_TYPE_ISOCHRONOUS:
+            chan->iso_frame_idx = 0;
+            chan->iso_interval = 1 << (MIN(MAX(urb->ep->bInterval, 1), 16) - 1);
+            chan->iso_started = false;
+            chan->iso_wait_sof = false;
+            usb_slist_init(&chan->iso_queue);
+            dwc2_iso_urb_init(bus, chidx, urb, &urb->iso_packet[0]);
             break;
         default:
             break;
@@ -842,8 +1045,33 @@ int usbh_kill_urb(struct usbh_urb *urb)
 
     chan = (struct dwc2_chan *)urb->hcpriv;
 
+    if (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+        struct usbh_urb *iso_urb;
+
+        if (chan->urb != urb) {
+            /* only queued, channel keeps streaming */
+            usb_slist_remove(&chan->iso_queue, &urb->list);
+            urb->hcpriv = NULL;
+            urb->errorcode = -USB_ERR_SHUTDOWN;
+            usb_osal_leave_critical_section(flags);
+            return 0;
+        }
+
+        usb_slist_for_each_entry(iso_urb, &chan->iso_queue, list)
+        {
+            iso_urb->hcpriv = NULL;
+            iso_urb->errorcode = -USB_ERR_SHUTDOWN;
+        }
+        usb_slist_init(&chan->iso_queue);
+        chan->iso_started = false;
+        chan->iso_wait_sof = false;
+    }
+
     dwc2_halt(bus, chan->chidx);
 
+    dwc2_bounce_free(bus, chan->bounce);
+    chan->bounce = NULL;
+
     chan->urb = NULL;
     urb->hcpriv = NULL;
     urb->errorcode = -USB_ERR_SHUTDOWN;
@@ -859,7 +1087,7 @@ int usbh_kill_urb(struct usbh_urb *urb)
     return 0;
 }
 
-static inline void dwc2_urb_waitup(struct usbh_urb *urb)
+static inline void dwc2_urb_waitup(struct usbh_bus *bus, struct usbh_urb *urb)
 {
     struct dwc2_chan *chan;
 
@@ -867,6 +1095,9 @@ static inline void dwc2_urb_waitup(struct usbh_urb *urb)
     chan->urb = NULL;
     urb->hcpriv = NULL;
 
+    dwc2_bounce_free(bus, chan->bounce);
+    chan->bounce = NULL;
+
     if (urb->timeout) {
         usb_osal_sem_give(chan->waitsem);
     } else {
@@ -882,6 +1113,96 @@ static inline void dwc2_urb_waitup(struct usbh_urb *urb)
     }
 }
 
+static void dwc2_iso_irq_handler(struct usbh_bus *bus, uint8_t ch_num, uint32_t chan_intstatus)
+{
+    struct dwc2_hcd *hcd;
+    struct dwc2_chan *chan;
+    struct usbh_urb *urb;
+    struct usbh_urb *next;
+    struct usbh_iso_frame_packet *iso_packet;
+
+    hcd = &g_dwc2_hcd[bus->hcd.hcd_id];
+    chan = &hcd->chan_pool[ch_num];
+    urb = chan->urb;
+
+    iso_packet = &urb->iso_packet[chan->iso_frame_idx];
+    if (chan_intstatus & USB_OTG_HCINT_XFRC) {
+        if (urb->ep->bEndpointAddress & 0x80) {
+            iso_packet->actual_length = chan->xferlen - (USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_XFRSIZ);
+        } else {
+            iso_packet->actual_length = iso_packet->transfer_buffer_length;
+        }
+        iso_packet->errorcode = 0;
+        urb->actual_length += iso_packet->actual_length;
+    } else {
+        /* iso has no retry, drop this packet and go on with the next one */
+        if (chan_intstatus & USB_OTG_HCINT_FRMOR) {
+            hcd->iso_missed_frames++;
+        }
+        iso_packet->actual_length = 0;
+        iso_packet->errorcode = (chan_intstatus & USB_OTG_HCINT_BBERR) ? -USB_ERR_BABBLE : -USB_ERR_IO;
+    }
+
+    chan->iso_frame_idx++;
+    if (chan->iso_frame_idx < urb->num_of_iso_packets) {
+        dwc2_iso_schedule(bus, chan);
+        return;
+    }
+
+    urb->errorcode = 0;
+    urb->hcpriv = NULL;
+
+    /* hand the channel to the queued urb first, so that no frame is lost while class handles this one */
+    next = usb_slist_first_entry_or_null(&chan->iso_queue, struct usbh_urb, list);
+    if (next) {
+        usb_slist_remove(&chan->iso_queue, &next->list);
+        chan->urb = next;
+        chan->iso_frame_idx = 0;
+        dwc2_iso_schedule(bus, chan);
+    } else {
+        /* queue ran dry, the next urb was not submitted in time unless the class stops the stream here */
+        if (urb->transfer_flags & USBH_URB_ISO_STREAM) {
+            hcd->iso_late_submits++;
+        }
+        chan->urb = NULL;
+        chan->iso_started = false;
+        dwc2_chan_free(chan);
+    }
+
+    if (urb->complete) {
+        urb->complete(urb->arg, urb->actual_length);
+    }
+}
+
+static void dwc2_sof_irq_handler(struct usbh_bus *bus)
+{
+    struct dwc2_chan *chan;
+    uint16_t next_frame;
+    uint16_t wait;
+    bool waiting = false;
+
+    next_frame = (usbh_get_frame_number(bus) + 1) & DWC2_FRAME_NUM_MASK;
+
+    for (uint8_t chidx = 0; chidx < CONFIG_USBHOST_PIPE_NUM; chidx++) {
+        chan = &g_dwc2_hcd[bus->hcd.hcd_id].chan_pool[chidx];
+        if (!chan->iso_wait_sof || !chan->urb) {
+            continue;
+        }
+
+        wait = (chan->iso_next_frame - next_frame) & DWC2_FRAME_NUM_MASK;
+        if ((wait == 0) || (wait >= (DWC2_FRAME_NUM_MASK / 2))) {
+            chan->iso_wait_sof = false;
+            dwc2_iso_urb_init(bus, chidx, chan->urb, &chan->urb->iso_packet[chan->iso_frame_idx]);
+        } else {
+            waiting = true;
+        }
+    }
+
+    if (!waiting) {
+        USB_OTG_GLB->GINTMSK &= ~USB_OTG_GINTMSK_SOFM;
+    }
+}
+
 static void dwc2_inchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
 {
     uint32_t chan_intstatus;
@@ -894,6 +1215,12 @@ static void dwc2_inchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
     urb = chan->urb;
     //printf("s1:%08x\r\n", chan_intstatus);
 
+    if ((chan_intstatus & USB_OTG_HCINT_CHH) && urb && (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS)) {
+        USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
+        dwc2_iso_irq_handler(bus, ch_num, chan_intstatus);
+        return;
+    }
+
     if (chan_intstatus & USB_OTG_HCINT_CHH) {
         if (chan_intstatus & USB_OTG_HCINT_XFRC) {
             urb->errorcode = 0;
@@ -901,6 +1228,18 @@ static void dwc2_inchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
             uint32_t count = chan->xferlen - (USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_XFRSIZ);                        /* how many size has received */
             uint32_t has_used_packets = chan->num_packets - ((USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_PKTCNT) >> 19); /* how many packets have used */
 
+            if (chan->bounce) {
+                if (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_CONTROL) {
+                    if (chan->ep0_state == DWC2_EP0_STATE_INDATA) {
+                        usb_memcpy(urb->transfer_buffer, chan->bounce, MIN(count, urb->setup->wLength));
+                    }
+                } else {
+                    /* never copy more than caller asked for, the bounce segment is rounded up to mps */
+                    count = MIN(count, chan->seglen);
+                    usb_memcpy(urb->transfer_buffer + urb->actual_length, chan->bounce, count);
+                }
+            }
+
             urb->actual_length += count;
 
             uint8_t data_toggle = ((USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_DPID) >> USB_OTG_HCTSIZ_DPID_Pos);
@@ -917,36 +1256,40 @@ static void dwc2_inchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
                     dwc2_control_urb_init(bus, ch_num, urb, urb->setup, urb->transfer_buffer, urb->transfer_buffer_length);
                 } else if (chan->ep0_state == DWC2_EP0_STATE_INSTATUS) {
                     chan->ep0_state = DWC2_EP0_STATE_SETUP;
-                    dwc2_urb_waitup(urb);
+                    dwc2_urb_waitup(bus, urb);
                 }
-            } else if (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+            } else if ((count == chan->seglen) && (urb->actual_length < urb->transfer_buffer_length)) {
+                /* segment done without short packet, start next one from irq */
+                USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
+                dwc2_bulk_intr_urb_init(bus, ch_num, urb, urb->transfer_buffer + urb->actual_length, urb->transfer_buffer_length - urb->actual_length);
+                return;
             } else {
-                dwc2_urb_waitup(urb);
+                dwc2_urb_waitup(bus, urb);
             }
         } else if (chan_intstatus & USB_OTG_HCINT_AHBERR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_STALL) {
             urb->errorcode = -USB_ERR_STALL;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_NAK) {
             urb->errorcode = -USB_ERR_NAK;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_NYET) {
             urb->errorcode = -USB_ERR_NAK;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_TXERR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_BBERR) {
             urb->errorcode = -USB_ERR_BABBLE;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_DTERR) {
             urb->errorcode = -USB_ERR_DT;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_FRMOR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         }
         USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
     }
@@ -964,6 +1307,12 @@ static void dwc2_outchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
     urb = chan->urb;
     //printf("s2:%08x\r\n", chan_intstatus);
 
+    if ((chan_intstatus & USB_OTG_HCINT_CHH) && urb && (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS)) {
+        USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
+        dwc2_iso_irq_handler(bus, ch_num, chan_intstatus);
+        return;
+    }
+
     if (chan_intstatus & USB_OTG_HCINT_CHH) {
         if (chan_intstatus & USB_OTG_HCINT_XFRC) {
             urb->errorcode = 0;
@@ -971,7 +1320,8 @@ static void dwc2_outchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
             uint32_t count = USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_XFRSIZ;                                          /* last packet size */
             uint32_t has_used_packets = chan->num_packets - ((USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_PKTCNT) >> 19); /* how many packets have used */
 
-            urb->actual_length += (has_used_packets - 1) * USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize) + count; //the same with urb->actual_length += chan->xferlen;
+            count += (has_used_packets - 1) * USB_GET_MAXPACKETSIZE(urb->ep->wMaxPacketSize); //the same with count = chan->xferlen;
+            urb->actual_length += count;
 
             uint8_t data_toggle = ((USB_OTG_HC(ch_num)->HCTSIZ & USB_OTG_HCTSIZ_DPID) >> USB_OTG_HCTSIZ_DPID_Pos);
 
@@ -998,36 +1348,40 @@ static void dwc2_outchan_irq_handler(struct usbh_bus *bus, uint8_t ch_num)
                     dwc2_control_urb_init(bus, ch_num, urb, urb->setup, urb->transfer_buffer, urb->transfer_buffer_length);
                 } else if (chan->ep0_state == DWC2_EP0_STATE_OUTSTATUS) {
                     chan->ep0_state = DWC2_EP0_STATE_SETUP;
-                    dwc2_urb_waitup(urb);
+                    dwc2_urb_waitup(bus, urb);
                 }
-            } else if (USB_GET_ENDPOINT_TYPE(urb->ep->bmAttributes) == USB_ENDPOINT_TYPE_ISOCHRONOUS) {
+            } else if (urb->actual_length < urb->transfer_buffer_length) {
+                /* start next segment from irq */
+                USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
+                dwc2_bulk_intr_urb_init(bus, ch_num, urb, urb->transfer_buffer + urb->actual_length, urb->transfer_buffer_length - urb->actual_length);
+                return;
             } else {
-                dwc2_urb_waitup(urb);
+                dwc2_urb_waitup(bus, urb);
             }
         } else if (chan_intstatus & USB_OTG_HCINT_AHBERR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_STALL) {
             urb->errorcode = -USB_ERR_STALL;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_NAK) {
             urb->errorcode = -USB_ERR_NAK;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_NYET) {
             urb->errorcode = -USB_ERR_NAK;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_TXERR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_BBERR) {
             urb->errorcode = -USB_ERR_BABBLE;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_DTERR) {
             urb->errorcode = -USB_ERR_DT;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         } else if (chan_intstatus & USB_OTG_HCINT_FRMOR) {
             urb->errorcode = -USB_ERR_IO;
-            dwc2_urb_waitup(urb);
+            dwc2_urb_waitup(bus, urb);
         }
         USB_OTG_HC(ch_num)->HCINT = chan_intstatus;
     }
@@ -1109,6 +1463,10 @@ void USBH_IRQHandler(uint8_t busid)
         if (gint_status & USB_OTG_GINTSTS_HPRTINT) {
             dwc2_port_irq_handler(bus);
         }
+        if (gint_status & USB_OTG_GINTSTS_SOF) {
+            dwc2_sof_irq_handler(bus);
+            USB_OTG_GLB->GINTSTS = USB_OTG_GINTSTS_SOF;
+        }
         if (gint_status & USB_OTG_GINTSTS_DISCINT) {
             g_dwc2_hcd[bus->hcd.hcd_id].port_csc = 1;
             bus->hcd.roothub.int_buffer[0] = (1 << 1);
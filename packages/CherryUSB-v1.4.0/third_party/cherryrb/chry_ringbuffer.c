@@ -472,3 +472,403 @@ uint32_t chry_ringbuffer_linear_read_done(chry_ringbuffer_t *rb, uint32_t size)
 {
     return chry_ringbuffer_drop(rb, size);
 }
+
+/*
+ * Single producer single consumer variant.
+ *
+ * in is only written by the producer and out only by the consumer. The other side's pointer is
+ * loaded once per call through a volatile access, and the barrier orders the pool access against
+ * publishing the pointer, so data copied in is visible before in moves, and a region handed back
+ * by read done is not reused before the consumer finished with it.
+ */
+#ifndef CHRY_RB_BARRIER
+#if defined(__GNUC__) || defined(__clang__)
+#define CHRY_RB_BARRIER() __sync_synchronize()
+#elif defined(__CC_ARM)
+#define CHRY_RB_BARRIER() __dmb(0xF)
+#else
+#define CHRY_RB_BARRIER() do { } while (0)
+#endif
+#endif
+
+#define CHRY_RB_LOAD(v)     (*(volatile uint32_t *)&(v))
+#define CHRY_RB_STORE(v, x) (*(volatile uint32_t *)&(v) = (x))
+
+static void chry_ringbuffer_spsc_wake_rx(chry_ringbuffer_spsc_t *spsc)
+{
+    uint32_t want;
+
+    CHRY_RB_BARRIER();
+    want = spsc->rx_want;
+    if (want && (CHRY_RB_LOAD(spsc->rb.in) - CHRY_RB_LOAD(spsc->rb.out) >= want)) {
+        spsc->rx_want = 0;
+        spsc->signal(spsc->rx_event);
+    }
+}
+
+static void chry_ringbuffer_spsc_wake_tx(chry_ringbuffer_spsc_t *spsc)
+{
+    uint32_t want;
+
+    CHRY_RB_BARRIER();
+    want = spsc->tx_want;
+    if (want && ((spsc->rb.mask + 1) - (CHRY_RB_LOAD(spsc->rb.in) - CHRY_RB_LOAD(spsc->rb.out)) >= want)) {
+        spsc->tx_want = 0;
+        spsc->signal(spsc->tx_event);
+    }
+}
+
+/*****************************************************************************
+* @brief        init spsc ringbuffer, without event the wait api returns
+*               at once
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    pool        memory pool address
+* @param[in]    size        memory size in byte,
+*                           must be power of 2 !!!
+* 
+* @retval int               0:Success -1:Error
+*****************************************************************************/
+int chry_ringbuffer_spsc_init(chry_ringbuffer_spsc_t *spsc, void *pool, uint32_t size)
+{
+    if (NULL == spsc) {
+        return -1;
+    }
+
+    memset(spsc, 0, sizeof(chry_ringbuffer_spsc_t));
+    return chry_ringbuffer_init(&spsc->rb, pool, size);
+}
+
+/*****************************************************************************
+* @brief        set os hooks for blocking wait, call before both sides run
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    rx_event    event for consumer, such as a semaphore
+* @param[in]    tx_event    event for producer, NULL if producer never waits
+* @param[in]    wait        block on event with timeout, return 0 when signalled
+* @param[in]    signal      wake event, must be callable in isr
+* 
+*****************************************************************************/
+void chry_ringbuffer_spsc_set_event(chry_ringbuffer_spsc_t *spsc, void *rx_event, void *tx_event,
+                                    int (*wait)(void *event, uint32_t timeout), void (*signal)(void *event))
+{
+    spsc->rx_event = rx_event;
+    spsc->tx_event = tx_event;
+    spsc->wait = wait;
+    spsc->signal = signal;
+}
+
+/*****************************************************************************
+* @brief        get spsc ringbuffer used size in byte, safe on both sides
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* 
+* @retval uint32_t          used size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_get_used(chry_ringbuffer_spsc_t *spsc)
+{
+    return CHRY_RB_LOAD(spsc->rb.in) - CHRY_RB_LOAD(spsc->rb.out);
+}
+
+/*****************************************************************************
+* @brief        get spsc ringbuffer free size in byte, safe on both sides
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* 
+* @retval uint32_t          free size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_get_free(chry_ringbuffer_spsc_t *spsc)
+{
+    return (spsc->rb.mask + 1) - chry_ringbuffer_spsc_get_used(spsc);
+}
+
+/*****************************************************************************
+* @brief        write data to spsc ringbuffer, producer side only,
+*               wakes the consumer when it waits for this much data
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    data        data pointer
+* @param[in]    size        size in byte
+* 
+* @retval uint32_t          actual write size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_write(chry_ringbuffer_spsc_t *spsc, void *data, uint32_t size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t in = rb->in;
+    uint32_t unused;
+    uint32_t offset;
+    uint32_t remain;
+
+    unused = (rb->mask + 1) - (in - CHRY_RB_LOAD(rb->out));
+
+    if (size > unused) {
+        size = unused;
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    offset = in & rb->mask;
+
+    remain = rb->mask + 1 - offset;
+    remain = remain > size ? size : remain;
+
+    /* out was loaded before the copy, the region is free */
+    CHRY_RB_BARRIER();
+    memcpy(((uint8_t *)(rb->pool)) + offset, data, remain);
+    memcpy(rb->pool, (uint8_t *)data + remain, size - remain);
+    CHRY_RB_BARRIER();
+
+    CHRY_RB_STORE(rb->in, in + size);
+    chry_ringbuffer_spsc_wake_rx(spsc);
+
+    return size;
+}
+
+/*****************************************************************************
+* @brief        read data from spsc ringbuffer, consumer side only,
+*               wakes the producer when it waits for this much space
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    data        data pointer
+* @param[in]    size        size in byte
+* 
+* @retval uint32_t          actual read size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_read(chry_ringbuffer_spsc_t *spsc, void *data, uint32_t size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t out = rb->out;
+    uint32_t used;
+    uint32_t offset;
+    uint32_t remain;
+
+    used = CHRY_RB_LOAD(rb->in) - out;
+    if (size > used) {
+        size = used;
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+
+    offset = out & rb->mask;
+
+    remain = rb->mask + 1 - offset;
+    remain = remain > size ? size : remain;
+
+    /* data behind in is visible once in is seen */
+    CHRY_RB_BARRIER();
+    memcpy(data, ((uint8_t *)(rb->pool)) + offset, remain);
+    memcpy((uint8_t *)data + remain, rb->pool, size - remain);
+    CHRY_RB_BARRIER();
+
+    CHRY_RB_STORE(rb->out, out + size);
+    chry_ringbuffer_spsc_wake_tx(spsc);
+
+    return size;
+}
+
+/*****************************************************************************
+* @brief        linear write setup, producer side only, the region can be
+*               handed to dma and committed by linear write done
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        pointer to store max linear size in byte
+* 
+* @retval void*             write memory pointer
+*****************************************************************************/
+void *chry_ringbuffer_spsc_linear_write_setup(chry_ringbuffer_spsc_t *spsc, uint32_t *size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t in = rb->in;
+    uint32_t unused;
+    uint32_t offset;
+    uint32_t remain;
+
+    unused = (rb->mask + 1) - (in - CHRY_RB_LOAD(rb->out));
+
+    offset = in & rb->mask;
+
+    remain = rb->mask + 1 - offset;
+    remain = remain > unused ? unused : remain;
+
+    CHRY_RB_BARRIER();
+    *size = remain;
+    return ((uint8_t *)(rb->pool)) + offset;
+}
+
+/*****************************************************************************
+* @brief        linear read setup, consumer side only, the region can be
+*               handed to dma and released by linear read done
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        pointer to store max linear size in byte
+* 
+* @retval void*             read memory pointer
+*****************************************************************************/
+void *chry_ringbuffer_spsc_linear_read_setup(chry_ringbuffer_spsc_t *spsc, uint32_t *size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t out = rb->out;
+    uint32_t used;
+    uint32_t offset;
+    uint32_t remain;
+
+    used = CHRY_RB_LOAD(rb->in) - out;
+
+    offset = out & rb->mask;
+
+    remain = rb->mask + 1 - offset;
+    remain = remain > used ? used : remain;
+
+    CHRY_RB_BARRIER();
+    *size = remain;
+    return ((uint8_t *)(rb->pool)) + offset;
+}
+
+/*****************************************************************************
+* @brief        linear write done, publish data written into the region
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        write size in byte
+* 
+* @retval uint32_t          actual write size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_linear_write_done(chry_ringbuffer_spsc_t *spsc, uint32_t size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t in = rb->in;
+    uint32_t unused;
+
+    unused = (rb->mask + 1) - (in - CHRY_RB_LOAD(rb->out));
+    if (size > unused) {
+        size = unused;
+    }
+
+    CHRY_RB_BARRIER();
+    CHRY_RB_STORE(rb->in, in + size);
+    chry_ringbuffer_spsc_wake_rx(spsc);
+
+    return size;
+}
+
+/*****************************************************************************
+* @brief        linear read done, release the region to the producer
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        read size in byte
+* 
+* @retval uint32_t          actual read size in byte
+*****************************************************************************/
+uint32_t chry_ringbuffer_spsc_linear_read_done(chry_ringbuffer_spsc_t *spsc, uint32_t size)
+{
+    chry_ringbuffer_t *rb = &spsc->rb;
+    uint32_t out = rb->out;
+    uint32_t used;
+
+    used = CHRY_RB_LOAD(rb->in) - out;
+    if (size > used) {
+        size = used;
+    }
+
+    CHRY_RB_BARRIER();
+    CHRY_RB_STORE(rb->out, out + size);
+    chry_ringbuffer_spsc_wake_tx(spsc);
+
+    return size;
+}
+
+/*****************************************************************************
+* @brief        wait until at least size bytes can be read, consumer side
+*               only, the want is published before the last check so a
+*               producer running in between always sees it
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        size in byte, limited to ringbuffer size
+* @param[in]    timeout     passed to wait hook
+* 
+* @retval int               used size in byte, -1:timeout
+*****************************************************************************/
+int chry_ringbuffer_spsc_wait_data(chry_ringbuffer_spsc_t *spsc, uint32_t size, uint32_t timeout)
+{
+    uint32_t used;
+
+    if (size == 0) {
+        size = 1;
+    }
+    if (size > spsc->rb.mask + 1) {
+        size = spsc->rb.mask + 1;
+    }
+
+    for (;;) {
+        used = chry_ringbuffer_spsc_get_used(spsc);
+        if ((used >= size) || (NULL == spsc->wait)) {
+            break;
+        }
+
+        spsc->rx_want = size;
+        CHRY_RB_BARRIER();
+        used = chry_ringbuffer_spsc_get_used(spsc);
+        if (used >= size) {
+            spsc->rx_want = 0;
+            break;
+        }
+
+        /* a stale signal only makes one more round */
+        if (spsc->wait(spsc->rx_event, timeout) != 0) {
+            spsc->rx_want = 0;
+            used = chry_ringbuffer_spsc_get_used(spsc);
+            break;
+        }
+    }
+
+    return used >= size ? (int)used : -1;
+}
+
+/*****************************************************************************
+* @brief        wait until at least size bytes can be written, producer
+*               side only, must not be called in isr
+* 
+* @param[in]    spsc        spsc ringbuffer instance
+* @param[in]    size        size in byte, limited to ringbuffer size
+* @param[in]    timeout     passed to wait hook
+* 
+* @retval int               free size in byte, -1:timeout
+*****************************************************************************/
+int chry_ringbuffer_spsc_wait_free(chry_ringbuffer_spsc_t *spsc, uint32_t size, uint32_t timeout)
+{
+    uint32_t unused;
+
+    if (size == 0) {
+        size = 1;
+    }
+    if (size > spsc->rb.mask + 1) {
+        size = spsc->rb.mask + 1;
+    }
+
+    for (;;) {
+        unused = chry_ringbuffer_spsc_get_free(spsc);
+        if ((unused >= size) || (NULL == spsc->wait)) {
+            break;
+        }
+
+        spsc->tx_want = size;
+        CHRY_RB_BARRIER();
+        unused = chry_ringbuffer_spsc_get_free(spsc);
+        if (unused >= size) {
+            spsc->tx_want = 0;
+            break;
+        }
+
+        if (spsc->wait(spsc->tx_event, timeout) != 0) {
+            spsc->tx_want = 0;
+            unused = chry_ringbuffer_spsc_get_free(spsc);
+            break;
+        }
+    }
+
+    return unused >= size ? (int)unused : -1;
+}
@@ -21,6 +21,21 @@ typedef struct {
     void *pool;    /*!< Define the memory pointer.              */
 } chry_ringbuffer_t;
 
+/**
+ * single producer single consumer ringbuffer, in and out are published with a memory barrier
+ * so one side can live in isr or dma complete callback without lock. wait and signal are the
+ * os hooks for blocking, signal is only called when the other side is sleeping.
+ */
+typedef struct {
+    chry_ringbuffer_t rb;
+    volatile uint32_t rx_want;                  /*!< consumer sleeps until this many bytes used, 0:not waiting */
+    volatile uint32_t tx_want;                  /*!< producer sleeps until this many bytes free, 0:not waiting */
+    void *rx_event;                             /*!< event the consumer waits on                              */
+    void *tx_event;                             /*!< event the producer waits on                              */
+    int (*wait)(void *event, uint32_t timeout); /*!< block on event, 0:signalled                              */
+    void (*signal)(void *event);                /*!< wake event, may be called in isr                         */
+} chry_ringbuffer_spsc_t;
+
 extern int chry_ringbuffer_init(chry_ringbuffer_t *rb, void *pool, uint32_t size);
 extern void chry_ringbuffer_reset(chry_ringbuffer_t *rb);
 extern void chry_ringbuffer_reset_read(chry_ringbuffer_t *rb);
@@ -49,6 +64,24 @@ extern void *chry_ringbuffer_linear_read_setup(chry_ringbuffer_t *rb, uint32_t *
 extern uint32_t chry_ringbuffer_linear_write_done(chry_ringbuffer_t *rb, uint32_t size);
 extern uint32_t chry_ringbuffer_linear_read_done(chry_ringbuffer_t *rb, uint32_t size);
 
+extern int chry_ringbuffer_spsc_init(chry_ringbuffer_spsc_t *spsc, void *pool, uint32_t size);
+extern void chry_ringbuffer_spsc_set_event(chry_ringbuffer_spsc_t *spsc, void *rx_event, void *tx_event,
+                                           int (*wait)(void *event, uint32_t timeout), void (*signal)(void *event));
+
+extern uint32_t chry_ringbuffer_spsc_get_used(chry_ringbuffer_spsc_t *spsc);
+extern uint32_t chry_ringbuffer_spsc_get_free(chry_ringbuffer_spsc_t *spsc);
+
+extern uint32_t chry_ringbuffer_spsc_write(chry_ringbuffer_spsc_t *spsc, void *data, uint32_t size);
+extern uint32_t chry_ringbuffer_spsc_read(chry_ringbuffer_spsc_t *spsc, void *data, uint32_t size);
+
+extern void *chry_ringbuffer_spsc_linear_write_setup(chry_ringbuffer_spsc_t *spsc, uint32_t *size);
+extern void *chry_ringbuffer_spsc_linear_read_setup(chry_ringbuffer_spsc_t *spsc, uint32_t *size);
+extern uint32_t chry_ringbuffer_spsc_linear_write_done(chry_ringbuffer_spsc_t *spsc, uint32_t size);
+extern uint32_t chry_ringbuffer_spsc_linear_read_done(chry_ringbuffer_spsc_t *spsc, uint32_t size);
+
+extern int chry_ringbuffer_spsc_wait_data(chry_ringbuffer_spsc_t *spsc, uint32_t size, uint32_t timeout);
+extern int chry_ringbuffer_spsc_wait_free(chry_ringbuffer_spsc_t *spsc, uint32_t size, uint32_t timeout);
+
 #ifdef __cplusplus
 }
 #endif
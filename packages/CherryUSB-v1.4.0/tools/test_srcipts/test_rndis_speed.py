@@ -0,0 +1,108 @@
+import struct
+import sys
+import time
+
+import usb.core
+import usb.util
+
+# Stands in for the host rndis driver to measure the rndis device class (cdc_rndis_template).
+# Out: packed REMOTE_NDIS_PACKET_MSG transfers as the device allows (MaxPacketsPerTransfer, MaxTransferSize,
+# PacketAlignmentFactor), frames of an experimental ethertype the device stack drops.
+# In: run "rndis_bench tx" on the device console and parse what comes on bulk in.
+# On linux the kernel rndis_host driver is detached first, run as root.
+
+test_vid = 0xEFFF
+test_pid = 0xEFFF
+test_seconds = 5
+test_frame_len = 1514
+test_host_max_transfer = 16384
+
+REMOTE_NDIS_PACKET_MSG = 0x00000001
+REMOTE_NDIS_INITIALIZE_MSG = 0x00000002
+REMOTE_NDIS_SET_MSG = 0x00000005
+OID_GEN_CURRENT_PACKET_FILTER = 0x0001010E
+RNDIS_HEADER_LEN = 44
+
+dev = usb.core.find(idVendor=test_vid, idProduct=test_pid)
+if dev is None:
+    sys.exit('rndis device %04x:%04x not found' % (test_vid, test_pid))
+
+for intf in dev.get_active_configuration():
+    if dev.is_kernel_driver_active(intf.bInterfaceNumber):
+        dev.detach_kernel_driver(intf.bInterfaceNumber)
+
+data_intf = usb.util.find_descriptor(dev.get_active_configuration(), bInterfaceClass=0x0A)
+ep_out = usb.util.find_descriptor(data_intf, custom_match=lambda e: usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_OUT)
+ep_in = usb.util.find_descriptor(data_intf, custom_match=lambda e: usb.util.endpoint_direction(e.bEndpointAddress) == usb.util.ENDPOINT_IN)
+
+
+def rndis_command(msg):
+    dev.ctrl_transfer(0x21, 0x00, 0, 0, msg)
+    time.sleep(0.01)
+    return bytes(dev.ctrl_transfer(0xA1, 0x01, 0, 0, 1025))
+
+
+def rndis_init():
+    resp = rndis_command(struct.pack('<6I', REMOTE_NDIS_INITIALIZE_MSG, 24, 1, 1, 0, test_host_max_transfer))
+    fields = struct.unpack('<11I', resp[:44])
+    max_pkts, max_size, align = fields[8], fields[9], fields[10]
+    rndis_command(struct.pack('<8I', REMOTE_NDIS_SET_MSG, 32, 2, OID_GEN_CURRENT_PACKET_FILTER, 4, 20, 0, 0x0F))
+    return max(max_pkts, 1), max_size, 1 << align
+
+
+def test_rndis_out(max_pkts, max_size, align):
+    frame = b'\xff' * 6 + b'\x02\x00\x00\x00\x00\x01' + b'\x88\xb5' + b'\xaa' * (test_frame_len - 14)
+    msg_len = (RNDIS_HEADER_LEN + len(frame) + align - 1) // align * align
+    msg = struct.pack('<11I', REMOTE_NDIS_PACKET_MSG, msg_len, 36, len(frame), 0, 0, 0, 0, 0, 0, 0) + frame
+    msg += b'\x00' * (msg_len - len(msg))
+    pkts = max(min(max_pkts, max_size // msg_len), 1)
+    transfer = msg * pkts
+
+    send_count = 0
+    begin = time.time()
+    while time.time() - begin < test_seconds:
+        ep_out.write(transfer)
+        send_count += pkts
+    elapsed = time.time() - begin
+    print('rndis out %d frames, %d per transfer, %f MB/s' % (send_count, pkts, send_count * len(frame) / 1024 / 1024 / elapsed))
+
+
+def test_rndis_in():
+    read_count = 0
+    read_bytes = 0
+    transfers = 0
+    begin = None
+    while True:
+        try:
+            data = bytes(ep_in.read(test_host_max_transfer, timeout=2000))
+        except usb.core.USBTimeoutError:
+            break
+        if begin is None:
+            begin = time.time()
+        transfers += 1
+        offset = 0
+        while offset + RNDIS_HEADER_LEN <= len(data):
+            msg_type, msg_len, data_offset, data_len = struct.unpack_from('<4I', data, offset)
+            if msg_type != REMOTE_NDIS_PACKET_MSG or msg_len < RNDIS_HEADER_LEN:
+                break
+            read_count += 1
+            read_bytes += data_len
+            offset += msg_len
+    if begin is None:
+        print('rndis in: nothing received, run "rndis_bench tx" on the device')
+        return
+    elapsed = max(time.time() - begin - 2, 0.001)
+    print('rndis in %d frames in %d transfers, %f MB/s' % (read_count, transfers, read_bytes / 1024 / 1024 / elapsed))
+
+
+if __name__ == '__main__':
+    max_pkts, max_size, align = rndis_init()
+    print('device takes %d packets, %d bytes per transfer, align %d' % (max_pkts, max_size, align))
+
+    print('test rndis out speed')
+    test_rndis_out(max_pkts, max_size, align)
+
+    print('test rndis in speed, run "rndis_bench tx" on the device')
+    test_rndis_in()
+
+    usb.util.dispose_resources(dev)
@@ -15,6 +15,9 @@
  * 2017-02-13     Hichard      Update Fatfs version to 0.12b, support exFAT.
  * 2017-04-11     Bernard      fix the st_blksize issue.
  * 2017-05-26     Urey         fix f_mount error when mount more fats
+ * 2026-10-17     loogg        add sector cache under disk_read/disk_write
+ * 2026-10-18     loogg        report a failed device sync on CTRL_SYNC
+ * 2026-10-18     loogg        unmount and mkfs fail on sectors the cache can not write back
  */
 
 #include <rtthread.h>
@@ -28,6 +31,13 @@
 
 #include <dfs_fs.h>
 #include <dfs_file.h>
+#include "dfs_elm.h"
+
+#ifndef RT_DFS_ELM_USING_CACHE
+#define elm_cache_attach(drv, dev)
+#define elm_cache_detach(drv)
+#define elm_cache_sync(drv)         RT_EOK
+#endif
 
 #undef SS
 #if FF_MAX_SS == FF_MIN_SS
@@ -118,6 +128,7 @@ int dfs_elm_mount(struct dfs_filesystem *fs, unsigned long rwflag, const void *d
 
     /* save device */
     disk[index] = fs->dev_id;
+    elm_cache_attach(index, fs->dev_id);
     /* check sector size */
     if (rt_device_control(fs->dev_id, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry) == RT_EOK)
     {
@@ -131,6 +142,7 @@ int dfs_elm_mount(struct dfs_filesystem *fs, unsigned long rwflag, const void *d
     fat = (FATFS *)rt_malloc(sizeof(FATFS));
     if (fat == RT_NULL)
     {
+        elm_cache_detach(index);
         disk[index] = RT_NULL;
         return -ENOMEM;
     }
@@ -147,6 +159,7 @@ int dfs_elm_mount(struct dfs_filesystem *fs, unsigned long rwflag, const void *d
         if (dir == RT_NULL)
         {
             f_mount(RT_NULL, (const TCHAR *)logic_nbr, 1);
+            elm_cache_detach(index);
             disk[index] = RT_NULL;
             rt_free(fat);
             return -ENOMEM;
@@ -165,6 +178,7 @@ int dfs_elm_mount(struct dfs_filesystem *fs, unsigned long rwflag, const void *d
 
 __err:
     f_mount(RT_NULL, (const TCHAR *)logic_nbr, 1);
+    elm_cache_detach(index);
     disk[index] = RT_NULL;
     rt_free(fat);
     return elm_result_to_dfs(result);
@@ -186,12 +200,17 @@ int dfs_elm_unmount(struct dfs_filesystem *fs)
     if (index == -1) /* not found */
         return -ENOENT;
 
+    /* sectors the cache can not write back fail the unmount, it may be tried again */
+    if (elm_cache_sync(index) != RT_EOK)
+        return -EIO;
+
     logic_nbr[0] = '0' + index;
     result = f_mount(RT_NULL, logic_nbr, (BYTE)0);
     if (result != FR_OK)
         return elm_result_to_dfs(result);
 
     fs->data = RT_NULL;
+    elm_cache_detach(index);
     disk[index] = RT_NULL;
     rt_free(fat);
 
@@ -252,6 +271,7 @@ int dfs_elm_mkfs(rt_device_t dev_id, const char *fs_name)
             disk[index] = dev_id;
             /* try to open device */
             rt_device_open(dev_id, RT_DEVICE_OFLAG_RDWR);
+            elm_cache_attach(index, dev_id);
 
             /* just fill the FatFs[vol] in ff.c, or mkfs will failded!
              * consider this condition: you just umount the elm fat,
@@ -282,6 +302,12 @@ int dfs_elm_mkfs(rt_device_t dev_id, const char *fs_name)
     {
         rt_free(fat);
         f_mount(RT_NULL, logic_nbr, (BYTE)index);
+#ifdef RT_DFS_ELM_USING_CACHE
+        if (elm_cache_detach(index) != RT_EOK && result == FR_OK)
+        {
+            result = FR_DISK_ERR;
+        }
+#endif
         disk[index] = RT_NULL;
         /* close device */
         rt_device_close(dev_id);
@@ -878,6 +904,12 @@ int elm_init(void)
 {
     /* register fatfs file system */
     dfs_register(&dfs_elm);
+#ifdef RT_DFS_ELM_USING_CACHE
+    if (elm_cache_init() != RT_EOK)
+    {
+        rt_kprintf("elm sector cache init failed, uncached\n");
+    }
+#endif
 
     return 0;
 }
@@ -906,6 +938,14 @@ DRESULT disk_read(BYTE drv, BYTE *buff, DWORD sector, UINT count)
     rt_size_t result;
     rt_device_t device = disk[drv];
 
+#ifdef RT_DFS_ELM_USING_CACHE
+    rt_err_t err = elm_cache_read(drv, buff, sector, count);
+    if (err != -RT_ENOSYS)
+    {
+        return err == RT_EOK ? RES_OK : RES_ERROR;
+    }
+#endif
+
     result = rt_device_read(device, sector, buff, count);
     if (result == count)
     {
@@ -921,6 +961,14 @@ DRESULT disk_write(BYTE drv, const BYTE *buff, DWORD sector, UINT count)
     rt_size_t result;
     rt_device_t device = disk[drv];
 
+#ifdef RT_DFS_ELM_USING_CACHE
+    rt_err_t err = elm_cache_write(drv, buff, sector, count);
+    if (err != -RT_ENOSYS)
+    {
+        return err == RT_EOK ? RES_OK : RES_ERROR;
+    }
+#endif
+
     result = rt_device_write(device, sector, buff, count);
     if (result == count)
     {
@@ -969,7 +1017,20 @@ DRESULT disk_ioctl(BYTE drv, BYTE ctrl, void *buff)
     }
     else if (ctrl == CTRL_SYNC)
     {
-        rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+        rt_err_t result;
+
+#ifdef RT_DFS_ELM_USING_CACHE
+        if (elm_cache_sync(drv) != RT_EOK)
+        {
+            return RES_ERROR;
+        }
+#endif
+        /* a device without control has nothing to sync */
+        result = rt_device_control(device, RT_DEVICE_CTRL_BLK_SYNC, RT_NULL);
+        if (result != RT_EOK && result != -RT_ENOSYS)
+        {
+            return RES_ERROR;
+        }
     }
     else if (ctrl == CTRL_TRIM)
     {
@@ -6,17 +6,29 @@
  * Change Logs:
  * Date           Author       Notes
  * 2010-02-06     Bernard      Add elm_init function declaration
+ * 2026-10-17     loogg        Add sector cache declarations
  */
 
 #ifndef __DFS_ELM_H__
 #define __DFS_ELM_H__
 
+#include <rtthread.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
 int elm_init(void);
 
+#ifdef RT_DFS_ELM_USING_CACHE
+int elm_cache_init(void);
+void elm_cache_attach(int drv, rt_device_t dev);
+rt_err_t elm_cache_detach(int drv);
+rt_err_t elm_cache_read(int drv, void *buff, rt_uint32_t sector, rt_uint32_t count);
+rt_err_t elm_cache_write(int drv, const void *buff, rt_uint32_t sector, rt_uint32_t count);
+rt_err_t elm_cache_sync(int drv);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
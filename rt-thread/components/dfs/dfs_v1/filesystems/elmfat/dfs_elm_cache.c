@@ -0,0 +1,657 @@
+/*
+ * Copyright (c) 2006-2021, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        first version
+ * 2026-10-18     loogg        no stuck victim on a failed write back, detach fails with dirty sectors
+ */
+
+#include <rtthread.h>
+#include <rtdevice.h>
+#include "ffconf.h"
+#include "dfs_elm.h"
+
+#ifdef RT_DFS_ELM_USING_CACHE
+
+#define DBG_TAG "elm.cache"
+#define DBG_LVL DBG_WARNING
+#include <rtdbg.h>
+
+/*
+ * Sector cache between FatFs disk_read/disk_write and the block device.
+ *
+ * FatFs moves every FAT, directory and partial file sector through single sector calls, those
+ * go through the cache: LRU, written back by the "elmwb" thread or on CTRL_SYNC, and a miss right
+ * after the previous miss reads the following sectors ahead in one request. Multi sector calls are
+ * file data going straight to the user buffer, they bypass the cache so big transfers do not flush
+ * the metadata out. Dirty cached copies are laid over bypassed reads and dropped by bypassed writes.
+ * A dirty sector the disk does not take is passed over for eviction, and only lost when no other
+ * sector can be evicted, the next sync of its volume fails then.
+ */
+
+#define ELM_CACHE_SS        FF_MAX_SS
+#define ELM_CACHE_HASH_SIZE 16
+/* write back early above this */
+#define ELM_CACHE_DIRTY_HIGH (RT_DFS_ELM_CACHE_SECTORS * 3 / 4)
+
+#if RT_DFS_ELM_CACHE_READ_AHEAD < 1 || RT_DFS_ELM_CACHE_READ_AHEAD * 2 > RT_DFS_ELM_CACHE_SECTORS
+#error "RT_DFS_ELM_CACHE_READ_AHEAD must be 1 ~ RT_DFS_ELM_CACHE_SECTORS / 2"
+#endif
+
+struct elm_cache_blk
+{
+    rt_list_t lru;
+    rt_list_t hash;
+    rt_uint32_t sector;
+    rt_uint8_t drv;
+    rt_uint8_t valid;
+    rt_uint8_t dirty;
+    rt_uint8_t ahead;        /* filled by read ahead, not asked for yet */
+    rt_uint8_t held;         /* taken by a fill in progress */
+    rt_uint8_t *data;
+};
+
+struct elm_cache_stat
+{
+    rt_uint32_t reads;
+    rt_uint32_t read_hits;
+    rt_uint32_t writes;
+    rt_uint32_t write_hits;
+    rt_uint32_t ahead;
+    rt_uint32_t ahead_hits;
+    rt_uint32_t bypass_reads;
+    rt_uint32_t bypass_writes;
+    rt_uint32_t evicts;
+    rt_uint32_t writebacks;
+    rt_uint32_t writeback_ios;
+    rt_uint32_t errors;
+};
+
+struct elm_cache
+{
+    struct rt_mutex lock;
+    struct rt_semaphore wb_sem;
+    rt_list_t lru;                             /* most recently used first */
+    rt_list_t hash[ELM_CACHE_HASH_SIZE];
+    struct elm_cache_blk *blks;
+    rt_uint8_t *io_buf;                        /* read ahead and write back runs */
+    rt_uint32_t dirty;
+
+    rt_device_t dev[FF_VOLUMES];
+    rt_uint32_t sector_count[FF_VOLUMES];
+    rt_uint32_t ahead_next[FF_VOLUMES];        /* a miss here is sequential */
+    rt_err_t werr[FF_VOLUMES];                 /* a dirty sector was lost, for the next sync */
+
+    struct elm_cache_stat stat;
+};
+
+static struct elm_cache *elm_cache;
+
+rt_inline rt_list_t *elm_cache_bucket(int drv, rt_uint32_t sector)
+{
+    return &elm_cache->hash[(sector ^ ((rt_uint32_t)drv << 3)) & (ELM_CACHE_HASH_SIZE - 1)];
+}
+
+static struct elm_cache_blk *elm_cache_lookup(int drv, rt_uint32_t sector)
+{
+    rt_list_t *bucket = elm_cache_bucket(drv, sector);
+    struct elm_cache_blk *blk;
+
+    rt_list_for_each_entry(blk, bucket, hash)
+    {
+        if (blk->sector == sector && blk->drv == drv)
+        {
+            return blk;
+        }
+    }
+
+    return RT_NULL;
+}
+
+rt_inline void elm_cache_touch(struct elm_cache_blk *blk)
+{
+    rt_list_remove(&blk->lru);
+    rt_list_insert_after(&elm_cache->lru, &blk->lru);
+}
+
+static void elm_cache_drop(struct elm_cache_blk *blk)
+{
+    if (blk->dirty)
+    {
+        blk->dirty = 0;
+        elm_cache->dirty--;
+    }
+    blk->valid = 0;
+    blk->ahead = 0;
+    rt_list_remove(&blk->hash);
+    rt_list_init(&blk->hash);
+    /* free ones are taken first */
+    rt_list_remove(&blk->lru);
+    rt_list_insert_before(&elm_cache->lru, &blk->lru);
+}
+
+/* write the dirty run starting at blk in one request, neighbours before it are not looked at */
+static rt_err_t elm_cache_writeback(struct elm_cache_blk *blk)
+{
+    struct elm_cache_blk *run[RT_DFS_ELM_CACHE_READ_AHEAD];
+    rt_uint32_t n = 0, i;
+    rt_device_t dev = elm_cache->dev[blk->drv];
+
+    while (blk && blk->dirty && n < RT_DFS_ELM_CACHE_READ_AHEAD)
+    {
+        rt_memcpy(elm_cache->io_buf + n * ELM_CACHE_SS, blk->data, ELM_CACHE_SS);
+        run[n++] = blk;
+        blk = elm_cache_lookup(blk->drv, blk->sector + 1);
+    }
+
+    elm_cache->stat.writeback_ios++;
+    if (dev == RT_NULL || rt_device_write(dev, run[0]->sector, elm_cache->io_buf, n) != n)
+    {
+        elm_cache->stat.errors++;
+        LOG_E("write back %d sectors at %d failed", n, run[0]->sector);
+        return -RT_EIO;
+    }
+
+    for (i = 0; i < n; i++)
+    {
+        run[i]->dirty = 0;
+    }
+    elm_cache->dirty -= n;
+    elm_cache->stat.writebacks += n;
+
+    return RT_EOK;
+}
+
+/* drv < 0 flushes every volume */
+static rt_err_t elm_cache_flush(int drv)
+{
+    struct elm_cache_blk *blk, *first;
+    rt_err_t err = RT_EOK;
+
+    while (elm_cache->dirty)
+    {
+        /* lowest sector first so runs are found from their start */
+        first = RT_NULL;
+        rt_list_for_each_entry(blk, &elm_cache->lru, lru)
+        {
+            if (blk->dirty && (drv < 0 || blk->drv == drv) &&
+                (first == RT_NULL || blk->drv < first->drv ||
+                 (blk->drv == first->drv && blk->sector < first->sector)))
+            {
+                first = blk;
+            }
+        }
+        if (first == RT_NULL)
+        {
+            break;
+        }
+
+        err = elm_cache_writeback(first);
+        if (err != RT_EOK)
+        {
+            break;
+        }
+    }
+
+    return err;
+}
+
+/* least recently used first, a dirty sector failing its write back is passed over */
+static struct elm_cache_blk *elm_cache_victim(void)
+{
+    struct elm_cache_blk *blk, *failed = RT_NULL;
+    rt_list_t *node;
+
+    for (node = elm_cache->lru.prev; node != &elm_cache->lru; node = node->prev)
+    {
+        blk = rt_list_entry(node, struct elm_cache_blk, lru);
+        if (blk->held)
+        {
+            continue;
+        }
+        if (!blk->valid)
+        {
+            return blk;
+        }
+        if (blk->dirty && elm_cache_writeback(blk) != RT_EOK)
+        {
+            if (failed == RT_NULL)
+            {
+                failed = blk;
+            }
+            continue;
+        }
+
+        blk->ahead = 0;
+        elm_cache->stat.evicts++;
+        rt_list_remove(&blk->hash);
+        rt_list_init(&blk->hash);
+        blk->valid = 0;
+        return blk;
+    }
+
+    if (failed == RT_NULL)
+    {
+        return RT_NULL;
+    }
+
+    /* nothing else to evict, lose the oldest rather than fail every access from now on */
+    LOG_E("sector %d of volume %d lost", failed->sector, failed->drv);
+    elm_cache->werr[failed->drv] = -RT_EIO;
+    elm_cache->stat.evicts++;
+    elm_cache_drop(failed);
+
+    return failed;
+}
+
+static rt_err_t elm_cache_fill(int drv, rt_uint32_t sector)
+{
+    struct elm_cache_blk *blks[RT_DFS_ELM_CACHE_READ_AHEAD];
+    rt_device_t dev = elm_cache->dev[drv];
+    rt_uint32_t n = 1, i;
+
+    /* sequential misses read ahead up to the next cached sector or the end of the disk */
+    if (sector == elm_cache->ahead_next[drv])
+    {
+        while (n < RT_DFS_ELM_CACHE_READ_AHEAD && sector + n < elm_cache->sector_count[drv] &&
+               elm_cache_lookup(drv, sector + n) == RT_NULL)
+        {
+            n++;
+        }
+    }
+
+    /* victims first, writing them back goes through io_buf too */
+    for (i = 0; i < n; i++)
+    {
+        blks[i] = elm_cache_victim();
+        if (blks[i] == RT_NULL)
+        {
+            break;
+        }
+        blks[i]->held = 1;
+        elm_cache_touch(blks[i]);
+    }
+    n = i;
+    for (i = 0; i < n; i++)
+    {
+        blks[i]->held = 0;
+    }
+
+    if (n == 0 || rt_device_read(dev, sector, elm_cache->io_buf, n) != n)
+    {
+        for (i = 0; i < n; i++)
+        {
+            elm_cache_drop(blks[i]);
+        }
+        elm_cache->stat.errors++;
+        return -RT_EIO;
+    }
+    elm_cache->ahead_next[drv] = sector + n;
+    elm_cache->stat.ahead += n - 1;
+
+    /* the asked sector ends up most recent, the ahead ones just behind it */
+    while (n--)
+    {
+        struct elm_cache_blk *blk = blks[n];
+
+        rt_memcpy(blk->data, elm_cache->io_buf + n * ELM_CACHE_SS, ELM_CACHE_SS);
+        blk->drv = drv;
+        blk->sector = sector + n;
+        blk->valid = 1;
+        blk->ahead = n > 0;
+        rt_list_insert_after(elm_cache_bucket(drv, blk->sector), &blk->hash);
+        elm_cache_touch(blk);
+    }
+
+    return RT_EOK;
+}
+
+rt_err_t elm_cache_read(int drv, void *buff, rt_uint32_t sector, rt_uint32_t count)
+{
+    struct elm_cache_blk *blk;
+    rt_device_t dev;
+    rt_err_t err = RT_EOK;
+    rt_uint32_t i;
+
+    dev = elm_cache ? elm_cache->dev[drv] : RT_NULL;
+    if (dev == RT_NULL)
+    {
+        return -RT_ENOSYS;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+
+    if (count > 1)
+    {
+        elm_cache->stat.bypass_reads += count;
+        if (rt_device_read(dev, sector, buff, count) != count)
+        {
+            elm_cache->stat.errors++;
+            err = -RT_EIO;
+        }
+        else if (elm_cache->dirty)
+        {
+            for (i = 0; i < count; i++)
+            {
+                blk = elm_cache_lookup(drv, sector + i);
+                if (blk && blk->dirty)
+                {
+                    rt_memcpy((rt_uint8_t *)buff + i * ELM_CACHE_SS, blk->data, ELM_CACHE_SS);
+                }
+            }
+        }
+    }
+    else
+    {
+        elm_cache->stat.reads++;
+        blk = elm_cache_lookup(drv, sector);
+        if (blk)
+        {
+            elm_cache->stat.read_hits++;
+            if (blk->ahead)
+            {
+                blk->ahead = 0;
+                elm_cache->stat.ahead_hits++;
+            }
+        }
+        else
+        {
+            err = elm_cache_fill(drv, sector);
+            blk = err == RT_EOK ? elm_cache_lookup(drv, sector) : RT_NULL;
+        }
+
+        if (blk)
+        {
+            rt_memcpy(buff, blk->data, ELM_CACHE_SS);
+            elm_cache_touch(blk);
+        }
+    }
+
+    rt_mutex_release(&elm_cache->lock);
+
+    return err;
+}
+
+rt_err_t elm_cache_write(int drv, const void *buff, rt_uint32_t sector, rt_uint32_t count)
+{
+    struct elm_cache_blk *blk;
+    rt_device_t dev;
+    rt_err_t err = RT_EOK;
+    rt_uint32_t i;
+    rt_bool_t wakeup = RT_FALSE;
+
+    dev = elm_cache ? elm_cache->dev[drv] : RT_NULL;
+    if (dev == RT_NULL)
+    {
+        return -RT_ENOSYS;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+
+    if (count > 1)
+    {
+        /* cached copies are older than this, clean or not */
+        for (i = 0; i < count; i++)
+        {
+            blk = elm_cache_lookup(drv, sector + i);
+            if (blk)
+            {
+                elm_cache_drop(blk);
+            }
+        }
+
+        elm_cache->stat.bypass_writes += count;
+        if (rt_device_write(dev, sector, buff, count) != count)
+        {
+            elm_cache->stat.errors++;
+            err = -RT_EIO;
+        }
+    }
+    else
+    {
+        elm_cache->stat.writes++;
+        blk = elm_cache_lookup(drv, sector);
+        if (blk)
+        {
+            elm_cache->stat.write_hits++;
+            blk->ahead = 0;
+        }
+        else
+        {
+            blk = elm_cache_victim();
+            if (blk)
+            {
+                blk->drv = drv;
+                blk->sector = sector;
+                blk->valid = 1;
+                rt_list_insert_after(elm_cache_bucket(drv, sector), &blk->hash);
+            }
+        }
+
+        if (blk)
+        {
+            rt_memcpy(blk->data, buff, ELM_CACHE_SS);
+            if (!blk->dirty)
+            {
+                blk->dirty = 1;
+                elm_cache->dirty++;
+            }
+            elm_cache_touch(blk);
+            /* the first dirty sector starts the write back period, keep clean sectors around for reads */
+            wakeup = elm_cache->dirty == 1 || elm_cache->dirty >= ELM_CACHE_DIRTY_HIGH;
+        }
+        else
+        {
+            err = -RT_EIO;
+        }
+    }
+
+    rt_mutex_release(&elm_cache->lock);
+
+    if (wakeup)
+    {
+        rt_sem_release(&elm_cache->wb_sem);
+    }
+
+    return err;
+}
+
+rt_err_t elm_cache_sync(int drv)
+{
+    rt_err_t err;
+
+    if (elm_cache == RT_NULL || elm_cache->dev[drv] == RT_NULL)
+    {
+        return RT_EOK;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+    err = elm_cache_flush(drv);
+    if (err == RT_EOK)
+    {
+        err = elm_cache->werr[drv];
+    }
+    elm_cache->werr[drv] = RT_EOK;
+    rt_mutex_release(&elm_cache->lock);
+
+    return err;
+}
+
+void elm_cache_attach(int drv, rt_device_t dev)
+{
+    struct rt_device_blk_geometry geometry;
+
+    if (elm_cache == RT_NULL)
+    {
+        return;
+    }
+
+    rt_memset(&geometry, 0, sizeof(geometry));
+    rt_device_control(dev, RT_DEVICE_CTRL_BLK_GETGEOME, &geometry);
+    if (geometry.bytes_per_sector != ELM_CACHE_SS)
+    {
+        LOG_W("sector size %d, not cached", geometry.bytes_per_sector);
+        return;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+    elm_cache->werr[drv] = RT_EOK;
+    elm_cache->dev[drv] = dev;
+    elm_cache->sector_count[drv] = geometry.sector_count;
+    elm_cache->ahead_next[drv] = 0xffffffff;
+    rt_mutex_release(&elm_cache->lock);
+}
+
+rt_err_t elm_cache_detach(int drv)
+{
+    struct elm_cache_blk *blk;
+    rt_err_t err;
+    rt_uint32_t i;
+
+    if (elm_cache == RT_NULL || elm_cache->dev[drv] == RT_NULL)
+    {
+        return RT_EOK;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+    err = elm_cache_flush(drv);
+    if (err == RT_EOK)
+    {
+        err = elm_cache->werr[drv];
+    }
+    if (err != RT_EOK)
+    {
+        LOG_E("volume %d detached with sectors not written back", drv);
+    }
+    for (i = 0; i < RT_DFS_ELM_CACHE_SECTORS; i++)
+    {
+        blk = &elm_cache->blks[i];
+        if (blk->valid && blk->drv == drv)
+        {
+            elm_cache_drop(blk);
+        }
+    }
+    elm_cache->dev[drv] = RT_NULL;
+    rt_mutex_release(&elm_cache->lock);
+
+    return err;
+}
+
+static void elm_cache_wb_entry(void *parameter)
+{
+    rt_err_t ret;
+
+    while (1)
+    {
+        /* asleep while nothing is dirty, a period after the first dirty sector or early when many are */
+        ret = rt_sem_take(&elm_cache->wb_sem,
+                          elm_cache->dirty ? rt_tick_from_millisecond(RT_DFS_ELM_CACHE_FLUSH_MS) : RT_WAITING_FOREVER);
+
+        if (elm_cache->dirty && (ret != RT_EOK || elm_cache->dirty >= ELM_CACHE_DIRTY_HIGH))
+        {
+            rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+            elm_cache_flush(-1);
+            rt_mutex_release(&elm_cache->lock);
+        }
+    }
+}
+
+int elm_cache_init(void)
+{
+    struct elm_cache *cache;
+    rt_thread_t tid;
+    rt_uint32_t i;
+
+    cache = rt_calloc(1, sizeof(struct elm_cache) + RT_DFS_ELM_CACHE_SECTORS * sizeof(struct elm_cache_blk));
+    if (cache == RT_NULL)
+    {
+        return -RT_ENOMEM;
+    }
+    /* one piece for the sectors and the io run, the block device may dma into it */
+    cache->io_buf = rt_malloc((RT_DFS_ELM_CACHE_SECTORS + RT_DFS_ELM_CACHE_READ_AHEAD) * ELM_CACHE_SS);
+    if (cache->io_buf == RT_NULL)
+    {
+        rt_free(cache);
+        return -RT_ENOMEM;
+    }
+
+    cache->blks = (struct elm_cache_blk *)(cache + 1);
+    rt_list_init(&cache->lru);
+    for (i = 0; i < ELM_CACHE_HASH_SIZE; i++)
+    {
+        rt_list_init(&cache->hash[i]);
+    }
+    for (i = 0; i < RT_DFS_ELM_CACHE_SECTORS; i++)
+    {
+        cache->blks[i].data = cache->io_buf + (RT_DFS_ELM_CACHE_READ_AHEAD + i) * ELM_CACHE_SS;
+        rt_list_init(&cache->blks[i].hash);
+        rt_list_insert_before(&cache->lru, &cache->blks[i].lru);
+    }
+    rt_mutex_init(&cache->lock, "elmc", RT_IPC_FLAG_PRIO);
+    rt_sem_init(&cache->wb_sem, "elmwb", 0, RT_IPC_FLAG_PRIO);
+
+    tid = rt_thread_create("elmwb", elm_cache_wb_entry, RT_NULL, 2048, RT_THREAD_PRIORITY_MAX / 2, 10);
+    if (tid == RT_NULL)
+    {
+        rt_sem_detach(&cache->wb_sem);
+        rt_mutex_detach(&cache->lock);
+        rt_free(cache->io_buf);
+        rt_free(cache);
+        return -RT_ENOMEM;
+    }
+
+    elm_cache = cache;
+    rt_thread_startup(tid);
+
+    return RT_EOK;
+}
+
+#ifdef RT_USING_FINSH
+#include <string.h>
+
+static void elm_cache_cmd(int argc, char **argv)
+{
+    struct elm_cache_stat *s;
+    rt_uint32_t i, valid = 0;
+
+    if (elm_cache == RT_NULL)
+    {
+        rt_kprintf("elm cache not initialized\n");
+        return;
+    }
+
+    if (argc > 1 && !strcmp(argv[1], "flush"))
+    {
+        rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+        rt_kprintf("flush %s\n", elm_cache_flush(-1) == RT_EOK ? "ok" : "failed");
+        rt_mutex_release(&elm_cache->lock);
+        return;
+    }
+
+    rt_mutex_take(&elm_cache->lock, RT_WAITING_FOREVER);
+    if (argc > 1 && !strcmp(argv[1], "reset"))
+    {
+        rt_memset(&elm_cache->stat, 0, sizeof(elm_cache->stat));
+    }
+    for (i = 0; i < RT_DFS_ELM_CACHE_SECTORS; i++)
+    {
+        valid += elm_cache->blks[i].valid;
+    }
+    s = &elm_cache->stat;
+    rt_kprintf("sectors %d, used %d, dirty %d, read ahead %d, write back %d ms\n",
+               RT_DFS_ELM_CACHE_SECTORS, valid, elm_cache->dirty, RT_DFS_ELM_CACHE_READ_AHEAD, RT_DFS_ELM_CACHE_FLUSH_MS);
+    rt_kprintf("read   %8d, hit %8d (%d%%)\n", s->reads, s->read_hits, s->reads ? s->read_hits * 100 / s->reads : 0);
+    rt_kprintf("write  %8d, hit %8d (%d%%)\n", s->writes, s->write_hits, s->writes ? s->write_hits * 100 / s->writes : 0);
+    rt_kprintf("ahead  %8d, hit %8d\n", s->ahead, s->ahead_hits);
+    rt_kprintf("bypass read %d, write %d sectors\n", s->bypass_reads, s->bypass_writes);
+    rt_kprintf("evict  %8d, write back %d sectors in %d requests, errors %d\n",
+               s->evicts, s->writebacks, s->writeback_ios, s->errors);
+    rt_mutex_release(&elm_cache->lock);
+}
+MSH_CMD_EXPORT_ALIAS(elm_cache_cmd, elm_cache, fatfs sector cache stats: elm_cache [flush|reset]);
+#endif
+
+#endif /* RT_DFS_ELM_USING_CACHE */
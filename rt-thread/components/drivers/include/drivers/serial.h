@@ -66,6 +66,22 @@
 #define RT_SERIAL_RB_BUFSZ              64
 #endif
 
+#if defined(RT_SERIAL_USING_TX_FIFO) && !defined(RT_SERIAL_TX_RB_BUFSZ)
+#define RT_SERIAL_TX_RB_BUFSZ           256
+#endif
+
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+#ifndef RT_SERIAL_DMA_TX_BUFSZ
+#define RT_SERIAL_DMA_TX_BUFSZ          512
+#endif
+#ifndef RT_SERIAL_DMA_TX_ZEROCOPY_MIN
+#define RT_SERIAL_DMA_TX_ZEROCOPY_MIN   0
+#endif
+#ifndef RT_SERIAL_DMA_TX_DONE_NUM
+#define RT_SERIAL_DMA_TX_DONE_NUM       8   /* writes waiting for tx_complete */
+#endif
+#endif
+
 #define RT_SERIAL_EVENT_RX_IND          0x01    /* Rx indication */
 #define RT_SERIAL_EVENT_TX_DONE         0x02    /* Tx complete   */
 #define RT_SERIAL_EVENT_RX_DMADONE      0x03    /* Rx DMA transfer done */
@@ -140,6 +156,18 @@ struct rt_serial_rx_fifo
 struct rt_serial_tx_fifo
 {
     struct rt_completion completion;
+
+#ifdef RT_SERIAL_USING_TX_FIFO
+    /* software fifo, drained in tx empty interrupt */
+    rt_uint8_t *buffer;
+    /* one writer at a time waits on the completion */
+    struct rt_mutex lock;
+
+    rt_uint16_t put_index, get_index;
+    rt_uint16_t count;
+
+    rt_bool_t activated;
+#endif
 };
 
 /*
@@ -154,6 +182,38 @@ struct rt_serial_tx_dma
 {
     rt_bool_t activated;
     struct rt_data_queue data_queue;
+
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+    /* staging arena, writes queued while a transfer runs go out together in the next one */
+    rt_uint8_t *buffer;
+
+    rt_uint16_t put_index, get_index;
+    rt_uint16_t count;
+    rt_uint16_t burst;                  /* arena bytes in the running transfer */
+
+    const rt_uint8_t *zc_data;          /* caller buffer in the running transfer, zero copy */
+    struct rt_completion completion;
+    struct rt_mutex lock;               /* one writer at a time waits on the completion */
+
+    /* writes waiting for tx_complete, end is the queued count after the write */
+    struct
+    {
+        const rt_uint8_t *data;
+        rt_uint32_t end;
+    } done[RT_SERIAL_DMA_TX_DONE_NUM];
+    rt_uint8_t done_head, done_count;
+    rt_uint32_t queued;                 /* bytes ever queued */
+    rt_uint32_t sent;                   /* bytes ever sent */
+
+    /* statistics */
+    rt_uint32_t writes;
+    rt_uint32_t bursts;
+    rt_uint32_t zc_bursts;
+    rt_uint32_t burst_bytes;
+    rt_uint32_t burst_max;
+    rt_uint32_t stalls;
+    rt_tick_t   stall_ticks;
+#endif
 };
 
 struct rt_serial_device
@@ -195,4 +255,8 @@ rt_err_t rt_hw_serial_register(struct rt_serial_device *serial,
 
 rt_err_t rt_hw_serial_register_tty(struct rt_serial_device *serial);
 
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+rt_bool_t rt_hw_serial_dma_reachable(struct rt_serial_device *serial, const void *buf);
+#endif
+
 #endif
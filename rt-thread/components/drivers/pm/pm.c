@@ -10,6 +10,7 @@
  * 2019-04-28     Zero-Free    improve PM mode and device ops interface
  * 2020-11-23     zhangsz      update pm mode select
  * 2020-11-27     zhangsz      update pm 2.0
+ * 2026-10-17     loogg        check timers as from the tick isr after tick-less sleep
  */
 
 #include <rthw.h>
@@ -456,7 +457,10 @@ static void _pm_change_sleep_mode(struct rt_pm *pm)
         {
             if (delta_tick)
             {
+                /* as the tick isr does, timeout functions expect an interrupt context */
+                rt_interrupt_enter();
                 rt_timer_check();
+                rt_interrupt_leave();
             }
         }
     }
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author        Notes
  * 2011-07-25     weety     first version
+ * 2026-10-17     loogg     pre-erase sd card before multiple block write
  */
 
 #include <rtthread.h>
@@ -165,6 +166,40 @@ rt_int32_t mmcsd_num_wr_blocks(struct rt_mmcsd_card *card)
     return blocks;
 }
 
+/*
+ * ACMD23, tells the sd card how many blocks the coming CMD25 writes so it can erase them
+ * up front. Only a hint, the card still takes the full CMD25 if this fails.
+ */
+static rt_int32_t mmcsd_set_wr_blk_erase_count(struct rt_mmcsd_card *card, rt_uint32_t blks)
+{
+    rt_int32_t err;
+    struct rt_mmcsd_cmd cmd;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+
+    cmd.cmd_code = APP_CMD;
+    cmd.arg = card->rca << 16;
+    cmd.flags = RESP_R1 | CMD_AC;
+
+    err = mmcsd_send_cmd(card->host, &cmd, 0);
+    if (err)
+        return -RT_ERROR;
+    if (!(cmd.resp[0] & R1_APP_CMD))
+        return -RT_ERROR;
+
+    rt_memset(&cmd, 0, sizeof(struct rt_mmcsd_cmd));
+
+    cmd.cmd_code = SD_APP_SET_WR_BLK_ERASE_COUNT;
+    cmd.arg = blks & 0x7fffff;
+    cmd.flags = RESP_R1 | CMD_AC;
+
+    err = mmcsd_send_cmd(card->host, &cmd, 0);
+    if (err)
+        return -RT_ERROR;
+
+    return RT_EOK;
+}
+
 static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
                                  rt_uint32_t           sector,
                                  void                 *buf,
@@ -231,6 +266,14 @@ static rt_err_t rt_mmcsd_req_blk(struct rt_mmcsd_card *card,
         cmd.cmd_code = w_cmd;
         data.flags |= DATA_DIR_WRITE;
         card->flags |= 0x8000;
+
+        if ((blks > 1) && (card->card_type == CARD_TYPE_SD) && !controller_is_spi(card->host))
+        {
+            if (mmcsd_set_wr_blk_erase_count(card, blks) != RT_EOK)
+            {
+                LOG_D("set write block erase count failed");
+            }
+        }
     }
 
     mmcsd_set_data_timeout(&data, card);
@@ -27,6 +27,10 @@
  * 2020-12-14     Meco Man     implement function of setting window's size(TIOCSWINSZ)
  * 2021-08-22     Meco Man     implement function of getting window's size(TIOCGWINSZ)
  * 2023-09-15     xqyjlj       perf rt_hw_interrupt_disable/enable
+ * 2026-10-17     loogg        bulk copy for interrupt rx and software fifo for interrupt tx
+ * 2026-10-17     loogg        staging arena and zero copy for dma tx
+ * 2026-10-18     loogg        polled tx behind the fifo for callers that can not sleep
+ * 2026-10-18     loogg        one dma arena writer at a time, tx_complete for every write
  */
 
 #include <rthw.h>
@@ -292,50 +296,45 @@ rt_inline int _serial_poll_tx(struct rt_serial_device *serial, const rt_uint8_t
  */
 rt_inline int _serial_int_rx(struct rt_serial_device *serial, rt_uint8_t *data, int length)
 {
-    int size;
+    int size, len;
+    rt_base_t level;
+    rt_uint16_t put_index, get_index;
     struct rt_serial_rx_fifo* rx_fifo;
 
     RT_ASSERT(serial != RT_NULL);
-    size = length;
 
     rx_fifo = (struct rt_serial_rx_fifo*) serial->serial_rx;
     RT_ASSERT(rx_fifo != RT_NULL);
 
-    /* read from software FIFO */
-    while (length)
-    {
-        int ch;
-        rt_base_t level;
-
-        /* disable interrupt */
-        level = rt_spin_lock_irqsave(&(serial->spinlock));
-
-        /* there's no data: */
-        if ((rx_fifo->get_index == rx_fifo->put_index) && (rx_fifo->is_full == RT_FALSE))
-        {
-            /* no data, enable interrupt and break out */
-            rt_spin_unlock_irqrestore(&(serial->spinlock), level);
-            break;
-        }
+    /*
+     * read from software FIFO: snapshot the indexes once and copy at most
+     * two contiguous segments, the lock is taken once instead of per byte.
+     * The copy stays under the lock as the isr moves get_index when full.
+     */
+    level = rt_spin_lock_irqsave(&(serial->spinlock));
 
-        /* otherwise there's the data: */
-        ch = rx_fifo->buffer[rx_fifo->get_index];
-        rx_fifo->get_index += 1;
-        if (rx_fifo->get_index >= serial->config.bufsz) rx_fifo->get_index = 0;
+    put_index = rx_fifo->put_index;
+    get_index = rx_fifo->get_index;
+    if (put_index > get_index || (put_index == get_index && rx_fifo->is_full == RT_FALSE))
+        size = put_index - get_index;
+    else
+        size = serial->config.bufsz - get_index + put_index;
+    if (size > length) size = length;
 
-        if (rx_fifo->is_full == RT_TRUE)
-        {
-            rx_fifo->is_full = RT_FALSE;
-        }
+    /* first segment up to the end of buffer, then the wrapped one */
+    len = serial->config.bufsz - get_index;
+    if (len > size) len = size;
+    rt_memcpy(data, &rx_fifo->buffer[get_index], len);
+    rt_memcpy(data + len, rx_fifo->buffer, size - len);
 
-        /* enable interrupt */
-        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+    get_index += size;
+    if (get_index >= serial->config.bufsz) get_index -= serial->config.bufsz;
+    rx_fifo->get_index = get_index;
+    if (size) rx_fifo->is_full = RT_FALSE;
 
-        *data = ch & 0xff;
-        data ++; length --;
-    }
+    rt_spin_unlock_irqrestore(&(serial->spinlock), level);
 
-    return size - length;
+    return size;
 }
 
 rt_inline int _serial_int_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
@@ -375,6 +374,179 @@ rt_inline int _serial_int_tx(struct rt_serial_device *serial, const rt_uint8_t *
     return size - length;
 }
 
+#ifdef RT_SERIAL_USING_TX_FIFO
+/*
+ * Interrupt TX with software FIFO: write copies into the FIFO and enables
+ * the tx empty interrupt, the isr drains it by RT_SERIAL_EVENT_TX_DONE.
+ * The writer only sleeps when the FIFO is full, writers take turns by the
+ * lock. The console, isr and interrupt masked callers can not sleep, they
+ * write by polling after the queued bytes.
+ */
+rt_inline int _serial_fifo_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
+{
+    int size, len, seg;
+    rt_base_t level;
+    struct rt_serial_tx_fifo *tx;
+
+    RT_ASSERT(serial != RT_NULL);
+
+    size = length;
+    tx = (struct rt_serial_tx_fifo*) serial->serial_tx;
+    RT_ASSERT(tx != RT_NULL);
+
+    /* closed meanwhile */
+    if (rt_mutex_take(&(tx->lock), RT_WAITING_FOREVER) != RT_EOK)
+    {
+        return 0;
+    }
+
+    while (length)
+    {
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+
+        if (serial->parent.open_flag & RT_DEVICE_FLAG_STREAM)
+        {
+            /* '\n' needs two slots for the added '\r' */
+            while (length && tx->count < RT_SERIAL_TX_RB_BUFSZ - (*data == '\n'))
+            {
+                if (*data == '\n')
+                {
+                    tx->buffer[tx->put_index] = '\r';
+                    if (++tx->put_index >= RT_SERIAL_TX_RB_BUFSZ) tx->put_index = 0;
+                    tx->count ++;
+                }
+                tx->buffer[tx->put_index] = *data;
+                if (++tx->put_index >= RT_SERIAL_TX_RB_BUFSZ) tx->put_index = 0;
+                tx->count ++;
+
+                data ++; length --;
+            }
+        }
+        else
+        {
+            len = RT_SERIAL_TX_RB_BUFSZ - tx->count;
+            if (len > length) len = length;
+
+            seg = RT_SERIAL_TX_RB_BUFSZ - tx->put_index;
+            if (seg > len) seg = len;
+            rt_memcpy(&tx->buffer[tx->put_index], data, seg);
+            rt_memcpy(tx->buffer, data + seg, len - seg);
+
+            tx->put_index += len;
+            if (tx->put_index >= RT_SERIAL_TX_RB_BUFSZ) tx->put_index -= RT_SERIAL_TX_RB_BUFSZ;
+            tx->count += len;
+
+            data += len; length -= len;
+        }
+
+        if (tx->count && tx->activated == RT_FALSE)
+        {
+            tx->activated = RT_TRUE;
+            serial->ops->control(serial, RT_DEVICE_CTRL_SET_INT, (void *)RT_DEVICE_FLAG_INT_TX);
+        }
+
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+        /* FIFO full, wait for the isr to make room */
+        if (length)
+        {
+            rt_completion_wait(&(tx->completion), RT_WAITING_FOREVER);
+        }
+    }
+
+    rt_mutex_release(&(tx->lock));
+
+    return size - length;
+}
+
+/* put one char after the queued ones, putc fails while the tx empty interrupt runs and the register is full */
+static rt_bool_t _serial_fifo_poll_putc(struct rt_serial_device *serial, struct rt_serial_tx_fifo *tx, char c)
+{
+    rt_base_t level;
+    rt_bool_t freed = RT_FALSE;
+
+    while (1)
+    {
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+        if (tx->count == 0)
+        {
+            if (serial->ops->putc(serial, c) != -1)
+            {
+                rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+                return freed;
+            }
+        }
+        else if (serial->ops->putc(serial, tx->buffer[tx->get_index]) != -1)
+        {
+            if (++tx->get_index >= RT_SERIAL_TX_RB_BUFSZ) tx->get_index = 0;
+            tx->count --;
+            freed = RT_TRUE;
+        }
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+    }
+}
+
+rt_inline int _serial_fifo_poll_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
+{
+    int size;
+    rt_bool_t freed = RT_FALSE;
+    struct rt_serial_tx_fifo *tx;
+
+    size = length;
+    tx = (struct rt_serial_tx_fifo*) serial->serial_tx;
+
+    while (length)
+    {
+        if (*data == '\n' && (serial->parent.open_flag & RT_DEVICE_FLAG_STREAM))
+        {
+            freed |= _serial_fifo_poll_putc(serial, tx, '\r');
+        }
+        freed |= _serial_fifo_poll_putc(serial, tx, *data);
+
+        data ++; length --;
+    }
+
+    /* a writer may wait for the room made here */
+    if (freed)
+    {
+        rt_completion_done(&(tx->completion));
+    }
+
+    return size;
+}
+
+/* move bytes from the software FIFO to the hardware until it is full, in isr */
+static void _serial_fifo_tx_isr(struct rt_serial_device *serial)
+{
+    rt_base_t level;
+    rt_bool_t freed = RT_FALSE;
+    struct rt_serial_tx_fifo *tx;
+
+    tx = (struct rt_serial_tx_fifo*) serial->serial_tx;
+
+    level = rt_spin_lock_irqsave(&(serial->spinlock));
+    while (tx->count)
+    {
+        if (serial->ops->putc(serial, tx->buffer[tx->get_index]) == -1) break;
+
+        if (++tx->get_index >= RT_SERIAL_TX_RB_BUFSZ) tx->get_index = 0;
+        tx->count --;
+        freed = RT_TRUE;
+    }
+    if (tx->count == 0 && tx->activated == RT_TRUE)
+    {
+        tx->activated = RT_FALSE;
+        serial->ops->control(serial, RT_DEVICE_CTRL_CLR_INT, (void *)RT_DEVICE_FLAG_INT_TX);
+    }
+    rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+    if (freed)
+    {
+        rt_completion_done(&(tx->completion));
+    }
+}
+#endif /* RT_SERIAL_USING_TX_FIFO */
+
 static void _serial_check_buffer_size(void)
 {
     static rt_bool_t already_output = RT_FALSE;
@@ -590,6 +762,281 @@ rt_inline int _serial_dma_tx(struct rt_serial_device *serial, const rt_uint8_t *
         return 0;
     }
 }
+
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+/*
+ * DMA TX with staging arena: write copies into the arena, the DMA sends the
+ * contiguous part from get_index. Whatever is written while a transfer runs
+ * goes out in one burst when it is done. Called with the spinlock held.
+ */
+static rt_err_t _serial_dma_arena_kick(struct rt_serial_device *serial, struct rt_serial_tx_dma *tx_dma)
+{
+    rt_uint16_t len;
+
+    len = RT_SERIAL_DMA_TX_BUFSZ - tx_dma->get_index;
+    if (len > tx_dma->count) len = tx_dma->count;
+
+    tx_dma->burst = len;
+    tx_dma->activated = RT_TRUE;
+    if (serial->ops->dma_transmit(serial, &tx_dma->buffer[tx_dma->get_index], len, RT_SERIAL_DMA_TX) != len)
+    {
+        tx_dma->burst = 0;
+        tx_dma->activated = RT_FALSE;
+        return -RT_EIO;
+    }
+
+    tx_dma->bursts ++;
+    tx_dma->burst_bytes += len;
+    if (len > tx_dma->burst_max) tx_dma->burst_max = len;
+
+    return RT_EOK;
+}
+
+/* a driver whose dma does not reach all of ram tells which buffers go through the arena */
+rt_weak rt_bool_t rt_hw_serial_dma_reachable(struct rt_serial_device *serial, const void *buf)
+{
+    return RT_TRUE;
+}
+
+/* wait for the isr to free the arena, the time is counted as stall */
+static void _serial_dma_arena_stall(struct rt_serial_device *serial, struct rt_serial_tx_dma *tx_dma)
+{
+    rt_base_t level;
+    rt_tick_t tick = rt_tick_get();
+
+    rt_completion_wait(&(tx_dma->completion), RT_WAITING_FOREVER);
+
+    level = rt_spin_lock_irqsave(&(serial->spinlock));
+    tx_dma->stalls ++;
+    tx_dma->stall_ticks += rt_tick_get() - tick;
+    rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+}
+
+/*
+ * Remember the write for tx_complete, called once its last byte is sent.
+ * Returns RT_FALSE while all records are in use. Called with the spinlock held.
+ */
+static rt_bool_t _serial_dma_arena_done_put(struct rt_serial_tx_dma *tx_dma, const rt_uint8_t *data)
+{
+    rt_uint8_t index;
+
+    if (tx_dma->done_count == RT_SERIAL_DMA_TX_DONE_NUM)
+    {
+        return RT_FALSE;
+    }
+
+    index = (tx_dma->done_head + tx_dma->done_count) % RT_SERIAL_DMA_TX_DONE_NUM;
+    tx_dma->done[index].data = data;
+    tx_dma->done[index].end = tx_dma->queued;
+    tx_dma->done_count ++;
+
+    return RT_TRUE;
+}
+
+/* call tx_complete for the writes all sent, outside the spinlock */
+static void _serial_dma_arena_done(struct rt_serial_device *serial, struct rt_serial_tx_dma *tx_dma)
+{
+    rt_base_t level;
+    const rt_uint8_t *data;
+
+    while (1)
+    {
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+        /* counters wrap, compare the distance */
+        if (tx_dma->done_count == 0 ||
+            (rt_int32_t)(tx_dma->sent - tx_dma->done[tx_dma->done_head].end) < 0)
+        {
+            rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+            break;
+        }
+        data = tx_dma->done[tx_dma->done_head].data;
+        tx_dma->done_head = (tx_dma->done_head + 1) % RT_SERIAL_DMA_TX_DONE_NUM;
+        tx_dma->done_count --;
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+        if (serial->parent.tx_complete != RT_NULL)
+        {
+            serial->parent.tx_complete(&serial->parent, (void *)data);
+        }
+    }
+}
+
+/*
+ * Writers take turns by the lock, so only one waits on the completion. The
+ * console, isr and interrupt masked callers can not sleep: they only copy what
+ * fits into the arena and get no tx_complete.
+ */
+rt_inline int _serial_dma_arena_tx(struct rt_serial_device *serial, const rt_uint8_t *data, int length)
+{
+    int size, len, seg;
+    rt_base_t level;
+    rt_err_t result = RT_EOK;
+    rt_bool_t can_wait;
+    const rt_uint8_t *buffer = data;
+    struct rt_serial_tx_dma *tx_dma;
+
+    size = length;
+    tx_dma = (struct rt_serial_tx_dma*)(serial->serial_tx);
+    RT_ASSERT(tx_dma != RT_NULL);
+
+    can_wait = rt_scheduler_is_available();
+#if defined(RT_USING_DEVICE) && defined(RT_USING_CONSOLE)
+    if (&serial->parent == rt_console_get_device())
+    {
+        can_wait = RT_FALSE;
+    }
+#endif
+    /* closed meanwhile */
+    if (can_wait && rt_mutex_take(&(tx_dma->lock), RT_WAITING_FOREVER) != RT_EOK)
+    {
+        return 0;
+    }
+
+    level = rt_spin_lock_irqsave(&(serial->spinlock));
+    tx_dma->writes ++;
+    rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+    while (length && result == RT_EOK)
+    {
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+
+#if RT_SERIAL_DMA_TX_ZEROCOPY_MIN > 0
+        if (can_wait && length >= RT_SERIAL_DMA_TX_ZEROCOPY_MIN && rt_hw_serial_dma_reachable(serial, data))
+        {
+            /* keep the order, the arena goes first */
+            if (tx_dma->activated == RT_TRUE || tx_dma->count)
+            {
+                rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+                _serial_dma_arena_stall(serial, tx_dma);
+                continue;
+            }
+
+            /* the dma counter is 16 bits */
+            len = length > 0xffff ? 0xffff : length;
+            tx_dma->zc_data = data;
+            tx_dma->burst = len;
+            tx_dma->activated = RT_TRUE;
+            if (serial->ops->dma_transmit(serial, (rt_uint8_t *)data, len, RT_SERIAL_DMA_TX) != len)
+            {
+                tx_dma->zc_data = RT_NULL;
+                tx_dma->burst = 0;
+                tx_dma->activated = RT_FALSE;
+                rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+                result = -RT_EIO;
+                break;
+            }
+            tx_dma->queued += len;
+            tx_dma->bursts ++;
+            tx_dma->zc_bursts ++;
+            tx_dma->burst_bytes += len;
+            if (len > tx_dma->burst_max) tx_dma->burst_max = len;
+            rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+            /* the buffer is the caller's, hold it until the dma is done */
+            while (tx_dma->zc_data == data)
+            {
+                rt_completion_wait(&(tx_dma->completion), RT_WAITING_FOREVER);
+            }
+            data += len; length -= len;
+            continue;
+        }
+#endif /* RT_SERIAL_DMA_TX_ZEROCOPY_MIN > 0 */
+
+        len = RT_SERIAL_DMA_TX_BUFSZ - tx_dma->count;
+        if (len > length) len = length;
+
+        seg = RT_SERIAL_DMA_TX_BUFSZ - tx_dma->put_index;
+        if (seg > len) seg = len;
+        rt_memcpy(&tx_dma->buffer[tx_dma->put_index], data, seg);
+        rt_memcpy(tx_dma->buffer, data + seg, len - seg);
+
+        tx_dma->put_index += len;
+        if (tx_dma->put_index >= RT_SERIAL_DMA_TX_BUFSZ) tx_dma->put_index -= RT_SERIAL_DMA_TX_BUFSZ;
+        tx_dma->count += len;
+        tx_dma->queued += len;
+        data += len; length -= len;
+
+        if (tx_dma->count && tx_dma->activated == RT_FALSE)
+        {
+            result = _serial_dma_arena_kick(serial, tx_dma);
+        }
+
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+        if (length && result == RT_EOK)
+        {
+            /* arena full, wait for the running transfer or take what fitted */
+            if (!can_wait)
+            {
+                break;
+            }
+            _serial_dma_arena_stall(serial, tx_dma);
+        }
+    }
+
+    /* tx_complete once the last byte of the write is sent */
+    while (can_wait && result == RT_EOK && serial->parent.tx_complete != RT_NULL)
+    {
+        level = rt_spin_lock_irqsave(&(serial->spinlock));
+        if (_serial_dma_arena_done_put(tx_dma, buffer))
+        {
+            rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+            /* it may be sent already and no isr comes anymore */
+            _serial_dma_arena_done(serial, tx_dma);
+            break;
+        }
+        rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+        _serial_dma_arena_stall(serial, tx_dma);
+    }
+
+    if (can_wait)
+    {
+        rt_mutex_release(&(tx_dma->lock));
+    }
+
+    if (result != RT_EOK)
+    {
+        rt_set_errno(result);
+    }
+
+    return size - length;
+}
+
+/* running transfer is done, in isr */
+static void _serial_dma_arena_tx_isr(struct rt_serial_device *serial)
+{
+    rt_base_t level;
+    struct rt_serial_tx_dma *tx_dma;
+
+    tx_dma = (struct rt_serial_tx_dma*) serial->serial_tx;
+
+    level = rt_spin_lock_irqsave(&(serial->spinlock));
+    if (tx_dma->zc_data != RT_NULL)
+    {
+        tx_dma->zc_data = RT_NULL;
+    }
+    else
+    {
+        tx_dma->get_index += tx_dma->burst;
+        if (tx_dma->get_index >= RT_SERIAL_DMA_TX_BUFSZ) tx_dma->get_index -= RT_SERIAL_DMA_TX_BUFSZ;
+        tx_dma->count -= tx_dma->burst;
+    }
+    tx_dma->sent += tx_dma->burst;
+    tx_dma->burst = 0;
+    tx_dma->activated = RT_FALSE;
+
+    /* everything written meanwhile goes in one burst */
+    if (tx_dma->count)
+    {
+        _serial_dma_arena_kick(serial, tx_dma);
+    }
+    rt_spin_unlock_irqrestore(&(serial->spinlock), level);
+
+    rt_completion_done(&(tx_dma->completion));
+
+    _serial_dma_arena_done(serial, tx_dma);
+}
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
 #endif /* RT_SERIAL_USING_DMA */
 
 /* RT-Thread Device Interface */
@@ -720,6 +1167,23 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
         {
             struct rt_serial_tx_fifo *tx_fifo;
 
+#ifdef RT_SERIAL_USING_TX_FIFO
+            tx_fifo = (struct rt_serial_tx_fifo*) rt_malloc(sizeof(struct rt_serial_tx_fifo) +
+                RT_SERIAL_TX_RB_BUFSZ);
+            RT_ASSERT(tx_fifo != RT_NULL);
+            tx_fifo->buffer = (rt_uint8_t*) (tx_fifo + 1);
+            tx_fifo->put_index = 0;
+            tx_fifo->get_index = 0;
+            tx_fifo->count = 0;
+            tx_fifo->activated = RT_FALSE;
+
+            rt_completion_init(&(tx_fifo->completion));
+            rt_mutex_init(&(tx_fifo->lock), "stx", RT_IPC_FLAG_PRIO);
+            serial->serial_tx = tx_fifo;
+
+            /* tx empty interrupt is enabled by the first write */
+            dev->open_flag |= RT_DEVICE_FLAG_INT_TX;
+#else
             tx_fifo = (struct rt_serial_tx_fifo*) rt_malloc(sizeof(struct rt_serial_tx_fifo));
             RT_ASSERT(tx_fifo != RT_NULL);
 
@@ -729,6 +1193,7 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
             dev->open_flag |= RT_DEVICE_FLAG_INT_TX;
             /* configure low level device */
             serial->ops->control(serial, RT_DEVICE_CTRL_SET_INT, (void *)RT_DEVICE_FLAG_INT_TX);
+#endif /* RT_SERIAL_USING_TX_FIFO */
         }
 #ifdef RT_SERIAL_USING_DMA
         else if (oflag & RT_DEVICE_FLAG_DMA_TX)
@@ -739,7 +1204,15 @@ static rt_err_t rt_serial_open(struct rt_device *dev, rt_uint16_t oflag)
             RT_ASSERT(tx_dma != RT_NULL);
             tx_dma->activated = RT_FALSE;
 
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+            rt_memset(tx_dma, 0, sizeof(struct rt_serial_tx_dma));
+            tx_dma->buffer = (rt_uint8_t *) rt_malloc (RT_SERIAL_DMA_TX_BUFSZ);
+            RT_ASSERT(tx_dma->buffer != RT_NULL);
+            rt_completion_init(&(tx_dma->completion));
+            rt_mutex_init(&(tx_dma->lock), "stx", RT_IPC_FLAG_PRIO);
+#else
             rt_data_queue_init(&(tx_dma->data_queue), 8, 4, RT_NULL);
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
             serial->serial_tx = tx_dma;
 
             dev->open_flag |= RT_DEVICE_FLAG_DMA_TX;
@@ -827,12 +1300,25 @@ static rt_err_t rt_serial_close(struct rt_device *dev)
     {
         struct rt_serial_tx_fifo* tx_fifo;
 
-        serial->ops->control(serial, RT_DEVICE_CTRL_CLR_INT, (void*)RT_DEVICE_FLAG_INT_TX);
-        dev->open_flag &= ~RT_DEVICE_FLAG_INT_TX;
-
         tx_fifo = (struct rt_serial_tx_fifo*)serial->serial_tx;
         RT_ASSERT(tx_fifo != RT_NULL);
 
+#ifdef RT_SERIAL_USING_TX_FIFO
+        /* let the writer and the queued bytes go out, give up if the line is stuck */
+        if (rt_mutex_take(&(tx_fifo->lock), RT_TICK_PER_SECOND) == RT_EOK)
+        {
+            while (tx_fifo->count)
+            {
+                if (rt_completion_wait(&(tx_fifo->completion), RT_TICK_PER_SECOND) != RT_EOK) break;
+            }
+            rt_mutex_release(&(tx_fifo->lock));
+        }
+        rt_mutex_detach(&(tx_fifo->lock));
+#endif /* RT_SERIAL_USING_TX_FIFO */
+
+        serial->ops->control(serial, RT_DEVICE_CTRL_CLR_INT, (void*)RT_DEVICE_FLAG_INT_TX);
+        dev->open_flag &= ~RT_DEVICE_FLAG_INT_TX;
+
         rt_free(tx_fifo);
         serial->serial_tx = RT_NULL;
 
@@ -843,14 +1329,31 @@ static rt_err_t rt_serial_close(struct rt_device *dev)
     {
         struct rt_serial_tx_dma* tx_dma;
 
+        tx_dma = (struct rt_serial_tx_dma*)serial->serial_tx;
+        RT_ASSERT(tx_dma != RT_NULL);
+
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+        /* let the writer and the staged bytes go out, give up if the line is stuck */
+        if (rt_mutex_take(&(tx_dma->lock), RT_TICK_PER_SECOND) == RT_EOK)
+        {
+            while (tx_dma->activated == RT_TRUE)
+            {
+                if (rt_completion_wait(&(tx_dma->completion), RT_TICK_PER_SECOND) != RT_EOK) break;
+            }
+            rt_mutex_release(&(tx_dma->lock));
+        }
+        rt_mutex_detach(&(tx_dma->lock));
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
+
         /* configure low level device */
         serial->ops->control(serial, RT_DEVICE_CTRL_CLR_INT, (void *) RT_DEVICE_FLAG_DMA_TX);
         dev->open_flag &= ~RT_DEVICE_FLAG_DMA_TX;
 
-        tx_dma = (struct rt_serial_tx_dma*)serial->serial_tx;
-        RT_ASSERT(tx_dma != RT_NULL);
-
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+        rt_free(tx_dma->buffer);
+#else
         rt_data_queue_deinit(&(tx_dma->data_queue));
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
 
         rt_free(tx_dma);
         serial->serial_tx = RT_NULL;
@@ -904,12 +1407,28 @@ static rt_ssize_t rt_serial_write(struct rt_device *dev,
 
     if (dev->open_flag & RT_DEVICE_FLAG_INT_TX)
     {
+#ifdef RT_SERIAL_USING_TX_FIFO
+        if (!rt_scheduler_is_available()
+#if defined(RT_USING_DEVICE) && defined(RT_USING_CONSOLE)
+            || dev == rt_console_get_device()
+#endif
+           )
+        {
+            return _serial_fifo_poll_tx(serial, (const rt_uint8_t *)buffer, size);
+        }
+        return _serial_fifo_tx(serial, (const rt_uint8_t *)buffer, size);
+#else
         return _serial_int_tx(serial, (const rt_uint8_t *)buffer, size);
+#endif /* RT_SERIAL_USING_TX_FIFO */
     }
 #ifdef RT_SERIAL_USING_DMA
     else if (dev->open_flag & RT_DEVICE_FLAG_DMA_TX)
     {
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+        return _serial_dma_arena_tx(serial, (const rt_uint8_t *)buffer, size);
+#else
         return _serial_dma_tx(serial, (const rt_uint8_t *)buffer, size);
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
     }
 #endif /* RT_SERIAL_USING_DMA */
     else
@@ -1407,15 +1926,13 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             rx_fifo = (struct rt_serial_rx_fifo*)serial->serial_rx;
             RT_ASSERT(rx_fifo != RT_NULL);
 
+            /* disable interrupt once for all the pending chars */
+            level = rt_spin_lock_irqsave(&(serial->spinlock));
             while (1)
             {
                 ch = serial->ops->getc(serial);
                 if (ch == -1) break;
 
-
-                /* disable interrupt */
-                level = rt_spin_lock_irqsave(&(serial->spinlock));
-
                 rx_fifo->buffer[rx_fifo->put_index] = ch;
                 rx_fifo->put_index += 1;
                 if (rx_fifo->put_index >= serial->config.bufsz) rx_fifo->put_index = 0;
@@ -1429,10 +1946,9 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
 
                     _serial_check_buffer_size();
                 }
-
-                /* enable interrupt */
-                rt_spin_unlock_irqrestore(&(serial->spinlock), level);
             }
+            /* enable interrupt */
+            rt_spin_unlock_irqrestore(&(serial->spinlock), level);
 
             /**
              * Invoke callback.
@@ -1463,15 +1979,22 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
         }
         case RT_SERIAL_EVENT_TX_DONE:
         {
+#ifdef RT_SERIAL_USING_TX_FIFO
+            _serial_fifo_tx_isr(serial);
+#else
             struct rt_serial_tx_fifo* tx_fifo;
 
             tx_fifo = (struct rt_serial_tx_fifo*)serial->serial_tx;
             rt_completion_done(&(tx_fifo->completion));
+#endif /* RT_SERIAL_USING_TX_FIFO */
             break;
         }
 #ifdef RT_SERIAL_USING_DMA
         case RT_SERIAL_EVENT_TX_DMADONE:
         {
+#ifdef RT_SERIAL_USING_DMA_TX_ARENA
+            _serial_dma_arena_tx_isr(serial);
+#else
             const void *data_ptr;
             rt_size_t data_size;
             const void *last_data_ptr;
@@ -1496,6 +2019,7 @@ void rt_hw_serial_isr(struct rt_serial_device *serial, int event)
             {
                 serial->parent.tx_complete(&serial->parent, (void*)last_data_ptr);
             }
+#endif /* RT_SERIAL_USING_DMA_TX_ARENA */
             break;
         }
         case RT_SERIAL_EVENT_RX_DMADONE:
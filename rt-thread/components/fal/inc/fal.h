@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-05-17     armink       the first version
+ * 2026-10-17     loogg        add the partition counters and the asynchronous requests
  */
 
 #ifndef _FAL_H_
@@ -115,6 +116,70 @@ int fal_partition_erase(const struct fal_partition *part, uint32_t addr, size_t
  */
 int fal_partition_erase_all(const struct fal_partition *part);
 
+/**
+ * get the erase and write counters of partition since FAL initialization
+ *
+ * @param part partition
+ * @param stat return the counters
+ *
+ * @return 0: successful
+ *        -1: error
+ */
+int fal_partition_stat_get(const struct fal_partition *part, struct fal_partition_stat *stat);
+
+#ifdef FAL_USING_ASYNC
+/**
+ * queue a write of data to partition, the data is copied and written by the FAL thread
+ * It waits while all requests are queued.
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param buf write buffer
+ * @param size write size
+ *
+ * @return >= 0: queued data size
+ *           -1: error
+ */
+int fal_partition_write_async(const struct fal_partition *part, uint32_t addr, const uint8_t *buf, size_t size);
+
+/**
+ * queue an erase of partition data, done by the FAL thread after the requests queued before
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param size erase size
+ *
+ * @return >= 0: queued erase size
+ *           -1: error
+ */
+int fal_partition_erase_async(const struct fal_partition *part, uint32_t addr, size_t size);
+
+/**
+ * tell the blocks in partition data hold nothing anymore
+ * The FAL thread erases them while no request is queued, so that a later erase costs nothing.
+ * A block is left alone if it is written in the meantime, only whole blocks are discarded.
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param size discard size
+ *
+ * @return >= 0: discarded data size
+ *           -1: error
+ */
+int fal_partition_discard(const struct fal_partition *part, uint32_t addr, size_t size);
+
+/**
+ * wait for the requests of all partitions queued before
+ * Reading partition data still queued gives the data before.
+ *
+ * @param part partition
+ *
+ * @return 0: the requests of the partition all done
+ *        -1: a request of the partition failed since the last sync
+ */
+int fal_partition_sync(const struct fal_partition *part);
+#endif /* FAL_USING_ASYNC */
+
 /**
  * print the partition table
  */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-05-17     armink       the first version
+ * 2026-10-17     loogg        add the partition counters and the asynchronous requests
  */
 
 #ifndef _FAL_DEF_H_
@@ -129,4 +130,19 @@ struct fal_partition
 };
 typedef struct fal_partition *fal_partition_t;
 
+/**
+ * FAL partition counters, erases in the block size of the flash device
+ */
+struct fal_partition_stat
+{
+    /* blocks erased on the flash, the erased ahead included */
+    uint32_t erases;
+    /* blocks erased in the background after a discard */
+    uint32_t erases_ahead;
+    /* blocks not erased, still erased since the last erase */
+    uint32_t erases_skipped;
+    /* bytes written */
+    uint32_t write_bytes;
+};
+
 #endif /* _FAL_DEF_H_ */
@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-05-17     armink       the first version
+ * 2026-10-17     loogg        start the FAL thread of the asynchronous requests
  */
 
 #include <fal.h>
@@ -22,6 +23,9 @@ int fal_init(void)
 {
     extern int fal_flash_init(void);
     extern int fal_partition_init(void);
+#ifdef FAL_USING_ASYNC
+    extern int fal_async_init(void);
+#endif
 
     int result;
 
@@ -35,6 +39,13 @@ int fal_init(void)
     /* initialize all flash partition on FAL partition table */
     result = fal_partition_init();
 
+#ifdef FAL_USING_ASYNC
+    if (result > 0 && fal_async_init() < 0)
+    {
+        result = -1;
+    }
+#endif
+
 __exit:
 
     if ((result > 0) && (!init_ok))
@@ -0,0 +1,281 @@
+/*
+ * Copyright (c) 2006-2022, RT-Thread Development Team
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ *
+ * Change Logs:
+ * Date           Author       Notes
+ * 2026-10-17     loogg        the first version
+ */
+
+#include <fal.h>
+#include <string.h>
+
+#ifdef FAL_USING_ASYNC
+
+/*
+ * Asynchronous writes and erases. The requests go in order through a mailbox to the FAL thread
+ * which does them with fal_partition_write and fal_partition_erase, so the caller gets on while
+ * the flash programs and erases. When nothing is queued the thread erases the discarded blocks
+ * one by one, and a later erase of them is skipped.
+ */
+
+#define FAL_ASYNC_WRITE             0
+#define FAL_ASYNC_ERASE             1
+#define FAL_ASYNC_SYNC              2
+
+struct fal_async_req
+{
+    uint8_t type;
+    const struct fal_partition *part;
+    uint32_t addr;
+    size_t size;
+    /* the caller waiting for a sync */
+    struct rt_semaphore *done;
+    int *result;
+    uint8_t buf[FAL_ASYNC_BUF_SIZE];
+};
+
+static struct fal_async_req req_pool[FAL_ASYNC_REQ_NUM];
+static struct rt_mailbox free_mb, work_mb;
+static rt_ubase_t free_mb_pool[FAL_ASYNC_REQ_NUM];
+/* one more for a wakeup */
+static rt_ubase_t work_mb_pool[FAL_ASYNC_REQ_NUM + 1];
+static struct rt_thread fal_thread;
+rt_align(RT_ALIGN_SIZE)
+static uint8_t fal_thread_stack[FAL_ASYNC_THREAD_STACK_SIZE];
+static uint8_t init_ok = 0;
+
+extern int fal_partition_erase_ahead(void);
+extern int fal_partition_async_failed(const struct fal_partition *part, int failed);
+
+static void fal_async_entry(void *parameter)
+{
+    struct fal_async_req *req;
+    rt_int32_t timeout = RT_WAITING_NO;
+
+    while (1)
+    {
+        if (rt_mb_recv(&work_mb, (rt_ubase_t *)&req, timeout) != RT_EOK)
+        {
+            /* nothing queued, erase a discarded block and look again */
+            timeout = fal_partition_erase_ahead() ? RT_WAITING_NO : RT_WAITING_FOREVER;
+            continue;
+        }
+
+        timeout = RT_WAITING_NO;
+        if (req == RT_NULL)
+        {
+            /* a wakeup for blocks discarded */
+            continue;
+        }
+
+        switch (req->type)
+        {
+        case FAL_ASYNC_WRITE:
+            if (fal_partition_write(req->part, req->addr, req->buf, req->size) < 0)
+            {
+                fal_partition_async_failed(req->part, 1);
+            }
+            break;
+        case FAL_ASYNC_ERASE:
+            if (fal_partition_erase(req->part, req->addr, req->size) < 0)
+            {
+                fal_partition_async_failed(req->part, 1);
+            }
+            break;
+        case FAL_ASYNC_SYNC:
+            *req->result = fal_partition_async_failed(req->part, 0);
+            rt_sem_release(req->done);
+            break;
+        }
+
+        rt_mb_send(&free_mb, (rt_ubase_t)req);
+    }
+}
+
+/**
+ * Initialize the FAL thread and the request queue
+ *
+ * @return result
+ */
+int fal_async_init(void)
+{
+    size_t i;
+
+    if (init_ok)
+    {
+        return 0;
+    }
+
+    rt_mb_init(&free_mb, "fal_free", free_mb_pool, FAL_ASYNC_REQ_NUM, RT_IPC_FLAG_FIFO);
+    rt_mb_init(&work_mb, "fal_work", work_mb_pool, FAL_ASYNC_REQ_NUM + 1, RT_IPC_FLAG_FIFO);
+    for (i = 0; i < FAL_ASYNC_REQ_NUM; i++)
+    {
+        rt_mb_send(&free_mb, (rt_ubase_t)&req_pool[i]);
+    }
+
+    if (rt_thread_init(&fal_thread, "fal", fal_async_entry, RT_NULL, fal_thread_stack, sizeof(fal_thread_stack),
+            FAL_ASYNC_THREAD_PRIORITY, 10) != RT_EOK)
+    {
+        log_e("Initialize failed! The FAL thread can't be made.");
+        rt_mb_detach(&free_mb);
+        rt_mb_detach(&work_mb);
+        return -1;
+    }
+    rt_thread_startup(&fal_thread);
+
+    init_ok = 1;
+    return 0;
+}
+
+/**
+ * wake the FAL thread up for discarded blocks
+ */
+void fal_async_wakeup(void)
+{
+    if (init_ok)
+    {
+        /* full is fine, the thread looks at the blocks after the queue anyway */
+        rt_mb_send(&work_mb, (rt_ubase_t)RT_NULL);
+    }
+}
+
+static struct fal_async_req *fal_async_req_get(const struct fal_partition *part, uint8_t type)
+{
+    struct fal_async_req *req;
+
+    rt_mb_recv(&free_mb, (rt_ubase_t *)&req, RT_WAITING_FOREVER);
+    req->type = type;
+    req->part = part;
+
+    return req;
+}
+
+static void fal_async_req_put(struct fal_async_req *req)
+{
+    /* wakeups may hold the places for a moment */
+    rt_mb_send_wait(&work_mb, (rt_ubase_t)req, RT_WAITING_FOREVER);
+}
+
+/**
+ * queue a write of data to partition, the data is copied and written by the FAL thread
+ * It waits while all requests are queued.
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param buf write buffer
+ * @param size write size
+ *
+ * @return >= 0: queued data size
+ *           -1: error
+ */
+int fal_partition_write_async(const struct fal_partition *part, uint32_t addr, const uint8_t *buf, size_t size)
+{
+    struct fal_async_req *req;
+    size_t done, len;
+
+    assert(part);
+    assert(buf);
+
+    if (!init_ok)
+    {
+        log_e("Partition write error! FAL thread NOT initialized.");
+        return -1;
+    }
+
+    if (addr + size > part->len)
+    {
+        log_e("Partition write error! Partition address out of bound.");
+        return -1;
+    }
+
+    for (done = 0; done < size; done += len)
+    {
+        /* cut on buffer size boundaries, a NOR flash page each */
+        len = FAL_ASYNC_BUF_SIZE - (addr + done) % FAL_ASYNC_BUF_SIZE;
+        if (len > size - done)
+        {
+            len = size - done;
+        }
+
+        req = fal_async_req_get(part, FAL_ASYNC_WRITE);
+        req->addr = addr + done;
+        req->size = len;
+        memcpy(req->buf, buf + done, len);
+        fal_async_req_put(req);
+    }
+
+    return size;
+}
+
+/**
+ * queue an erase of partition data, done by the FAL thread after the requests queued before
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param size erase size
+ *
+ * @return >= 0: queued erase size
+ *           -1: error
+ */
+int fal_partition_erase_async(const struct fal_partition *part, uint32_t addr, size_t size)
+{
+    struct fal_async_req *req;
+
+    assert(part);
+
+    if (!init_ok)
+    {
+        log_e("Partition erase error! FAL thread NOT initialized.");
+        return -1;
+    }
+
+    if (addr + size > part->len)
+    {
+        log_e("Partition erase error! Partition address out of bound.");
+        return -1;
+    }
+
+    req = fal_async_req_get(part, FAL_ASYNC_ERASE);
+    req->addr = addr;
+    req->size = size;
+    fal_async_req_put(req);
+
+    return size;
+}
+
+/**
+ * wait for the requests of all partitions queued before
+ * Reading partition data still queued gives the data before.
+ *
+ * @param part partition
+ *
+ * @return 0: the requests of the partition all done
+ *        -1: a request of the partition failed since the last sync
+ */
+int fal_partition_sync(const struct fal_partition *part)
+{
+    struct fal_async_req *req;
+    struct rt_semaphore done;
+    int result = -1;
+
+    assert(part);
+
+    if (!init_ok)
+    {
+        return 0;
+    }
+
+    rt_sem_init(&done, "fal_sync", 0, RT_IPC_FLAG_FIFO);
+    req = fal_async_req_get(part, FAL_ASYNC_SYNC);
+    req->done = &done;
+    req->result = &result;
+    fal_async_req_put(req);
+    rt_sem_take(&done, RT_WAITING_FOREVER);
+    rt_sem_detach(&done);
+
+    return result;
+}
+
+#endif /* FAL_USING_ASYNC */
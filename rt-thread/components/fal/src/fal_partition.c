@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-05-17     armink       the first version
+ * 2026-10-17     loogg        add erase counters, erase-ahead of discarded blocks
  */
 
 #include <fal.h>
@@ -21,6 +22,15 @@
 struct part_flash_info
 {
     const struct fal_flash_dev *flash_dev;
+    struct fal_partition_stat stat;
+#ifdef FAL_USING_ASYNC
+    /* a bit for every block: erased since the last erase, discarded and not erased yet */
+    uint32_t *erased;
+    uint32_t *discarded;
+    size_t discards;
+    /* a queued request failed since the last sync */
+    int failed;
+#endif
 };
 
 /**
@@ -58,6 +68,93 @@ static struct part_flash_info *part_flash_cache = NULL;
 static uint8_t init_ok = 0;
 static size_t partition_table_len = 0;
 
+#ifdef FAL_USING_ASYNC
+#define PART_BLK_GET(map, i)        ((map)[(i) / 32] & (1UL << ((i) % 32)))
+#define PART_BLK_SET(map, i)        ((map)[(i) / 32] |= (1UL << ((i) % 32)))
+#define PART_BLK_CLR(map, i)        ((map)[(i) / 32] &= ~(1UL << ((i) % 32)))
+
+/* writes, erases and the block state of all partitions */
+static struct rt_mutex part_lock;
+static uint8_t lock_init_ok = 0;
+/* discarded blocks of all partitions not erased yet */
+static size_t part_discards = 0;
+/* the partition to erase ahead next */
+static size_t part_ahead = 0;
+
+extern void fal_async_wakeup(void);
+
+static void part_blocks_free(struct part_flash_info *info)
+{
+    if (info->erased)
+    {
+        FAL_FREE(info->erased);
+    }
+    part_discards -= info->discards;
+    info->erased = NULL;
+    info->discarded = NULL;
+    info->discards = 0;
+}
+
+static void part_blocks_alloc(const struct fal_partition *part, struct part_flash_info *info)
+{
+    const struct fal_flash_dev *flash_dev = info->flash_dev;
+    size_t words;
+
+    /* a flash of one block size and the partition on whole blocks, else its erases are never skipped */
+    if (flash_dev->blk_size == 0 || flash_dev->blocks[0].count != 0 || part->offset % flash_dev->blk_size != 0
+            || part->len % flash_dev->blk_size != 0)
+    {
+        return;
+    }
+
+    words = (part->len / flash_dev->blk_size + 31) / 32;
+    info->erased = FAL_CALLOC(2 * words, sizeof(uint32_t));
+    if (info->erased == NULL)
+    {
+        log_e("No memory for the block state of partition(%s), its erases are never skipped.", part->name);
+        return;
+    }
+    info->discarded = info->erased + words;
+}
+
+static void part_blocks_written(struct part_flash_info *info, uint32_t addr, size_t size)
+{
+    size_t i, blk_size = info->flash_dev->blk_size;
+
+    if (info->erased == NULL || size == 0)
+    {
+        return;
+    }
+
+    for (i = addr / blk_size; i <= (addr + size - 1) / blk_size; i++)
+    {
+        PART_BLK_CLR(info->erased, i);
+        if (PART_BLK_GET(info->discarded, i))
+        {
+            PART_BLK_CLR(info->discarded, i);
+            info->discards--;
+            part_discards--;
+        }
+    }
+}
+
+static void part_blocks_erased(struct part_flash_info *info, size_t first, size_t end)
+{
+    size_t i;
+
+    for (i = first; i < end; i++)
+    {
+        PART_BLK_SET(info->erased, i);
+        if (PART_BLK_GET(info->discarded, i))
+        {
+            PART_BLK_CLR(info->discarded, i);
+            info->discards--;
+            part_discards--;
+        }
+    }
+}
+#endif /* FAL_USING_ASYNC */
+
 /**
  * print the partition table
  */
@@ -106,6 +203,14 @@ static int check_and_update_part_cache(const struct fal_partition *table, size_t
     const struct fal_flash_dev *flash_dev = NULL;
     size_t i;
 
+#ifdef FAL_USING_ASYNC
+    /* the block state of the table before */
+    for (i = 0; init_ok && i < partition_table_len; i++)
+    {
+        part_blocks_free(&part_flash_cache[i]);
+    }
+#endif
+
 #ifndef FAL_PART_HAS_TABLE_CFG
     if (part_flash_cache)
     {
@@ -121,6 +226,7 @@ static int check_and_update_part_cache(const struct fal_partition *table, size_t
 
     for (i = 0; i < len; i++)
     {
+        memset(&part_flash_cache[i], 0x00, sizeof(struct part_flash_info));
         flash_dev = fal_flash_device_find(table[i].flash_name);
         if (flash_dev == NULL)
         {
@@ -138,6 +244,9 @@ static int check_and_update_part_cache(const struct fal_partition *table, size_t
         }
 
         part_flash_cache[i].flash_dev = flash_dev;
+#ifdef FAL_USING_ASYNC
+        part_blocks_alloc(&table[i], &part_flash_cache[i]);
+#endif
     }
 
     return 0;
@@ -156,6 +265,14 @@ int fal_partition_init(void)
         return partition_table_len;
     }
 
+#ifdef FAL_USING_ASYNC
+    if (!lock_init_ok)
+    {
+        rt_mutex_init(&part_lock, "fal", RT_IPC_FLAG_PRIO);
+        lock_init_ok = 1;
+    }
+#endif
+
 #ifdef FAL_PART_HAS_TABLE_CFG
     partition_table = &partition_table_def[0];
     partition_table_len = sizeof(partition_table_def) / sizeof(partition_table_def[0]);
@@ -443,6 +560,7 @@ int fal_partition_write(const struct fal_partition *part, uint32_t addr, const u
 {
     int ret = 0;
     const struct fal_flash_dev *flash_dev = NULL;
+    struct part_flash_info *info;
 
     assert(part);
     assert(buf);
@@ -460,11 +578,79 @@ int fal_partition_write(const struct fal_partition *part, uint32_t addr, const u
         return -1;
     }
 
+    info = &part_flash_cache[part - partition_table];
+#ifdef FAL_USING_ASYNC
+    rt_mutex_take(&part_lock, RT_WAITING_FOREVER);
+#endif
+
     ret = flash_dev->ops.write(part->offset + addr, buf, size);
     if (ret < 0)
     {
         log_e("Partition write error! Flash device(%s) write error!", part->flash_name);
     }
+    else
+    {
+        info->stat.write_bytes += ret;
+    }
+
+#ifdef FAL_USING_ASYNC
+    /* failed or not, the blocks are not erased anymore */
+    part_blocks_written(info, addr, size);
+    rt_mutex_release(&part_lock);
+#endif
+
+    return ret;
+}
+
+static int part_erase(const struct fal_partition *part, struct part_flash_info *info, uint32_t addr, size_t size)
+{
+    const struct fal_flash_dev *flash_dev = info->flash_dev;
+    size_t blk_size = flash_dev->blk_size;
+    int ret;
+
+    if (size == 0 || blk_size == 0)
+    {
+        return flash_dev->ops.erase(part->offset + addr, size);
+    }
+
+#ifdef FAL_USING_ASYNC
+    if (info->erased)
+    {
+        size_t i = addr / blk_size, end = (addr + size - 1) / blk_size + 1, run;
+
+        while (i < end)
+        {
+            if (PART_BLK_GET(info->erased, i))
+            {
+                info->stat.erases_skipped++;
+                i++;
+                continue;
+            }
+            /* the blocks up to the next one still erased at once */
+            run = i + 1;
+            while (run < end && !PART_BLK_GET(info->erased, run))
+            {
+                run++;
+            }
+            ret = flash_dev->ops.erase(part->offset + i * blk_size, (run - i) * blk_size);
+            if (ret < 0)
+            {
+                return ret;
+            }
+            info->stat.erases += run - i;
+            part_blocks_erased(info, i, run);
+            i = run;
+        }
+
+        return size;
+    }
+#endif /* FAL_USING_ASYNC */
+
+    ret = flash_dev->ops.erase(part->offset + addr, size);
+    if (ret >= 0)
+    {
+        info->stat.erases += (part->offset + addr + size - 1) / blk_size - (part->offset + addr) / blk_size + 1;
+    }
 
     return ret;
 }
@@ -499,12 +685,20 @@ int fal_partition_erase(const struct fal_partition *part, uint32_t addr, size_t
         return -1;
     }
 
-    ret = flash_dev->ops.erase(part->offset + addr, size);
+#ifdef FAL_USING_ASYNC
+    rt_mutex_take(&part_lock, RT_WAITING_FOREVER);
+#endif
+
+    ret = part_erase(part, &part_flash_cache[part - partition_table], addr, size);
     if (ret < 0)
     {
         log_e("Partition erase error! Flash device(%s) erase error!", part->flash_name);
     }
 
+#ifdef FAL_USING_ASYNC
+    rt_mutex_release(&part_lock);
+#endif
+
     return ret;
 }
 
@@ -520,3 +714,178 @@ int fal_partition_erase_all(const struct fal_partition *part)
 {
     return fal_partition_erase(part, 0, part->len);
 }
+
+/**
+ * get the erase and write counters of partition since FAL initialization
+ *
+ * @param part partition
+ * @param stat return the counters
+ *
+ * @return 0: successful
+ *        -1: error
+ */
+int fal_partition_stat_get(const struct fal_partition *part, struct fal_partition_stat *stat)
+{
+    assert(part);
+    assert(stat);
+
+    if (flash_device_find_by_part(part) == NULL)
+    {
+        return -1;
+    }
+
+    *stat = part_flash_cache[part - partition_table].stat;
+
+    return 0;
+}
+
+#ifdef FAL_USING_ASYNC
+/**
+ * tell the blocks in partition data hold nothing anymore
+ * The FAL thread erases them while no request is queued, so that a later erase costs nothing.
+ * A block is left alone if it is written in the meantime, only whole blocks are discarded.
+ *
+ * @param part partition
+ * @param addr relative address for partition
+ * @param size discard size
+ *
+ * @return >= 0: discarded data size
+ *           -1: error
+ */
+int fal_partition_discard(const struct fal_partition *part, uint32_t addr, size_t size)
+{
+    struct part_flash_info *info;
+    size_t i, first, end, blk_size;
+
+    assert(part);
+
+    if (addr + size > part->len)
+    {
+        log_e("Partition discard error! Partition address out of bound.");
+        return -1;
+    }
+
+    if (flash_device_find_by_part(part) == NULL)
+    {
+        log_e("Partition discard error! Don't found flash device(%s) of the partition(%s).", part->flash_name, part->name);
+        return -1;
+    }
+
+    info = &part_flash_cache[part - partition_table];
+    if (info->erased == NULL)
+    {
+        return 0;
+    }
+
+    blk_size = info->flash_dev->blk_size;
+    first = (addr + blk_size - 1) / blk_size;
+    end = (addr + size) / blk_size;
+    if (first >= end)
+    {
+        return 0;
+    }
+
+    rt_mutex_take(&part_lock, RT_WAITING_FOREVER);
+    for (i = first; i < end; i++)
+    {
+        if (!PART_BLK_GET(info->erased, i) && !PART_BLK_GET(info->discarded, i))
+        {
+            PART_BLK_SET(info->discarded, i);
+            info->discards++;
+            part_discards++;
+        }
+    }
+    rt_mutex_release(&part_lock);
+
+    fal_async_wakeup();
+
+    return (end - first) * blk_size;
+}
+
+/**
+ * erase a discarded block, done by the FAL thread while no request is queued
+ *
+ * @return 1: a block erased, 0: no block discarded
+ */
+int fal_partition_erase_ahead(void)
+{
+    struct part_flash_info *info = NULL;
+    size_t i, n, blk_size;
+    int ret;
+
+    rt_mutex_take(&part_lock, RT_WAITING_FOREVER);
+    if (part_discards == 0)
+    {
+        rt_mutex_release(&part_lock);
+        return 0;
+    }
+
+    /* the partitions in turn, a block at a time */
+    for (n = 0; n < partition_table_len; n++)
+    {
+        part_ahead = (part_ahead + 1) % partition_table_len;
+        if (part_flash_cache[part_ahead].discards)
+        {
+            info = &part_flash_cache[part_ahead];
+            break;
+        }
+    }
+    assert(info);
+
+    i = 0;
+    while (!info->discarded[i / 32])
+    {
+        i += 32;
+    }
+    while (!PART_BLK_GET(info->discarded, i))
+    {
+        i++;
+    }
+
+    blk_size = info->flash_dev->blk_size;
+    ret = info->flash_dev->ops.erase(partition_table[part_ahead].offset + i * blk_size, blk_size);
+    if (ret < 0)
+    {
+        log_e("Partition erase error! Flash device(%s) erase error!", partition_table[part_ahead].flash_name);
+        PART_BLK_CLR(info->discarded, i);
+        info->discards--;
+        part_discards--;
+    }
+    else
+    {
+        info->stat.erases++;
+        info->stat.erases_ahead++;
+        part_blocks_erased(info, i, i + 1);
+    }
+    rt_mutex_release(&part_lock);
+
+    return 1;
+}
+
+/**
+ * set or take the failure of a queued request of partition
+ *
+ * @param part partition
+ * @param failed 1: a request failed, 0: take the failure
+ *
+ * @return 0: no request failed since the last take, -1: a request failed
+ */
+int fal_partition_async_failed(const struct fal_partition *part, int failed)
+{
+    struct part_flash_info *info;
+    int ret;
+
+    if (flash_device_find_by_part(part) == NULL)
+    {
+        return -1;
+    }
+
+    info = &part_flash_cache[part - partition_table];
+    rt_mutex_take(&part_lock, RT_WAITING_FOREVER);
+    ret = info->failed ? -1 : 0;
+    info->failed = failed;
+    rt_mutex_release(&part_lock);
+
+    return ret;
+}
+#endif /* FAL_USING_ASYNC */
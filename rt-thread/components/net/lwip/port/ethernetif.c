@@ -15,6 +15,7 @@
  * 2018-11-02     MurphyZhao   port to lwIP 2.1.0
  * 2021-09-07     Grissiom     fix eth_tx_msg ack bug
  * 2022-02-22     xiangxistu   integrate v1.4.1 v2.0.3 and v2.1.2 porting layer
+ * 2026-10-18     loogg        full tx ring is ERR_MEM
  */
 
 /*
@@ -456,11 +457,18 @@ static err_t ethernetif_linkoutput(struct netif *netif, struct pbuf *p)
     }
 #else
     struct eth_device* enetif;
+    rt_err_t result;
 
     RT_ASSERT(netif != RT_NULL);
     enetif = (struct eth_device*)netif->state;
 
-    if (enetif->eth_tx(&(enetif->parent), p) != RT_EOK)
+    result = enetif->eth_tx(&(enetif->parent), p);
+    if (result == -RT_EBUSY || result == -RT_ENOMEM)
+    {
+        /* out of tx buffers for now, tcp keeps the segment and sends it again */
+        return ERR_MEM;
+    }
+    else if (result != RT_EOK)
     {
         return ERR_IF;
     }
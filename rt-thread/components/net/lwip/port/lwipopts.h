@@ -344,10 +344,21 @@
 #define PBUF_POOL_BUFSIZE            RT_LWIP_PBUF_POOL_BUFSIZE
 #endif
 
+/* LWIP_SUPPORT_CUSTOM_PBUF: zero copy drivers hand their dma buffers to the stack as custom pbufs */
+#ifndef LWIP_SUPPORT_CUSTOM_PBUF
+#define LWIP_SUPPORT_CUSTOM_PBUF     1
+#endif
+
 /* PBUF_LINK_HLEN: the number of bytes that should be allocated for a
    link level header. */
 #define PBUF_LINK_HLEN              16
 
+/* PBUF_LINK_ENCAPSULATION_HLEN: headroom in front of the link header,
+   usb host rndis builds its packet message header there to send pbuf without copy. */
+#ifdef PKG_CHERRYUSB_HOST_CDC_RNDIS
+#define PBUF_LINK_ENCAPSULATION_HLEN 48
+#endif
+
 #ifdef RT_LWIP_ETH_PAD_SIZE
 #define ETH_PAD_SIZE                RT_LWIP_ETH_PAD_SIZE
 #endif
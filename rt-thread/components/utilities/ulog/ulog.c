@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2026-10-17     loogg        binary log records, per tag rate limit
  */
 
 #include <stdarg.h>
@@ -70,6 +71,43 @@
 #error "the log line buffer size must more than 80"
 #endif
 
+#ifdef ULOG_USING_BINARY
+#if (ULOG_BINARY_BUF_SIZE & (ULOG_BINARY_BUF_SIZE - 1)) != 0 || ULOG_BINARY_BUF_SIZE > 32768
+#error "the binary record ring size must be a power of 2, 32768 at most"
+#endif
+
+/* raw arguments a record may carry */
+#define ULOG_BINARY_ARGS_SIZE          ULOG_LINE_BUF_SIZE
+
+#define ULOG_BINARY_NEWLINE            0x01
+/* nothing but padding up to the ring end */
+#define ULOG_BINARY_PAD                0x02
+
+/* a log as the caller left it, the raw arguments follow */
+struct ulog_binary_record
+{
+    rt_uint16_t size;
+    rt_uint8_t flags;
+    rt_uint8_t level;
+    /* arguments packed, the format is printed up to this conversion */
+    rt_uint32_t nargs;
+    rt_tick_t tick;
+    const char *tag;
+    const char *format;
+};
+#endif /* ULOG_USING_BINARY */
+
+#ifdef ULOG_USING_RATE_LIMIT
+struct ulog_rate_bucket
+{
+    const char *tag;
+    /* in 1/RT_TICK_PER_SECOND logs */
+    rt_uint32_t credit;
+    rt_tick_t last;
+    rt_uint32_t dropped;
+};
+#endif /* ULOG_USING_RATE_LIMIT */
+
 struct rt_ulog
 {
     rt_bool_t init_ok;
@@ -95,6 +133,25 @@ struct rt_ulog
     struct rt_semaphore async_notice;
 #endif
 
+#ifdef ULOG_USING_BINARY
+    rt_bool_t binary_enabled;
+    /* records between tail and head, free running */
+    rt_uint8_t *binary_buf;
+    rt_uint32_t binary_head;
+    rt_uint32_t binary_tail;
+    rt_uint32_t binary_lost;
+    rt_uint32_t binary_lost_shown;
+    /* the record being formatted, its tick goes to the log head */
+    const struct ulog_binary_record *binary_record;
+    char log_buf_binary[ULOG_LINE_BUF_SIZE + 1];
+#endif
+
+#ifdef ULOG_USING_RATE_LIMIT
+    rt_uint32_t rate_per_second;
+    rt_uint32_t rate_burst;
+    struct ulog_rate_bucket rate_bucket[ULOG_RATE_LIMIT_TAGS];
+#endif
+
 #ifdef ULOG_USING_FILTER
     struct
     {
@@ -307,9 +364,16 @@ rt_weak rt_size_t ulog_head_formater(char *log_buf, rt_uint32_t level, const cha
 
 #else
         static rt_size_t tick_len = 0;
+        rt_tick_t tick = rt_tick_get();
 
+#ifdef ULOG_USING_BINARY
+        if (ulog.binary_record && rt_interrupt_get_nest() == 0)
+        {
+            tick = ulog.binary_record->tick;
+        }
+#endif
         log_buf[log_len] = '[';
-        tick_len = ulog_ultoa(log_buf + log_len + 1, rt_tick_get());
+        tick_len = ulog_ultoa(log_buf + log_len + 1, tick);
         log_buf[log_len + 1 + tick_len] = ']';
         log_buf[log_len + 1 + tick_len + 1] = '\0';
 #endif /* ULOG_TIME_USING_TIMESTAMP */
@@ -625,6 +689,568 @@ static void do_output(rt_uint32_t level, const char *tag, rt_bool_t is_raw, cons
     }
 }
 
+#ifdef ULOG_USING_RATE_LIMIT
+static const char ulog_rate_notice[] = "%d logs dropped by the rate limit";
+
+/**
+ * take a log from the tag's bucket
+ *
+ * @param tag tag
+ * @param dropped the logs of the tag dropped since the last one passed
+ *
+ * @return RT_TRUE when the log may go out
+ */
+static rt_bool_t ulog_rate_pass(const char *tag, rt_uint32_t *dropped)
+{
+    struct ulog_rate_bucket *bucket = RT_NULL;
+    rt_uint32_t full, elapsed;
+    rt_tick_t now = rt_tick_get();
+    rt_bool_t pass = RT_TRUE;
+    rt_base_t level;
+    rt_size_t i;
+
+    *dropped = 0;
+    if (ulog.rate_per_second == 0)
+    {
+        return RT_TRUE;
+    }
+
+    level = rt_spin_lock_irqsave(&_spinlock);
+    full = ulog.rate_burst * RT_TICK_PER_SECOND;
+    /* the last bucket is shared by the tags that found no room */
+    for (i = 0; i < ULOG_RATE_LIMIT_TAGS; i++)
+    {
+        bucket = &ulog.rate_bucket[i];
+        if (bucket->tag == tag)
+        {
+            break;
+        }
+        if (bucket->tag == RT_NULL)
+        {
+            bucket->tag = tag;
+            bucket->credit = full;
+            bucket->last = now;
+            break;
+        }
+    }
+
+    elapsed = now - bucket->last;
+    bucket->last = now;
+    if (elapsed >= full / ulog.rate_per_second)
+    {
+        bucket->credit = full;
+    }
+    else if (bucket->credit + elapsed * ulog.rate_per_second < full)
+    {
+        bucket->credit += elapsed * ulog.rate_per_second;
+    }
+    else
+    {
+        bucket->credit = full;
+    }
+
+    if (bucket->credit >= RT_TICK_PER_SECOND)
+    {
+        bucket->credit -= RT_TICK_PER_SECOND;
+        *dropped = bucket->dropped;
+        bucket->dropped = 0;
+    }
+    else
+    {
+        bucket->dropped++;
+        pass = RT_FALSE;
+    }
+    rt_spin_unlock_irqrestore(&_spinlock, level);
+
+    return pass;
+}
+
+/**
+ * set the rate limit of every tag, the buckets start full again
+ *
+ * @param per_second logs per second a tag may output, 0 for no limit
+ * @param burst logs a tag may output at once
+ */
+void ulog_rate_limit_set(rt_uint32_t per_second, rt_uint32_t burst)
+{
+    rt_base_t level;
+
+    level = rt_spin_lock_irqsave(&_spinlock);
+    ulog.rate_per_second = per_second;
+    ulog.rate_burst = burst ? burst : 1;
+    rt_memset(ulog.rate_bucket, 0, sizeof(ulog.rate_bucket));
+    rt_spin_unlock_irqrestore(&_spinlock, level);
+}
+#endif /* ULOG_USING_RATE_LIMIT */
+
+#ifdef ULOG_USING_BINARY
+/* what a conversion takes from the arguments */
+enum ulog_binary_arg
+{
+    ULOG_BINARY_ARG_NONE,
+    ULOG_BINARY_ARG_INT,
+    ULOG_BINARY_ARG_LONG,
+    ULOG_BINARY_ARG_LLONG,
+    ULOG_BINARY_ARG_SIZE,
+    ULOG_BINARY_ARG_PTR,
+    ULOG_BINARY_ARG_STR,
+    ULOG_BINARY_ARG_DOUBLE,
+    ULOG_BINARY_ARG_UNKNOWN,
+};
+
+/**
+ * parse a conversion of the format
+ *
+ * @param fmt the conversion, just after '%'
+ * @param len the conversion length after '%'
+ * @param stars '*' width and precision, taken from the arguments before the value
+ * @param precision the precision, -1 when there is none, -2 when it is a '*'
+ *
+ * @return the argument kind
+ */
+static enum ulog_binary_arg ulog_binary_conv(const char *fmt, rt_size_t *len, int *stars, int *precision)
+{
+    const char *p = fmt;
+    int length = 0;
+
+    *stars = 0;
+    *precision = -1;
+    while (*p == '-' || *p == '+' || *p == ' ' || *p == '#' || *p == '0')
+    {
+        p++;
+    }
+    if (*p == '*')
+    {
+        (*stars)++;
+        p++;
+    }
+    while (*p >= '0' && *p <= '9')
+    {
+        p++;
+    }
+    if (*p == '.')
+    {
+        p++;
+        if (*p == '*')
+        {
+            (*stars)++;
+            *precision = -2;
+            p++;
+        }
+        else
+        {
+            *precision = 0;
+            while (*p >= '0' && *p <= '9')
+            {
+                *precision = *precision * 10 + *p++ - '0';
+            }
+        }
+    }
+    if (*p == 'h')
+    {
+        p += p[1] == 'h' ? 2 : 1;
+    }
+    else if (*p == 'l')
+    {
+        length = p[1] == 'l' ? 2 : 1;
+        p += length;
+    }
+    else if (*p == 'j')
+    {
+        length = 2;
+        p++;
+    }
+    else if (*p == 'z' || *p == 't')
+    {
+        length = 3;
+        p++;
+    }
+
+    *len = p - fmt + 1;
+    switch (*p)
+    {
+    case '%':
+        return ULOG_BINARY_ARG_NONE;
+    case 'c': case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        return length == 1 ? ULOG_BINARY_ARG_LONG : length == 2 ? ULOG_BINARY_ARG_LLONG :
+               length == 3 ? ULOG_BINARY_ARG_SIZE : ULOG_BINARY_ARG_INT;
+    case 'p':
+        return ULOG_BINARY_ARG_PTR;
+    case 's':
+        return ULOG_BINARY_ARG_STR;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        return ULOG_BINARY_ARG_DOUBLE;
+    default:
+        /* %n, long double and the like are not kept */
+        return ULOG_BINARY_ARG_UNKNOWN;
+    }
+}
+
+#define ULOG_BINARY_PACK(type, va_type)                                   \
+    do                                                                    \
+    {                                                                     \
+        type v = (type)va_arg(args, va_type);                             \
+        if (size + sizeof(v) > ULOG_BINARY_ARGS_SIZE)                     \
+        {                                                                 \
+            return size;                                                  \
+        }                                                                 \
+        rt_memcpy(&buf[size], &v, sizeof(v));                             \
+        size += sizeof(v);                                                \
+    } while (0)
+
+/**
+ * copy the raw arguments of the format
+ *
+ * @param buf ULOG_BINARY_ARGS_SIZE bytes
+ * @param nargs the conversions kept, the output stops at the first that is not
+ * @param format output format
+ * @param args variable argument list
+ *
+ * @return the bytes used
+ */
+static rt_size_t ulog_binary_pack(rt_uint8_t *buf, rt_uint32_t *nargs, const char *format, va_list args)
+{
+    const char *p, *str;
+    rt_size_t size = 0, len, str_len;
+    int stars, precision, star = -1;
+    enum ulog_binary_arg kind;
+
+    *nargs = 0;
+    for (p = format; *p; p++)
+    {
+        if (*p != '%')
+        {
+            continue;
+        }
+        kind = ulog_binary_conv(p + 1, &len, &stars, &precision);
+        if (kind == ULOG_BINARY_ARG_UNKNOWN)
+        {
+            break;
+        }
+        while (stars--)
+        {
+            ULOG_BINARY_PACK(int, int);
+            rt_memcpy(&star, &buf[size - sizeof(int)], sizeof(int));
+        }
+        if (precision == -2)
+        {
+            /* the precision comes last of the stars */
+            precision = star;
+        }
+        switch (kind)
+        {
+        case ULOG_BINARY_ARG_INT:
+            ULOG_BINARY_PACK(int, int);
+            break;
+        case ULOG_BINARY_ARG_LONG:
+            ULOG_BINARY_PACK(long, long);
+            break;
+        case ULOG_BINARY_ARG_LLONG:
+            ULOG_BINARY_PACK(long long, long long);
+            break;
+        case ULOG_BINARY_ARG_SIZE:
+            ULOG_BINARY_PACK(rt_size_t, rt_size_t);
+            break;
+        case ULOG_BINARY_ARG_PTR:
+            ULOG_BINARY_PACK(void *, void *);
+            break;
+        case ULOG_BINARY_ARG_DOUBLE:
+            ULOG_BINARY_PACK(double, double);
+            break;
+        case ULOG_BINARY_ARG_STR:
+            /* the string may not outlive the call, it is copied */
+            str = va_arg(args, const char *);
+            if (str == RT_NULL)
+            {
+                str = "(null)";
+            }
+            str_len = ULOG_BINARY_STR_MAX - 1;
+            if (precision >= 0 && (rt_size_t)precision < str_len)
+            {
+                str_len = precision;
+            }
+            str_len = rt_strnlen(str, str_len);
+            if (size + str_len + 1 > ULOG_BINARY_ARGS_SIZE)
+            {
+                return size;
+            }
+            rt_memcpy(&buf[size], str, str_len);
+            buf[size + str_len] = '\0';
+            size += str_len + 1;
+            break;
+        default:
+            break;
+        }
+        (*nargs)++;
+        p += len;
+    }
+
+    return size;
+}
+
+/**
+ * store the log to the binary ring, the async output formats it
+ */
+static void ulog_binary_put(rt_uint32_t level, const char *tag, rt_bool_t newline, const char *format, va_list args)
+{
+    rt_uint32_t frame[(sizeof(struct ulog_binary_record) + ULOG_BINARY_ARGS_SIZE + 3) / 4];
+    struct ulog_binary_record *record = (struct ulog_binary_record *)frame;
+    struct ulog_binary_record *pad_record;
+    rt_uint32_t size, head, offset, pad;
+    rt_base_t lock;
+
+    size = sizeof(struct ulog_binary_record) + ulog_binary_pack((rt_uint8_t *)(record + 1), &record->nargs, format, args);
+    size = RT_ALIGN(size, 4);
+    record->size = size;
+    record->flags = newline ? ULOG_BINARY_NEWLINE : 0;
+    record->level = level;
+    record->tick = rt_tick_get();
+    record->tag = tag;
+    record->format = format;
+
+    lock = rt_spin_lock_irqsave(&_spinlock);
+    head = ulog.binary_head;
+    offset = head & (ULOG_BINARY_BUF_SIZE - 1);
+    /* a record never wraps, the room up to the ring end is skipped */
+    pad = ULOG_BINARY_BUF_SIZE - offset < size ? ULOG_BINARY_BUF_SIZE - offset : 0;
+    if (ULOG_BINARY_BUF_SIZE - (head - ulog.binary_tail) < pad + size)
+    {
+        ulog.binary_lost++;
+        rt_spin_unlock_irqrestore(&_spinlock, lock);
+        return;
+    }
+    if (pad)
+    {
+        pad_record = (struct ulog_binary_record *)(ulog.binary_buf + offset);
+        pad_record->size = pad;
+        pad_record->flags = ULOG_BINARY_PAD;
+        offset = 0;
+    }
+    rt_memcpy(ulog.binary_buf + offset, frame, size);
+    ulog.binary_head = head + pad + size;
+    rt_spin_unlock_irqrestore(&_spinlock, lock);
+
+    /* the async output has been told already when it has not run since */
+    if (ulog.async_notice.value == 0)
+    {
+        rt_sem_release(&ulog.async_notice);
+    }
+}
+
+#define ULOG_BINARY_PRINT(type)                                                        \
+    do                                                                                 \
+    {                                                                                  \
+        type v;                                                                        \
+        rt_memcpy(&v, arg, sizeof(v));                                                 \
+        arg += sizeof(v);                                                              \
+        fmt_result = stars == 0 ? rt_snprintf(buf, size, spec, v) :                    \
+                     stars == 1 ? rt_snprintf(buf, size, spec, star[0], v) :           \
+                     rt_snprintf(buf, size, spec, star[0], star[1], v);                \
+    } while (0)
+
+/**
+ * format a binary record the way ulog_formater formats the log
+ */
+static rt_size_t ulog_binary_formater(char *log_buf, const struct ulog_binary_record *record)
+{
+    /* the caller has locker, so it can use static variable for reduce stack usage */
+    static rt_size_t log_len, len, size;
+    static int fmt_result;
+    static char spec[16];
+    const rt_uint8_t *arg = (const rt_uint8_t *)(record + 1);
+    const char *p = record->format;
+    enum ulog_binary_arg kind;
+    rt_uint32_t index = 0;
+    int i, stars, precision, star[2];
+    char *buf;
+
+    /* log head */
+    log_len = ulog_head_formater(log_buf, record->level, record->tag);
+    /* log content */
+    while (*p && log_len < ULOG_LINE_BUF_SIZE)
+    {
+        if (*p != '%')
+        {
+            log_buf[log_len++] = *p++;
+            continue;
+        }
+        if (index++ == record->nargs)
+        {
+            break;
+        }
+        kind = ulog_binary_conv(p + 1, &len, &stars, &precision);
+        if (len + 2 > sizeof(spec))
+        {
+            break;
+        }
+        rt_memcpy(spec, p, len + 1);
+        spec[len + 1] = '\0';
+        p += len + 1;
+        for (i = 0; i < stars; i++)
+        {
+            rt_memcpy(&star[i], arg, sizeof(int));
+            arg += sizeof(int);
+        }
+
+        buf = log_buf + log_len;
+        size = ULOG_LINE_BUF_SIZE - log_len;
+        switch (kind)
+        {
+        case ULOG_BINARY_ARG_NONE:
+            fmt_result = rt_snprintf(buf, size, "%%");
+            break;
+        case ULOG_BINARY_ARG_INT:
+            ULOG_BINARY_PRINT(int);
+            break;
+        case ULOG_BINARY_ARG_LONG:
+            ULOG_BINARY_PRINT(long);
+            break;
+        case ULOG_BINARY_ARG_LLONG:
+            ULOG_BINARY_PRINT(long long);
+            break;
+        case ULOG_BINARY_ARG_SIZE:
+            ULOG_BINARY_PRINT(rt_size_t);
+            break;
+        case ULOG_BINARY_ARG_PTR:
+            ULOG_BINARY_PRINT(void *);
+            break;
+        case ULOG_BINARY_ARG_DOUBLE:
+            ULOG_BINARY_PRINT(double);
+            break;
+        case ULOG_BINARY_ARG_STR:
+        {
+            const char *v = (const char *)arg;
+
+            arg += rt_strlen(v) + 1;
+            fmt_result = stars == 0 ? rt_snprintf(buf, size, spec, v) :
+                         stars == 1 ? rt_snprintf(buf, size, spec, star[0], v) :
+                         rt_snprintf(buf, size, spec, star[0], star[1], v);
+            break;
+        }
+        default:
+            fmt_result = -1;
+            break;
+        }
+        /* calculate log length */
+        if (fmt_result < 0)
+        {
+            break;
+        }
+        else if (log_len + fmt_result <= ULOG_LINE_BUF_SIZE)
+        {
+            log_len += fmt_result;
+        }
+        else
+        {
+            /* using max length */
+            log_len = ULOG_LINE_BUF_SIZE;
+        }
+    }
+    /* log tail */
+    return ulog_tail_formater(log_buf, log_len, record->flags & ULOG_BINARY_NEWLINE, record->level);
+}
+
+static void ulog_binary_record_output(const struct ulog_binary_record *record)
+{
+    char *log_buf = ulog.log_buf_binary;
+    rt_size_t log_len;
+
+    ulog.binary_record = record;
+    log_len = ulog_binary_formater(log_buf, record);
+    ulog.binary_record = RT_NULL;
+
+#ifdef ULOG_USING_FILTER
+    /* keyword filter */
+    if (ulog.filter.keyword[0] != '\0' && !rt_strstr(log_buf, ulog.filter.keyword))
+    {
+        return;
+    }
+#endif /* ULOG_USING_FILTER */
+    ulog_output_to_all_backend(record->level, record->tag, RT_FALSE, log_buf, log_len);
+}
+
+/**
+ * format and output the binary records
+ */
+static void ulog_binary_output(void)
+{
+    const struct ulog_binary_record *record;
+    struct
+    {
+        struct ulog_binary_record record;
+        rt_uint32_t lost;
+    } notice;
+    rt_uint32_t head, tail, lost;
+    rt_base_t level;
+
+    if (ulog.binary_buf == RT_NULL)
+    {
+        return;
+    }
+
+    output_lock();
+
+    level = rt_spin_lock_irqsave(&_spinlock);
+    head = ulog.binary_head;
+    lost = ulog.binary_lost - ulog.binary_lost_shown;
+    ulog.binary_lost_shown = ulog.binary_lost;
+    rt_spin_unlock_irqrestore(&_spinlock, level);
+
+    tail = ulog.binary_tail;
+    while (tail != head)
+    {
+        record = (const struct ulog_binary_record *)(ulog.binary_buf + (tail & (ULOG_BINARY_BUF_SIZE - 1)));
+        if ((record->flags & ULOG_BINARY_PAD) == 0)
+        {
+            ulog_binary_record_output(record);
+        }
+        tail += record->size;
+
+        /* give the room back at once, and see what came meanwhile */
+        level = rt_spin_lock_irqsave(&_spinlock);
+        ulog.binary_tail = tail;
+        head = ulog.binary_head;
+        rt_spin_unlock_irqrestore(&_spinlock, level);
+    }
+
+    if (lost)
+    {
+        notice.record.size = sizeof(notice);
+        notice.record.flags = ULOG_BINARY_NEWLINE;
+        notice.record.level = LOG_LVL_WARNING;
+        notice.record.nargs = 1;
+        notice.record.tick = rt_tick_get();
+        notice.record.tag = "ulog";
+        notice.record.format = "%d logs lost, the binary ring is full";
+        notice.lost = lost;
+        ulog_binary_record_output(&notice.record);
+    }
+
+    output_unlock();
+}
+
+/**
+ * enable or disable binary log records
+ * the logs are formatted by the caller when it is disabled
+ *
+ * @param enabled RT_TRUE: enabled, RT_FALSE: disabled
+ */
+void ulog_binary_enabled(rt_bool_t enabled)
+{
+    ulog.binary_enabled = enabled && ulog.binary_buf != RT_NULL;
+}
+
+/**
+ * get the logs lost to a full binary ring
+ *
+ * @return the logs lost since init
+ */
+rt_uint32_t ulog_binary_lost_get(void)
+{
+    return ulog.binary_lost;
+}
+#endif /* ULOG_USING_BINARY */
+
 /**
  * output the log by variable argument list
  *
@@ -679,6 +1305,30 @@ void ulog_voutput(rt_uint32_t level, const char *tag, rt_bool_t newline, const r
     }
 #endif /* ULOG_USING_FILTER */
 
+#ifdef ULOG_USING_RATE_LIMIT
+    if (hex_buf == RT_NULL && level != LOG_LVL_ASSERT && format != ulog_rate_notice)
+    {
+        rt_uint32_t dropped;
+
+        if (!ulog_rate_pass(tag, &dropped))
+        {
+            return;
+        }
+        if (dropped)
+        {
+            ulog_output(LOG_LVL_WARNING, tag, RT_TRUE, ulog_rate_notice, dropped);
+        }
+    }
+#endif /* ULOG_USING_RATE_LIMIT */
+
+#ifdef ULOG_USING_BINARY
+    if (hex_buf == RT_NULL && ulog.binary_enabled && ulog.async_enabled)
+    {
+        ulog_binary_put(level, tag, newline, format, args);
+        return;
+    }
+#endif /* ULOG_USING_BINARY */
+
     /* get log buffer */
     log_buf = get_log_buf();
 
@@ -1375,6 +2025,9 @@ void ulog_async_output(void)
             rt_free(log);
         }
     }
+#ifdef ULOG_USING_BINARY
+    ulog_binary_output();
+#endif
 }
 
 /**
@@ -1481,6 +2134,19 @@ int ulog_init(void)
     rt_sem_init(&ulog.async_notice, "ulog", 0, RT_IPC_FLAG_FIFO);
 #endif /* ULOG_USING_ASYNC_OUTPUT */
 
+#ifdef ULOG_USING_BINARY
+    ulog.binary_buf = rt_malloc(ULOG_BINARY_BUF_SIZE);
+    if (ulog.binary_buf == RT_NULL)
+    {
+        rt_kprintf("Warning: no memory for the ulog binary ring, the logs are formatted by the caller.\n");
+    }
+    ulog.binary_enabled = ulog.binary_buf != RT_NULL;
+#endif /* ULOG_USING_BINARY */
+
+#ifdef ULOG_USING_RATE_LIMIT
+    ulog_rate_limit_set(ULOG_RATE_LIMIT_PER_SECOND, ULOG_RATE_LIMIT_BURST);
+#endif
+
 #ifdef ULOG_USING_FILTER
     ulog_global_filter_lvl_set(LOG_FILTER_LVL_ALL);
 #endif
@@ -1551,6 +2217,12 @@ void ulog_deinit(void)
         rt_ringbuffer_destroy(ulog.async_rb);
 #endif
 
+#ifdef ULOG_USING_BINARY
+    ulog.binary_enabled = RT_FALSE;
+    rt_free(ulog.binary_buf);
+    ulog.binary_buf = RT_NULL;
+#endif
+
     ulog.init_ok = RT_FALSE;
 }
 
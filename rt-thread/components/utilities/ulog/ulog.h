@@ -6,6 +6,7 @@
  * Change Logs:
  * Date           Author       Notes
  * 2018-08-25     armink       the first version
+ * 2026-10-17     loogg        binary log records, per tag rate limit
  */
 
 #ifndef _ULOG_H_
@@ -84,6 +85,21 @@ void ulog_async_output_enabled(rt_bool_t enabled);
 rt_err_t ulog_async_waiting_log(rt_int32_t time);
 #endif
 
+#ifdef ULOG_USING_BINARY
+/*
+ * binary log records, formatted by the async output
+ */
+void ulog_binary_enabled(rt_bool_t enabled);
+rt_uint32_t ulog_binary_lost_get(void);
+#endif
+
+#ifdef ULOG_USING_RATE_LIMIT
+/*
+ * per tag rate limit, per_second 0 for no limit
+ */
+void ulog_rate_limit_set(rt_uint32_t per_second, rt_uint32_t burst);
+#endif
+
 /*
  * dump the hex format data to log
  */
@@ -225,6 +225,12 @@ typedef int (*init_fn_t)(void);
 #define RT_MM_PAGE_BITS                 12
 
 /* kernel malloc definitions */
+#ifdef RT_USING_KERNEL_MALLOC
+#define RT_KERNEL_MALLOC(sz)            rt_kernel_malloc(sz)
+#define RT_KERNEL_FREE(ptr)             rt_kernel_free(ptr)
+#define RT_KERNEL_REALLOC(ptr, size)    rt_kernel_realloc(ptr, size)
+#endif /* RT_USING_KERNEL_MALLOC */
+
 #ifndef RT_KERNEL_MALLOC
 #define RT_KERNEL_MALLOC(sz)            rt_malloc(sz)
 #endif /* RT_KERNEL_MALLOC */
@@ -351,6 +357,9 @@ struct rt_object
 #endif /* RT_USING_SMART */
 
     rt_list_t   list;                                    /**< list node of kernel object */
+#ifdef RT_USING_OBJECT_HASH
+    struct rt_object *hash_next;                         /**< next object in the name index bucket */
+#endif /* RT_USING_OBJECT_HASH */
 };
 typedef struct rt_object *rt_object_t;                   /**< Type for kernel objects. */
 
@@ -306,6 +306,12 @@ void rt_memory_info(rt_size_t *total,
                     rt_size_t *used,
                     rt_size_t *max_used);
 
+#ifdef RT_USING_KERNEL_MALLOC
+void *rt_kernel_malloc(rt_size_t size);
+void *rt_kernel_realloc(void *ptr, rt_size_t newsize);
+void rt_kernel_free(void *ptr);
+#endif /* RT_USING_KERNEL_MALLOC */
+
 #if defined(RT_USING_SLAB) && defined(RT_USING_SLAB_AS_HEAP)
 void *rt_page_alloc(rt_size_t npages);
 void rt_page_free(void *addr, rt_size_t npages);
@@ -331,6 +337,13 @@ rt_err_t rt_smem_detach(rt_smem_t m);
 void *rt_smem_alloc(rt_smem_t m, rt_size_t size);
 void *rt_smem_realloc(rt_smem_t m, void *rmem, rt_size_t newsize);
 void rt_smem_free(void *rmem);
+void rt_smem_frag_info(rt_smem_t m, rt_size_t *blocks, rt_size_t *free_size, rt_size_t *largest);
+#ifdef RT_USING_SMALL_MEM_CACHE
+void *rt_smem_cache_alloc(rt_smem_t m, rt_size_t size);
+rt_bool_t rt_smem_cache_free(void *rmem);
+void rt_smem_cache_flush(rt_smem_t m);
+void rt_smem_cache_enable(rt_smem_t m, rt_bool_t enable);
+#endif /* RT_USING_SMALL_MEM_CACHE */
 #endif /* RT_USING_SMALL_MEM */
 
 #ifdef RT_USING_MEMHEAP
@@ -27,6 +27,8 @@
  * 2023-10-16     Shell        Add hook point for rt_malloc services
  * 2023-12-10     xqyjlj       perf rt_hw_interrupt_disable/enable, fix memheap lock
  * 2024-03-10     Meco Man     move std libc related functions to rtklibc
+ * 2026-10-17     loogg        take small blocks from the smem size class cache first
+ * 2026-10-17     loogg        add rt_kernel_malloc for kernel objects and stacks
  */
 
 #include <rtthread.h>
@@ -726,6 +728,12 @@ rt_inline void _smem_info(rt_size_t *total,
     rt_smem_free(_ptr)
 #define _MEM_INFO(_total, _used, _max)  \
     _smem_info(_total, _used, _max)
+#ifdef RT_USING_SMALL_MEM_CACHE
+#define _MEM_CACHE_ALLOC(_size) \
+    rt_smem_cache_alloc(system_heap, _size)
+#define _MEM_CACHE_FREE(_ptr) \
+    rt_smem_cache_free(_ptr)
+#endif /* RT_USING_SMALL_MEM_CACHE */
 #elif defined(RT_USING_MEMHEAP_AS_HEAP)
 static struct rt_memheap system_heap;
 void *_memheap_alloc(struct rt_memheap *heap, rt_size_t size);
@@ -773,6 +781,11 @@ rt_inline void _slab_info(rt_size_t *total,
 #define _MEM_INFO(...)
 #endif
 
+#ifndef _MEM_CACHE_ALLOC
+#define _MEM_CACHE_ALLOC(...)   RT_NULL
+#define _MEM_CACHE_FREE(...)    RT_FALSE
+#endif
+
 static void _rt_system_heap_init(void *begin_addr, void *end_addr)
 {
     rt_ubase_t begin_align = RT_ALIGN((rt_ubase_t)begin_addr, RT_ALIGN_SIZE);
@@ -810,12 +823,17 @@ rt_weak void *rt_malloc(rt_size_t size)
     rt_base_t level;
     void *ptr;
 
-    /* Enter critical zone */
-    level = _heap_lock();
-    /* allocate memory block from system heap */
-    ptr = _MEM_MALLOC(size);
-    /* Exit critical zone */
-    _heap_unlock(level);
+    /* small blocks freed before come back without the heap lock */
+    ptr = _MEM_CACHE_ALLOC(size);
+    if (ptr == RT_NULL)
+    {
+        /* Enter critical zone */
+        level = _heap_lock();
+        /* allocate memory block from system heap */
+        ptr = _MEM_MALLOC(size);
+        /* Exit critical zone */
+        _heap_unlock(level);
+    }
     /* call 'rt_malloc' hook */
     RT_OBJECT_HOOK_CALL(rt_malloc_hook, (&ptr, size));
     return ptr;
@@ -892,6 +910,8 @@ rt_weak void rt_free(void *ptr)
     RT_OBJECT_HOOK_CALL(rt_free_hook, (&ptr));
     /* NULL check */
     if (ptr == RT_NULL) return;
+    /* kept for the next allocation of its size class */
+    if (_MEM_CACHE_FREE(ptr)) return;
     /* Enter critical zone */
     level = _heap_lock();
     _MEM_FREE(ptr);
@@ -924,6 +944,48 @@ rt_weak void rt_memory_info(rt_size_t *total,
 }
 RTM_EXPORT(rt_memory_info);
 
+#ifdef RT_USING_KERNEL_MALLOC
+/**
+ * @brief This function allocates the memory of kernel objects, thread stacks and
+ *        ipc pools. The BSP may take it from a heap of its own.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return the pointer to allocated memory or NULL if no free memory was found.
+ */
+rt_weak void *rt_kernel_malloc(rt_size_t size)
+{
+    return rt_malloc(size);
+}
+RTM_EXPORT(rt_kernel_malloc);
+
+/**
+ * @brief This function changes the size of a block got from rt_kernel_malloc.
+ *
+ * @param ptr is the pointer to memory allocated by rt_kernel_malloc.
+ *
+ * @param newsize is the required new size.
+ *
+ * @return the changed memory block address.
+ */
+rt_weak void *rt_kernel_realloc(void *ptr, rt_size_t newsize)
+{
+    return rt_realloc(ptr, newsize);
+}
+RTM_EXPORT(rt_kernel_realloc);
+
+/**
+ * @brief This function releases a block got from rt_kernel_malloc.
+ *
+ * @param ptr is the address of memory which will be released.
+ */
+rt_weak void rt_kernel_free(void *ptr)
+{
+    rt_free(ptr);
+}
+RTM_EXPORT(rt_kernel_free);
+#endif /* RT_USING_KERNEL_MALLOC */
+
 #if defined(RT_USING_SLAB) && defined(RT_USING_SLAB_AS_HEAP)
 void *rt_page_alloc(rt_size_t npages)
 {
@@ -12,6 +12,8 @@
  * 2010-10-14     Bernard      fix rt_realloc issue when realloc a NULL pointer.
  * 2017-07-14     armink       fix rt_realloc issue when new size is 0
  * 2018-10-02     Bernard      Add 64bit support
+ * 2026-10-17     loogg        add size class cache, fragmentation and walk statistics
+ * 2026-10-18     loogg        size classes and cache can be turned off per heap
  */
 
 /*
@@ -73,6 +75,23 @@ struct rt_small_mem_item
 /**
  * Base structure of small memory object
  */
+#ifdef RT_USING_SMALL_MEM_CACHE
+#define SMEM_CACHE_CLASSES   6                          /* 16, 32, 64, 128, 256, 512 */
+#define SMEM_CACHE_MIN       16
+#define SMEM_CACHE_MAX       (SMEM_CACHE_MIN << (SMEM_CACHE_CLASSES - 1))
+
+/**
+ * Freed blocks of one size class, still used in the heap, linked through their data
+ */
+struct rt_small_mem_cache
+{
+    void                       *free;
+    rt_uint16_t                 count;
+    rt_uint32_t                 hit;
+    rt_uint32_t                 miss;
+};
+#endif /* RT_USING_SMALL_MEM_CACHE */
+
 struct rt_small_mem
 {
     struct rt_memory            parent;                 /**< inherit from rt_memory */
@@ -80,6 +99,16 @@ struct rt_small_mem
     struct rt_small_mem_item   *heap_end;
     struct rt_small_mem_item   *lfree;
     rt_size_t                   mem_size_aligned;       /**< aligned memory size */
+#ifdef RT_USING_SMALL_MEM_CACHE
+    struct rt_spinlock          cache_lock;
+    struct rt_small_mem_cache   cache[SMEM_CACHE_CLASSES];
+    rt_bool_t                   cache_off;              /**< plain allocation, no size classes */
+#endif /* RT_USING_SMALL_MEM_CACHE */
+#ifdef RT_USING_MEMTRACE
+    rt_uint32_t                 walk_num;               /**< allocations walked for */
+    rt_uint32_t                 walk_sum;               /**< blocks looked at */
+    rt_uint32_t                 walk_max;
+#endif /* RT_USING_MEMTRACE */
 };
 
 #define MIN_SIZE (sizeof(rt_ubase_t) + sizeof(rt_size_t) + sizeof(rt_size_t))
@@ -156,6 +185,61 @@ static void plug_holes(struct rt_small_mem *m, struct rt_small_mem_item *mem)
     }
 }
 
+#ifdef RT_USING_SMALL_MEM_CACHE
+rt_inline int _smem_cache_index(rt_size_t size)
+{
+    int index;
+
+    if (size == 0 || size > SMEM_CACHE_MAX)
+        return -1;
+
+    for (index = 0; (SMEM_CACHE_MIN << index) < size; index ++);
+
+    return index;
+}
+
+/* give every cached block back to the heap, the caller holds the heap lock */
+static rt_size_t _smem_cache_drain(struct rt_small_mem *m)
+{
+    struct rt_small_mem_item *mem;
+    rt_base_t level;
+    rt_size_t count = 0;
+    void *list[SMEM_CACHE_CLASSES];
+    void *next;
+    int index;
+
+    level = rt_spin_lock_irqsave(&m->cache_lock);
+    for (index = 0; index < SMEM_CACHE_CLASSES; index ++)
+    {
+        list[index] = m->cache[index].free;
+        m->cache[index].free = RT_NULL;
+        m->cache[index].count = 0;
+    }
+    rt_spin_unlock_irqrestore(&m->cache_lock, level);
+
+    for (index = 0; index < SMEM_CACHE_CLASSES; index ++)
+    {
+        for (; list[index] != RT_NULL; list[index] = next)
+        {
+            next = *(void **)list[index];
+            mem = (struct rt_small_mem_item *)((rt_uint8_t *)list[index] - SIZEOF_STRUCT_MEM);
+
+            mem->pool_ptr = MEM_FREED(m);
+#ifdef RT_USING_MEMTRACE
+            rt_smem_setname(mem, "    ");
+#endif /* RT_USING_MEMTRACE */
+            if (mem < m->lfree)
+                m->lfree = mem;
+            m->parent.used -= (mem->next - ((rt_uint8_t *)mem - m->heap_ptr));
+            plug_holes(m, mem);
+            count ++;
+        }
+    }
+
+    return count;
+}
+#endif /* RT_USING_SMALL_MEM_CACHE */
+
 /**
  * @brief This function will initialize small memory management algorithm.
  *
@@ -205,6 +289,9 @@ rt_smem_t rt_smem_init(const char    *name,
 
     /* point to begin address of heap */
     small_mem->heap_ptr = (rt_uint8_t *)begin_align;
+#ifdef RT_USING_SMALL_MEM_CACHE
+    rt_spin_lock_init(&small_mem->cache_lock);
+#endif /* RT_USING_SMALL_MEM_CACHE */
 
     LOG_D("mem init, heap begin address 0x%x, size %d",
             (rt_ubase_t)small_mem->heap_ptr, small_mem->mem_size_aligned);
@@ -273,6 +360,9 @@ void *rt_smem_alloc(rt_smem_t m, rt_size_t size)
     rt_size_t ptr, ptr2;
     struct rt_small_mem_item *mem, *mem2;
     struct rt_small_mem *small_mem;
+#ifdef RT_USING_MEMTRACE
+    rt_uint32_t walk = 0;
+#endif /* RT_USING_MEMTRACE */
 
     if (size == 0)
         return RT_NULL;
@@ -282,6 +372,11 @@ void *rt_smem_alloc(rt_smem_t m, rt_size_t size)
     RT_ASSERT(rt_object_is_systemobject(&m->parent));
 
     small_mem = (struct rt_small_mem *)m;
+#ifdef RT_USING_SMALL_MEM_CACHE
+    /* small blocks are of the class size, so they can be cached when freed */
+    if (!small_mem->cache_off && size <= SMEM_CACHE_MAX)
+        size = SMEM_CACHE_MIN << _smem_cache_index(size);
+#endif /* RT_USING_SMALL_MEM_CACHE */
     /* alignment size */
     size = RT_ALIGN(size, RT_ALIGN_SIZE);
 
@@ -301,6 +396,9 @@ void *rt_smem_alloc(rt_smem_t m, rt_size_t size)
          ptr = ((struct rt_small_mem_item *)&small_mem->heap_ptr[ptr])->next)
     {
         mem = (struct rt_small_mem_item *)&small_mem->heap_ptr[ptr];
+#ifdef RT_USING_MEMTRACE
+        walk ++;
+#endif /* RT_USING_MEMTRACE */
 
         if ((!MEM_ISUSED(mem)) && (mem->next - (ptr + SIZEOF_STRUCT_MEM)) >= size)
         {
@@ -372,6 +470,12 @@ void *rt_smem_alloc(rt_smem_t m, rt_size_t size)
 
                 RT_ASSERT(((small_mem->lfree == small_mem->heap_end) || (!MEM_ISUSED(small_mem->lfree))));
             }
+#ifdef RT_USING_MEMTRACE
+            small_mem->walk_num ++;
+            small_mem->walk_sum += walk;
+            if (small_mem->walk_max < walk)
+                small_mem->walk_max = walk;
+#endif /* RT_USING_MEMTRACE */
             RT_ASSERT((rt_ubase_t)mem + SIZEOF_STRUCT_MEM + size <= (rt_ubase_t)small_mem->heap_end);
             RT_ASSERT((rt_ubase_t)((rt_uint8_t *)mem + SIZEOF_STRUCT_MEM) % RT_ALIGN_SIZE == 0);
             RT_ASSERT((((rt_ubase_t)mem) & (RT_ALIGN_SIZE - 1)) == 0);
@@ -385,6 +489,12 @@ void *rt_smem_alloc(rt_smem_t m, rt_size_t size)
         }
     }
 
+#ifdef RT_USING_SMALL_MEM_CACHE
+    /* the cached blocks may be just what is missing */
+    if (_smem_cache_drain(small_mem) > 0)
+        return rt_smem_alloc(m, size);
+#endif /* RT_USING_SMALL_MEM_CACHE */
+
     return RT_NULL;
 }
 RTM_EXPORT(rt_smem_alloc);
@@ -539,10 +649,200 @@ void rt_smem_free(void *rmem)
 }
 RTM_EXPORT(rt_smem_free);
 
+#ifdef RT_USING_SMALL_MEM_CACHE
+/**
+ * @brief This function will take a block of the size class of 'size' from the cache
+ *        of the small memory object, without the heap lock.
+ *
+ * @param m the small memory management object.
+ *
+ * @param size is the minimum size of the requested block in bytes.
+ *
+ * @return the pointer to allocated memory or NULL if the class of 'size' has no block cached.
+ */
+void *rt_smem_cache_alloc(rt_smem_t m, rt_size_t size)
+{
+    struct rt_small_mem *small_mem;
+    struct rt_small_mem_cache *cache;
+    rt_base_t level;
+    void *rmem;
+    int index;
+
+    RT_ASSERT(m != RT_NULL);
+
+    index = _smem_cache_index(size);
+    if (index < 0)
+        return RT_NULL;
+
+    small_mem = (struct rt_small_mem *)m;
+    if (small_mem->cache_off)
+        return RT_NULL;
+    cache = &small_mem->cache[index];
+
+    level = rt_spin_lock_irqsave(&small_mem->cache_lock);
+    rmem = cache->free;
+    if (rmem != RT_NULL)
+    {
+        cache->free = *(void **)rmem;
+        cache->count --;
+        cache->hit ++;
+    }
+    else
+    {
+        cache->miss ++;
+    }
+    rt_spin_unlock_irqrestore(&small_mem->cache_lock, level);
+
+#ifdef RT_USING_MEMTRACE
+    if (rmem != RT_NULL)
+        rt_smem_setname((struct rt_small_mem_item *)((rt_uint8_t *)rmem - SIZEOF_STRUCT_MEM),
+                        rt_thread_self() ? rt_thread_self()->parent.name : "NONE");
+#endif /* RT_USING_MEMTRACE */
+
+    return rmem;
+}
+RTM_EXPORT(rt_smem_cache_alloc);
+
+/**
+ * @brief This function will keep a block of a class size in the cache of its small
+ *        memory object, without the heap lock.
+ *
+ * @param rmem the address of memory which will be released.
+ *
+ * @return RT_TRUE if it is cached, RT_FALSE if it is to be freed by rt_smem_free.
+ */
+rt_bool_t rt_smem_cache_free(void *rmem)
+{
+    struct rt_small_mem_item *mem;
+    struct rt_small_mem *small_mem;
+    struct rt_small_mem_cache *cache;
+    rt_base_t level;
+    rt_size_t size;
+    int index;
+
+    mem = (struct rt_small_mem_item *)((rt_uint8_t *)rmem - SIZEOF_STRUCT_MEM);
+    small_mem = MEM_POOL(mem);
+    RT_ASSERT(MEM_ISUSED(mem));
+    if (small_mem->cache_off)
+        return RT_FALSE;
+
+    /* a near fit block was not split, it is bigger than its class */
+    size = MEM_SIZE(small_mem, mem);
+    index = _smem_cache_index(size);
+    if (index < 0 || (SMEM_CACHE_MIN << index) != size)
+        return RT_FALSE;
+
+    cache = &small_mem->cache[index];
+    level = rt_spin_lock_irqsave(&small_mem->cache_lock);
+    if (cache->count >= RT_SMALL_MEM_CACHE_DEPTH)
+    {
+        rt_spin_unlock_irqrestore(&small_mem->cache_lock, level);
+        return RT_FALSE;
+    }
+    *(void **)rmem = cache->free;
+    cache->free = rmem;
+    cache->count ++;
+    rt_spin_unlock_irqrestore(&small_mem->cache_lock, level);
+
+#ifdef RT_USING_MEMTRACE
+    rt_smem_setname(mem, "CACH");
+#endif /* RT_USING_MEMTRACE */
+
+    return RT_TRUE;
+}
+RTM_EXPORT(rt_smem_cache_free);
+
+/**
+ * @brief This function will give every cached block back to the small memory object.
+ *
+ * @param m the small memory management object, locked by the caller as for rt_smem_free.
+ */
+void rt_smem_cache_flush(rt_smem_t m)
+{
+    RT_ASSERT(m != RT_NULL);
+
+    _smem_cache_drain((struct rt_small_mem *)m);
+}
+RTM_EXPORT(rt_smem_cache_flush);
+
+/**
+ * @brief This function will turn the size classes and the cache of a small memory
+ *        object on or off, they are on after rt_smem_init.
+ *
+ * @param m the small memory management object, locked by the caller as for rt_smem_free.
+ *
+ * @param enable RT_FALSE to allocate the sizes asked for and cache nothing.
+ */
+void rt_smem_cache_enable(rt_smem_t m, rt_bool_t enable)
+{
+    RT_ASSERT(m != RT_NULL);
+
+    _smem_cache_drain((struct rt_small_mem *)m);
+    ((struct rt_small_mem *)m)->cache_off = !enable;
+}
+RTM_EXPORT(rt_smem_cache_enable);
+#endif /* RT_USING_SMALL_MEM_CACHE */
+
+/**
+ * @brief This function will count the free blocks of a small memory object.
+ *
+ * @param m the small memory management object, locked by the caller.
+ *
+ * @param blocks is a pointer to get the number of free blocks.
+ *
+ * @param free_size is a pointer to get the free bytes.
+ *
+ * @param largest is a pointer to get the size of the largest free block.
+ */
+void rt_smem_frag_info(rt_smem_t m, rt_size_t *blocks, rt_size_t *free_size, rt_size_t *largest)
+{
+    struct rt_small_mem_item *mem;
+    struct rt_small_mem *small_mem;
+    rt_size_t size;
+
+    RT_ASSERT(m != RT_NULL);
+
+    small_mem = (struct rt_small_mem *)m;
+    *blocks = *free_size = *largest = 0;
+    for (mem = small_mem->lfree; mem != small_mem->heap_end;
+         mem = (struct rt_small_mem_item *)&small_mem->heap_ptr[mem->next])
+    {
+        if (MEM_ISUSED(mem))
+            continue;
+
+        size = MEM_SIZE(small_mem, mem);
+        *blocks += 1;
+        *free_size += size;
+        if (*largest < size)
+            *largest = size;
+    }
+}
+RTM_EXPORT(rt_smem_frag_info);
+
 #ifdef RT_USING_FINSH
 #include <finsh.h>
 
 #ifdef RT_USING_MEMTRACE
+static void _smem_show_stat(struct rt_small_mem *m)
+{
+    rt_size_t blocks, free_size, largest;
+
+    rt_smem_frag_info(&m->parent, &blocks, &free_size, &largest);
+    /* what the largest free block misses of all free memory */
+    rt_kprintf("free    : %d in %d blocks, largest %d, fragmentation %d%%\n", free_size, blocks, largest,
+               free_size ? 100 - largest * 100 / free_size : 0);
+    rt_kprintf("walk    : %d allocs, %d blocks avg, %d max\n", m->walk_num,
+               m->walk_num ? m->walk_sum / m->walk_num : 0, m->walk_max);
+#ifdef RT_USING_SMALL_MEM_CACHE
+    rt_kprintf("cache   : size cached/hit/miss\n");
+    for (int index = 0; index < SMEM_CACHE_CLASSES; index ++)
+    {
+        rt_kprintf("          %4d %d/%d/%d\n", SMEM_CACHE_MIN << index, m->cache[index].count,
+                   m->cache[index].hit, m->cache[index].miss);
+    }
+#endif /* RT_USING_SMALL_MEM_CACHE */
+}
+
 static int memcheck(int argc, char *argv[])
 {
     int position;
@@ -576,6 +876,8 @@ static int memcheck(int argc, char *argv[])
             if (position > (int)m->mem_size_aligned) goto __exit;
             if (MEM_POOL(mem) != m) goto __exit;
         }
+        rt_kprintf("%s:\n", m->parent.parent.name);
+        _smem_show_stat(m);
     }
     rt_hw_interrupt_enable(level);
 
@@ -623,6 +925,7 @@ static int memtrace(int argc, char **argv)
         rt_kprintf("heap_ptr: 0x%08x\n", m->heap_ptr);
         rt_kprintf("lfree   : 0x%08x\n", m->lfree);
         rt_kprintf("heap_end: 0x%08x\n", m->heap_end);
+        _smem_show_stat(m);
         rt_kprintf("\n--memory item information --\n");
         for (mem = (struct rt_small_mem_item *)m->heap_ptr; mem != m->heap_end; mem = (struct rt_small_mem_item *)&m->heap_ptr[mem->next])
         {
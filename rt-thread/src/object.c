@@ -16,6 +16,7 @@
  * 2022-01-07     Gabriel      Moving __on_rt_xxxxx_hook to object.c
  * 2023-09-15     xqyjlj       perf rt_hw_interrupt_disable/enable
  * 2023-11-17     xqyjlj       add process group and session support
+ * 2026-10-17     loogg        add name hash index for rt_object_find
  */
 
 #include <rtthread.h>
@@ -29,6 +30,10 @@
 #include <lwp.h>
 #endif
 
+#ifdef RT_USING_OBJECT_HASH
+#include <hashmap.h>
+#endif /* RT_USING_OBJECT_HASH */
+
 struct rt_custom_object
 {
     struct rt_object parent;
@@ -144,6 +149,62 @@ static struct rt_object_information _object_container[RT_Object_Info_Unknown] =
 #endif
 };
 
+#ifdef RT_USING_OBJECT_HASH
+/*
+ * Name index of the objects in the object containers, one table for all classes.
+ * Objects of a bucket are chained by hash_next, the latest first as in the lists.
+ */
+static struct rt_object *_object_hash[1 << RT_OBJECT_HASH_BITS];
+static struct rt_spinlock _object_hash_lock = RT_SPINLOCK_INIT;
+
+rt_inline rt_uint32_t _object_hash_index(const char *name, rt_uint8_t type)
+{
+    rt_uint32_t hash = 2166136261U;
+    int i;
+
+    /* fnv-1a over what rt_strncmp compares */
+    for (i = 0; i < RT_NAME_MAX && name[i] != '\0'; i++)
+    {
+        hash = (hash ^ (rt_uint8_t)name[i]) * 16777619U;
+    }
+
+    return rt_hashmap_32(hash ^ (type & ~RT_Object_Class_Static), RT_OBJECT_HASH_BITS);
+}
+
+static void _object_hash_insert(struct rt_object *object)
+{
+    struct rt_object **bucket;
+    rt_base_t level;
+
+    bucket = &_object_hash[_object_hash_index(object->name, object->type)];
+
+    level = rt_spin_lock_irqsave(&_object_hash_lock);
+    object->hash_next = *bucket;
+    *bucket = object;
+    rt_spin_unlock_irqrestore(&_object_hash_lock, level);
+}
+
+static void _object_hash_remove(struct rt_object *object)
+{
+    struct rt_object **node;
+    rt_base_t level;
+
+    node = &_object_hash[_object_hash_index(object->name, object->type)];
+
+    level = rt_spin_lock_irqsave(&_object_hash_lock);
+    for (; *node != RT_NULL; node = &(*node)->hash_next)
+    {
+        if (*node == object)
+        {
+            *node = object->hash_next;
+            break;
+        }
+    }
+    object->hash_next = RT_NULL;
+    rt_spin_unlock_irqrestore(&_object_hash_lock, level);
+}
+#endif /* RT_USING_OBJECT_HASH */
+
 #if defined(RT_USING_HOOK) && defined(RT_HOOK_USING_FUNC_PTR)
 static void (*rt_object_attach_hook)(struct rt_object *object);
 static void (*rt_object_detach_hook)(struct rt_object *object);
@@ -401,6 +462,9 @@ void rt_object_init(struct rt_object         *object,
     {
         /* insert object into information object list */
         rt_list_insert_after(&(information->object_list), &(object->list));
+#ifdef RT_USING_OBJECT_HASH
+        _object_hash_insert(object);
+#endif /* RT_USING_OBJECT_HASH */
     }
     rt_spin_unlock_irqrestore(&(information->spinlock), level);
 }
@@ -427,6 +491,9 @@ void rt_object_detach(rt_object_t object)
     level = rt_spin_lock_irqsave(&(information->spinlock));
     /* remove from old list */
     rt_list_remove(&(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _object_hash_remove(object);
+#endif /* RT_USING_OBJECT_HASH */
     rt_spin_unlock_irqrestore(&(information->spinlock), level);
 
     object->type = 0;
@@ -496,6 +563,9 @@ rt_object_t rt_object_allocate(enum rt_object_class_type type, const char *name)
     {
         /* insert object into information object list */
         rt_list_insert_after(&(information->object_list), &(object->list));
+#ifdef RT_USING_OBJECT_HASH
+        _object_hash_insert(object);
+#endif /* RT_USING_OBJECT_HASH */
     }
     rt_spin_unlock_irqrestore(&(information->spinlock), level);
 
@@ -526,6 +596,9 @@ void rt_object_delete(rt_object_t object)
 
     /* remove from old list */
     rt_list_remove(&(object->list));
+#ifdef RT_USING_OBJECT_HASH
+    _object_hash_remove(object);
+#endif /* RT_USING_OBJECT_HASH */
 
     rt_spin_unlock_irqrestore(&(information->spinlock), level);
 
@@ -602,6 +675,21 @@ rt_object_t rt_object_find(const char *name, rt_uint8_t type)
     /* which is invoke in interrupt status */
     RT_DEBUG_NOT_IN_INTERRUPT;
 
+#ifdef RT_USING_OBJECT_HASH
+    level = rt_spin_lock_irqsave(&_object_hash_lock);
+    for (object = _object_hash[_object_hash_index(name, type)]; object != RT_NULL; object = object->hash_next)
+    {
+        if ((object->type & ~RT_Object_Class_Static) == type &&
+            rt_strncmp(object->name, name, RT_NAME_MAX) == 0)
+        {
+            break;
+        }
+    }
+    rt_spin_unlock_irqrestore(&_object_hash_lock, level);
+    RT_UNUSED(node);
+
+    return object;
+#else
     /* enter critical */
     level = rt_spin_lock_irqsave(&(information->spinlock));
 
@@ -620,6 +708,7 @@ rt_object_t rt_object_find(const char *name, rt_uint8_t type)
     rt_spin_unlock_irqrestore(&(information->spinlock), level);
 
     return RT_NULL;
+#endif /* RT_USING_OBJECT_HASH */
 }
 
 /**
@@ -21,6 +21,7 @@
  * 2022-04-19     Stanley      Correct descriptions
  * 2023-09-15     xqyjlj       perf rt_hw_interrupt_disable/enable
  * 2024-01-25     Shell        add RT_TIMER_FLAG_THREAD_TIMER for timer to sync with sched
+ * 2026-10-17     loogg        add hierarchical timing wheel backend
  */
 
 #include <rtthread.h>
@@ -30,8 +31,36 @@
 #define DBG_LVL           DBG_INFO
 #include <rtdbg.h>
 
+#ifdef RT_TIMER_USING_WHEEL
+/*
+ * Hierarchical timing wheel: level 0 has one slot per tick, every upper level slot spans a whole
+ * round of the level below and is spread into it when that level wraps. Start and stop are O(1),
+ * the tick only looks at the slot of the current tick. Timers are kept on their last row.
+ */
+#define _TIMER_WHEEL_BITS       6
+#define _TIMER_WHEEL_SIZE       (1 << _TIMER_WHEEL_BITS)
+#define _TIMER_WHEEL_MASK       (_TIMER_WHEEL_SIZE - 1)
+#define _TIMER_WHEEL_LEVEL      5       /* 2^30 ticks, farther timers wait in the top level */
+
+#define _TIMER_NODE(t)          ((t)->row[RT_TIMER_SKIP_LIST_LEVEL - 1])
+#define _TIMER_SLOT_BIT(idx)    ((rt_uint64_t)1 << (idx))
+
+struct _timer_wheel
+{
+    rt_tick_t   clk;                                            /* next tick to expire */
+    rt_list_t   expired;                                        /* due, timeout function not called yet */
+    rt_uint64_t map[_TIMER_WHEEL_LEVEL];                        /* slots that may be in use */
+    rt_list_t   slot[_TIMER_WHEEL_LEVEL][_TIMER_WHEEL_SIZE];
+};
+typedef struct _timer_wheel _timer_head_t;
+#define _TIMER_HEAD_NUM         1
+#else
+typedef rt_list_t _timer_head_t;
+#define _TIMER_HEAD_NUM         RT_TIMER_SKIP_LIST_LEVEL
+#endif /* RT_TIMER_USING_WHEEL */
+
 /* hard timer list */
-static rt_list_t _timer_list[RT_TIMER_SKIP_LIST_LEVEL];
+static _timer_head_t _timer_list[_TIMER_HEAD_NUM];
 static struct rt_spinlock _htimer_lock;
 
 #ifdef RT_USING_TIMER_SOFT
@@ -45,7 +74,7 @@ static struct rt_spinlock _htimer_lock;
 #endif /* RT_TIMER_THREAD_PRIO */
 
 /* soft timer list */
-static rt_list_t _soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL];
+static _timer_head_t _soft_timer_list[_TIMER_HEAD_NUM];
 static struct rt_spinlock _stimer_lock;
 static struct rt_thread _timer_thread;
 static struct rt_semaphore _soft_timer_sem;
@@ -148,6 +177,250 @@ static void _timer_init(rt_timer_t timer,
     }
 }
 
+#ifdef RT_TIMER_USING_WHEEL
+static void _timer_wheel_init(struct _timer_wheel *wheel)
+{
+    int level, idx;
+
+    wheel->clk = rt_tick_get();
+    rt_list_init(&wheel->expired);
+    for (level = 0; level < _TIMER_WHEEL_LEVEL; level++)
+    {
+        wheel->map[level] = 0;
+        for (idx = 0; idx < _TIMER_WHEEL_SIZE; idx++)
+        {
+            rt_list_init(&wheel->slot[level][idx]);
+        }
+    }
+}
+
+/**
+ * @brief First slot at or after idx that may be in use
+ *
+ * @return the slot index, _TIMER_WHEEL_SIZE if there is none
+ */
+static int _timer_wheel_next_slot(rt_uint64_t map, int idx)
+{
+    rt_uint32_t part;
+
+    if (idx >= _TIMER_WHEEL_SIZE)
+    {
+        return _TIMER_WHEEL_SIZE;
+    }
+
+    map >>= idx;
+    part = (rt_uint32_t)map;
+    if (part)
+    {
+        return idx + __rt_ffs(part) - 1;
+    }
+    part = (rt_uint32_t)(map >> 32);
+    if (part)
+    {
+        return idx + 32 + __rt_ffs(part) - 1;
+    }
+
+    return _TIMER_WHEEL_SIZE;
+}
+
+/**
+ * @brief Move all timers of a slot to the tail of list, order kept
+ */
+rt_inline void _timer_wheel_splice(rt_list_t *slot, rt_list_t *list)
+{
+    rt_list_t *first, *last;
+
+    if (rt_list_isempty(slot))
+    {
+        return;
+    }
+
+    first = slot->next;
+    last = slot->prev;
+    first->prev = list->prev;
+    list->prev->next = first;
+    last->next = list;
+    list->prev = last;
+    rt_list_init(slot);
+}
+
+/**
+ * @brief Put the timer into the slot of its timeout tick, on the lowest level that reaches it
+ */
+static void _timer_wheel_add(struct _timer_wheel *wheel, rt_timer_t timer)
+{
+    rt_tick_t expires = timer->timeout_tick;
+    rt_tick_t delta = expires - wheel->clk;
+    int level = 0, idx;
+
+    if (delta >= RT_TICK_MAX / 2)
+    {
+        /* already due, goes with the next tick */
+        expires = wheel->clk;
+        delta = 0;
+    }
+
+    while (level < _TIMER_WHEEL_LEVEL - 1 && (delta >> ((level + 1) * _TIMER_WHEEL_BITS)))
+    {
+        level++;
+    }
+    idx = (expires >> (level * _TIMER_WHEEL_BITS)) & _TIMER_WHEEL_MASK;
+
+    /* to the tail, timers with the same timeout are called in start order */
+    rt_list_insert_before(&wheel->slot[level][idx], &_TIMER_NODE(timer));
+    wheel->map[level] |= _TIMER_SLOT_BIT(idx);
+}
+
+/**
+ * @brief Spread the current slot of a level into the levels below
+ *
+ * @return the slot index, 0 means this level wrapped too
+ */
+static int _timer_wheel_cascade(struct _timer_wheel *wheel, int level)
+{
+    int idx = (wheel->clk >> (level * _TIMER_WHEEL_BITS)) & _TIMER_WHEEL_MASK;
+    struct rt_timer *t;
+    rt_list_t list;
+
+    rt_list_init(&list);
+    _timer_wheel_splice(&wheel->slot[level][idx], &list);
+    wheel->map[level] &= ~_TIMER_SLOT_BIT(idx);
+
+    while (!rt_list_isempty(&list))
+    {
+        t = rt_list_entry(list.next, struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        rt_list_remove(&_TIMER_NODE(t));
+        _timer_wheel_add(wheel, t);
+    }
+
+    return idx;
+}
+
+/**
+ * @brief Drop the bits of slots emptied by stop, check whether any timer is left
+ */
+static rt_bool_t _timer_wheel_idle(struct _timer_wheel *wheel)
+{
+    int level, idx;
+
+    for (level = 0; level < _TIMER_WHEEL_LEVEL; level++)
+    {
+        for (idx = _timer_wheel_next_slot(wheel->map[level], 0); idx < _TIMER_WHEEL_SIZE;
+             idx = _timer_wheel_next_slot(wheel->map[level], idx + 1))
+        {
+            if (!rt_list_isempty(&wheel->slot[level][idx]))
+            {
+                return RT_FALSE;
+            }
+            wheel->map[level] &= ~_TIMER_SLOT_BIT(idx);
+        }
+    }
+
+    return RT_TRUE;
+}
+
+/**
+ * @brief Turn the wheel up to current_tick, empty slots are skipped
+ *
+ * @return the list of due timers
+ */
+static rt_list_t *_timer_wheel_advance(struct _timer_wheel *wheel, rt_tick_t current_tick)
+{
+    int idx, next, level;
+
+    while ((current_tick - wheel->clk) < RT_TICK_MAX / 2)
+    {
+        idx = wheel->clk & _TIMER_WHEEL_MASK;
+        if (idx == 0)
+        {
+            for (level = 1; level < _TIMER_WHEEL_LEVEL; level++)
+            {
+                if (_timer_wheel_cascade(wheel, level) != 0)
+                {
+                    break;
+                }
+            }
+        }
+
+        _timer_wheel_splice(&wheel->slot[0][idx], &wheel->expired);
+        wheel->map[0] &= ~_TIMER_SLOT_BIT(idx);
+
+        /* the next used slot of this round, or the wrap where the level above comes down */
+        next = _timer_wheel_next_slot(wheel->map[0], idx + 1);
+        if ((next == _TIMER_WHEEL_SIZE && _timer_wheel_idle(wheel)) ||
+            (rt_tick_t)(next - idx) > current_tick - wheel->clk)
+        {
+            wheel->clk = current_tick + 1;
+            break;
+        }
+        wheel->clk += next - idx;
+    }
+
+    return &wheel->expired;
+}
+
+/**
+ * @brief The earliest timeout in the wheel: the first used slot of every level. Once the
+ *        current slot of an upper level is spread out, it only holds timers of a later round.
+ */
+static rt_err_t _timer_wheel_next_timeout(struct _timer_wheel *wheel, rt_tick_t *timeout_tick)
+{
+    struct rt_timer *t, *first = RT_NULL;
+    rt_list_t *slot;
+    int level, cur, n, idx, round;
+
+    if (!rt_list_isempty(&wheel->expired))
+    {
+        first = rt_list_entry(wheel->expired.next, struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        *timeout_tick = first->timeout_tick;
+        return RT_EOK;
+    }
+
+    for (level = 0; level < _TIMER_WHEEL_LEVEL; level++)
+    {
+        if (wheel->map[level] == 0)
+        {
+            continue;
+        }
+
+        cur = (wheel->clk >> (level * _TIMER_WHEEL_BITS)) & _TIMER_WHEEL_MASK;
+        round = (wheel->clk & ((1UL << (level * _TIMER_WHEEL_BITS)) - 1)) ? 1 : 0;
+        for (n = 0; n < _TIMER_WHEEL_SIZE; n++)
+        {
+            idx = (cur + n + round) & _TIMER_WHEEL_MASK;
+            if (!(wheel->map[level] & _TIMER_SLOT_BIT(idx)))
+            {
+                continue;
+            }
+
+            slot = &wheel->slot[level][idx];
+            if (rt_list_isempty(slot))
+            {
+                wheel->map[level] &= ~_TIMER_SLOT_BIT(idx);
+                continue;
+            }
+
+            rt_list_for_each_entry(t, slot, row[RT_TIMER_SKIP_LIST_LEVEL - 1])
+            {
+                if (first == RT_NULL || (t->timeout_tick - first->timeout_tick) >= RT_TICK_MAX / 2)
+                {
+                    first = t;
+                }
+            }
+            break;
+        }
+    }
+
+    if (first == RT_NULL)
+    {
+        return -RT_ERROR;
+    }
+
+    *timeout_tick = first->timeout_tick;
+    return RT_EOK;
+}
+#endif /* RT_TIMER_USING_WHEEL */
+
 /**
  * @brief  Find the next emtpy timer ticks
  *
@@ -158,8 +431,11 @@ static void _timer_init(rt_timer_t timer,
  * @return  Return the operation status. If the return value is RT_EOK, the function is successfully executed.
  *          If the return value is any other values, it means this operation failed.
  */
-static rt_err_t _timer_list_next_timeout(rt_list_t timer_list[], rt_tick_t *timeout_tick)
+static rt_err_t _timer_list_next_timeout(_timer_head_t timer_list[], rt_tick_t *timeout_tick)
 {
+#ifdef RT_TIMER_USING_WHEEL
+    return _timer_wheel_next_timeout(timer_list, timeout_tick);
+#else
     struct rt_timer *timer;
 
     if (!rt_list_isempty(&timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
@@ -170,6 +446,7 @@ static rt_err_t _timer_list_next_timeout(rt_list_t timer_list[], rt_tick_t *time
         return RT_EOK;
     }
     return -RT_ERROR;
+#endif /* RT_TIMER_USING_WHEEL */
 }
 
 /**
@@ -187,7 +464,7 @@ rt_inline void _timer_remove(rt_timer_t timer)
     }
 }
 
-#if (DBG_LVL == DBG_LOG)
+#if (DBG_LVL == DBG_LOG) && !defined(RT_TIMER_USING_WHEEL)
 /**
  * @brief The number of timer
  *
@@ -226,7 +503,7 @@ void rt_timer_dump(rt_list_t timer_heads[])
     }
     rt_kprintf("\n");
 }
-#endif /* (DBG_LVL == DBG_LOG) */
+#endif /* (DBG_LVL == DBG_LOG) && !defined(RT_TIMER_USING_WHEEL) */
 
 /**
  * @addtogroup Clock
@@ -395,12 +672,14 @@ RTM_EXPORT(rt_timer_delete);
  *
  * @return the operation status, RT_EOK on OK, -RT_ERROR on error
  */
-static rt_err_t _timer_start(rt_list_t *timer_list, rt_timer_t timer)
+static rt_err_t _timer_start(_timer_head_t *timer_list, rt_timer_t timer)
 {
+#ifndef RT_TIMER_USING_WHEEL
     unsigned int row_lvl;
     rt_list_t *row_head[RT_TIMER_SKIP_LIST_LEVEL];
     unsigned int tst_nr;
     static unsigned int random_nr;
+#endif /* RT_TIMER_USING_WHEEL */
 
     if (timer->parent.flag & RT_TIMER_FLAG_PROCESSING)
     {
@@ -416,6 +695,9 @@ static rt_err_t _timer_start(rt_list_t *timer_list, rt_timer_t timer)
 
     timer->timeout_tick = rt_tick_get() + timer->init_tick;
 
+#ifdef RT_TIMER_USING_WHEEL
+    _timer_wheel_add(timer_list, timer);
+#else
     row_head[0]  = &timer_list[0];
     for (row_lvl = 0; row_lvl < RT_TIMER_SKIP_LIST_LEVEL; row_lvl++)
     {
@@ -466,6 +748,7 @@ static rt_err_t _timer_start(rt_list_t *timer_list, rt_timer_t timer)
          * bits. */
         tst_nr >>= (RT_TIMER_SKIP_LIST_MASK + 1) >> 1;
     }
+#endif /* RT_TIMER_USING_WHEEL */
 
     timer->parent.flag |= RT_TIMER_FLAG_ACTIVATED;
 
@@ -484,7 +767,7 @@ rt_err_t rt_timer_start(rt_timer_t timer)
     rt_sched_lock_level_t slvl;
     int is_thread_timer = 0;
     struct rt_spinlock *spinlock;
-    rt_list_t *timer_list;
+    _timer_head_t *timer_list;
     rt_base_t level;
     rt_err_t err;
 
@@ -673,6 +956,7 @@ void rt_timer_check(void)
     rt_tick_t current_tick;
     rt_base_t level;
     rt_list_t list;
+    rt_list_t *due;
 
     RT_ASSERT(rt_interrupt_get_nest() > 0);
 
@@ -693,10 +977,15 @@ void rt_timer_check(void)
 
     rt_list_init(&list);
 
-    while (!rt_list_isempty(&_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
+#ifdef RT_TIMER_USING_WHEEL
+    due = _timer_wheel_advance(_timer_list, current_tick);
+#else
+    due = &_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1];
+#endif /* RT_TIMER_USING_WHEEL */
+
+    while (!rt_list_isempty(due))
     {
-        t = rt_list_entry(_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1].next,
-                          struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        t = rt_list_entry(due->next, struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
 
         /*
          * It supposes that the new tick shall less than the half duration of
@@ -777,15 +1066,21 @@ static void _soft_timer_check(void)
     struct rt_timer *t;
     rt_base_t level;
     rt_list_t list;
+    rt_list_t *due;
 
     rt_list_init(&list);
     LOG_D("software timer check enter");
     level = rt_spin_lock_irqsave(&_stimer_lock);
 
-    while (!rt_list_isempty(&_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1]))
+#ifdef RT_TIMER_USING_WHEEL
+    due = _timer_wheel_advance(_soft_timer_list, rt_tick_get());
+#else
+    due = &_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1];
+#endif /* RT_TIMER_USING_WHEEL */
+
+    while (!rt_list_isempty(due))
     {
-        t = rt_list_entry(_soft_timer_list[RT_TIMER_SKIP_LIST_LEVEL - 1].next,
-                            struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
+        t = rt_list_entry(due->next, struct rt_timer, row[RT_TIMER_SKIP_LIST_LEVEL - 1]);
 
         current_tick = rt_tick_get();
 
@@ -896,12 +1191,16 @@ static void _timer_thread_entry(void *parameter)
  */
 void rt_system_timer_init(void)
 {
+#ifdef RT_TIMER_USING_WHEEL
+    _timer_wheel_init(_timer_list);
+#else
     rt_size_t i;
 
     for (i = 0; i < sizeof(_timer_list) / sizeof(_timer_list[0]); i++)
     {
         rt_list_init(_timer_list + i);
     }
+#endif /* RT_TIMER_USING_WHEEL */
     rt_spin_lock_init(&_htimer_lock);
 }
 
@@ -913,6 +1212,9 @@ void rt_system_timer_init(void)
 void rt_system_timer_thread_init(void)
 {
 #ifdef RT_USING_TIMER_SOFT
+#ifdef RT_TIMER_USING_WHEEL
+    _timer_wheel_init(_soft_timer_list);
+#else
     int i;
 
     for (i = 0;
@@ -921,6 +1223,7 @@ void rt_system_timer_thread_init(void)
     {
         rt_list_init(_soft_timer_list + i);
     }
+#endif /* RT_TIMER_USING_WHEEL */
     rt_spin_lock_init(&_stimer_lock);
     rt_sem_init(&_soft_timer_sem, "stimer", 0, RT_IPC_FLAG_PRIO);
     /* start software timer thread */